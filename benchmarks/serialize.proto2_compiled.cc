@@ -0,0 +1,43 @@
+
+#include "main.c"
+#include MESSAGE_HFILE
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+
+static std::string str;
+static MESSAGE_CIDENT msg;
+
+static bool initialize()
+{
+  // Read the message data itself. */
+  std::ifstream stream(MESSAGE_FILE);
+  if(!stream.is_open()) {
+    fprintf(stderr, "Error opening " MESSAGE_FILE ".\n");
+    return false;
+  }
+  std::stringstream stringstream;
+  stringstream << stream.rdbuf();
+  if(!msg.ParsePartialFromString(stringstream.str())) {
+    fprintf(stderr, "Error parsing with proto2.\n");
+    return false;
+  }
+  return true;
+}
+
+static void cleanup()
+{
+}
+
+// Serializing computes (and caches) the size of every submessage in one pass,
+// and then writes the message front to back in another.
+static size_t run(int i)
+{
+  (void)i;
+  if(!msg.SerializePartialToString(&str)) {
+    fprintf(stderr, "Error serializing with proto2.\n");
+    return 0;
+  }
+  return str.size();
+}
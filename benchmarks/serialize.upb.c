@@ -0,0 +1,125 @@
+
+#include "main.c"
+
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/def.h"
+#include "upb/pb/decoder.h"
+#include "upb/pb/encoder.h"
+#include "upb/pb/glue.h"
+#include "upb/shim/shim.h"
+
+static upb_pipeline arena;
+static const upb_handlers *handlers;
+static upb_pbencoder *encoder;
+static upb_pbencbuf buf;
+static char *span;  // With SPAN, the caller's buffer, sized exactly.
+static size_t span_len;
+static void *msg;
+
+static void *arenaalloc(void *ud, void *ptr, size_t oldsize, size_t size) {
+  return upb_pipeline_realloc(ud, ptr, oldsize, size);
+}
+
+static bool initialize()
+{
+  // Initialize upb state, decode descriptor.
+  upb_status status = UPB_STATUS_INIT;
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_load_descriptor_file_into_symtab(s, MESSAGE_DESCRIPTOR_FILE, &status);
+  if(!upb_ok(&status)) {
+    fprintf(stderr, "Error reading descriptor: %s\n",
+            upb_status_getstr(&status));
+    return false;
+  }
+
+  const upb_msgdef *def =
+      upb_dyncast_msgdef(upb_symtab_lookup(s, MESSAGE_NAME, &def));
+  if(!def) {
+    fprintf(stderr, "Error finding symbol '%s'.\n", MESSAGE_NAME);
+    return false;
+  }
+  upb_symtab_unref(s, &s);
+
+  // Read the message data itself.
+  size_t input_len;
+  char *input_str = upb_readfile(MESSAGE_FILE, &input_len);
+  if(input_str == NULL) {
+    fprintf(stderr, "Error reading " MESSAGE_FILE "\n");
+    return false;
+  }
+
+  // Decode it once into a struct, which is what each run serializes.
+  upb_pipeline_init(&arena, NULL, 0, upb_realloc, NULL);
+  static upb_shim_alloc alloc = {arenaalloc, &arena};
+  handlers = upb_handlers_newfrozen(def, NULL, &handlers,
+                                    &upb_shim_structhandlers, &alloc);
+  size_t size = upb_shim_structsize(def);
+  msg = upb_pipeline_alloc(&arena, size);
+  memset(msg, 0, size);
+  upb_msgdef_unref(def, &def);
+
+  const upb_handlers *decoder_handlers =
+      upb_pbdecoder_gethandlers(handlers, false, &decoder_handlers);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, handlers);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_handlers);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  upb_sink_reset(sink, msg);
+  bool ok = upb_bytestream_putstr(decoder_sink, input_str, input_len);
+  if (!ok) {
+    fprintf(stderr, "Decode error: %s",
+            upb_status_getstr(upb_pipeline_status(&pipeline)));
+  }
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_handlers, &decoder_handlers);
+  free(input_str);
+  if (!ok) return false;
+
+  encoder = upb_pbencoder_new(handlers, &status);
+  if (!encoder) {
+    fprintf(stderr, "Error creating encoder: %s\n",
+            upb_status_getstr(&status));
+    return false;
+  }
+  upb_pbencbuf_init(&buf);
+  if (SPAN) {
+    if (!upb_pbencoder_size(encoder, msg, &span_len, &status)) {
+      fprintf(stderr, "Size error: %s\n", upb_status_getstr(&status));
+      return false;
+    }
+    span = malloc(span_len);
+  }
+  return true;
+}
+
+static void cleanup()
+{
+  free(span);
+  upb_pbencbuf_uninit(&buf);
+  upb_pbencoder_free(encoder);
+  upb_handlers_unref(handlers, &handlers);
+  upb_pipeline_uninit(&arena);
+}
+
+static size_t run(int i)
+{
+  (void)i;
+  upb_status status = UPB_STATUS_INIT;
+  if (SPAN) {
+    size_t len;
+    if (!upb_pbencoder_encodeto(encoder, msg, span, span_len, &len,
+                                &status)) {
+      fprintf(stderr, "Encode error: %s", upb_status_getstr(&status));
+      return 0;
+    }
+    return len;
+  }
+  if (!upb_pbencoder_encode(encoder, msg, &buf, &status)) {
+    fprintf(stderr, "Encode error: %s", upb_status_getstr(&status));
+    return 0;
+  }
+  return upb_pbencbuf_len(&buf);
+}
@@ -19,6 +19,8 @@
 
 #include <float.h>
 #include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "lauxlib.h"
@@ -140,6 +142,193 @@ static int lupbtable_enumdef_ntoi(lua_State *L) {
   return 1;
 }
 
+
+/* C initializer dumping ******************************************************/
+
+// Building a Lua table for every entry and formatting it from Lua dominates
+// the time it takes to dump large schemas, so these format a def's tables
+// directly into C initializers.  "addrs" maps def wrappers to the C
+// expressions for their addresses, and "state" holds the shared entry arrays:
+//
+//   strsym, intsym, arrsym:    C symbols of the shared entry arrays.
+//   strbase, intbase, arrbase: next free offset in each array (updated).
+//   strbuf, intbuf, arrbuf:    arrays of strings that initializers for the
+//                              entries are appended to (one per table).
+
+// Formats like lua_pushfstring(), so any length of symbol fits.
+static void lupbtable_addf(lua_State *L, luaL_Buffer *b, const char *fmt,
+                           ...) {
+  va_list args;
+  va_start(args, fmt);
+  lua_pushvfstring(L, fmt, args);
+  va_end(args);
+  luaL_addvalue(b);
+}
+
+static void lupbtable_addval(lua_State *L, luaL_Buffer *b, _upb_value val,
+                             upb_ctype_t type, int addrs) {
+  switch (type) {
+    case UPB_CTYPE_INT32:
+      lupbtable_addf(L, b, "UPB_VALUE_INIT_INT32(%d)", (int)val.int32);
+      break;
+    case UPB_CTYPE_PTR:
+      luaL_addstring(b, "UPB_VALUE_INIT_CONSTPTR(");
+      lupb_def_pushwrapper(L, val.ptr, NULL);
+      lua_rawget(L, addrs);
+      if (!lua_isstring(L, -1)) luaL_error(L, "unknown object");
+      luaL_addvalue(b);
+      luaL_addchar(b, ')');
+      break;
+    case UPB_CTYPE_CSTR:
+      luaL_addstring(b, "UPB_VALUE_INIT_CONSTPTR(\"");
+      luaL_addstring(b, val.cstr);
+      luaL_addstring(b, "\")");
+      break;
+    default:
+      luaL_error(L, "Unexpected type: %d", type);
+  }
+}
+
+static lua_Number lupbtable_getnum(lua_State *L, int tab, const char *key) {
+  lua_getfield(L, tab, key);
+  lua_Number ret = luaL_checknumber(L, -1);
+  lua_pop(L, 1);
+  return ret;
+}
+
+// Appends the string on the top of the stack to the array state[key].
+static void lupbtable_appendstr(lua_State *L, int state, const char *key) {
+  lua_getfield(L, state, key);
+  lua_insert(L, -2);
+  lua_rawseti(L, -2, lua_rawlen(L, -2) + 1);
+  lua_pop(L, 1);
+}
+
+// Appends initializers for the table's hash entries to state[bufkey] and
+// pushes the address of the first entry (or NULL).
+static void lupbtable_dumpentries(lua_State *L, const upb_table *t,
+                                  bool inttab, int addrs, int state,
+                                  const char *symkey, const char *basekey,
+                                  const char *bufkey) {
+  lua_getfield(L, state, symkey);
+  const char *sym = luaL_checkstring(L, -1);
+  int base = lupbtable_getnum(L, state, basekey);
+  size_t size = upb_table_size(t);
+
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+  for (size_t i = 0; i < size; i++) {
+    const upb_tabent *e = &t->entries[i];
+    luaL_addstring(&b, "  {");
+    if (upb_tabent_isempty(e)) {
+      luaL_addstring(&b, "UPB_TABKEY_NONE, UPB__VALUE_INIT_NONE");
+    } else {
+      if (inttab) {
+        // lua_pushfstring() has no %lu; a number can't overflow this.
+        char num[32];
+        snprintf(num, sizeof(num), "%lu", (unsigned long)e->key.num);
+        lupbtable_addf(L, &b, "UPB_TABKEY_NUM(%s)", num);
+      } else {
+        luaL_addstring(&b, "UPB_TABKEY_STR(\"");
+        luaL_addstring(&b, e->key.str);
+        luaL_addstring(&b, "\")");
+      }
+      luaL_addstring(&b, ", ");
+      lupbtable_addval(L, &b, e->val, t->type, addrs);
+    }
+    if (e->next) {
+      lupbtable_addf(L, &b, ", &%s[%d]},\n", sym,
+                     base + (int)(e->next - t->entries));
+    } else {
+      luaL_addstring(&b, ", NULL},\n");
+    }
+  }
+  luaL_pushresult(&b);
+  lupbtable_appendstr(L, state, bufkey);
+
+  lua_pushnumber(L, base + size);
+  lua_setfield(L, state, basekey);
+
+  if (size > 0) {
+    lua_pushfstring(L, "&%s[%d]", sym, base);
+  } else {
+    lua_pushliteral(L, "NULL");
+  }
+  lua_remove(L, -2);  // sym
+}
+
+static void lupbtable_pushstrcinit(lua_State *L, const upb_strtable *t,
+                                   int addrs, int state) {
+  lupbtable_dumpentries(L, &t->t, false, addrs, state,
+                        "strsym", "strbase", "strbuf");
+  const char *entries = lua_tostring(L, -1);
+  lua_pushfstring(L, "UPB_STRTABLE_INIT(%d, %d, %d, %d, %s)",
+                  (int)t->t.count, (int)t->t.mask, (int)t->t.type,
+                  (int)t->t.size_lg2, entries);
+  lua_remove(L, -2);
+}
+
+static void lupbtable_pushintcinit(lua_State *L, const upb_inttable *t,
+                                   int addrs, int state) {
+  lupbtable_dumpentries(L, &t->t, true, addrs, state,
+                        "intsym", "intbase", "intbuf");
+
+  lua_getfield(L, state, "arrsym");
+  const char *sym = luaL_checkstring(L, -1);
+  int base = lupbtable_getnum(L, state, "arrbase");
+
+  luaL_Buffer b;
+  luaL_buffinit(L, &b);
+  for (size_t i = 0; i < t->array_size; i++) {
+    if (upb_arrhas(t->array[i])) {
+      luaL_addstring(&b, "  ");
+      lupbtable_addval(L, &b, t->array[i], t->t.type, addrs);
+      luaL_addstring(&b, ",\n");
+    } else {
+      luaL_addstring(&b, "  UPB_ARRAY_EMPTYENT,\n");
+    }
+  }
+  luaL_pushresult(&b);
+  lupbtable_appendstr(L, state, "arrbuf");
+
+  lua_pushnumber(L, base + t->array_size);
+  lua_setfield(L, state, "arrbase");
+
+  // Stack: entries, sym.
+  const char *entries = lua_tostring(L, -2);
+  if (t->array_size > 0) {
+    lua_pushfstring(L, "&%s[%d]", sym, base);
+  } else {
+    lua_pushliteral(L, "NULL");
+  }
+  lua_pushfstring(L, "UPB_INTTABLE_INIT(%d, %d, %d, %d, %s, %s, %d, %d)",
+                  (int)t->t.count, (int)t->t.mask, (int)t->t.type,
+                  (int)t->t.size_lg2, entries, lua_tostring(L, -1),
+                  (int)t->array_size, (int)t->array_count);
+  lua_replace(L, -4);
+  lua_pop(L, 2);
+}
+
+// upbtable.msgdef_cinit(msgdef, addrs, state) -> itof_init, ntof_init
+static int lupbtable_msgdef_cinit(lua_State *L) {
+  const upb_msgdef *m = lupb_msgdef_check(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  luaL_checktype(L, 3, LUA_TTABLE);
+  lupbtable_pushintcinit(L, &m->itof, 2, 3);
+  lupbtable_pushstrcinit(L, &m->ntof, 2, 3);
+  return 2;
+}
+
+// upbtable.enumdef_cinit(enumdef, addrs, state) -> iton_init, ntoi_init
+static int lupbtable_enumdef_cinit(lua_State *L) {
+  const upb_enumdef *e = lupb_enumdef_check(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  luaL_checktype(L, 3, LUA_TTABLE);
+  lupbtable_pushintcinit(L, &e->iton, 2, 3);
+  lupbtable_pushstrcinit(L, &e->ntoi, 2, 3);
+  return 2;
+}
+
 static void lupbtable_setfieldi(lua_State *L, const char *field, int i) {
   lua_pushnumber(L, i);
   lua_setfield(L, -2, field);
@@ -150,6 +339,8 @@ static const struct luaL_Reg lupbtable_toplevel_m[] = {
   {"msgdef_ntof", lupbtable_msgdef_ntof},
   {"enumdef_iton", lupbtable_enumdef_iton},
   {"enumdef_ntoi", lupbtable_enumdef_ntoi},
+  {"msgdef_cinit", lupbtable_msgdef_cinit},
+  {"enumdef_cinit", lupbtable_enumdef_cinit},
   {NULL, NULL}
 };
 
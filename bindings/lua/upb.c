@@ -10,6 +10,7 @@
 
 #include <float.h>
 #include <math.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "lauxlib.h"
@@ -574,6 +575,15 @@ static int lupb_fielddef_type(lua_State *L) {
   return 1;
 }
 
+static int lupb_fielddef_descriptortype(lua_State *L) {
+  const upb_fielddef *f = lupb_fielddef_check(L, 1);
+  if (upb_fielddef_typeisset(f))
+    lua_pushnumber(L, upb_fielddef_descriptortype(f));
+  else
+    lua_pushnil(L);
+  return 1;
+}
+
 static int lupb_fielddef_intfmt(lua_State *L) {
   const upb_fielddef *f = lupb_fielddef_check(L, 1);
   lua_pushnumber(L, upb_fielddef_intfmt(f));
@@ -586,6 +596,22 @@ static int lupb_fielddef_istagdelim(lua_State *L) {
   return 1;
 }
 
+static int lupb_fielddef_isextension(lua_State *L) {
+  const upb_fielddef *f = lupb_fielddef_check(L, 1);
+  lua_pushboolean(L, upb_fielddef_isextension(f));
+  return 1;
+}
+
+static int lupb_fielddef_containingtypename(lua_State *L) {
+  const upb_fielddef *f = lupb_fielddef_check(L, 1);
+  const char *name = upb_fielddef_containingtypename(f);
+  if (name)
+    lua_pushstring(L, name);
+  else
+    lua_pushnil(L);
+  return 1;
+}
+
 static int lupb_fielddef_gc(lua_State *L) {
   lupb_refcounted *r = luaL_checkudata(L, 1, LUPB_FIELDDEF);
   upb_def_unref(r->def, r);
@@ -596,10 +622,13 @@ static int lupb_fielddef_gc(lua_State *L) {
 static const struct luaL_Reg lupb_fielddef_m[] = {
   LUPB_COMMON_DEF_METHODS
 
+  {"containing_type_name", lupb_fielddef_containingtypename},
   {"default", lupb_fielddef_default},
+  {"descriptor_type", lupb_fielddef_descriptortype},
   {"getsel", lupb_fielddef_getsel},
   {"has_subdef", lupb_fielddef_hassubdef},
   {"intfmt", lupb_fielddef_intfmt},
+  {"is_extension", lupb_fielddef_isextension},
   {"istagdelim", lupb_fielddef_istagdelim},
   {"label", lupb_fielddef_label},
   {"msgdef", lupb_fielddef_msgdef},
@@ -710,12 +739,45 @@ static int lupb_msgdef_len(lua_State *L) {
   return 1;
 }
 
+// Returned as a list of {start, end} pairs, each range being [start, end).
+static int lupb_msgdef_extensionranges(lua_State *L) {
+  const upb_msgdef *m = lupb_msgdef_check(L, 1);
+  int n = upb_msgdef_extrangecount(m);
+  lua_createtable(L, n, 0);
+  for (int i = 0; i < n; i++) {
+    const upb_extrange *r = upb_msgdef_extrange(m, i);
+    lua_createtable(L, 2, 0);
+    lua_pushnumber(L, r->start);
+    lua_rawseti(L, -2, 1);
+    lua_pushnumber(L, r->end);
+    lua_rawseti(L, -2, 2);
+    lua_rawseti(L, -2, i + 1);
+  }
+  return 1;
+}
+
+static int lupb_msgdef_mapentry(lua_State *L) {
+  const upb_msgdef *m = lupb_msgdef_check(L, 1);
+  lua_pushboolean(L, upb_msgdef_mapentry(m));
+  return 1;
+}
+
 static int lupb_msgdef_selectorcount(lua_State *L) {
   const upb_msgdef *m = lupb_msgdef_check(L, 1);
   lua_pushinteger(L, m->selector_count);
   return 1;
 }
 
+// Returned as a hex string since a Lua number cannot hold all 64 bits.
+static int lupb_msgdef_fingerprint(lua_State *L) {
+  const upb_msgdef *m = lupb_msgdef_check(L, 1);
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016llx",
+           (unsigned long long)upb_msgdef_fingerprint(m));
+  lua_pushstring(L, buf);
+  return 1;
+}
+
 static int lupb_msgdef_field(lua_State *L) {
   const upb_msgdef *m = lupb_msgdef_check(L, 1);
   int type = lua_type(L, 2);
@@ -759,11 +821,14 @@ static const struct luaL_Reg lupb_msgdef_mm[] = {
 static const struct luaL_Reg lupb_msgdef_m[] = {
   LUPB_COMMON_DEF_METHODS
   {"add", lupb_msgdef_add},
+  {"extension_ranges", lupb_msgdef_extensionranges},
   {"field", lupb_msgdef_field},
   {"fields", lupb_msgdef_fields},
+  {"map_entry", lupb_msgdef_mapentry},
 
   // Internal-only.
   {"_selector_count", lupb_msgdef_selectorcount},
+  {"_fingerprint", lupb_msgdef_fingerprint},
 
   {NULL, NULL}
 };
@@ -0,0 +1,235 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Tests for the C++20 coroutine front end to the decoder.
+ */
+
+#include <string.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+#include "upb/descriptor/descriptor.upb.h"
+#include "upb/pb/async.h"
+#include "upb/pb/decoder.h"
+#include "upb_test.h"
+
+// Coroutines waiting to be resumed; stands in for an event loop.
+static std::deque<std::coroutine_handle<> > ready;
+
+static void RunUntilDone(upb::pb::AsyncDecode* task) {
+  task->Resume();
+  while (!task->done()) {
+    ASSERT(!ready.empty());
+    std::coroutine_handle<> h = ready.front();
+    ready.pop_front();
+    h.resume();
+  }
+  ASSERT(ready.empty());
+}
+
+// Suspends the awaiting coroutine until the event loop gets to it.
+struct Yield {
+  bool await_ready() { return false; }
+  void await_suspend(std::coroutine_handle<> h) { ready.push_back(h); }
+  void await_resume() {}
+};
+
+// Hands out a buffer "chunk" bytes at a time, suspending before each one as if
+// it were waiting for the network.
+class ChunkedSource {
+ public:
+  ChunkedSource(const std::string& data, size_t chunk)
+      : data_(data), ofs_(0), chunk_(chunk), reads_(0) {}
+
+  struct ReadAwaiter : public Yield {
+    ChunkedSource* source;
+    upb::pb::AsyncBuffer await_resume() {
+      upb::pb::AsyncBuffer buf;
+      buf.size = std::min(source->chunk_, source->data_.size() - source->ofs_);
+      // A fresh copy each time, so that the decoder can't rely on earlier
+      // buffers staying around.
+      source->buf_.assign(source->data_, source->ofs_, buf.size);
+      buf.data = source->buf_.data();
+      source->ofs_ += buf.size;
+      return buf;
+    }
+  };
+
+  ReadAwaiter Read() {
+    reads_++;
+    ReadAwaiter r;
+    r.source = this;
+    return r;
+  }
+
+  int reads() const { return reads_; }
+
+ private:
+  std::string data_;
+  std::string buf_;
+  size_t ofs_;
+  size_t chunk_;
+  int reads_;
+};
+
+// Like ChunkedSource, but also yields whenever the consumer applies
+// backpressure.
+class PatientSource : public ChunkedSource {
+ public:
+  PatientSource(const std::string& data, size_t chunk)
+      : ChunkedSource(data, chunk), waits_(0) {}
+
+  Yield WaitForConsumer() {
+    waits_++;
+    return Yield();
+  }
+
+  int waits() const { return waits_; }
+
+ private:
+  int waits_;
+};
+
+struct Names {
+  std::string name;
+  std::string field_names;
+  int calls;
+  bool throttle;  // Take at most 3 bytes per call, and none every third call.
+};
+
+static size_t PutName(void* c, const void* hd, const char* buf, size_t n) {
+  UPB_UNUSED(hd);
+  Names* names = static_cast<Names*>(c);
+  if (names->throttle) {
+    if (++names->calls % 3 == 0) return 0;
+    n = std::min<size_t>(n, 3);
+  }
+  names->name.append(buf, n);
+  return n;
+}
+
+static size_t PutFieldName(void* c, const void* hd, const char* buf,
+                           size_t n) {
+  UPB_UNUSED(hd);
+  static_cast<Names*>(c)->field_names.append(buf, n);
+  return n;
+}
+
+static void* StartField(void* c, const void* hd) {
+  UPB_UNUSED(hd);
+  return c;
+}
+
+static void SetHandlers(void* closure, upb_handlers* h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef* m = upb_handlers_msgdef(h);
+  if (m == GOOGLE_PROTOBUF_DESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &PutName, NULL, NULL);
+    upb_handlers_setstartsubmsg(h, upb_msgdef_itof(m, 2), &StartField, NULL,
+                                NULL);
+  } else if (m == GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &PutFieldName, NULL,
+                           NULL);
+  }
+}
+
+// DescriptorProto { name: "Message" field { name: "abc" } }
+static const std::string kInput("\x0a\x07Message\x12\x05\x0a\x03" "abc", 16);
+
+// An outer coroutine, to check that DecodeAsync() can itself be awaited.
+template <class Source>
+static upb::pb::AsyncDecode Outer(upb::Sink* sink, Source* source) {
+  bool ok = co_await upb::pb::DecodeAsync(sink, source);
+  co_return ok;
+}
+
+// Returns whether the decode succeeded, having checked that if it did, it
+// decoded everything.
+template <class Source>
+static bool TestDecode(const upb::Handlers* h, Source* source, bool throttle,
+                       bool nested) {
+  const upb::Handlers* decoder_h = upb::pb::GetDecoderHandlers(h, false, &h);
+  upb::SeededPipeline<2048> pipeline(upb_realloc, NULL);
+  upb::Sink* sink = pipeline.NewSink(h);
+  upb::Sink* decoder_sink = pipeline.NewSink(decoder_h);
+  upb::pb::ResetDecoderSink(decoder_sink->GetObject<upb::pb::Decoder>(), sink);
+  Names names;
+  names.calls = 0;
+  names.throttle = throttle;
+  sink->Reset(&names);
+
+  upb::pb::AsyncDecode task =
+      nested ? Outer(decoder_sink, source)
+             : upb::pb::DecodeAsync(decoder_sink, source);
+  RunUntilDone(&task);
+  ASSERT(pipeline.status().ok());
+  if (task.result()) {
+    ASSERT(names.name == "Message");
+    ASSERT(names.field_names == "abc");
+  }
+  decoder_h->Unref(&h);
+  return task.result();
+}
+
+static void TestAsync() {
+  const upb::Handlers* h = upb::Handlers::NewFrozen(
+      GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h, &SetHandlers, NULL);
+
+  for (size_t chunk = 1; chunk <= kInput.size(); chunk++) {
+    for (int nested = 0; nested < 2; nested++) {
+      ChunkedSource source(kInput, chunk);
+      ASSERT(TestDecode(h, &source, false, nested));
+      // One read per chunk, plus one for the end of the stream.
+      ASSERT(source.reads() == (int)((kInput.size() + chunk - 1) / chunk + 1));
+    }
+
+    PatientSource patient(kInput, chunk);
+    ASSERT(TestDecode(h, &patient, true, false));
+    if (chunk > 1) ASSERT(patient.waits() > 0);
+
+    // Without WaitForConsumer() there is nothing to wait on when the handler
+    // takes nothing, so rather than spinning the decode fails.
+    ChunkedSource impatient(kInput, chunk);
+    ASSERT(!TestDecode(h, &impatient, true, false));
+  }
+
+  h->Unref(&h);
+}
+
+static void TestAsyncError() {
+  const upb::Handlers* h = upb::Handlers::NewFrozen(
+      GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h, &SetHandlers, NULL);
+  const upb::Handlers* decoder_h = upb::pb::GetDecoderHandlers(h, false, &h);
+  upb::SeededPipeline<2048> pipeline(upb_realloc, NULL);
+  upb::Sink* sink = pipeline.NewSink(h);
+  upb::Sink* decoder_sink = pipeline.NewSink(decoder_h);
+  upb::pb::ResetDecoderSink(decoder_sink->GetObject<upb::pb::Decoder>(), sink);
+  Names names;
+  names.calls = 0;
+  names.throttle = false;
+  sink->Reset(&names);
+
+  // Ends in the middle of the name.
+  ChunkedSource source(kInput.substr(0, 5), 2);
+  upb::pb::AsyncDecode task = upb::pb::DecodeAsync(decoder_sink, &source);
+  RunUntilDone(&task);
+  ASSERT(!task.result());
+  ASSERT(!pipeline.status().ok());
+
+  decoder_h->Unref(&h);
+  h->Unref(&h);
+}
+
+extern "C" {
+
+int run_tests(int argc, char *argv[]) {
+  UPB_UNUSED(argc);
+  UPB_UNUSED(argv);
+  TestAsync();
+  TestAsyncError();
+  return 0;
+}
+
+}
@@ -0,0 +1,215 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Tests of the structs and shim registration that tools/dump_cstruct.lua
+ * generates, using the checked-in output for tests/test_cstruct.proto.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/pb/decoder.h"
+#include "upb/shim/shim.h"
+#include "upb/symtab.h"
+#include "upb_test.h"
+#include "test_cstruct.upb_struct.h"
+
+// Structs are allocated from this pipeline, which frees them all at the end.
+static upb_pipeline arena;
+
+static void *arenaalloc(void *ud, void *ptr, size_t oldsize, size_t size) {
+  return upb_pipeline_realloc(ud, ptr, oldsize, size);
+}
+
+static upb_fielddef *newfield(const char *name, int32_t num, uint8_t type,
+                              uint8_t label, const char *subdef, void *owner) {
+  upb_fielddef *f = upb_fielddef_new(owner);
+  ASSERT(upb_fielddef_setname(f, name, NULL));
+  ASSERT(upb_fielddef_setnumber(f, num, NULL));
+  upb_fielddef_setdescriptortype(f, type);
+  upb_fielddef_setlabel(f, label);
+  if (subdef) ASSERT(upb_fielddef_setsubdefname(f, subdef, NULL));
+  return f;
+}
+
+// Builds the messages of tests/test_cstruct.proto, and returns cstruct.Outer.
+static const upb_msgdef *newouter(const void *owner) {
+  static const struct {
+    const char *name;
+    uint8_t type;
+    bool repeated;
+    const char *subdef;
+  } fields[] = {
+    {"i32", UPB_DESCRIPTOR_TYPE_INT32, false, NULL},
+    {"d", UPB_DESCRIPTOR_TYPE_DOUBLE, false, NULL},
+    {"b", UPB_DESCRIPTOR_TYPE_BOOL, false, NULL},
+    {"s", UPB_DESCRIPTOR_TYPE_STRING, false, NULL},
+    {"inner", UPB_DESCRIPTOR_TYPE_MESSAGE, false, ".cstruct.Inner"},
+    {"r64", UPB_DESCRIPTOR_TYPE_INT64, true, NULL},
+    {"rs", UPB_DESCRIPTOR_TYPE_STRING, true, NULL},
+    {"rinner", UPB_DESCRIPTOR_TYPE_MESSAGE, true, ".cstruct.Inner"},
+    {"u32", UPB_DESCRIPTOR_TYPE_UINT32, false, NULL},
+    {"outer", UPB_DESCRIPTOR_TYPE_MESSAGE, false, ".cstruct.Outer"},
+  };
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_msgdef *outer = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(outer), "cstruct.Outer", NULL));
+  for (int i = 0; i < 10; i++) {
+    uint8_t label = fields[i].repeated ? UPB_LABEL_REPEATED
+                                       : UPB_LABEL_OPTIONAL;
+    upb_msgdef_addfield(outer, newfield(fields[i].name, i + 1, fields[i].type,
+                                        label, fields[i].subdef, &s),
+                        &s, NULL);
+  }
+  upb_msgdef *inner = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(inner), "cstruct.Inner", NULL));
+  upb_msgdef_addfield(inner,
+                      newfield("a", 1, UPB_DESCRIPTOR_TYPE_INT64,
+                               UPB_LABEL_OPTIONAL, NULL, &s),
+                      &s, NULL);
+  upb_msgdef_addfield(inner,
+                      newfield("data", 2, UPB_DESCRIPTOR_TYPE_BYTES,
+                               UPB_LABEL_OPTIONAL, NULL, &s),
+                      &s, NULL);
+
+  upb_def *defs[2] = {upb_upcast(outer), upb_upcast(inner)};
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 2, &s, &status), &status);
+  const upb_msgdef *ret = upb_symtab_lookupmsg(s, "cstruct.Outer", owner);
+  upb_symtab_unref(s, &s);
+  return ret;
+}
+
+static const upb_handlers *newhandlers(const upb_msgdef *m,
+                                       const void *owner) {
+  static upb_shim_alloc alloc = {arenaalloc, &arena};
+  return upb_handlers_newfrozen(m, NULL, owner, &test_cstruct_shimhandlers,
+                                &alloc);
+}
+
+// Decodes "buf" into a new struct, passing it to the decoder "chunk" bytes at
+// a time.
+static cstruct_Outer *decode(const upb_handlers *h, bool allowjit,
+                             const char *buf, size_t len, size_t chunk) {
+  cstruct_Outer *msg = upb_pipeline_alloc(&arena, sizeof(*msg));
+  memset(msg, 0, sizeof(*msg));
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, allowjit, &h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  upb_sink_reset(sink, msg);
+  ASSERT(upb_sink_startmsg(decoder_sink));
+  ASSERT(upb_sink_startstr(decoder_sink, UPB_BYTESTREAM_BYTES_STARTSTR, len));
+  for (size_t ofs = 0; ofs < len; ofs += chunk) {
+    size_t n = UPB_MIN(len - ofs, chunk);
+    ASSERT(upb_sink_putstring(decoder_sink, UPB_BYTESTREAM_BYTES_STRING,
+                              buf + ofs, n) == n);
+  }
+  ASSERT(upb_sink_endstr(decoder_sink, UPB_BYTESTREAM_BYTES_ENDSTR));
+  upb_sink_endmsg(decoder_sink);
+  ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+  return msg;
+}
+
+static bool streq(const upb_shim_str *str, const char *expected) {
+  return str->len == strlen(expected) &&
+         memcmp(str->ptr, expected, str->len) == 0;
+}
+
+// The generated structs are interchangeable with the ones that
+// upb_shim_setstruct() lays out at runtime.
+static void test_layout() {
+  const upb_msgdef *m = newouter(&m);
+  const upb_msgdef *inner =
+      upb_downcast_msgdef(upb_fielddef_subdef(upb_msgdef_itof(m, 5)));
+  ASSERT(upb_shim_structsize(m) == sizeof(cstruct_Outer));
+  ASSERT(upb_shim_structsize(inner) == sizeof(cstruct_Inner));
+  ASSERT(offsetof(cstruct_Outer, d) == 8);
+
+  const upb_handlers *h = newhandlers(m, &h);
+  static upb_shim_alloc alloc = {arenaalloc, &arena};
+  const upb_handlers *rt = upb_handlers_newfrozen(
+      m, NULL, &rt, &upb_shim_structhandlers, &alloc);
+  for (uint32_t i = 1; i <= 10; i++) {
+    const upb_fielddef *f = upb_msgdef_itof(m, i);
+    const upb_shim_data *d1 = upb_shim_getfielddata(h, f);
+    const upb_shim_data *d2 = upb_shim_getfielddata(rt, f);
+    ASSERT(d1 && d2);
+    ASSERT(d1->offset == d2->offset && d1->hasbit == d2->hasbit);
+  }
+  upb_handlers_unref(rt, &rt);
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(m, &m);
+}
+
+static const char outer[] =
+    "\x08\xfb\xff\xff\xff\xff\xff\xff\xff\xff\x01"  // i32 = -5
+    "\x11\x00\x00\x00\x00\x00\x00\xf8\x3f"          // d = 1.5
+    "\x18\x01"                                      // b = true
+    "\x22\x05" "hello"                              // s
+    "\x2a\x06" "\x08\x07" "\x12\x02" "xy"           // inner
+    "\x30\x01" "\x30\xac\x02"                       // r64 = 1, 300
+    "\x3a\x01" "a" "\x3a\x02" "bc"                  // rs
+    "\x42\x02" "\x08\x01" "\x42\x03" "\x12\x01" "z" // rinner
+    "\x52\x02" "\x08\x03";                          // outer { i32 = 3 }
+
+static void check_outer(const cstruct_Outer *msg) {
+  ASSERT(CSTRUCT_OUTER_I32_HAS(msg) && msg->i32 == -5);
+  ASSERT(CSTRUCT_OUTER_D_HAS(msg) && msg->d == 1.5);
+  ASSERT(CSTRUCT_OUTER_B_HAS(msg) && msg->b);
+  ASSERT(CSTRUCT_OUTER_S_HAS(msg) && streq(&msg->s, "hello"));
+  ASSERT(!CSTRUCT_OUTER_U32_HAS(msg) && msg->u32 == 0);
+
+  ASSERT(CSTRUCT_OUTER_INNER_HAS(msg));
+  ASSERT(CSTRUCT_INNER_A_HAS(msg->inner) && msg->inner->a == 7);
+  ASSERT(CSTRUCT_INNER_DATA_HAS(msg->inner) && streq(&msg->inner->data, "xy"));
+
+  ASSERT(msg->r64.len == 2);
+  ASSERT(((int64_t*)msg->r64.ptr)[0] == 1);
+  ASSERT(((int64_t*)msg->r64.ptr)[1] == 300);
+  ASSERT(msg->rs.len == 2);
+  ASSERT(streq(&((upb_shim_str*)msg->rs.ptr)[0], "a"));
+  ASSERT(streq(&((upb_shim_str*)msg->rs.ptr)[1], "bc"));
+  ASSERT(msg->rinner.len == 2);
+  cstruct_Inner **rinner = msg->rinner.ptr;
+  ASSERT(CSTRUCT_INNER_A_HAS(rinner[0]) && rinner[0]->a == 1);
+  ASSERT(!CSTRUCT_INNER_DATA_HAS(rinner[0]));
+  ASSERT(!CSTRUCT_INNER_A_HAS(rinner[1]) && streq(&rinner[1]->data, "z"));
+
+  ASSERT(CSTRUCT_OUTER_OUTER_HAS(msg));
+  ASSERT(CSTRUCT_OUTER_I32_HAS(msg->outer) && msg->outer->i32 == 3);
+  ASSERT(!CSTRUCT_OUTER_S_HAS(msg->outer) && !msg->outer->inner);
+}
+
+// With and without the JIT (where it is built in), and with buffer seams
+// inside each submessage and sequence.
+static void test_decode() {
+  const upb_msgdef *m = newouter(&m);
+  const upb_handlers *h = newhandlers(m, &h);
+  static const size_t chunks[] = {sizeof(outer), 1, 3, 7};
+  for (int jit = 0; jit <= 1; jit++) {
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+      check_outer(decode(h, jit, outer, sizeof(outer) - 1, chunks[i]));
+    }
+  }
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(m, &m);
+}
+
+int run_tests(int argc, char *argv[]) {
+  UPB_UNUSED(argc);
+  UPB_UNUSED(argv);
+  upb_pipeline_init(&arena, NULL, 0, upb_realloc, NULL);
+  test_layout();
+  test_decode();
+  upb_pipeline_uninit(&arena);
+  return 0;
+}
@@ -0,0 +1,107 @@
+// This file was generated by upbc (the upb compiler).
+// Do not edit -- your changes will be discarded when the file is
+// regenerated.
+
+#ifndef TEST_CSTRUCT_UPB_STRUCT_H_
+#define TEST_CSTRUCT_UPB_STRUCT_H_
+
+#include <stddef.h>
+#include <string.h>
+#include "upb/shim/shim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct cstruct_Inner cstruct_Inner;
+typedef struct cstruct_Outer cstruct_Outer;
+
+struct cstruct_Inner {
+  uint32_t _hasbits[2];
+  int64_t a;
+  upb_shim_str data;
+};
+
+#define CSTRUCT_INNER_A_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x01) != 0)
+#define CSTRUCT_INNER_DATA_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x02) != 0)
+
+struct cstruct_Outer {
+  uint32_t _hasbits[2];
+  double d;
+  upb_shim_str s;
+  struct cstruct_Inner* inner;
+  upb_shim_arr r64;
+  upb_shim_arr rs;
+  upb_shim_arr rinner;
+  struct cstruct_Outer* outer;
+  int32_t i32;
+  uint32_t u32;
+  bool b;
+};
+
+#define CSTRUCT_OUTER_D_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x02) != 0)
+#define CSTRUCT_OUTER_S_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x08) != 0)
+#define CSTRUCT_OUTER_INNER_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x10) != 0)
+#define CSTRUCT_OUTER_OUTER_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x40) != 0)
+#define CSTRUCT_OUTER_I32_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x01) != 0)
+#define CSTRUCT_OUTER_U32_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x20) != 0)
+#define CSTRUCT_OUTER_B_HAS(msg) \
+    ((((const uint8_t*)(msg)->_hasbits)[0] & 0x04) != 0)
+
+UPB_INLINE bool cstruct_Inner_sethandlers(upb_handlers *h,
+                               const upb_shim_alloc *a) {
+  const upb_msgdef *md = upb_handlers_msgdef(h);
+  const upb_fielddef *f;
+  UPB_UNUSED(md);
+  UPB_UNUSED(f);
+  UPB_UNUSED(a);
+  if (!(f = upb_msgdef_itof(md, 1)) || !upb_shim_set(h, f, offsetof(cstruct_Inner, a), 0)) return false;
+  if (!(f = upb_msgdef_itof(md, 2)) || !upb_shim_setstr(h, f, offsetof(cstruct_Inner, data), 1, a)) return false;
+  return true;
+}
+
+UPB_INLINE bool cstruct_Outer_sethandlers(upb_handlers *h,
+                               const upb_shim_alloc *a) {
+  const upb_msgdef *md = upb_handlers_msgdef(h);
+  const upb_fielddef *f;
+  UPB_UNUSED(md);
+  UPB_UNUSED(f);
+  UPB_UNUSED(a);
+  if (!(f = upb_msgdef_itof(md, 2)) || !upb_shim_set(h, f, offsetof(cstruct_Outer, d), 1)) return false;
+  if (!(f = upb_msgdef_itof(md, 4)) || !upb_shim_setstr(h, f, offsetof(cstruct_Outer, s), 3, a)) return false;
+  if (!(f = upb_msgdef_itof(md, 5)) || !upb_shim_setsubmsg(h, f, offsetof(cstruct_Outer, inner), 4, sizeof(cstruct_Inner), a)) return false;
+  if (!(f = upb_msgdef_itof(md, 6)) || !upb_shim_setrepeated(h, f, offsetof(cstruct_Outer, r64), a)) return false;
+  if (!(f = upb_msgdef_itof(md, 7)) || !upb_shim_setstr(h, f, offsetof(cstruct_Outer, rs), -1, a)) return false;
+  if (!(f = upb_msgdef_itof(md, 8)) || !upb_shim_setsubmsg(h, f, offsetof(cstruct_Outer, rinner), -1, sizeof(cstruct_Inner), a)) return false;
+  if (!(f = upb_msgdef_itof(md, 10)) || !upb_shim_setsubmsg(h, f, offsetof(cstruct_Outer, outer), 6, sizeof(cstruct_Outer), a)) return false;
+  if (!(f = upb_msgdef_itof(md, 1)) || !upb_shim_set(h, f, offsetof(cstruct_Outer, i32), 0)) return false;
+  if (!(f = upb_msgdef_itof(md, 9)) || !upb_shim_set(h, f, offsetof(cstruct_Outer, u32), 5)) return false;
+  if (!(f = upb_msgdef_itof(md, 3)) || !upb_shim_set(h, f, offsetof(cstruct_Outer, b), 2)) return false;
+  return true;
+}
+
+UPB_INLINE void test_cstruct_shimhandlers(void *closure, upb_handlers *h) {
+  const upb_shim_alloc *a = (const upb_shim_alloc*)closure;
+  const char *name = upb_msgdef_fullname(upb_handlers_msgdef(h));
+  bool ok = false;
+  if (strcmp(name, "cstruct.Inner") == 0) {
+    ok = cstruct_Inner_sethandlers(h, a);
+  } else if (strcmp(name, "cstruct.Outer") == 0) {
+    ok = cstruct_Outer_sethandlers(h, a);
+  }
+  UPB_ASSERT_VAR(ok, ok);
+}
+
+#ifdef __cplusplus
+};  // extern "C"
+#endif
+
+#endif  // TEST_CSTRUCT_UPB_STRUCT_H_
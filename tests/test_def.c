@@ -8,6 +8,8 @@
  */
 
 #include "upb/def.h"
+#include "upb/defimage.h"
+#include "upb/descriptor/descriptor.upb.h"
 #include "upb/pb/glue.h"
 #include "upb_test.h"
 #include <stdlib.h>
@@ -169,6 +171,70 @@ static void test_replacement() {
   upb_symtab_unref(s, &s);
 }
 
+static const upb_def *subdef(const upb_msgdef *m, uint32_t num) {
+  return upb_fielddef_subdef(upb_msgdef_itof(m, num));
+}
+
+static void test_relative_names() {
+  upb_symtab *s = upb_symtab_new(&s);
+
+  upb_msgdef *outer = upb_msgdef_newnamed("pkg.Outer", &s);
+  upb_msgdef_addfield(outer, newfield("a", 1, UPB_TYPE_MESSAGE,
+                                      UPB_LABEL_OPTIONAL, "Inner", &s),
+                      &s, NULL);
+  upb_msgdef_addfield(outer, newfield("b", 2, UPB_TYPE_MESSAGE,
+                                      UPB_LABEL_OPTIONAL, "Other", &s),
+                      &s, NULL);
+  upb_msgdef_addfield(outer, newfield("c", 3, UPB_TYPE_MESSAGE,
+                                      UPB_LABEL_OPTIONAL, "Outer.Inner", &s),
+                      &s, NULL);
+  upb_msgdef_addfield(outer, newfield("d", 4, UPB_TYPE_ENUM,
+                                      UPB_LABEL_OPTIONAL, "Top", &s),
+                      &s, NULL);
+  upb_msgdef_addfield(outer, newfield("e", 5, UPB_TYPE_MESSAGE,
+                                      UPB_LABEL_OPTIONAL, "pkg.Other", &s),
+                      &s, NULL);
+  upb_msgdef *inner = upb_msgdef_newnamed("pkg.Outer.Inner", &s);
+  upb_msgdef *other = upb_msgdef_newnamed("pkg.Other", &s);
+  upb_enumdef *top = upb_enumdef_newnamed("Top", &s);
+
+  upb_def *defs[] = {
+    upb_upcast(outer), upb_upcast(inner), upb_upcast(other), upb_upcast(top)
+  };
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 4, &s, &status), &status);
+
+  ASSERT(subdef(outer, 1) == upb_upcast(inner));
+  ASSERT(subdef(outer, 2) == upb_upcast(other));
+  ASSERT(subdef(outer, 3) == upb_upcast(inner));
+  ASSERT(subdef(outer, 4) == upb_upcast(top));
+  ASSERT(subdef(outer, 5) == upb_upcast(other));
+
+  // Lookups walk outward from the base scope.
+  const upb_def *def = upb_symtab_resolve(s, "pkg.Other", "Outer.Inner", &def);
+  ASSERT(def == upb_upcast(inner));
+  upb_def_unref(def, &def);
+  def = upb_symtab_resolve(s, "pkg.Outer.Inner", "Outer", &def);
+  ASSERT(def == upb_upcast(outer));
+  upb_def_unref(def, &def);
+  ASSERT(upb_symtab_resolve(s, "pkg.Other", "Inner", &def) == NULL);
+  ASSERT(upb_symtab_resolve(s, "pkg.Outer", "Top.Inner", &def) == NULL);
+  ASSERT(upb_symtab_resolve(s, "pkg.Outer", ".Outer", &def) == NULL);
+  ASSERT(upb_symtab_resolve(s, "pkg.Outer", "", &def) == NULL);
+
+  // Names that do not resolve are an error.
+  upb_msgdef *bad = upb_msgdef_newnamed("pkg.Bad", &s);
+  upb_msgdef_addfield(bad, newfield("a", 1, UPB_TYPE_MESSAGE,
+                                    UPB_LABEL_OPTIONAL, "Inner", &s),
+                      &s, NULL);
+  upb_def *baddefs[] = {upb_upcast(bad)};
+  ASSERT(!upb_symtab_add(s, baddefs, 1, &s, &status));
+  upb_msgdef_unref(bad, &s);
+  upb_status_uninit(&status);
+
+  upb_symtab_unref(s, &s);
+}
+
 static void test_freeze_free() {
   // Test that freeze frees defs that were only being kept alive by virtue of
   // sharing a group with other defs that are being frozen.
@@ -257,6 +323,308 @@ static void test_partial_freeze() {
   upb_msgdef_unref(m3, &m3);
 }
 
+static void test_sampled_tracking() {
+  // Exercise ref tracking (including the verification of visit() functions)
+  // with only some refs sampled, and with tracking off.
+  upb_refcounted_settracking(3);
+  test_replacement();
+  test_freeze_free();
+  test_partial_freeze();
+  upb_refcounted_settracking(0);
+  test_replacement();
+  test_freeze_free();
+  upb_refcounted_settracking(1);
+}
+
+static void test_hotfields() {
+  upb_symtab *s = load_test_proto(&s);
+  // Field numbers 1, 2, 3 and 5; 4 is missing.
+  const upb_msgdef *m = upb_symtab_lookupmsg(s, "SimplePrimitives", &m);
+  ASSERT(m);
+  ASSERT(upb_msgdef_hotfield(m, 0) == NULL);
+  ASSERT(upb_msgdef_hotfield(m, 4) == NULL);
+  ASSERT(upb_msgdef_hotfield(m, 6) == NULL);
+  ASSERT(upb_msgdef_itof(m, 4) == NULL);
+  uint32_t nums[] = {1, 2, 3, 5};
+  for (int i = 0; i < 4; i++) {
+    const upb_hotfield *h = upb_msgdef_hotfield(m, nums[i]);
+    ASSERT(h);
+    ASSERT(h->number == nums[i]);
+    ASSERT(h->f == upb_msgdef_itof(m, nums[i]));
+    ASSERT(upb_fielddef_number(h->f) == nums[i]);
+    ASSERT(h->descriptortype == upb_fielddef_descriptortype(h->f));
+    ASSERT(h->label == upb_fielddef_label(h->f));
+    ASSERT(h->subdef == NULL);
+  }
+  upb_msgdef_unref(m, &m);
+
+  m = upb_symtab_lookupmsg(s, "C", &m);
+  const upb_hotfield *h = upb_msgdef_hotfield(m, 3);
+  ASSERT(h && h->subdef == upb_fielddef_subdef(h->f));
+  ASSERT(strcmp(upb_def_fullname(h->subdef), "D") == 0);
+  upb_msgdef_unref(m, &m);
+  upb_symtab_unref(s, &s);
+}
+
+static void test_fingerprint() {
+  upb_symtab *s1 = load_test_proto(&s1);
+  upb_symtab *s2 = load_test_proto(&s2);
+  const upb_msgdef *a1 = upb_symtab_lookupmsg(s1, "A", &a1);
+  const upb_msgdef *a2 = upb_symtab_lookupmsg(s2, "A", &a2);
+  const upb_msgdef *e = upb_symtab_lookupmsg(s1, "E", &e);
+  const upb_msgdef *f = upb_symtab_lookupmsg(s1, "F", &f);
+
+  // Same schema, different defs: same fingerprint.
+  ASSERT(upb_msgdef_fingerprint(a1) == upb_msgdef_fingerprint(a2));
+  // E and F both contain only "optional E e = 1" but have different names.
+  ASSERT(upb_msgdef_fingerprint(e) != upb_msgdef_fingerprint(f));
+  ASSERT(upb_msgdef_fingerprint(a1) != upb_msgdef_fingerprint(e));
+
+  upb_msgdef_unref(a1, &a1);
+  upb_msgdef_unref(a2, &a2);
+  upb_msgdef_unref(e, &e);
+  upb_msgdef_unref(f, &f);
+  upb_symtab_unref(s1, &s1);
+  upb_symtab_unref(s2, &s2);
+}
+
+static void addfield(upb_msgdef *m, const char *name, int32_t num,
+                     uint8_t type, uint8_t label) {
+  upb_fielddef *f = upb_fielddef_new(&f);
+  ASSERT(upb_fielddef_setname(f, name, NULL));
+  ASSERT(upb_fielddef_setnumber(f, num, NULL));
+  upb_fielddef_settype(f, type);
+  upb_fielddef_setlabel(f, label);
+  ASSERT(upb_msgdef_addfield(m, f, &f, NULL));
+}
+
+// Freezes a map entry with the given fields, or without field 2 if val_type
+// is 0.
+static bool freeze_mapentry(uint8_t key_type, uint8_t val_type,
+                            uint8_t key_label, upb_status *status) {
+  upb_msgdef *m = upb_msgdef_newnamed("Entry", &m);
+  upb_msgdef_setmapentry(m, true);
+  ASSERT(upb_msgdef_mapentry(m));
+  addfield(m, "key", 1, key_type, key_label);
+  if (val_type) addfield(m, "value", 2, val_type, UPB_LABEL_OPTIONAL);
+  upb_def *defs[] = {upb_upcast(m)};
+  bool ok = upb_def_freeze(defs, 1, status);
+  if (ok) {
+    ASSERT(upb_msgdef_mapentry(m));
+    ASSERT(!upb_fielddef_ismap(upb_msgdef_itof(m, 1)));
+    upb_msgdef_unref(m, &m);
+    return true;
+  }
+  upb_msgdef_unref(m, &m);
+  return false;
+}
+
+static void test_mapentry() {
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(freeze_mapentry(UPB_TYPE_STRING, UPB_TYPE_DOUBLE,
+                                UPB_LABEL_OPTIONAL, &status), &status);
+  ASSERT_STATUS(freeze_mapentry(UPB_TYPE_BOOL, UPB_TYPE_BYTES,
+                                UPB_LABEL_OPTIONAL, &status), &status);
+  ASSERT(!freeze_mapentry(UPB_TYPE_DOUBLE, UPB_TYPE_INT32, UPB_LABEL_OPTIONAL,
+                          &status));
+  ASSERT(!freeze_mapentry(UPB_TYPE_INT32, UPB_TYPE_INT32, UPB_LABEL_REPEATED,
+                          &status));
+  ASSERT(!freeze_mapentry(UPB_TYPE_INT32, 0, UPB_LABEL_OPTIONAL, &status));
+  upb_status_uninit(&status);
+
+  // The flag is part of the fingerprint, and is kept by dup().
+  upb_msgdef *m1 = upb_msgdef_newnamed("Entry", &m1);
+  addfield(m1, "key", 1, UPB_TYPE_INT32, UPB_LABEL_OPTIONAL);
+  addfield(m1, "value", 2, UPB_TYPE_INT32, UPB_LABEL_OPTIONAL);
+  upb_msgdef *m2 = upb_msgdef_dup(m1, &m2);
+  upb_msgdef_setmapentry(m2, true);
+  upb_msgdef *m3 = upb_msgdef_dup(m2, &m3);
+  ASSERT(upb_msgdef_mapentry(m3));
+  upb_def *defs[] = {upb_upcast(m1), upb_upcast(m2), upb_upcast(m3)};
+  ASSERT(upb_def_freeze(defs, 3, NULL));
+  ASSERT(upb_msgdef_fingerprint(m1) != upb_msgdef_fingerprint(m2));
+  ASSERT(upb_msgdef_fingerprint(m2) == upb_msgdef_fingerprint(m3));
+  upb_msgdef_unref(m1, &m1);
+  upb_msgdef_unref(m2, &m2);
+  upb_msgdef_unref(m3, &m3);
+}
+
+static upb_fielddef *newext(const char *name, int32_t num,
+                             const char *extendee, void *owner) {
+  upb_fielddef *f = upb_fielddef_new(owner);
+  ASSERT(upb_fielddef_setname(f, name, NULL));
+  ASSERT(upb_fielddef_setnumber(f, num, NULL));
+  upb_fielddef_settype(f, UPB_TYPE_INT32);
+  upb_fielddef_setisextension(f, true);
+  ASSERT(upb_fielddef_setcontainingtypename(f, extendee, NULL));
+  return f;
+}
+
+// Adds the extension "f" to "s", passing the ref on "f" that "owner" owns.
+static bool add_ext(upb_symtab *s, upb_fielddef *f, void *owner,
+                    upb_status *status) {
+  upb_def *defs[] = {upb_upcast(f)};
+  return upb_symtab_add(s, defs, 1, owner, status);
+}
+
+static void test_extensions() {
+  // From a descriptor: ranges, and extensions at file and message scope.
+  upb_symtab *s = load_test_proto(&s);
+  const upb_msgdef *m = upb_symtab_lookupmsg(s, "Extendable", &m);
+  ASSERT(m);
+  ASSERT(upb_msgdef_extrangecount(m) == 2);
+  ASSERT(upb_msgdef_extrange(m, 0)->start == 100);
+  ASSERT(upb_msgdef_extrange(m, 0)->end == 200);
+  ASSERT(upb_msgdef_extrange(m, 1)->end == UPB_MAX_FIELDNUMBER + 1);
+  ASSERT(upb_msgdef_isextnum(m, 199) && !upb_msgdef_isextnum(m, 200));
+  ASSERT(!upb_fielddef_isextension(upb_msgdef_itof(m, 1)));
+  const upb_fielddef *f = upb_msgdef_itof(m, 100);
+  ASSERT(f && upb_fielddef_isextension(f));
+  ASSERT(strcmp(upb_fielddef_name(f), "ext") == 0);
+  f = upb_msgdef_ntof(m, "ExtensionScope.scoped_ext");
+  ASSERT(f && upb_fielddef_number(f) == 1000);
+  ASSERT(upb_fielddef_type(f) == UPB_TYPE_STRING);
+  ASSERT(upb_msgdef_hotfield(m, 1000)->f == f);
+  ASSERT(upb_msgdef_hotfield(m, 1)->f == upb_msgdef_ntof(m, "a"));
+  ASSERT(upb_msgdef_hotfield(m, 101) == NULL);
+  ASSERT(upb_msgdef_hotfield(m, 2) == NULL);
+  // Extensions are not defs of their own in the symtab.
+  ASSERT(upb_symtab_lookup(s, "ext", &f) == NULL);
+  upb_msgdef_unref(m, &m);
+  upb_symtab_unref(s, &s);
+
+  // Extensions added by themselves replace the message they extend, and
+  // everything that reaches it.
+  s = upb_symtab_new(&s);
+  upb_msgdef *ext = upb_msgdef_newnamed("pkg.Ext", &s);
+  ASSERT(upb_msgdef_addextrange(ext, 10, 20, NULL));
+  ASSERT(!upb_msgdef_addextrange(ext, 15, 30, NULL));
+  ASSERT(!upb_msgdef_addextrange(ext, 0, 5, NULL));
+  upb_msgdef *holder = upb_msgdef_newnamed("pkg.Holder", &s);
+  upb_msgdef_addfield(holder, newfield("ext", 1, UPB_TYPE_MESSAGE,
+                                       UPB_LABEL_OPTIONAL, ".pkg.Ext", &s),
+                      &s, NULL);
+  upb_def *defs[] = {upb_upcast(ext), upb_upcast(holder)};
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 2, &s, &status), &status);
+
+  ASSERT_STATUS(add_ext(s, newext("pkg.e", 10, ".pkg.Ext", &s), &s, &status),
+                &status);
+  m = upb_symtab_lookupmsg(s, "pkg.Ext", &m);
+  ASSERT(m != ext);
+  ASSERT(upb_msgdef_extrangecount(m) == 1);
+  f = upb_msgdef_itof(m, 10);
+  ASSERT(f && upb_fielddef_isextension(f));
+  ASSERT(upb_msgdef_ntof(m, "pkg.e") == f);
+  const upb_msgdef *h = upb_symtab_lookupmsg(s, "pkg.Holder", &h);
+  ASSERT(h != holder);
+  ASSERT(upb_fielddef_subdef(upb_msgdef_itof(h, 1)) == upb_upcast(m));
+  upb_msgdef_unref(h, &h);
+
+  // Later replacements keep the extension.
+  ASSERT_STATUS(add_ext(s, newext("pkg.e2", 11, "pkg.Ext", &s), &s, &status),
+                &status);
+  const upb_msgdef *m2 = upb_symtab_lookupmsg(s, "pkg.Ext", &m2);
+  ASSERT(upb_msgdef_numfields(m2) == 2);
+  ASSERT(upb_fielddef_isextension(upb_msgdef_itof(m2, 10)));
+  ASSERT(upb_msgdef_fingerprint(m2) != upb_msgdef_fingerprint(m));
+  upb_msgdef_unref(m2, &m2);
+  upb_msgdef_unref(m, &m);
+
+  // Failures leave the symtab unchanged.
+  upb_fielddef *bad = newext("pkg.bad", 30, "pkg.Ext", &bad);
+  ASSERT(!add_ext(s, bad, &bad, &status));  // Outside the ranges; bad is freed.
+  bad = newext("pkg.bad", 12, "pkg.Missing", &bad);
+  ASSERT(!add_ext(s, bad, &bad, &status));
+  upb_fielddef_unref(bad, &bad);
+  bad = newext("pkg.bad", 12, "pkg.Ext", &bad);
+  upb_fielddef_setisextension(bad, false);
+  ASSERT(!add_ext(s, bad, &bad, &status));
+  upb_fielddef_unref(bad, &bad);
+  m = upb_symtab_lookupmsg(s, "pkg.Ext", &m);
+  ASSERT(upb_msgdef_numfields(m) == 2);
+  upb_msgdef_unref(m, &m);
+  upb_symtab_unref(s, &s);
+
+  // Ordinary fields may not be in the ranges, and ranges are kept by dup().
+  upb_msgdef *m3 = upb_msgdef_newnamed("M", &m3);
+  ASSERT(upb_msgdef_addextrange(m3, 10, 20, NULL));
+  addfield(m3, "f", 10, UPB_TYPE_INT32, UPB_LABEL_OPTIONAL);
+  upb_def *defs3[] = {upb_upcast(m3)};
+  ASSERT(!upb_def_freeze(defs3, 1, &status));
+  upb_msgdef *m4 = upb_msgdef_dup(m3, &m4);
+  ASSERT(upb_msgdef_extrangecount(m4) == 1);
+  upb_fielddef_setisextension(upb_msgdef_itof_mutable(m4, 10), true);
+  upb_def *defs4[] = {upb_upcast(m4)};
+  ASSERT_STATUS(upb_def_freeze(defs4, 1, &status), &status);
+  ASSERT(upb_msgdef_hotfield(m4, 10)->f == upb_msgdef_itof(m4, 10));
+  upb_msgdef_unref(m3, &m3);
+  upb_msgdef_unref(m4, &m4);
+  upb_status_uninit(&status);
+
+  // The static descriptor defs have their ranges, and no extensions.
+  m = GOOGLE_PROTOBUF_FIELDOPTIONS;
+  ASSERT(upb_msgdef_extrangecount(m) == 1);
+  ASSERT(upb_msgdef_extrange(m, 0)->start == 1000);
+  ASSERT(upb_msgdef_extrange(m, 0)->end == UPB_MAX_FIELDNUMBER + 1);
+  ASSERT(!upb_fielddef_isextension(upb_msgdef_itof(m, 1)));
+  ASSERT(upb_msgdef_hotfield(m, 1000) == NULL);
+  ASSERT(upb_msgdef_extrangecount(GOOGLE_PROTOBUF_DESCRIPTORPROTO) == 0);
+}
+
+static void test_defimage() {
+  upb_symtab *s = load_test_proto(&s);
+  upb_status status = UPB_STATUS_INIT;
+  size_t len;
+  char *img = upb_defimage_build(s, &len, &status);
+  ASSERT(img);
+
+  // A corrupt image is rejected.
+  char *copy = malloc(len);
+  memcpy(copy, img, len);
+  copy[0] = 'x';
+  ASSERT(!upb_defimage_load(copy, len, &status));
+  upb_status_clear(&status);
+
+  // Load a copy, so the image is not at the address it was built at.
+  memcpy(copy, img, len);
+  free(img);
+  ASSERT(upb_defimage_load(copy, len, &status));
+  ASSERT(upb_defimage_load(copy, len, &status));  // No-op.
+
+  const upb_msgdef *md = upb_symtab_lookupmsg(s, "A", &md);
+  const upb_msgdef *img_md = upb_defimage_lookupmsg(copy, "A");
+  ASSERT(img_md);
+  ASSERT(upb_msgdef_isfrozen(img_md));
+  ASSERT(strcmp(upb_msgdef_fullname(img_md), "A") == 0);
+  ASSERT(upb_msgdef_fingerprint(img_md) == upb_msgdef_fingerprint(md));
+  ASSERT(upb_defimage_lookupmsg(copy, "NoSuchMessage") == NULL);
+
+  // Refcounting image defs is a no-op.
+  upb_msgdef_ref(img_md, &img_md);
+  upb_msgdef_unref(img_md, &img_md);
+
+  const upb_fielddef *f = upb_msgdef_itof(img_md, 1);
+  ASSERT(f);
+  ASSERT(f == upb_msgdef_ntof(img_md, "b"));
+  ASSERT(upb_fielddef_msgdef(f) == img_md);
+  const upb_msgdef *img_b = upb_defimage_lookupmsg(copy, "B");
+  ASSERT(upb_fielddef_subdef(f) == upb_upcast(img_b));
+  const upb_hotfield *h = upb_msgdef_hotfield(img_md, 1);
+  ASSERT(h && h->f == f && h->subdef == upb_fielddef_subdef(f));
+
+  const upb_msgdef *prims = upb_defimage_lookupmsg(copy, "SimplePrimitives");
+  ASSERT(prims);
+  f = upb_msgdef_ntof(prims, "d");
+  ASSERT(f && upb_fielddef_number(f) == 5);
+  ASSERT(upb_fielddef_type(f) == UPB_TYPE_FLOAT);
+
+  upb_msgdef_unref(md, &md);
+  upb_symtab_unref(s, &s);
+  upb_status_uninit(&status);
+  free(copy);
+}
+
 int run_tests(int argc, char *argv[]) {
   if (argc < 2) {
     fprintf(stderr, "Usage: test_def <test.proto.pb>\n");
@@ -268,7 +636,14 @@ int run_tests(int argc, char *argv[]) {
   test_fielddef_accessors();
   test_fielddef_unref();
   test_replacement();
+  test_relative_names();
   test_freeze_free();
   test_partial_freeze();
+  test_sampled_tracking();
+  test_hotfields();
+  test_fingerprint();
+  test_mapentry();
+  test_extensions();
+  test_defimage();
   return 0;
 }
@@ -17,6 +17,13 @@ static bool startmsg(void *c, const void *hd) {
   return true;
 }
 
+static size_t str(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(c);
+  UPB_UNUSED(hd);
+  UPB_UNUSED(buf);
+  return n;
+}
+
 static void test_error() {
   upb_handlers *h = upb_handlers_new(GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h);
 
@@ -36,9 +43,78 @@ static void test_error() {
   upb_handlers_unref(h, &h);
 }
 
+static void test_sparse() {
+  upb_handlers *sub =
+      upb_handlers_new(GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO, NULL, &sub);
+  upb_handlers *h = upb_handlers_new(GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  const upb_fielddef *name = upb_msgdef_itof(m, 1);
+  const upb_fielddef *field = upb_msgdef_itof(m, 2);
+  const upb_selector_t name_str = GOOGLE_PROTOBUF_DESCRIPTORPROTO_NAME_STRING;
+  const upb_selector_t name_start =
+      GOOGLE_PROTOBUF_DESCRIPTORPROTO_NAME_STARTSTR;
+  static int data;
+
+  // Selectors are assigned in field number order.
+  ASSERT(GOOGLE_PROTOBUF_DESCRIPTORPROTO_NAME_STRING <
+         GOOGLE_PROTOBUF_DESCRIPTORPROTO_FIELD_STARTSEQ);
+  ASSERT(GOOGLE_PROTOBUF_DESCRIPTORPROTO_FIELD_STARTSUBMSG <
+         GOOGLE_PROTOBUF_DESCRIPTORPROTO_EXTENSION_RANGE_STARTSEQ);
+
+  ASSERT(upb_handlers_setstartmsg(h, &startmsg, NULL, NULL));
+  ASSERT(upb_handlers_setstring(h, name, &str, &data, NULL));
+  ASSERT(upb_handlers_setsubhandlers(h, field, sub));
+  ASSERT(upb_handlers_hashandler(h, name_str));
+  ASSERT(!upb_handlers_hashandler(h, UPB_ENDMSG_SELECTOR));
+  upb_handlers_unref(sub, &sub);
+  ASSERT(upb_handlers_freeze(&h, 1, NULL));
+
+  // Once frozen, only the set handlers are stored, but lookups are unchanged.
+  ASSERT(upb_handlers_hashandler(h, UPB_STARTMSG_SELECTOR));
+  ASSERT(!upb_handlers_hashandler(h, UPB_ENDMSG_SELECTOR));
+  ASSERT(upb_handlers_hashandler(h, name_str));
+  ASSERT(!upb_handlers_hashandler(h, name_start));
+  ASSERT(upb_handlers_gethandler(h, UPB_STARTMSG_SELECTOR) ==
+         (upb_func*)&startmsg);
+  ASSERT(upb_handlers_gethandler(h, UPB_ENDMSG_SELECTOR) == NULL);
+  ASSERT(upb_handlers_gethandler(h, name_str) == (upb_func*)&str);
+  ASSERT(upb_handlers_gethandlerdata(h, name_str) == &data);
+  ASSERT(upb_handlers_gethandlerdata(h, name_start) == NULL);
+  sub = (upb_handlers*)upb_handlers_getsubhandlers(h, field);
+  ASSERT(sub && upb_handlers_isfrozen(sub));
+  ASSERT(upb_handlers_msgdef(sub) == GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO);
+  ASSERT(upb_handlers_getsubhandlers(
+      sub, upb_msgdef_itof(upb_handlers_msgdef(sub), 8)) == NULL);
+
+  upb_handlers_unref(h, &h);
+}
+
+static void nohandlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  UPB_UNUSED(h);
+}
+
+static void test_maxdepth() {
+  // The deepest path is FieldDescriptorProto -> options -> seq of
+  // uninterpreted_option -> UninterpretedOption -> seq of name -> NamePart ->
+  // name_part string: six frames on top of the message's own.
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO, NULL, &h, nohandlers, NULL);
+  ASSERT(upb_handlers_maxdepth(h) == 7);
+  upb_handlers_unref(h, &h);
+
+  // DescriptorProto can contain itself, so its depth is unbounded.
+  h = upb_handlers_newfrozen(GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h,
+                             nohandlers, NULL);
+  ASSERT(upb_handlers_maxdepth(h) == 0);
+  upb_handlers_unref(h, &h);
+}
+
 int run_tests(int argc, char *argv[]) {
   UPB_UNUSED(argc);
   UPB_UNUSED(argv);
   test_error();
+  test_sparse();
+  test_maxdepth();
   return 0;
 }
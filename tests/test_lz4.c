@@ -0,0 +1,353 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Tests of the LZ4 block decoder, with blocks from a small greedy compressor.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/descriptor/descriptor.upb.h"
+#include "upb/lz4.h"
+#include "upb/pb/decoder.h"
+#include "upb/pb/records.h"
+#include "upb/pb/varint.h"
+#include "upb_test.h"
+
+static uint32_t read32(const char *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static char *putlen(char *out, size_t len) {
+  for (; len >= 255; len -= 255) *out++ = (char)255;
+  *out++ = len;
+  return out;
+}
+
+static char *putsequence(char *out, const char *lit, size_t litlen,
+                         size_t offset, size_t matchlen) {
+  char *token = out++;
+  *token = (litlen >= 15 ? 15 : litlen) << 4;
+  if (litlen >= 15) out = putlen(out, litlen - 15);
+  memcpy(out, lit, litlen);
+  out += litlen;
+  if (matchlen == 0) return out;
+  *out++ = offset & 0xff;
+  *out++ = offset >> 8;
+  *token |= matchlen - 4 >= 15 ? 15 : matchlen - 4;
+  if (matchlen - 4 >= 15) out = putlen(out, matchlen - 4 - 15);
+  return out;
+}
+
+// Compresses "in" into "out", which must have room for len + len / 255 + 16
+// bytes, and returns the compressed length.
+static size_t compress(const char *in, size_t len, char *out) {
+  static int table[4096];
+  for (int i = 0; i < 4096; i++) table[i] = -1;
+  char *start = out;
+  size_t anchor = 0;
+  size_t i = 0;
+  // As the format requires, the last match starts at least 12 bytes from
+  // the end and the last 5 bytes are literals.
+  while (i + 12 <= len) {
+    uint32_t h = (read32(in + i) * 2654435761U) >> 20;
+    int ref = table[h];
+    table[h] = i;
+    if (ref < 0 || i - ref > 65535 || read32(in + ref) != read32(in + i)) {
+      i++;
+      continue;
+    }
+    size_t matchlen = 4;
+    while (i + matchlen < len - 5 && in[ref + matchlen] == in[i + matchlen])
+      matchlen++;
+    out = putsequence(out, in + anchor, i - anchor, i - ref, matchlen);
+    i += matchlen;
+    anchor = i;
+  }
+  out = putsequence(out, in + anchor, len - anchor, 0, 0);
+  return out - start;
+}
+
+typedef struct {
+  char *buf;
+  size_t len;
+  size_t pieces;
+  size_t maxpiece;
+  bool ended;
+
+  // The sink takes no more than "cap" bytes in all.  If "limit" is nonzero,
+  // it applies backpressure: it takes at most "limit" bytes at a time, and
+  // nothing at all every other time.
+  size_t cap;
+  size_t limit;
+  size_t calls;
+} output;
+
+static void *out_startstr(void *closure, const void *hd, size_t size_hint) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(size_hint);
+  output *o = closure;
+  o->len = 0;
+  o->pieces = 0;
+  o->maxpiece = 0;
+  o->ended = false;
+  o->calls = 0;
+  return o;
+}
+
+static size_t out_string(void *closure, const void *hd, const char *buf,
+                         size_t n) {
+  UPB_UNUSED(hd);
+  output *o = closure;
+  if (o->limit && o->calls++ % 2) return 0;
+  if (o->limit) n = UPB_MIN(n, o->limit);
+  n = UPB_MIN(n, o->cap - o->len);
+  memcpy(o->buf + o->len, buf, n);
+  o->len += n;
+  o->pieces++;
+  if (n > o->maxpiece) o->maxpiece = n;
+  return n;
+}
+
+static bool out_endstr(void *closure, const void *hd) {
+  UPB_UNUSED(hd);
+  output *o = closure;
+  o->ended = true;
+  return true;
+}
+
+// Decompresses "in", passing it "piece" bytes at a time, and passing again
+// whatever was not consumed until nothing more is consumed or output.
+static bool decompress(const char *in, size_t len, size_t piece, output *o) {
+  const upb_handlers *out_h = upb_handlers_new(UPB_BYTESTREAM, NULL, &out_h);
+  upb_handlers *h = (upb_handlers*)out_h;
+  upb_handlers_setstartstr(h, UPB_BYTESTREAM_BYTES, out_startstr, NULL, NULL);
+  upb_handlers_setstring(h, UPB_BYTESTREAM_BYTES, out_string, NULL, NULL);
+  upb_handlers_setendstr(h, UPB_BYTESTREAM_BYTES, out_endstr, NULL, NULL);
+  const upb_handlers *lz4_h = upb_lz4decoder_newhandlers(&lz4_h);
+
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *out = upb_pipeline_newsink(&pipeline, out_h);
+  upb_sink *lz4 = upb_pipeline_newsink(&pipeline, lz4_h);
+  upb_lz4decoder_resetsink(upb_sink_getobj(lz4), out);
+  upb_sink_reset(out, o);
+
+  bool ok = upb_sink_startmsg(lz4) &&
+            upb_sink_startstr(lz4, UPB_BYTESTREAM_BYTES_STARTSTR, len);
+  size_t ofs = 0;
+  size_t idle = 0;
+  while (ok && ofs < len && idle < 2) {
+    size_t n = UPB_MIN(piece, len - ofs);
+    size_t outlen = o->len;
+    n = upb_sink_putstring(lz4, UPB_BYTESTREAM_BYTES_STRING, in + ofs, n);
+    ofs += n;
+    ok = upb_ok(upb_pipeline_status(&pipeline));
+    idle = n == 0 && o->len == outlen ? idle + 1 : 0;
+  }
+  // A sink that stops is not an error, but the string can't be ended early.
+  ok = upb_sink_endstr(lz4, UPB_BYTESTREAM_BYTES_ENDSTR) &&
+       upb_sink_endmsg(lz4) && ok;
+  ASSERT(ok == upb_ok(upb_pipeline_status(&pipeline)) || ofs < len);
+
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(lz4_h, &lz4_h);
+  upb_handlers_unref(out_h, &out_h);
+  return ok;
+}
+
+static void check_roundtrip(const char *data, size_t len) {
+  char *compressed = malloc(len + len / 255 + 16);
+  size_t clen = compress(data, len, compressed);
+  output o;
+  o.buf = malloc(len + 1);
+  o.cap = len;
+  size_t pieces[] = {1, 7, 4096, clen};
+  for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+    if (pieces[i] == 1 && len > 100000) continue;
+    size_t limits[] = {0, 1000};
+    for (size_t j = 0; j < 2; j++) {
+      o.limit = limits[j];
+      ASSERT(decompress(compressed, clen, pieces[i], &o));
+      ASSERT(o.ended);
+      ASSERT(o.len == len && memcmp(o.buf, data, len) == 0);
+      ASSERT(o.maxpiece <= UPB_LZ4_CHUNK_SIZE);
+    }
+  }
+  free(o.buf);
+  free(compressed);
+}
+
+static void test_roundtrip() {
+  check_roundtrip("", 0);
+  check_roundtrip("x", 1);
+  check_roundtrip("hello, hello, hello, world", 26);
+
+  // Long literal runs and long overlapping matches.
+  size_t len = 300000;
+  char *data = malloc(len);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < len; i++) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = seed >> 16;
+  }
+  check_roundtrip(data, len);
+  memset(data, 'a', len);
+  check_roundtrip(data, len);
+
+  // Words from a small vocabulary, plus long copies from nearly 64k back, so
+  // that matches are read across the end of the ring.
+  static const char *words[] = {"upb ", "record ", "field ", "message ",
+                                "varint ", "lz4 ", "decoder "};
+  size_t ofs = 0;
+  while (ofs < len - 20) {
+    seed = seed * 1103515245 + 12345;
+    if (ofs > 70000 && (seed >> 16) % 50 == 0) {
+      size_t n = UPB_MIN(1000 + (seed >> 8) % 3000, len - ofs);
+      memcpy(data + ofs, data + ofs - 65000, n);
+      ofs += n;
+    } else {
+      const char *w = words[(seed >> 16) % 7];
+      size_t n = UPB_MIN(strlen(w), len - ofs);
+      memcpy(data + ofs, w, n);
+      ofs += n;
+    }
+  }
+  check_roundtrip(data, ofs);
+  free(data);
+}
+
+static void test_errors() {
+  output o;
+  char buf[64];
+  o.buf = buf;
+  o.cap = sizeof(buf);
+  o.limit = 0;
+
+  // An offset before the start of the output.
+  ASSERT(!decompress("\x10" "a\x05\x00", 4, 4, &o));
+  ASSERT(!decompress("\x10" "a\x00\x00", 4, 4, &o));
+
+  // Blocks that end inside a sequence.
+  ASSERT(decompress("\x10" "a", 2, 2, &o));
+  ASSERT(!decompress("\x20" "a", 2, 2, &o));
+  ASSERT(!decompress("\x10" "a\x01", 3, 3, &o));
+  ASSERT(!decompress("\x1f" "a\x01\x00", 4, 4, &o));
+  ASSERT(!decompress("", 0, 1, &o));
+}
+
+// A sink that stops taking output stops the stage too, which can't end the
+// string with output left over.
+static void test_stop() {
+  const char *data = "hello, hello, hello, world";
+  char compressed[64];
+  size_t clen = compress(data, strlen(data), compressed);
+  char buf[64];
+  output o;
+  o.buf = buf;
+  o.limit = 0;
+  size_t caps[] = {0, 3, strlen(data) - 1};
+  for (size_t i = 0; i < sizeof(caps) / sizeof(caps[0]); i++) {
+    o.cap = caps[i];
+    ASSERT(!decompress(compressed, clen, clen, &o));
+    ASSERT(!o.ended);
+    ASSERT(o.len == caps[i] && memcmp(buf, data, o.len) == 0);
+  }
+}
+
+static bool putnumber(void *c, const void *hd, int32_t val) {
+  UPB_UNUSED(hd);
+  int32_t *sum = c;
+  *sum += val;
+  return true;
+}
+
+static void number_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  if (m == GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO)
+    upb_handlers_setint32(h, upb_msgdef_itof(m, 3), &putnumber, NULL, NULL);
+}
+
+// Compressed records in a record file, decoded with no intermediate buffer.
+static void test_records() {
+  FILE *f = tmpfile();
+  const upb_handlers *writer_h = upb_recordwriter_newhandlers(&writer_h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *writer = upb_pipeline_newsink(&pipeline, writer_h);
+  ASSERT(upb_recordwriter_open(upb_sink_getobj(writer), f, 0,
+                               UPB_RECORDS_RECORDCHECKSUM));
+  const int num_records = 100;
+  for (int i = 0; i < num_records; i++) {
+    char record[64], compressed[128];
+    size_t len = 0;
+    record[len++] = 0x0a;
+    record[len++] = 40;
+    memset(record + len, 'a' + i % 26, 40);
+    len += 40;
+    record[len++] = 0x18;
+    len += upb_vencode64(i, record + len);
+    size_t clen = compress(record, len, compressed);
+    ASSERT(clen < len);
+    ASSERT(upb_bytestream_putstr(writer, compressed, clen));
+  }
+  ASSERT(upb_recordwriter_finish(upb_sink_getobj(writer)));
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(writer_h, &writer_h);
+
+  fseek(f, 0, SEEK_END);
+  size_t len = ftell(f);
+  char *buf = malloc(len);
+  rewind(f);
+  ASSERT(fread(buf, 1, len, f) == len);
+  fclose(f);
+  upb_status status = UPB_STATUS_INIT;
+  upb_recordreader *r = upb_recordreader_openbuf(buf, len, &status);
+  ASSERT(r);
+
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO, NULL, &h, &number_handlers, NULL);
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  const upb_handlers *lz4_h = upb_lz4decoder_newhandlers(&h);
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_sink *lz4_sink = upb_pipeline_newsink(&pipeline, lz4_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  upb_lz4decoder_resetsink(upb_sink_getobj(lz4_sink), decoder_sink);
+  int32_t sum = 0;
+  upb_sink_reset(sink, &sum);
+
+  upb_recordcursor c;
+  upb_recordreader_seek(r, 0, &c);
+  int count = 0;
+  while (upb_recordcursor_decode(&c, lz4_sink)) count++;
+  ASSERT(upb_ok(upb_recordcursor_status(&c)));
+  ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+  ASSERT(count == num_records);
+  ASSERT(sum == num_records * (num_records - 1) / 2);
+
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(lz4_h, &h);
+  upb_handlers_unref(decoder_h, &h);
+  upb_handlers_unref(h, &h);
+  upb_recordreader_close(r);
+  upb_status_uninit(&status);
+  free(buf);
+}
+
+int run_tests(int argc, char *argv[]) {
+  UPB_UNUSED(argc);
+  UPB_UNUSED(argv);
+  test_roundtrip();
+  test_errors();
+  test_stop();
+  test_records();
+  return 0;
+}
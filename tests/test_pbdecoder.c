@@ -0,0 +1,1227 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Tests of upb_pbdecoder and the tools built on it that only need the static
+ * descriptor.proto defs, so
+ * unlike test_decoder.cc they can be built without upbc.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/descriptor/descriptor.upb.h"
+#include "upb/pb/decoder.h"
+#include "upb/pb/filter.h"
+#include "upb/pb/index.h"
+#include "upb/pb/key.h"
+#include "upb/pb/pull.h"
+#include "upb/shim/shim.h"
+#include "upb/symtab.h"
+#include "upb_test.h"
+
+// Decodes "buf" into "h" by passing it to the decoder in chunks of at most
+// "chunk" bytes, passing again whatever the decoder does not consume.
+static void decode_chunked(const upb_handlers *h, void *closure,
+                           const char *buf, size_t len, size_t chunk) {
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  upb_sink_reset(sink, closure);
+
+  ASSERT(upb_sink_startmsg(decoder_sink));
+  ASSERT(upb_sink_startstr(decoder_sink, UPB_BYTESTREAM_BYTES_STARTSTR, len));
+  size_t ofs = 0;
+  int stalls = 0;
+  while (ofs < len) {
+    size_t n = UPB_MIN(len - ofs, chunk);
+    size_t consumed = upb_sink_putstring(
+        decoder_sink, UPB_BYTESTREAM_BYTES_STRING, buf + ofs, n);
+    ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+    ASSERT(consumed <= n);
+    stalls = consumed ? 0 : stalls + 1;
+    ASSERT(stalls < 10);
+    ofs += consumed;
+  }
+  ASSERT(upb_sink_endstr(decoder_sink, UPB_BYTESTREAM_BYTES_ENDSTR));
+  ASSERT(upb_sink_endmsg(decoder_sink));
+
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+}
+
+/* Backpressure from string handlers ******************************************/
+
+typedef struct {
+  char name[512];
+  size_t name_len;
+  char field_names[128];
+  size_t field_names_len;
+  size_t max_take;  // Most bytes the "name" handler takes per call.
+  int calls;
+} strings;
+
+// Takes at most max_take bytes, and none at all on every third call.
+static size_t slow_name(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(hd);
+  strings *s = c;
+  if (++s->calls % 3 == 0) return 0;
+  n = UPB_MIN(n, s->max_take);
+  memcpy(s->name + s->name_len, buf, n);
+  s->name_len += n;
+  return n;
+}
+
+static size_t field_name(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(hd);
+  strings *s = c;
+  memcpy(s->field_names + s->field_names_len, buf, n);
+  s->field_names_len += n;
+  return n;
+}
+
+static void *startfield(void *c, const void *hd) {
+  UPB_UNUSED(hd);
+  return c;
+}
+
+static void strings_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  if (m == GOOGLE_PROTOBUF_DESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &slow_name, NULL, NULL);
+    upb_handlers_setstartsubmsg(h, upb_msgdef_itof(m, 2), &startfield, NULL,
+                                NULL);
+  } else if (m == GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &field_name, NULL, NULL);
+  }
+}
+
+static void test_string_backpressure() {
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h, &strings_handlers, NULL);
+
+  // Three DescriptorProto.name values of different lengths, each followed by
+  // a "field { name: 'xyz' }".
+  char buf[256];
+  char expected[256];
+  size_t len = 0, expected_len = 0;
+  static const int name_lens[] = {100, 5, 20};
+  for (int i = 0; i < 3; i++) {
+    buf[len++] = 0x0a;  // Field 1, delimited.
+    buf[len++] = name_lens[i];
+    for (int j = 0; j < name_lens[i]; j++) {
+      buf[len++] = expected[expected_len++] = 'a' + (i + j) % 26;
+    }
+    memcpy(buf + len, "\x12\x05\x0a\x03xyz", 7);  // Field 2, submessage.
+    len += 7;
+  }
+
+  // Every chunking, so that strings are cut off by both the handler and the
+  // end of the buffer, in both the user's buffer and the residual one.
+  for (size_t chunk = 1; chunk <= len; chunk++) {
+    for (size_t take = 1; take <= 16; take += 5) {
+      strings s;
+      memset(&s, 0, sizeof(s));
+      s.max_take = take;
+      decode_chunked(h, &s, buf, len, chunk);
+      ASSERT(s.name_len == expected_len);
+      ASSERT(memcmp(s.name, expected, expected_len) == 0);
+      ASSERT(s.field_names_len == 9);
+      ASSERT(memcmp(s.field_names, "xyzxyzxyz", 9) == 0);
+    }
+  }
+
+  upb_handlers_unref(h, &h);
+}
+
+/* Stack growth ***************************************************************/
+
+static void *start_nested(void *c, const void *hd) {
+  UPB_UNUSED(hd);
+  (*(int*)c)++;
+  return c;
+}
+
+static void nested_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  if (m == GOOGLE_PROTOBUF_DESCRIPTORPROTO) {
+    upb_handlers_setstartsubmsg(h, upb_msgdef_itof(m, 3), &start_nested, NULL,
+                                NULL);
+  }
+}
+
+// A DescriptorProto with nested_type submessages "depth" levels deep, written
+// from the innermost one out to the start of "buf".
+static size_t nested_input(char *buf, size_t size, int depth) {
+  char *p = buf + size;
+  *--p = 'x';
+  *--p = 1;
+  *--p = 0x0a;  // name: "x"
+  for (int i = 1; i < depth; i++) {
+    size_t len = buf + size - p;
+    ASSERT(len < 128);
+    *--p = len;
+    *--p = 0x1a;  // Field 3, delimited.
+  }
+  size_t len = buf + size - p;
+  memmove(buf, p, len);
+  return len;
+}
+
+static void test_stack_growth() {
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h, &nested_handlers, NULL);
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  ASSERT(upb_handlers_maxdepth(h) == 0);  // Recursive, so the stacks grow.
+  static const int depth = UPB_INITIAL_NESTING * 3;
+  char buf[128];
+  size_t len = nested_input(buf, sizeof(buf), depth);
+
+  for (size_t chunk = 1; chunk <= len; chunk += len - 1) {
+    int starts = 0;
+    decode_chunked(h, &starts, buf, len, chunk);
+    ASSERT(starts == depth - 1);
+  }
+
+  // With no realloc function the pipeline has only the initial block, so
+  // every allocation fails for some size of it: creating the sinks and the
+  // decoder, sizing the decoder's stack, and growing the stacks while
+  // decoding.  Each of these must fail cleanly.
+  static double mem[1024];
+  bool decoded = false, failed_decoding = false;
+  for (size_t size = 0; size <= sizeof(mem) && !decoded; size += 8) {
+    upb_pipeline pipeline;
+    upb_pipeline_init(&pipeline, mem, size, NULL, NULL);
+    upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+    upb_sink *decoder_sink =
+        sink ? upb_pipeline_newsink(&pipeline, decoder_h) : NULL;
+    if (decoder_sink &&
+        upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink)) {
+      int starts = 0;
+      upb_sink_reset(sink, &starts);
+      if (upb_bytestream_putstr(decoder_sink, buf, len)) {
+        ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+        ASSERT(starts == depth - 1);
+        decoded = true;
+      } else {
+        ASSERT(!upb_ok(upb_pipeline_status(&pipeline)));
+        failed_decoding = true;
+      }
+    }
+    upb_pipeline_uninit(&pipeline);
+  }
+  ASSERT(decoded && failed_decoding);
+
+  upb_handlers_unref(decoder_h, &h);
+  upb_handlers_unref(h, &h);
+}
+
+/* Batch decoding *************************************************************/
+
+static size_t all_name(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(hd);
+  strings *s = c;
+  memcpy(s->name + s->name_len, buf, n);
+  s->name_len += n;
+  return n;
+}
+
+static void batch_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  if (m == GOOGLE_PROTOBUF_DESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &all_name, NULL, NULL);
+    upb_handlers_setstartsubmsg(h, upb_msgdef_itof(m, 2), &startfield, NULL,
+                                NULL);
+  } else if (m == GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &field_name, NULL, NULL);
+  }
+}
+
+static void test_batch() {
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h, &batch_handlers, NULL);
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+
+  // More messages than are interleaved at once.  Message i has a name of
+  // length i and i fields named "xyz"; message 7 is truncated.
+  enum { N = 40 };
+  static char bufs[N][512];
+  const char *bufptrs[N];
+  size_t lens[N];
+  upb_pipeline pipelines[N];
+  upb_sink *sinks[N];
+  strings results[N];
+  for (int i = 0; i < N; i++) {
+    char *p = bufs[i];
+    *p++ = 0x0a;
+    *p++ = i;
+    for (int j = 0; j < i; j++) *p++ = 'a' + j % 26;
+    for (int j = 0; j < i; j++) {
+      memcpy(p, "\x12\x05\x0a\x03xyz", 7);
+      p += 7;
+    }
+    bufptrs[i] = bufs[i];
+    lens[i] = p - bufs[i] - (i == 7 ? 3 : 0);
+
+    upb_pipeline_init(&pipelines[i], NULL, 0, upb_realloc, NULL);
+    upb_sink *sink = upb_pipeline_newsink(&pipelines[i], h);
+    sinks[i] = upb_pipeline_newsink(&pipelines[i], decoder_h);
+    upb_pbdecoder_resetsink(upb_sink_getobj(sinks[i]), sink);
+    memset(&results[i], 0, sizeof(results[i]));
+    upb_sink_reset(sink, &results[i]);
+  }
+
+  ASSERT(!upb_pbdecoder_decodebatch(sinks, bufptrs, lens, N));
+
+  for (int i = 0; i < N; i++) {
+    ASSERT(upb_ok(upb_pipeline_status(&pipelines[i])) == (i != 7));
+    ASSERT(results[i].name_len == (size_t)i);
+    for (int j = 0; j < i; j++) ASSERT(results[i].name[j] == 'a' + j % 26);
+    if (i != 7) ASSERT(results[i].field_names_len == (size_t)i * 3);
+    upb_pipeline_uninit(&pipelines[i]);
+  }
+
+  upb_handlers_unref(decoder_h, &h);
+  upb_handlers_unref(h, &h);
+}
+
+/* Terminal fields ************************************************************/
+
+// DescriptorProto { name: "Message" field { name: "abc" } field { name: "d" } }
+// followed by bytes that are not valid protobuf data.
+static const char terminal_input[] =
+    "\x0a\x07Message" "\x12\x05\x0a\x03" "abc" "\x12\x03\x0a\x01" "d"
+    "\xff\xff\xff";
+
+// Decodes terminal_input with the given terminal field, in chunks, until the
+// decoder stops.  Returns the number of bytes consumed.
+static size_t decode_terminal(const upb_handlers *h, uint32_t terminal,
+                              strings *s, size_t chunk) {
+  const upb_fielddef *f = upb_msgdef_itof(GOOGLE_PROTOBUF_DESCRIPTORPROTO,
+                                          terminal);
+  const upb_handlers *decoder_h =
+      upb_pbdecoder_getterminalhandlers(h, &f, 1, &h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder *d = upb_sink_getobj(decoder_sink);
+  upb_pbdecoder_resetsink(d, sink);
+  upb_sink_reset(sink, s);
+
+  size_t len = sizeof(terminal_input) - 1;
+  ASSERT(upb_sink_startmsg(decoder_sink));
+  ASSERT(upb_sink_startstr(decoder_sink, UPB_BYTESTREAM_BYTES_STARTSTR, len));
+  size_t ofs = 0;
+  while (ofs < len) {
+    size_t n = UPB_MIN(len - ofs, chunk);
+    size_t consumed = upb_sink_putstring(
+        decoder_sink, UPB_BYTESTREAM_BYTES_STRING, terminal_input + ofs, n);
+    ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+    ofs += consumed;
+    if (consumed < n) break;
+  }
+  ASSERT(upb_eof(upb_pipeline_status(&pipeline)));
+  ASSERT(upb_pbdecoder_bytesparsed(d) == ofs);
+  // Once stopped, nothing more is consumed.
+  ASSERT(upb_sink_putstring(decoder_sink, UPB_BYTESTREAM_BYTES_STRING,
+                            terminal_input + ofs, len - ofs) == 0);
+  ASSERT(upb_sink_endstr(decoder_sink, UPB_BYTESTREAM_BYTES_ENDSTR));
+  ASSERT(upb_sink_endmsg(decoder_sink));
+
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+  return ofs;
+}
+
+static void test_terminal() {
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h, &batch_handlers, NULL);
+
+  for (size_t chunk = 1; chunk < sizeof(terminal_input); chunk++) {
+    strings s;
+    memset(&s, 0, sizeof(s));
+    ASSERT(decode_terminal(h, 1, &s, chunk) == 9);
+    ASSERT(s.name_len == 7 && memcmp(s.name, "Message", 7) == 0);
+    ASSERT(s.field_names_len == 0);
+
+    // Repeated fields are done after their first element.
+    memset(&s, 0, sizeof(s));
+    ASSERT(decode_terminal(h, 2, &s, chunk) == 16);
+    ASSERT(s.name_len == 7);
+    ASSERT(s.field_names_len == 3 && memcmp(s.field_names, "abc", 3) == 0);
+  }
+
+  upb_handlers_unref(h, &h);
+}
+
+static void test_key() {
+  // FieldDescriptorProto.number, followed by garbage.
+  upb_pbkey *k = upb_pbkey_new(
+      upb_msgdef_itof(GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO, 3));
+  ASSERT(k);
+  ASSERT(upb_pbkey_extract(k, "\x0a\x03" "abc" "\x18\x2a" "\xff\xff", 9));
+  ASSERT(upb_value_getint32(upb_pbkey_value(k)) == 42);
+  ASSERT(upb_pbkey_extract(k, "\x18\x07", 2));
+  ASSERT(upb_value_getint32(upb_pbkey_value(k)) == 7);
+  // Missing, and then broken before the key.
+  ASSERT(!upb_pbkey_extract(k, "\x0a\x03" "abc", 5));
+  ASSERT(upb_ok(upb_pbkey_status(k)));
+  ASSERT(!upb_pbkey_extract(k, "\x0a\x09" "abc", 5));
+  ASSERT(!upb_ok(upb_pbkey_status(k)));
+  upb_pbkey_free(k);
+
+  // DescriptorProto.name; the name of the nested_type that comes first must
+  // not be taken for it.
+  k = upb_pbkey_new(upb_msgdef_itof(GOOGLE_PROTOBUF_DESCRIPTORPROTO, 1));
+  ASSERT(k);
+  static const char nested[] = "\x1a\x05\x0a\x03" "xyz" "\x0a\x01" "M";
+  ASSERT(upb_pbkey_extract(k, nested, sizeof(nested) - 1));
+  size_t len;
+  const char *str = upb_pbkey_str(k, &len);
+  ASSERT(len == 1 && str == nested + 9);
+  upb_pbkey_free(k);
+
+  ASSERT(!upb_pbkey_new(upb_msgdef_itof(GOOGLE_PROTOBUF_DESCRIPTORPROTO, 2)));
+}
+
+/* Filters ********************************************************************/
+
+static bool match(upb_pbfilter *f, const char *buf, size_t len) {
+  bool ret = upb_pbfilter_match(f, buf, len);
+  ASSERT(upb_ok(upb_pbfilter_status(f)));
+  return ret;
+}
+
+#define MATCH(f, str) match(f, str, sizeof(str) - 1)
+
+static void test_filter() {
+  const upb_msgdef *m = GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO;
+  const upb_fielddef *name = upb_msgdef_itof(m, 1);
+  const upb_fielddef *number = upb_msgdef_itof(m, 3);
+  const upb_fielddef *packed[] = {
+    upb_msgdef_itof(m, 8), upb_msgdef_itof(GOOGLE_PROTOBUF_FIELDOPTIONS, 2)
+  };
+
+  // number == 3 && name in {"a", "bc"}
+  upb_value three = upb_value_int32(3);
+  upb_value names[] = {upb_value_cstr("a"), upb_value_cstr("bc")};
+  upb_pred eq = {UPB_PRED_EQ, &number, 1, &three, 1, NULL, 0};
+  upb_pred in = {UPB_PRED_IN, &name, 1, names, 2, NULL, 0};
+  const upb_pred *and_args[] = {&eq, &in};
+  upb_pred and = {UPB_PRED_AND, NULL, 0, NULL, 0, and_args, 2};
+  upb_status status = UPB_STATUS_INIT;
+  upb_pbfilter *f = upb_pbfilter_new(m, &and, &status);
+  ASSERT(f);
+  // The garbage at the end is never reached.
+  ASSERT(!MATCH(f, "\x18\x04" "\xff\xff\xff"));
+  ASSERT(MATCH(f, "\x18\x03" "\x0a\x02" "bc" "\xff\xff\xff"));
+  ASSERT(!MATCH(f, "\x0a\x01" "b" "\x18\x03"));
+  ASSERT(!MATCH(f, "\x0a\x02" "ab" "\x18\x03"));
+  ASSERT(!MATCH(f, "\x18\x03"));
+  ASSERT(MATCH(f, "\x0a\x01" "a" "\x18\x03"));
+  ASSERT(!upb_pbfilter_match(f, "\x0a\x05" "a", 3));
+  ASSERT(!upb_ok(upb_pbfilter_status(f)));
+  upb_pbfilter_free(f);
+
+  // options.packed == true || !(number < 100)
+  upb_value yes = upb_value_bool(true);
+  upb_value hundred = upb_value_int32(100);
+  upb_pred ispacked = {UPB_PRED_EQ, packed, 2, &yes, 1, NULL, 0};
+  upb_pred lt = {UPB_PRED_LT, &number, 1, &hundred, 1, NULL, 0};
+  const upb_pred *lt_arg = &lt;
+  upb_pred not = {UPB_PRED_NOT, NULL, 0, NULL, 0, &lt_arg, 1};
+  const upb_pred *or_args[] = {&ispacked, &not};
+  upb_pred or = {UPB_PRED_OR, NULL, 0, NULL, 0, or_args, 2};
+  f = upb_pbfilter_new(m, &or, &status);
+  ASSERT(f);
+  // Stops inside the submessage.
+  ASSERT(MATCH(f, "\x42\x02\x10\x01" "\xff\xff\xff"));
+  ASSERT(MATCH(f, "\x18\x64"));
+  ASSERT(!MATCH(f, "\x18\x05"));
+  ASSERT(!MATCH(f, "\x18\x05" "\x42\x02\x10\x00"));
+  upb_pbfilter_free(f);
+
+  // Repeated fields match if any element does, packed or not.
+  const upb_fielddef *path =
+      upb_msgdef_itof(GOOGLE_PROTOBUF_SOURCECODEINFO_LOCATION, 1);
+  upb_value v300 = upb_value_int32(300);
+  upb_pred has300 = {UPB_PRED_EQ, &path, 1, &v300, 1, NULL, 0};
+  f = upb_pbfilter_new(GOOGLE_PROTOBUF_SOURCECODEINFO_LOCATION, &has300,
+                       &status);
+  ASSERT(f);
+  ASSERT(MATCH(f, "\x0a\x04" "\x01\xac\x02\x02"));
+  ASSERT(MATCH(f, "\x08\x01" "\x08\xac\x02" "\xff"));
+  ASSERT(!MATCH(f, "\x0a\x02" "\x01\x02"));
+  upb_pbfilter_free(f);
+
+  // Fields must be in the message.
+  ASSERT(!upb_pbfilter_new(GOOGLE_PROTOBUF_DESCRIPTORPROTO, &eq, &status));
+  ASSERT(!upb_ok(&status));
+  upb_status_uninit(&status);
+}
+
+/* Index **********************************************************************/
+
+static size_t msg_name(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(hd);
+  strings *s = c;
+  memcpy(s->name + s->name_len, buf, n);
+  s->name_len += n;
+  return n;
+}
+
+static void index_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  if (m == GOOGLE_PROTOBUF_DESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &msg_name, NULL, NULL);
+    upb_handlers_setstartsubmsg(h, upb_msgdef_itof(m, 2), &startfield, NULL,
+                                NULL);
+  } else if (m == GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO) {
+    upb_handlers_setstring(h, upb_msgdef_itof(m, 1), &field_name, NULL, NULL);
+  }
+}
+
+// Decodes occurrences of an indexed path into "s" with handlers "h".
+static bool index_decode(const upb_pbindex *idx, int path, size_t first,
+                         size_t n, bool value, const upb_handlers *h,
+                         strings *s) {
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  upb_sink_reset(sink, s);
+  memset(s, 0, sizeof(*s));
+  bool ok = value ? upb_pbindex_decodevalue(idx, path, first, decoder_sink)
+                  : upb_pbindex_decode(idx, path, first, n, decoder_sink);
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+  return ok;
+}
+
+static void test_index() {
+  const upb_msgdef *m = GOOGLE_PROTOBUF_DESCRIPTORPROTO;
+  // DescriptorProto {
+  //   name: "M"
+  //   field { name: "a" number: 1 }
+  //   nested_type { field { name: "x" number: 9 } }
+  //   field { name: "b" number: 2 }
+  //   <unknown fixed32 51>
+  //   options { message_set_wire_format: true }
+  //   field { name: "c" number: 3 }
+  //   field { name: "d" number: 4 }
+  // }
+  static const char buf[] =
+      "\x0a\x01" "M"
+      "\x12\x05" "\x0a\x01" "a" "\x18\x01"
+      "\x1a\x07" "\x12\x05" "\x0a\x01" "x" "\x18\x09"
+      "\x12\x05" "\x0a\x01" "b" "\x18\x02"
+      "\x9d\x03" "abcd"
+      "\x3a\x02" "\x08\x01"
+      "\x12\x05" "\x0a\x01" "c" "\x18\x03"
+      "\x12\x05" "\x0a\x01" "d" "\x18\x04";
+
+  upb_pbindex *idx = upb_pbindex_new(m);
+  const upb_fielddef *field = upb_msgdef_itof(m, 2);
+  const upb_fielddef *wire_format[] = {
+    upb_msgdef_itof(m, 7), upb_msgdef_itof(GOOGLE_PROTOBUF_MESSAGEOPTIONS, 1)
+  };
+  int fields = upb_pbindex_addpath(idx, &field, 1);
+  int wf = upb_pbindex_addpath(idx, wire_format, 2);
+  ASSERT(fields == 0 && wf == 1);
+  ASSERT(upb_pbindex_addpath(idx, &field, 1) == fields);
+  ASSERT(upb_pbindex_addpath(idx, wire_format + 1, 1) == -1);
+  ASSERT(!upb_ok(upb_pbindex_status(idx)));
+
+  ASSERT(upb_pbindex_build(idx, buf, sizeof(buf) - 1));
+  ASSERT(upb_ok(upb_pbindex_status(idx)));
+  ASSERT(upb_pbindex_count(idx, fields) == 4);
+  size_t len;
+  const char *p = upb_pbindex_field(idx, fields, 1, &len);
+  ASSERT(len == 7 && memcmp(p, "\x12\x05" "\x0a\x01" "b" "\x18\x02", 7) == 0);
+  p = upb_pbindex_value(idx, fields, 1, &len);
+  ASSERT(len == 5 && memcmp(p, "\x0a\x01" "b" "\x18\x02", 5) == 0);
+  ASSERT(upb_pbindex_count(idx, wf) == 1);
+  p = upb_pbindex_value(idx, wf, 0, &len);
+  ASSERT(len == 1 && *p == 1);
+
+  strings s;
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO, NULL, &h, &index_handlers, NULL);
+  ASSERT(index_decode(idx, fields, 2, 1, true, h, &s));
+  ASSERT(s.field_names_len == 1 && s.field_names[0] == 'c');
+  upb_handlers_unref(h, &h);
+
+  // Only the given elements are decoded; "c" and "d" in one piece.
+  h = upb_handlers_newfrozen(m, NULL, &h, &index_handlers, NULL);
+  ASSERT(index_decode(idx, fields, 1, 3, false, h, &s));
+  ASSERT(s.name_len == 0);
+  ASSERT(s.field_names_len == 3 && memcmp(s.field_names, "bcd", 3) == 0);
+  upb_handlers_unref(h, &h);
+
+  ASSERT(!upb_pbindex_build(idx, buf, sizeof(buf) - 2));
+  ASSERT(!upb_ok(upb_pbindex_status(idx)));
+  upb_pbindex_free(idx);
+}
+
+/* Pull decoder ***************************************************************/
+
+// FileDescriptorProto {
+//   name: "f"
+//   source_code_info {
+//     location {
+//       path: [1, 300, 2]  (packed)
+//       span: 4  (not packed)
+//       <unknown group 50 containing an unknown varint and a nested group>
+//     }
+//   }
+//   <unknown fixed32 51>
+//   message_type { name: "M" }
+// }
+static const char pull_input[] =
+    "\x0a\x01" "f"
+    "\x4a\x12" "\x0a\x10"
+        "\x0a\x04" "\x01\xac\x02\x02"
+        "\x10\x04"
+        "\x93\x03" "\x08\x01" "\x0b\x0c" "\x94\x03"
+    "\x9d\x03" "abcd"
+    "\x22\x03" "\x0a\x01M";
+
+static void expect_value(upb_pbpull *p, uint32_t number, int32_t val) {
+  ASSERT(upb_pbpull_next(p) == UPB_PULL_VALUE);
+  ASSERT(upb_fielddef_number(upb_pbpull_field(p)) == number);
+  ASSERT(upb_value_getint32(upb_pbpull_value(p)) == val);
+}
+
+static void expect_string(upb_pbpull *p, uint32_t number, const char *str) {
+  ASSERT(upb_pbpull_next(p) == UPB_PULL_STRING);
+  ASSERT(upb_fielddef_number(upb_pbpull_field(p)) == number);
+  size_t len;
+  const char *data = upb_pbpull_str(p, &len);
+  ASSERT(len == strlen(str));
+  ASSERT(memcmp(data, str, len) == 0);
+}
+
+static void expect_submsg(upb_pbpull *p, upb_pull_event e, uint32_t number,
+                          const upb_msgdef *m) {
+  ASSERT(upb_pbpull_next(p) == e);
+  ASSERT(upb_fielddef_number(upb_pbpull_field(p)) == number);
+  ASSERT(upb_pbpull_msgdef(p) == m);
+}
+
+static void test_pull() {
+  const upb_msgdef *m = GOOGLE_PROTOBUF_FILEDESCRIPTORPROTO;
+  upb_pbpull p;
+  upb_pbpull_reset(&p, m, pull_input, sizeof(pull_input) - 1);
+  expect_string(&p, 1, "f");
+  expect_submsg(&p, UPB_PULL_STARTSUBMSG, 9, GOOGLE_PROTOBUF_SOURCECODEINFO);
+  expect_submsg(&p, UPB_PULL_STARTSUBMSG, 1,
+                GOOGLE_PROTOBUF_SOURCECODEINFO_LOCATION);
+  expect_value(&p, 1, 1);
+  expect_value(&p, 1, 300);
+  expect_value(&p, 1, 2);
+  expect_value(&p, 2, 4);
+  expect_submsg(&p, UPB_PULL_ENDSUBMSG, 1, GOOGLE_PROTOBUF_SOURCECODEINFO);
+  expect_submsg(&p, UPB_PULL_ENDSUBMSG, 9, m);
+  expect_submsg(&p, UPB_PULL_STARTSUBMSG, 4, GOOGLE_PROTOBUF_DESCRIPTORPROTO);
+  expect_string(&p, 1, "M");
+  expect_submsg(&p, UPB_PULL_ENDSUBMSG, 4, m);
+  ASSERT(upb_pbpull_next(&p) == UPB_PULL_EOF);
+  ASSERT(upb_pbpull_field(&p) == NULL);
+  ASSERT(upb_pbpull_next(&p) == UPB_PULL_EOF);
+  ASSERT(upb_ok(upb_pbpull_status(&p)));
+
+  // Skipping a submessage goes straight to its end.
+  upb_pbpull_reset(&p, m, pull_input, sizeof(pull_input) - 1);
+  upb_pull_event e;
+  int events = 0;
+  while ((e = upb_pbpull_next(&p)) > UPB_PULL_EOF) {
+    events++;
+    if (e == UPB_PULL_STARTSUBMSG) {
+      upb_pbpull_skipsubmsg(&p);
+      ASSERT(upb_pbpull_next(&p) == UPB_PULL_ENDSUBMSG);
+      ASSERT(upb_pbpull_msgdef(&p) == m);
+    }
+  }
+  ASSERT(e == UPB_PULL_EOF);
+  ASSERT(events == 3);
+}
+
+static upb_fielddef *newfield(const char *name, int32_t num, uint8_t type,
+                              uint8_t label, const char *type_name,
+                              void *owner) {
+  upb_fielddef *f = upb_fielddef_new(owner);
+  ASSERT(upb_fielddef_setname(f, name, NULL));
+  ASSERT(upb_fielddef_setnumber(f, num, NULL));
+  upb_fielddef_settype(f, type);
+  upb_fielddef_setlabel(f, label);
+  if (type_name) ASSERT(upb_fielddef_setsubdefname(f, type_name, NULL));
+  return f;
+}
+
+// GroupTest { optional group G = 1 { optional int32 a = 2; }
+//             optional int32 b = 3; }
+static const upb_msgdef *newgrouptest(const void *owner) {
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_msgdef *m = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(m), "GroupTest", NULL));
+  upb_fielddef *g = newfield("g", 1, UPB_TYPE_MESSAGE, UPB_LABEL_OPTIONAL,
+                             ".GroupTest.G", &s);
+  upb_fielddef_setdescriptortype(g, UPB_DESCRIPTOR_TYPE_GROUP);
+  upb_msgdef_addfield(m, g, &s, NULL);
+  upb_msgdef_addfield(m, newfield("b", 3, UPB_TYPE_INT32, UPB_LABEL_OPTIONAL,
+                                  NULL, &s), &s, NULL);
+  upb_msgdef *group = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(group), "GroupTest.G", NULL));
+  upb_msgdef_addfield(group, newfield("a", 2, UPB_TYPE_INT32,
+                                      UPB_LABEL_OPTIONAL, NULL, &s), &s, NULL);
+  upb_def *defs[] = {upb_upcast(m), upb_upcast(group)};
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 2, &s, &status), &status);
+  const upb_msgdef *ret = upb_symtab_lookupmsg(s, "GroupTest", owner);
+  upb_symtab_unref(s, &s);
+  return ret;
+}
+
+// GroupTest {
+//   g {
+//     a: 5
+//     <unknown group 4 containing an unknown varint and unknown group 5>
+//     a: 6
+//   }
+//   b: 7
+// }
+static const char group_input[] =
+    "\x0b"
+        "\x10\x05"
+        "\x23" "\x08\x01" "\x2b" "\x30\x07" "\x2c" "\x24"
+        "\x10\x06"
+    "\x0c"
+    "\x18\x07";
+
+static void test_pull_groups() {
+  const upb_msgdef *m = newgrouptest(&m);
+  const upb_msgdef *g =
+      upb_downcast_msgdef(upb_fielddef_subdef(upb_msgdef_itof(m, 1)));
+  upb_pbpull p;
+  upb_pbpull_reset(&p, m, group_input, sizeof(group_input) - 1);
+  expect_submsg(&p, UPB_PULL_STARTSUBMSG, 1, g);
+  expect_value(&p, 2, 5);
+  expect_value(&p, 2, 6);
+  expect_submsg(&p, UPB_PULL_ENDSUBMSG, 1, m);
+  expect_value(&p, 3, 7);
+  ASSERT(upb_pbpull_next(&p) == UPB_PULL_EOF);
+  ASSERT(upb_ok(upb_pbpull_status(&p)));
+
+  // Skipping a group scans over its contents, unknown groups and all, and
+  // stops at its own ENDGROUP.
+  upb_pbpull_reset(&p, m, group_input, sizeof(group_input) - 1);
+  expect_submsg(&p, UPB_PULL_STARTSUBMSG, 1, g);
+  upb_pbpull_skipsubmsg(&p);
+  expect_submsg(&p, UPB_PULL_ENDSUBMSG, 1, m);
+  expect_value(&p, 3, 7);
+  ASSERT(upb_pbpull_next(&p) == UPB_PULL_EOF);
+  ASSERT(upb_ok(upb_pbpull_status(&p)));
+
+  // A group with no ENDGROUP is an error, whether or not it is skipped.
+  for (int skip = 0; skip < 2; skip++) {
+    upb_pbpull_reset(&p, m, group_input, sizeof(group_input) - 4);
+    expect_submsg(&p, UPB_PULL_STARTSUBMSG, 1, g);
+    if (skip) upb_pbpull_skipsubmsg(&p);
+    upb_pull_event e;
+    while ((e = upb_pbpull_next(&p)) > UPB_PULL_EOF)
+      ;
+    ASSERT(e == UPB_PULL_ERROR);
+    ASSERT(!upb_ok(upb_pbpull_status(&p)));
+  }
+
+  upb_msgdef_unref(m, &m);
+}
+
+static void test_pull_errors() {
+  const upb_msgdef *m = GOOGLE_PROTOBUF_FILEDESCRIPTORPROTO;
+  upb_pbpull p;
+  upb_pull_event e;
+
+  // Every proper prefix that ends in the middle of a value is an error;
+  // the rest decode the fields that are there.
+  static const size_t field_ends[] = {3, 23, 29};
+  for (size_t len = 0; len < sizeof(pull_input) - 1; len++) {
+    bool complete = len == 0;
+    for (size_t i = 0; i < sizeof(field_ends) / sizeof(field_ends[0]); i++)
+      if (len == field_ends[i]) complete = true;
+    upb_pbpull_reset(&p, m, pull_input, len);
+    while ((e = upb_pbpull_next(&p)) > UPB_PULL_EOF)
+      ;
+    ASSERT(e == (complete ? UPB_PULL_EOF : UPB_PULL_ERROR));
+    ASSERT(upb_ok(upb_pbpull_status(&p)) == complete);
+  }
+
+  // A submessage that claims to extend past its parent.
+  static const char overflow[] = "\x22\x04" "\x12\x05\x18\x07";
+  upb_pbpull_reset(&p, m, overflow, sizeof(overflow) - 1);
+  ASSERT(upb_pbpull_next(&p) == UPB_PULL_STARTSUBMSG);
+  ASSERT(upb_pbpull_next(&p) == UPB_PULL_ERROR);
+  ASSERT(upb_pbpull_next(&p) == UPB_PULL_ERROR);
+  ASSERT(!upb_ok(upb_pbpull_status(&p)));
+}
+
+/* Map fields *****************************************************************/
+
+static upb_msgdef *newentry(const char *name, uint8_t key_type,
+                            uint8_t val_type, void *owner) {
+  upb_msgdef *m = upb_msgdef_new(owner);
+  ASSERT(upb_def_setfullname(upb_upcast(m), name, NULL));
+  upb_msgdef_setmapentry(m, true);
+  upb_msgdef_addfield(m, newfield("key", 1, key_type, UPB_LABEL_OPTIONAL,
+                                  NULL, owner), owner, NULL);
+  upb_msgdef_addfield(m, newfield("value", 2, val_type, UPB_LABEL_OPTIONAL,
+                                  NULL, owner), owner, NULL);
+  return m;
+}
+
+// MapTest {
+//   map<string, int32> strmap = 1;
+//   map<sint64, string> intmap = 2;
+//   map<int32, int64> valmap = 3;
+// }
+static const upb_msgdef *newmaptest(const void *owner) {
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_msgdef *m = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(m), "MapTest", NULL));
+  upb_msgdef_addfield(m, newfield("strmap", 1, UPB_TYPE_MESSAGE,
+                                  UPB_LABEL_REPEATED, ".MapTest.StrEntry", &s),
+                      &s, NULL);
+  upb_msgdef_addfield(m, newfield("intmap", 2, UPB_TYPE_MESSAGE,
+                                  UPB_LABEL_REPEATED, ".MapTest.IntEntry", &s),
+                      &s, NULL);
+  upb_msgdef_addfield(m, newfield("valmap", 3, UPB_TYPE_MESSAGE,
+                                  UPB_LABEL_REPEATED, ".MapTest.ValEntry", &s),
+                      &s, NULL);
+  upb_msgdef *str_entry =
+      newentry("MapTest.StrEntry", UPB_TYPE_STRING, UPB_TYPE_INT32, &s);
+  upb_msgdef *int_entry =
+      newentry("MapTest.IntEntry", UPB_TYPE_INT64, UPB_TYPE_STRING, &s);
+  upb_fielddef_setdescriptortype(
+      (upb_fielddef*)upb_msgdef_itof(int_entry, 1),
+      UPB_DESCRIPTOR_TYPE_SINT64);
+  upb_msgdef *val_entry =
+      newentry("MapTest.ValEntry", UPB_TYPE_INT32, UPB_TYPE_INT64, &s);
+  upb_def *defs[] = {
+    upb_upcast(m), upb_upcast(str_entry), upb_upcast(int_entry),
+    upb_upcast(val_entry)
+  };
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 4, &s, &status), &status);
+  const upb_msgdef *ret = upb_symtab_lookupmsg(s, "MapTest", owner);
+  upb_symtab_unref(s, &s);
+  return ret;
+}
+
+typedef struct {
+  upb_strtable strmap;
+  upb_inttable intmap;
+  upb_inttable valmap;
+  int entry_values;  // Calls of the StrEntry "value" handler.
+} maps;
+
+// Remembers what it allocates, so that the test can free it all at the end.
+static void *allocs[64];
+static int alloc_count;
+
+static void *testalloc(void *ud, void *ptr, size_t oldsize, size_t size) {
+  UPB_UNUSED(ud);
+  UPB_UNUSED(oldsize);
+  ASSERT(!ptr && alloc_count < 64);
+  return allocs[alloc_count++] = malloc(size);
+}
+
+static bool entry_value(void *c, const void *hd, int32_t val) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(val);
+  maps *mp = c;
+  mp->entry_values++;
+  return true;
+}
+
+static void map_handlers(void *closure, upb_handlers *h) {
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  if (strcmp(upb_msgdef_fullname(m), "MapTest") == 0) {
+    if (closure) {
+      ASSERT(upb_shim_setmap(h, upb_msgdef_itof(m, 1), offsetof(maps, strmap),
+                             closure));
+      ASSERT(upb_shim_setmap(h, upb_msgdef_itof(m, 2), offsetof(maps, intmap),
+                             closure));
+      ASSERT(upb_shim_setmap(h, upb_msgdef_itof(m, 3), offsetof(maps, valmap),
+                             closure));
+    }
+  } else if (strcmp(upb_msgdef_fullname(m), "MapTest.StrEntry") == 0) {
+    upb_handlers_setint32(h, upb_msgdef_itof(m, 2), &entry_value, NULL, NULL);
+  }
+}
+
+static const char map_input[] =
+    "\x0a\x05" "\x0a\x01" "a" "\x10\x01"
+    "\x0a\x07" "\x0a\x02" "bb" "\x10\xac\x02"
+    // A repeated key replaces the first value.
+    "\x0a\x05" "\x0a\x01" "a" "\x10\x07"
+    // No value.
+    "\x0a\x03" "\x0a\x01" "c"
+    // Value first, and an unknown field.
+    "\x0a\x07" "\x10\x05" "\x18\x09" "\x0a\x01" "d"
+    "\x12\x07" "\x08\x03" "\x12\x03" "xyz"
+    // No key.
+    "\x12\x06" "\x12\x04" "zero"
+    // Longer than the decoder's residual buffer.
+    "\x12\x2c" "\x08\x14" "\x12\x28"
+    "0123456789012345678901234567890123456789"
+    // Values with all bits set, which the table can't store as they are.
+    "\x1a\x0d" "\x08\x01" "\x10\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01"
+    "\x1a\x04" "\x08\x02" "\x10\x05";
+
+static int32_t strmap_get(const maps *mp, const char *key) {
+  upb_value v;
+  ASSERT(upb_strtable_lookup(&mp->strmap, key, &v));
+  return upb_value_getint32(v);
+}
+
+static bool intmap_is(const maps *mp, int64_t key, const char *val) {
+  upb_value v;
+  ASSERT(upb_inttable_lookup(&mp->intmap, (uintptr_t)key, &v));
+  const upb_shim_str *str = upb_value_getptr(v);
+  return str->len == strlen(val) && memcmp(str->ptr, val, str->len) == 0;
+}
+
+static int64_t valmap_get(const maps *mp, int32_t key) {
+  upb_value v;
+  ASSERT(upb_inttable_lookup(&mp->valmap, (uintptr_t)key, &v));
+  return *(int64_t*)upb_value_getptr(v);
+}
+
+static void test_map() {
+  const upb_msgdef *m = newmaptest(&m);
+  const upb_msgdef *entry =
+      upb_downcast_msgdef(upb_fielddef_subdef(upb_msgdef_itof(m, 1)));
+  ASSERT(upb_msgdef_mapentry(entry));
+  ASSERT(upb_fielddef_ismap(upb_msgdef_itof(m, 1)));
+  ASSERT(!upb_fielddef_ismap(upb_msgdef_itof(entry, 1)));
+
+  upb_shim_alloc alloc = {testalloc, NULL};
+  const upb_handlers *h =
+      upb_handlers_newfrozen(m, NULL, &h, &map_handlers, &alloc);
+  size_t chunks[] = {1, 3, sizeof(map_input)};
+  for (int i = 0; i < 3; i++) {
+    maps mp;
+    ASSERT(upb_strtable_init(&mp.strmap, UPB_CTYPE_INT32));
+    ASSERT(upb_inttable_init(&mp.intmap, UPB_CTYPE_PTR));
+    ASSERT(upb_inttable_init(&mp.valmap, UPB_CTYPE_PTR));
+    mp.entry_values = 0;
+    decode_chunked(h, &mp, map_input, sizeof(map_input) - 1, chunks[i]);
+    ASSERT(upb_strtable_count(&mp.strmap) == 4);
+    ASSERT(strmap_get(&mp, "a") == 7);
+    ASSERT(strmap_get(&mp, "bb") == 300);
+    ASSERT(strmap_get(&mp, "c") == 0);
+    ASSERT(strmap_get(&mp, "d") == 5);
+    ASSERT(upb_inttable_count(&mp.intmap) == 3);
+    ASSERT(intmap_is(&mp, -2, "xyz"));
+    ASSERT(intmap_is(&mp, 0, "zero"));
+    ASSERT(intmap_is(&mp, 10, "0123456789012345678901234567890123456789"));
+    ASSERT(upb_inttable_count(&mp.valmap) == 2);
+    ASSERT(valmap_get(&mp, 1) == -1);
+    ASSERT(valmap_get(&mp, 2) == 5);
+    // The entries never reached their own handlers.
+    ASSERT(mp.entry_values == 0);
+    upb_strtable_uninit(&mp.strmap);
+    upb_inttable_uninit(&mp.intmap);
+    upb_inttable_uninit(&mp.valmap);
+  }
+
+  // An entry that claims to be nearly 4GB long.  Its bytes are collected as
+  // they arrive, in a pipeline that can't allocate anything near that, and
+  // only ending the input inside it fails.
+  static const char huge[] = "\x0a\xf0\xff\xff\xff\x0f" "\x0a\x01" "a";
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  static double mem[1024];
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, mem, sizeof(mem), NULL, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  maps mp;
+  upb_sink_reset(sink, &mp);
+  ASSERT(upb_sink_startmsg(decoder_sink));
+  ASSERT(upb_sink_startstr(decoder_sink, UPB_BYTESTREAM_BYTES_STARTSTR, 0));
+  for (size_t ofs = 0; ofs < sizeof(huge) - 1; ofs += 4) {
+    size_t n = UPB_MIN(4, sizeof(huge) - 1 - ofs);
+    ASSERT(upb_sink_putstring(decoder_sink, UPB_BYTESTREAM_BYTES_STRING,
+                              huge + ofs, n) == n);
+    ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+  }
+  ASSERT(!upb_sink_endstr(decoder_sink, UPB_BYTESTREAM_BYTES_ENDSTR));
+  ASSERT(!upb_ok(upb_pipeline_status(&pipeline)));
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+  upb_handlers_unref(h, &h);
+
+  // Without a map entry handler, entries are submessages as before.
+  h = upb_handlers_newfrozen(m, NULL, &h, &map_handlers, NULL);
+  mp.entry_values = 0;
+  decode_chunked(h, &mp, map_input, sizeof(map_input) - 1, 2);
+  ASSERT(mp.entry_values == 4);
+  upb_handlers_unref(h, &h);
+
+  for (int i = 0; i < alloc_count; i++) free(allocs[i]);
+  upb_msgdef_unref(m, &m);
+}
+
+/* Extensions *****************************************************************/
+
+static bool ext_value(void *c, const void *hd, int32_t val) {
+  int32_t *vals = c;
+  vals[*(const uint32_t*)hd] = val;
+  return true;
+}
+
+static void ext_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  static const uint32_t slots[] = {0, 1, 2};
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  upb_handlers_setint32(h, upb_msgdef_itof(m, 1), &ext_value,
+                        (void*)&slots[0], NULL);
+  upb_handlers_setint32(h, upb_msgdef_itof(m, 100), &ext_value,
+                        (void*)&slots[1], NULL);
+  upb_handlers_setint32(h, upb_msgdef_itof(m, 100000), &ext_value,
+                        (void*)&slots[2], NULL);
+}
+
+static void test_extensions() {
+  // ExtTest { optional int32 a = 1; extensions 100 to max; }, with two
+  // extensions added to the symtab on their own.
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_msgdef *m = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(m), "ExtTest", NULL));
+  ASSERT(upb_msgdef_addextrange(m, 100, UPB_MAX_FIELDNUMBER + 1, NULL));
+  upb_msgdef_addfield(m, newfield("a", 1, UPB_TYPE_INT32, UPB_LABEL_OPTIONAL,
+                                  NULL, &s), &s, NULL);
+  upb_def *defs[] = {upb_upcast(m), NULL, NULL};
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 1, &s, &status), &status);
+  uint32_t nums[] = {100, 100000};
+  for (int i = 0; i < 2; i++) {
+    upb_fielddef *f = newfield(i ? "big" : "small", nums[i], UPB_TYPE_INT32,
+                               UPB_LABEL_OPTIONAL, NULL, &s);
+    upb_fielddef_setisextension(f, true);
+    ASSERT(upb_fielddef_setcontainingtypename(f, "ExtTest", NULL));
+    defs[i] = upb_upcast(f);
+  }
+  ASSERT_STATUS(upb_symtab_add(s, defs, 2, &s, &status), &status);
+  const upb_msgdef *ext_m = upb_symtab_lookupmsg(s, "ExtTest", &ext_m);
+  upb_symtab_unref(s, &s);
+
+  const upb_handlers *h =
+      upb_handlers_newfrozen(ext_m, NULL, &h, &ext_handlers, NULL);
+  // Fields 1, 100, an unknown 150 and 100000.
+  static const char input[] =
+      "\x08\x01" "\xa0\x06\x02" "\xb0\x09\x05" "\x80\xea\x30\x03";
+  for (size_t chunk = 1; chunk <= 2; chunk++) {
+    int32_t vals[3] = {0, 0, 0};
+    decode_chunked(h, vals, input, sizeof(input) - 1, chunk);
+    ASSERT(vals[0] == 1 && vals[1] == 2 && vals[2] == 3);
+  }
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(ext_m, &ext_m);
+  upb_status_uninit(&status);
+}
+
+/* Required fields ************************************************************/
+
+// ReqTest { required int32 a = 1; optional Inner inner = 2;
+//           repeated Inner items = 3; }
+// Inner { required string name = 1; optional int32 x = 2;
+//         required int32 y = 3; }
+static const upb_msgdef *newreqtest(const void *owner) {
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_msgdef *m = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(m), "ReqTest", NULL));
+  upb_msgdef_addfield(m, newfield("a", 1, UPB_TYPE_INT32, UPB_LABEL_REQUIRED,
+                                  NULL, &s), &s, NULL);
+  upb_msgdef_addfield(m, newfield("inner", 2, UPB_TYPE_MESSAGE,
+                                  UPB_LABEL_OPTIONAL, ".Inner", &s), &s, NULL);
+  upb_msgdef_addfield(m, newfield("items", 3, UPB_TYPE_MESSAGE,
+                                  UPB_LABEL_REPEATED, ".Inner", &s), &s, NULL);
+  upb_msgdef *inner = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(inner), "Inner", NULL));
+  upb_msgdef_addfield(inner, newfield("name", 1, UPB_TYPE_STRING,
+                                      UPB_LABEL_REQUIRED, NULL, &s), &s, NULL);
+  upb_msgdef_addfield(inner, newfield("x", 2, UPB_TYPE_INT32,
+                                      UPB_LABEL_OPTIONAL, NULL, &s), &s, NULL);
+  upb_msgdef_addfield(inner, newfield("y", 3, UPB_TYPE_INT32,
+                                      UPB_LABEL_REQUIRED, NULL, &s), &s, NULL);
+  upb_def *defs[] = {upb_upcast(m), upb_upcast(inner)};
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 2, &s, &status), &status);
+  const upb_msgdef *ret = upb_symtab_lookupmsg(s, "ReqTest", owner);
+  upb_symtab_unref(s, &s);
+  return ret;
+}
+
+static void no_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  UPB_UNUSED(h);
+}
+
+// Decodes "buf" with the given decoder handlers, "chunk" bytes at a time, and
+// checks that it fails with "err" (or succeeds if "err" is NULL).
+static void expect_validation(const upb_handlers *decoder_h, const char *buf,
+                              size_t len, size_t chunk, const char *err) {
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink =
+      upb_pipeline_newsink(&pipeline, upb_pbdecoder_getdesthandlers(decoder_h));
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+
+  bool ok = upb_sink_startmsg(decoder_sink) &&
+            upb_sink_startstr(decoder_sink, UPB_BYTESTREAM_BYTES_STARTSTR, len);
+  for (size_t ofs = 0; ok && ofs < len; ofs += chunk) {
+    size_t n = UPB_MIN(len - ofs, chunk);
+    ok = upb_sink_putstring(decoder_sink, UPB_BYTESTREAM_BYTES_STRING,
+                            buf + ofs, n) == n;
+  }
+  ok = ok && upb_sink_endstr(decoder_sink, UPB_BYTESTREAM_BYTES_ENDSTR);
+  const upb_status *status = upb_pipeline_status(&pipeline);
+  if (err) {
+    ASSERT(!ok && !upb_ok(status));
+    ASSERT(strcmp(upb_status_getstr(status), err) == 0);
+  } else {
+    ASSERT(ok && upb_ok(status));
+  }
+  upb_pipeline_uninit(&pipeline);
+}
+
+static void test_required() {
+  // The static defs have their required fields too.
+  const upb_handlers *namepart_h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_UNINTERPRETEDOPTION_NAMEPART, NULL, &namepart_h,
+      &no_handlers, NULL);
+  ASSERT(upb_handlers_requiredmask(namepart_h) == 3);
+  upb_handlers_unref(namepart_h, &namepart_h);
+
+  const upb_msgdef *m = newreqtest(&m);
+  const upb_handlers *h =
+      upb_handlers_newfrozen(m, NULL, &h, &no_handlers, NULL);
+  ASSERT(upb_handlers_requiredmask(h) == 1);
+  const upb_handlers *inner_h =
+      upb_handlers_getsubhandlers(h, upb_msgdef_itof(m, 2));
+  ASSERT(upb_handlers_requiredmask(inner_h) == 3);
+  ASSERT(upb_msgdef_hotfield(upb_handlers_msgdef(inner_h), 3)->required_index
+         == 1);
+
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  const upb_handlers *validating_h =
+      upb_pbdecoder_getvalidatinghandlers(h, &h);
+  static const struct {
+    const char *input;
+    size_t len;
+    const char *err;
+  } cases[] = {
+#define CASE(input, err) {input, sizeof(input) - 1, err}
+    CASE("\x08\x01" "\x12\x05" "\x0a\x01" "n" "\x18\x02"
+         "\x1a\x07" "\x18\x01" "\x10\x05" "\x0a\x01" "x", NULL),
+    CASE("", "Missing required field a"),
+    CASE("\x12\x05" "\x0a\x01" "n" "\x18\x02", "Missing required field a"),
+    CASE("\x08\x01" "\x12\x03" "\x0a\x01" "n",
+         "Missing required field inner.y"),
+    CASE("\x08\x01" "\x1a\x05" "\x0a\x01" "x" "\x18\x01" "\x1a\x02" "\x18\x01",
+         "Missing required field items.name"),
+#undef CASE
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    for (size_t chunk = 1; chunk <= cases[i].len + 1; chunk += 3) {
+      expect_validation(decoder_h, cases[i].input, cases[i].len, chunk, NULL);
+      expect_validation(validating_h, cases[i].input, cases[i].len, chunk,
+                        cases[i].err);
+    }
+  }
+  upb_handlers_unref(validating_h, &h);
+  upb_handlers_unref(decoder_h, &h);
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(m, &m);
+}
+
+// Outer { optional Big big = 1; } where Big has "n" required fields.
+static const upb_msgdef *newbigreq(int n, const void *owner) {
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_msgdef *m = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(m), "Outer", NULL));
+  upb_msgdef_addfield(m, newfield("big", 1, UPB_TYPE_MESSAGE,
+                                  UPB_LABEL_OPTIONAL, ".Big", &s), &s, NULL);
+  upb_msgdef *big = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(big), "Big", NULL));
+  for (int i = 1; i <= n; i++) {
+    char name[16];
+    snprintf(name, sizeof(name), "f%d", i);
+    upb_msgdef_addfield(big, newfield(name, i, UPB_TYPE_INT32,
+                                      UPB_LABEL_REQUIRED, NULL, &s), &s, NULL);
+  }
+  upb_def *defs[] = {upb_upcast(m), upb_upcast(big)};
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, defs, 2, &s, &status), &status);
+  const upb_msgdef *ret = upb_symtab_lookupmsg(s, "Outer", owner);
+  upb_symtab_unref(s, &s);
+  return ret;
+}
+
+// A frame can only track UPB_MAX_REQUIRED required fields, so messages with
+// more cannot be validated.
+static void test_toomanyrequired() {
+  for (int n = UPB_MAX_REQUIRED; n <= UPB_MAX_REQUIRED + 1; n++) {
+    const upb_msgdef *m = newbigreq(n, &m);
+    const upb_handlers *h =
+        upb_handlers_newfrozen(m, NULL, &h, &no_handlers, NULL);
+    const upb_handlers *validating_h =
+        upb_pbdecoder_getvalidatinghandlers(h, &h);
+    if (n <= UPB_MAX_REQUIRED) {
+      ASSERT(validating_h);
+      expect_validation(validating_h, "\x0a\x00", 2, 2,
+                        "Missing required field big.f1");
+      upb_handlers_unref(validating_h, &h);
+    } else {
+      ASSERT(!validating_h);
+    }
+    upb_handlers_unref(h, &h);
+    upb_msgdef_unref(m, &m);
+  }
+}
+
+int run_tests(int argc, char *argv[]) {
+  UPB_UNUSED(argc);
+  UPB_UNUSED(argv);
+  test_string_backpressure();
+  test_stack_growth();
+  test_batch();
+  test_terminal();
+  test_key();
+  test_filter();
+  test_index();
+  test_pull();
+  test_pull_groups();
+  test_pull_errors();
+  test_map();
+  test_extensions();
+  test_required();
+  test_toomanyrequired();
+  return 0;
+}
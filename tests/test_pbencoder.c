@@ -0,0 +1,349 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Tests of the encoder, on structs laid out by upb::Shim::SetStruct().
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/descriptor/descriptor.upb.h"
+#include "upb/pb/decoder.h"
+#include "upb/pb/encoder.h"
+#include "upb/pb/glue.h"
+#include "upb/shim/shim.h"
+#include "upb/symtab.h"
+#include "upb_test.h"
+
+static const char *descriptor_file;
+
+// Structs are allocated from this pipeline, which frees them all at the end.
+static upb_pipeline arena;
+
+static void *arenaalloc(void *ud, void *ptr, size_t oldsize, size_t size) {
+  return upb_pipeline_realloc(ud, ptr, oldsize, size);
+}
+
+static const upb_handlers *newstructhandlers(const upb_msgdef *m,
+                                             const void *owner) {
+  static upb_shim_alloc alloc = {arenaalloc, &arena};
+  return upb_handlers_newfrozen(m, NULL, owner, &upb_shim_structhandlers,
+                                &alloc);
+}
+
+// Decodes "buf" into a new struct for the message of "h".
+static void *decode(const upb_handlers *h, const char *buf, size_t len) {
+  size_t size = upb_shim_structsize(upb_handlers_msgdef(h));
+  void *msg = upb_pipeline_alloc(&arena, size);
+  memset(msg, 0, size);
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  upb_sink_reset(sink, msg);
+  ASSERT(upb_bytestream_putstr(decoder_sink, buf, len));
+  ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+  return msg;
+}
+
+static void expect_encode(const upb_pbencoder *e, const void *msg,
+                          const char *expected, size_t len) {
+  upb_pbencbuf buf;
+  upb_pbencbuf_init(&buf);
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_pbencoder_encode(e, msg, &buf, &status), &status);
+  ASSERT(upb_pbencbuf_len(&buf) == len);
+  ASSERT(len == 0 || memcmp(upb_pbencbuf_data(&buf), expected, len) == 0);
+  upb_pbencbuf_uninit(&buf);
+
+  // Into a span, the message fits exactly, and fails to fit in one byte less.
+  size_t size;
+  ASSERT_STATUS(upb_pbencoder_size(e, msg, &size, &status), &status);
+  ASSERT(size == len);
+  char *span = malloc(len + 1);
+  memset(span, 0, len + 1);
+  ASSERT_STATUS(upb_pbencoder_encodeto(e, msg, span, len, &size, &status),
+                &status);
+  ASSERT(size == len);
+  ASSERT(memcmp(span, expected, len) == 0 && span[len] == 0);
+  if (len > 0) {
+    memset(span, 0, len + 1);
+    ASSERT(!upb_pbencoder_encodeto(e, msg, span, len - 1, &size, &status));
+    ASSERT(!upb_ok(&status));
+    ASSERT(size == len && span[0] == 0);
+    upb_status_clear(&status);
+  }
+  free(span);
+}
+
+/* Round trips ****************************************************************/
+
+// protoc writes fields in number order, as the encoder does, but it may know
+// of descriptor fields that descriptor.upb.c does not, which are dropped.  So
+// the descriptor is compared after one round trip, which must not change it.
+static void test_descriptor() {
+  size_t len;
+  char *input = upb_readfile(descriptor_file, &len);
+  ASSERT(input);
+  const upb_handlers *h =
+      newstructhandlers(GOOGLE_PROTOBUF_FILEDESCRIPTORSET, &h);
+  upb_status status = UPB_STATUS_INIT;
+  upb_pbencoder *e = upb_pbencoder_new(h, &status);
+  ASSERT_STATUS(e, &status);
+
+  upb_pbencbuf buf;
+  upb_pbencbuf_init(&buf);
+  ASSERT_STATUS(upb_pbencoder_encode(e, decode(h, input, len), &buf, &status),
+                &status);
+  ASSERT(upb_pbencbuf_len(&buf) > len / 2);
+  expect_encode(e, decode(h, upb_pbencbuf_data(&buf), upb_pbencbuf_len(&buf)),
+                upb_pbencbuf_data(&buf), upb_pbencbuf_len(&buf));
+  upb_pbencbuf_uninit(&buf);
+
+  upb_pbencoder_free(e);
+  upb_handlers_unref(h, &h);
+  free(input);
+}
+
+// EncTest, and the struct that tools/dump_cstruct.lua generates for it:
+//
+//   message EncTest {
+//     optional int32 a = 1;         optional sint32 b = 2;
+//     optional sint64 c = 3;        optional fixed64 d = 4;
+//     optional double e = 5;        optional bool f = 6;
+//     optional string s = 7;        repeated int32 r = 8;
+//     optional EncTest sub = 9;     optional group G = 10 { ...EncTest };
+//     optional float fl = 11;       optional uint64 u = 12;
+//   }
+typedef struct EncTest EncTest;
+struct EncTest {
+  uint32_t _hasbits[2];
+  int64_t c;
+  uint64_t d;
+  double e;
+  upb_shim_str s;
+  upb_shim_arr r;
+  EncTest *sub;
+  EncTest *g;
+  uint64_t u;
+  int32_t a;
+  int32_t b;
+  float fl;
+  bool f;
+};
+
+static upb_fielddef *newfield(const char *name, int32_t num, uint8_t type,
+                              uint8_t label, void *owner) {
+  upb_fielddef *f = upb_fielddef_new(owner);
+  ASSERT(upb_fielddef_setname(f, name, NULL));
+  ASSERT(upb_fielddef_setnumber(f, num, NULL));
+  upb_fielddef_setdescriptortype(f, type);
+  upb_fielddef_setlabel(f, label);
+  if (type == UPB_DESCRIPTOR_TYPE_MESSAGE ||
+      type == UPB_DESCRIPTOR_TYPE_GROUP) {
+    ASSERT(upb_fielddef_setsubdefname(f, ".EncTest", NULL));
+  }
+  return f;
+}
+
+static const upb_msgdef *newenctest(const void *owner) {
+  static const struct {
+    const char *name;
+    uint8_t type;
+  } fields[] = {
+    {"a", UPB_DESCRIPTOR_TYPE_INT32},    {"b", UPB_DESCRIPTOR_TYPE_SINT32},
+    {"c", UPB_DESCRIPTOR_TYPE_SINT64},   {"d", UPB_DESCRIPTOR_TYPE_FIXED64},
+    {"e", UPB_DESCRIPTOR_TYPE_DOUBLE},   {"f", UPB_DESCRIPTOR_TYPE_BOOL},
+    {"s", UPB_DESCRIPTOR_TYPE_STRING},   {"r", UPB_DESCRIPTOR_TYPE_INT32},
+    {"sub", UPB_DESCRIPTOR_TYPE_MESSAGE}, {"g", UPB_DESCRIPTOR_TYPE_GROUP},
+    {"fl", UPB_DESCRIPTOR_TYPE_FLOAT},   {"u", UPB_DESCRIPTOR_TYPE_UINT64},
+  };
+  upb_symtab *s = upb_symtab_new(&s);
+  upb_msgdef *m = upb_msgdef_new(&s);
+  ASSERT(upb_def_setfullname(upb_upcast(m), "EncTest", NULL));
+  for (int i = 0; i < 12; i++) {
+    uint8_t label = i + 1 == 8 ? UPB_LABEL_REPEATED : UPB_LABEL_OPTIONAL;
+    upb_msgdef_addfield(
+        m, newfield(fields[i].name, i + 1, fields[i].type, label, &s), &s,
+        NULL);
+  }
+  upb_def *def = upb_upcast(m);
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT_STATUS(upb_symtab_add(s, &def, 1, &s, &status), &status);
+  const upb_msgdef *ret = upb_symtab_lookupmsg(s, "EncTest", owner);
+  upb_symtab_unref(s, &s);
+  return ret;
+}
+
+static void expect_field(const upb_handlers *h, uint32_t number, size_t ofs,
+                         int32_t hasbit) {
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  const upb_shim_data *d =
+      upb_shim_getfielddata(h, upb_msgdef_itof(m, number));
+  ASSERT(d && d->offset == ofs && d->hasbit == hasbit);
+}
+
+static void test_layout() {
+  const upb_msgdef *m = newenctest(&m);
+  const upb_handlers *h = newstructhandlers(m, &h);
+  ASSERT(upb_shim_structsize(m) == sizeof(EncTest));
+  expect_field(h, 1, offsetof(EncTest, a), 0);
+  expect_field(h, 2, offsetof(EncTest, b), 1);
+  expect_field(h, 3, offsetof(EncTest, c), 2);
+  expect_field(h, 4, offsetof(EncTest, d), 3);
+  expect_field(h, 5, offsetof(EncTest, e), 4);
+  expect_field(h, 6, offsetof(EncTest, f), 5);
+  expect_field(h, 7, offsetof(EncTest, s), 6);
+  expect_field(h, 8, offsetof(EncTest, r), -1);
+  expect_field(h, 9, offsetof(EncTest, sub), 7);
+  expect_field(h, 10, offsetof(EncTest, g), 8);
+  expect_field(h, 11, offsetof(EncTest, fl), 9);
+  expect_field(h, 12, offsetof(EncTest, u), 10);
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(m, &m);
+}
+
+static const char values[] =
+    "\x08\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01"  // a = -1
+    "\x10\x03"                                      // b = -2
+    "\x18\x80\x01"                                  // c = 64
+    "\x21\x08\x07\x06\x05\x04\x03\x02\x01"          // d
+    "\x29\x00\x00\x00\x00\x00\x00\xf8\x3f"          // e = 1.5
+    "\x30\x01"                                      // f = true
+    "\x3a\x03" "abc"                                // s
+    "\x40\x01" "\x40\x96\x01" "\x40\x00"            // r = 1, 150, 0
+    "\x4a\x02" "\x08\x05"                           // sub { a = 5 }
+    "\x53" "\x10\x01" "\x54"                        // G { b = -1 }
+    "\x5d\x00\x00\x00\x40"                          // fl = 2.0
+    "\x60\xac\x02";                                 // u = 300
+
+// A zero value is written if its hasbit is set.
+static const char zeros[] = "\x08\x00" "\x3a\x00" "\x4a\x00";
+
+static void test_values() {
+  const upb_msgdef *m = newenctest(&m);
+  const upb_handlers *h = newstructhandlers(m, &h);
+  upb_status status = UPB_STATUS_INIT;
+  upb_pbencoder *e = upb_pbencoder_new(h, &status);
+  ASSERT_STATUS(e, &status);
+
+  const EncTest *msg = decode(h, values, sizeof(values) - 1);
+  ASSERT(msg->a == -1 && msg->c == 64 && msg->sub->a == 5 && msg->g->b == -1);
+  expect_encode(e, msg, values, sizeof(values) - 1);
+  expect_encode(e, decode(h, zeros, sizeof(zeros) - 1), zeros,
+                sizeof(zeros) - 1);
+  expect_encode(e, decode(h, "", 0), "", 0);
+
+  // Fields out of order come out in order.
+  static const char reordered[] = "\x10\x03" "\x08\x01" "\x40\x02" "\x40\x03";
+  expect_encode(e, decode(h, reordered, sizeof(reordered) - 1),
+                "\x08\x01" "\x10\x03" "\x40\x02" "\x40\x03", 8);
+
+  upb_pbencoder_free(e);
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(m, &m);
+}
+
+static void test_depth() {
+  const upb_msgdef *m = newenctest(&m);
+  const upb_handlers *h = newstructhandlers(m, &h);
+  upb_status status = UPB_STATUS_INIT;
+  upb_pbencoder *e = upb_pbencoder_new(h, &status);
+  ASSERT_STATUS(e, &status);
+
+  // A chain of UPB_MAX_NESTING messages can be encoded, but not one more.
+  EncTest *msgs = calloc(UPB_MAX_NESTING + 1, sizeof(EncTest));
+  for (int i = 0; i < UPB_MAX_NESTING; i++) {
+    msgs[i].sub = &msgs[i + 1];
+    msgs[i]._hasbits[0] = 1 << 7;
+  }
+  upb_pbencbuf buf;
+  upb_pbencbuf_init(&buf);
+  ASSERT(!upb_pbencoder_encode(e, &msgs[0], &buf, &status));
+  ASSERT(!upb_ok(&status));
+  ASSERT(upb_pbencbuf_len(&buf) == 0);
+  upb_status_clear(&status);
+  size_t size;
+  ASSERT(!upb_pbencoder_size(e, &msgs[0], &size, &status));
+  ASSERT(!upb_ok(&status));
+  upb_status_clear(&status);
+  ASSERT_STATUS(upb_pbencoder_encode(e, &msgs[1], &buf, &status), &status);
+  ASSERT(upb_pbencbuf_len(&buf) >= 2 * (UPB_MAX_NESTING - 1));
+  upb_pbencbuf_uninit(&buf);
+  free(msgs);
+
+  upb_pbencoder_free(e);
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(m, &m);
+}
+
+/* Fields without hasbits *****************************************************/
+
+typedef struct {
+  int32_t a;
+  double e;
+  upb_shim_str s;
+  void *sub;
+} plain;
+
+static void plain_handlers(void *closure, upb_handlers *h) {
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  ASSERT(upb_shim_set(h, upb_msgdef_itof(m, 1), offsetof(plain, a), -1));
+  ASSERT(upb_shim_set(h, upb_msgdef_itof(m, 5), offsetof(plain, e), -1));
+  ASSERT(upb_shim_setstr(h, upb_msgdef_itof(m, 7), offsetof(plain, s), -1,
+                         closure));
+  ASSERT(upb_shim_setsubmsg(h, upb_msgdef_itof(m, 9), offsetof(plain, sub),
+                            -1, sizeof(plain), closure));
+}
+
+static void test_nohasbits() {
+  const upb_msgdef *m = newenctest(&m);
+  upb_shim_alloc alloc = {arenaalloc, &arena};
+  const upb_handlers *h =
+      upb_handlers_newfrozen(m, NULL, &h, &plain_handlers, &alloc);
+  upb_status status = UPB_STATUS_INIT;
+  upb_pbencoder *e = upb_pbencoder_new(h, &status);
+  ASSERT_STATUS(e, &status);
+
+  // Without a hasbit, a field is written if it is nonzero.
+  plain msg, sub;
+  memset(&msg, 0, sizeof(msg));
+  memset(&sub, 0, sizeof(sub));
+  expect_encode(e, &msg, "", 0);
+  msg.a = 7;
+  msg.e = -0.0;
+  msg.s.ptr = "x";
+  msg.s.len = 1;
+  msg.sub = &sub;
+  expect_encode(e, &msg,
+                "\x08\x07" "\x29\x00\x00\x00\x00\x00\x00\x00\x80"
+                "\x3a\x01" "x" "\x4a\x00", 16);
+
+  upb_pbencoder_free(e);
+  upb_handlers_unref(h, &h);
+  upb_msgdef_unref(m, &m);
+}
+
+int run_tests(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: test_pbencoder <test.proto.pb>\n");
+    return 1;
+  }
+  descriptor_file = argv[1];
+  upb_pipeline_init(&arena, NULL, 0, upb_realloc, NULL);
+  test_descriptor();
+  test_layout();
+  test_values();
+  test_depth();
+  test_nohasbits();
+  upb_pipeline_uninit(&arena);
+  return 0;
+}
@@ -6,6 +6,7 @@
  * Test of upb_pipeline.
  */
 
+#include "upb/descriptor/descriptor.upb.h"
 #include "upb/sink.h"
 #include "tests/upb_test.h"
 
@@ -107,6 +108,40 @@ static void test_realloc() {
   ASSERT(count == 2);
 }
 
+static void nohandlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  UPB_UNUSED(h);
+}
+
+static void test_sink_stack() {
+  // DescriptorProto is recursive, so the sink's stack starts small and has to
+  // grow, up to UPB_MAX_NESTING frames.
+  const upb_handlers *h =
+      upb_handlers_newfrozen(GOOGLE_PROTOBUF_DESCRIPTORPROTO, NULL, &h,
+                             nohandlers, NULL);
+  ASSERT(h);
+  ASSERT(upb_handlers_maxdepth(h) == 0);
+
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *s = upb_pipeline_newsink(&pipeline, h);
+  upb_sink_reset(s, NULL);
+  int depth = 1;
+  while (upb_sink_startseq(
+      s, GOOGLE_PROTOBUF_DESCRIPTORPROTO_NESTED_TYPE_STARTSEQ)) {
+    depth++;
+    if (!upb_sink_startsubmsg(
+            s, GOOGLE_PROTOBUF_DESCRIPTORPROTO_NESTED_TYPE_STARTSUBMSG)) {
+      break;
+    }
+    depth++;
+  }
+  ASSERT(depth == UPB_MAX_NESTING);
+  ASSERT(!upb_ok(upb_pipeline_status(&pipeline)));
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(h, &h);
+}
+
 int run_tests(int argc, char *argv[]) {
   UPB_UNUSED(argc);
   UPB_UNUSED(argv);
@@ -114,5 +149,6 @@ int run_tests(int argc, char *argv[]) {
   test_only_initial();
   test_with_alloc_func();
   test_realloc();
+  test_sink_stack();
   return 0;
 }
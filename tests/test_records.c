@@ -0,0 +1,295 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Tests of the record container format.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "upb/bytestream.h"
+#include "upb/descriptor/descriptor.upb.h"
+#include "upb/pb/crc32c.h"
+#include "upb/pb/decoder.h"
+#include "upb/pb/records.h"
+#include "upb/pb/varint.h"
+#include "upb_test.h"
+
+#define NUM_RECORDS 1000
+
+// Record i is a FieldDescriptorProto with number i, and every third one also
+// has a name, so that records differ in length.
+static size_t makerecord(int i, char *buf) {
+  size_t len = 0;
+  buf[len++] = 0x18;
+  len += upb_vencode64(i, buf + len);
+  if (i % 3 == 0) {
+    len += sprintf(buf + len, "\x0a%c%0*d", 10 + i % 7, 10 + i % 7, i);
+  }
+  return len;
+}
+
+// Writes the test records into a new file, passing each in two pieces.
+static void writefile(FILE *f, size_t block_size,
+                      upb_recordchecksum_t checksum) {
+  const upb_handlers *h = upb_recordwriter_newhandlers(&h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_recordwriter *w = upb_sink_getobj(sink);
+  ASSERT(upb_recordwriter_open(w, f, block_size, checksum));
+  for (int i = 0; i < NUM_RECORDS; i++) {
+    char buf[32];
+    size_t len = makerecord(i, buf);
+    ASSERT(upb_sink_startmsg(sink));
+    ASSERT(upb_sink_startstr(sink, UPB_BYTESTREAM_BYTES_STARTSTR, 0));
+    ASSERT(upb_sink_putstring(sink, UPB_BYTESTREAM_BYTES_STRING, buf, 1) == 1);
+    ASSERT(upb_sink_putstring(sink, UPB_BYTESTREAM_BYTES_STRING, buf + 1,
+                              len - 1) == len - 1);
+    ASSERT(upb_sink_endstr(sink, UPB_BYTESTREAM_BYTES_ENDSTR));
+    ASSERT(upb_sink_endmsg(sink));
+  }
+  ASSERT(upb_recordwriter_finish(w));
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(h, &h);
+}
+
+static char *readall(FILE *f, size_t *len) {
+  fseek(f, 0, SEEK_END);
+  *len = ftell(f);
+  char *buf = malloc(*len);
+  rewind(f);
+  ASSERT(fread(buf, 1, *len, f) == *len);
+  return buf;
+}
+
+// Checks that "c" returns records [first, end).
+static void expect_records(upb_recordcursor *c, int first, int end) {
+  for (int i = first; i < end; i++) {
+    char expected[32];
+    size_t expected_len = makerecord(i, expected);
+    const char *buf;
+    size_t len;
+    ASSERT(upb_recordcursor_next(c, &buf, &len));
+    ASSERT(len == expected_len && memcmp(buf, expected, len) == 0);
+  }
+  const char *buf;
+  size_t len;
+  ASSERT(!upb_recordcursor_next(c, &buf, &len));
+  ASSERT(upb_ok(upb_recordcursor_status(c)));
+}
+
+static void test_crc32c() {
+  ASSERT(upb_crc32c(0, "123456789", 9) == 0xe3069283);
+  ASSERT(upb_crc32c(upb_crc32c(0, "1234", 4), "56789", 5) == 0xe3069283);
+  ASSERT(upb_crc32c(0, "", 0) == 0);
+
+  // The iSCSI test vectors (RFC 3720), at every alignment and split point.
+  char buf[40];
+  for (int ofs = 0; ofs < 8; ofs++) {
+    char *p = buf + ofs;
+    memset(p, 0, 32);
+    ASSERT(upb_crc32c(0, p, 32) == 0x8a9136aa);
+    memset(p, 0xff, 32);
+    ASSERT(upb_crc32c(0, p, 32) == 0x62a8ab43);
+    for (int i = 0; i < 32; i++) p[i] = i;
+    ASSERT(upb_crc32c(0, p, 32) == 0x46dd794e);
+    for (int i = 0; i <= 32; i++)
+      ASSERT(upb_crc32c(upb_crc32c(0, p, i), p + i, 32 - i) == 0x46dd794e);
+  }
+}
+
+static void test_roundtrip() {
+  FILE *f = tmpfile();
+  writefile(f, 256, UPB_RECORDS_BLOCKCHECKSUM);
+  size_t len;
+  char *buf = readall(f, &len);
+  fclose(f);
+
+  upb_status status = UPB_STATUS_INIT;
+  upb_recordreader *r = upb_recordreader_openbuf(buf, len, &status);
+  ASSERT(r);
+  ASSERT(upb_recordreader_recordcount(r) == NUM_RECORDS);
+  ASSERT(upb_recordreader_blockcount(r) > 10);
+
+  upb_recordcursor c;
+  upb_recordreader_seek(r, 0, &c);
+  expect_records(&c, 0, NUM_RECORDS);
+  upb_recordreader_seek(r, 777, &c);
+  expect_records(&c, 777, NUM_RECORDS);
+  upb_recordreader_seek(r, NUM_RECORDS, &c);
+  expect_records(&c, NUM_RECORDS, NUM_RECORDS);
+
+  // Splits cover every record, in order, whatever their number.
+  for (size_t n = 1; n <= 40; n += 13) {
+    int next = 0;
+    for (size_t i = 0; i < n; i++) {
+      upb_recordreader_split(r, i, n, &c);
+      const char *rec;
+      size_t rec_len;
+      while (upb_recordcursor_next(&c, &rec, &rec_len)) {
+        char expected[32];
+        ASSERT(rec_len == makerecord(next, expected));
+        ASSERT(memcmp(rec, expected, rec_len) == 0);
+        next++;
+      }
+      ASSERT(upb_ok(upb_recordcursor_status(&c)));
+    }
+    ASSERT(next == NUM_RECORDS);
+  }
+  upb_recordreader_close(r);
+
+  // A flipped bit in a record is caught by its block's checksum.
+  buf[len / 2] ^= 1;
+  r = upb_recordreader_openbuf(buf, len, &status);
+  ASSERT(r);
+  upb_recordreader_seek(r, 0, &c);
+  const char *rec;
+  size_t rec_len;
+  while (upb_recordcursor_next(&c, &rec, &rec_len)) {}
+  ASSERT(!upb_ok(upb_recordcursor_status(&c)));
+  upb_recordreader_close(r);
+
+  // A truncated file is rejected.
+  ASSERT(!upb_recordreader_openbuf(buf, len - 1, &status));
+  ASSERT(!upb_ok(&status));
+  free(buf);
+  upb_status_uninit(&status);
+}
+
+static bool putnumber(void *c, const void *hd, int32_t val) {
+  UPB_UNUSED(hd);
+  int32_t *sum = c;
+  *sum += val;
+  return true;
+}
+
+static void number_handlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  if (m == GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO)
+    upb_handlers_setint32(h, upb_msgdef_itof(m, 3), &putnumber, NULL, NULL);
+}
+
+// Maps a file and decodes its records straight from the mapping.
+static void test_decode() {
+  char filename[] = "/tmp/upb_test_records_XXXXXX";
+  int fd = mkstemp(filename);
+  ASSERT(fd >= 0);
+  FILE *f = fdopen(fd, "w");
+  writefile(f, 0, UPB_RECORDS_NOCHECKSUM);
+  fclose(f);
+
+  upb_status status = UPB_STATUS_INIT;
+  upb_recordreader *r = upb_recordreader_open(filename, &status);
+  ASSERT(r);
+  unlink(filename);
+  ASSERT(upb_recordreader_blockcount(r) == 1);
+
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO, NULL, &h, &number_handlers, NULL);
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  int32_t sum = 0;
+  upb_sink_reset(sink, &sum);
+
+  upb_recordcursor c;
+  upb_recordreader_split(r, 0, 1, &c);
+  int count = 0;
+  while (upb_recordcursor_decode(&c, decoder_sink)) count++;
+  ASSERT(upb_ok(upb_recordcursor_status(&c)));
+  ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+  ASSERT(count == NUM_RECORDS);
+  ASSERT(sum == NUM_RECORDS * (NUM_RECORDS - 1) / 2);
+
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+  upb_handlers_unref(h, &h);
+  upb_recordreader_close(r);
+  upb_status_uninit(&status);
+}
+
+// Records with their own checksums are checked as they are decoded.
+static void test_recordchecksum() {
+  FILE *f = tmpfile();
+  writefile(f, 1024, UPB_RECORDS_RECORDCHECKSUM);
+  size_t len;
+  char *buf = readall(f, &len);
+  fclose(f);
+
+  const upb_handlers *h = upb_handlers_newfrozen(
+      GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO, NULL, &h, &number_handlers, NULL);
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  upb_status status = UPB_STATUS_INIT;
+  for (int corrupt = 0; corrupt < 2; corrupt++) {
+    if (corrupt) buf[len / 2] ^= 0x40;
+    upb_recordreader *r = upb_recordreader_openbuf(buf, len, &status);
+    ASSERT(r);
+
+    upb_recordcursor c;
+    upb_recordreader_seek(r, 0, &c);
+    int count = 0;
+    const char *rec;
+    size_t rec_len;
+    while (upb_recordcursor_next(&c, &rec, &rec_len)) count++;
+    ASSERT(upb_ok(upb_recordcursor_status(&c)) == !corrupt);
+    ASSERT((count == NUM_RECORDS) == !corrupt);
+
+    upb_pipeline pipeline;
+    upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+    upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+    upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+    upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+    int32_t sum = 0;
+    upb_sink_reset(sink, &sum);
+    upb_recordreader_seek(r, 0, &c);
+    int decoded = 0;
+    while (upb_recordcursor_decode(&c, decoder_sink)) decoded++;
+    ASSERT(upb_ok(upb_recordcursor_status(&c)));
+    ASSERT(upb_ok(upb_pipeline_status(&pipeline)) == !corrupt);
+    ASSERT(decoded == count);
+    if (!corrupt) ASSERT(sum == NUM_RECORDS * (NUM_RECORDS - 1) / 2);
+
+    upb_pipeline_uninit(&pipeline);
+    upb_recordreader_close(r);
+  }
+  buf[len / 2] ^= 0x40;
+
+  // Seeking skips the records before the one sought without checking them.
+  upb_recordreader *r = upb_recordreader_openbuf(buf, len, &status);
+  ASSERT(r);
+  upb_recordcursor c;
+  upb_recordreader_seek(r, 500, &c);
+  const char *rec;
+  size_t rec_len;
+  ASSERT(upb_recordcursor_next(&c, &rec, &rec_len));
+  buf[rec - buf] ^= 0x40;
+  upb_recordreader_seek(r, 501, &c);
+  expect_records(&c, 501, NUM_RECORDS);
+  upb_recordreader_seek(r, 500, &c);
+  ASSERT(!upb_recordcursor_next(&c, &rec, &rec_len));
+  ASSERT(!upb_ok(upb_recordcursor_status(&c)));
+  upb_recordreader_close(r);
+
+  upb_handlers_unref(decoder_h, &h);
+  upb_handlers_unref(h, &h);
+  upb_status_uninit(&status);
+  free(buf);
+}
+
+int run_tests(int argc, char *argv[]) {
+  UPB_UNUSED(argc);
+  UPB_UNUSED(argv);
+  test_crc32c();
+  test_roundtrip();
+  test_decode();
+  test_recordchecksum();
+  return 0;
+}
@@ -0,0 +1,299 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Tests of upb_shredder and upb_assembler, using the static descriptor.proto
+ * defs.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/descriptor/descriptor.upb.h"
+#include "upb/pb/decoder.h"
+#include "upb/shred.h"
+#include "upb_test.h"
+
+// Decodes one record into the shredder; returns whether it was accepted.
+static bool shred(upb_shredder *s, const char *buf, size_t len) {
+  const upb_handlers *h = upb_shredder_handlers(s);
+  const upb_handlers *decoder_h = upb_pbdecoder_gethandlers(h, false, &h);
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, h);
+  upb_sink *decoder_sink = upb_pipeline_newsink(&pipeline, decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(decoder_sink), sink);
+  upb_sink_reset(sink, s);
+
+  upb_sink_startmsg(decoder_sink);
+  upb_sink_startstr(decoder_sink, UPB_BYTESTREAM_BYTES_STARTSTR, len);
+  upb_sink_putstring(decoder_sink, UPB_BYTESTREAM_BYTES_STRING, buf, len);
+  bool ok = upb_sink_endstr(decoder_sink, UPB_BYTESTREAM_BYTES_ENDSTR) &&
+            upb_sink_endmsg(decoder_sink) &&
+            upb_ok(upb_pipeline_status(&pipeline));
+
+  upb_pipeline_uninit(&pipeline);
+  upb_handlers_unref(decoder_h, &h);
+  return ok;
+}
+
+#define SHRED(s, str) shred(s, str, sizeof(str) - 1)
+
+// Returns the column for the given path of field numbers.
+static const upb_column *findcol(const upb_shredder *s, const uint32_t *nums,
+                                 size_t n) {
+  for (size_t i = 0; i < upb_shredder_columncount(s); i++) {
+    const upb_column *c = upb_shredder_column(s, i);
+    size_t len;
+    const upb_fielddef *const *path = upb_column_path(c, &len);
+    if (len != n) continue;
+    size_t j = 0;
+    while (j < n && upb_fielddef_number(path[j]) == nums[j]) j++;
+    if (j == n) return c;
+  }
+  ASSERT(false);
+  return NULL;
+}
+
+static void expect_levels(const upb_column *c, const char *rep,
+                          const char *def) {
+  size_t n = strlen(rep);
+  ASSERT(upb_column_size(c) == n);
+  for (size_t i = 0; i < n; i++) {
+    ASSERT(upb_column_replevels(c)[i] == rep[i] - '0');
+    ASSERT(upb_column_deflevels(c)[i] == def[i] - '0');
+  }
+}
+
+// FieldDescriptorProto {
+//   name: "a"
+//   number: 1
+//   options {
+//     uninterpreted_option {
+//       name { name_part: "x" is_extension: false }
+//       name { name_part: "y" is_extension: true }
+//     }
+//     uninterpreted_option { name { name_part: "z" is_extension: false } }
+//   }
+// }
+static const char record1[] =
+    "\x0a\x01" "a"
+    "\x18\x01"
+    "\x42\x1b"
+        "\xba\x3e\x0e"
+            "\x12\x05" "\x0a\x01" "x" "\x10\x00"
+            "\x12\x05" "\x0a\x01" "y" "\x10\x01"
+        "\xba\x3e\x07"
+            "\x12\x05" "\x0a\x01" "z" "\x10\x00";
+
+// FieldDescriptorProto { number: 2 }
+static const char record2[] = "\x18\x02";
+
+// FieldDescriptorProto { name: "bc" options { } }
+static const char record3[] = "\x0a\x02" "bc" "\x42\x00";
+
+static void shred_all(upb_shredder *s) {
+  ASSERT(SHRED(s, record1));
+  ASSERT(SHRED(s, record2));
+  ASSERT(SHRED(s, record3));
+}
+
+static void test_levels() {
+  upb_status status = UPB_STATUS_INIT;
+  upb_shredder *s = upb_shredder_new(GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO,
+                                     &status);
+  ASSERT(s);
+  shred_all(s);
+  ASSERT(upb_shredder_recordcount(s) == 3);
+
+  const uint32_t number_path[] = {3};
+  const upb_column *number = findcol(s, number_path, 1);
+  ASSERT(upb_column_maxrep(number) == 0);
+  ASSERT(upb_column_maxdef(number) == 1);
+  expect_levels(number, "000", "110");
+  size_t n;
+  const int32_t *numbers = upb_column_values(number, &n);
+  ASSERT(n == 2 && numbers[0] == 1 && numbers[1] == 2);
+  ASSERT((uintptr_t)numbers % 64 == 0);
+
+  const uint32_t name_path[] = {1};
+  const upb_column *name = findcol(s, name_path, 1);
+  expect_levels(name, "000", "101");
+  const char *names = upb_column_values(name, &n);
+  const uint32_t *ofs = upb_column_stroffsets(name);
+  ASSERT(n == 2 && ofs[0] == 0 && ofs[1] == 1 && ofs[2] == 3);
+  ASSERT(memcmp(names, "abc", 3) == 0);
+
+  // options.uninterpreted_option.name.name_part; required, so it adds no
+  // definition level.
+  const uint32_t part_path[] = {8, 999, 2, 1};
+  const upb_column *part = findcol(s, part_path, 4);
+  ASSERT(upb_column_maxrep(part) == 2);
+  ASSERT(upb_column_maxdef(part) == 3);
+  expect_levels(part, "02100", "33301");
+  const char *parts = upb_column_values(part, &n);
+  ASSERT(n == 3 && memcmp(parts, "xyz", 3) == 0);
+
+  const uint32_t ext_path[] = {8, 999, 2, 2};
+  const upb_column *ext = findcol(s, ext_path, 4);
+  expect_levels(ext, "02100", "33301");
+  const uint8_t *exts = upb_column_values(ext, &n);
+  ASSERT(n == 3 && exts[0] == 0 && exts[1] == 1 && exts[2] == 0);
+
+  upb_shredder_clear(s);
+  ASSERT(upb_shredder_recordcount(s) == 0);
+  ASSERT(upb_column_size(number) == 0);
+  ASSERT(SHRED(s, record2));
+  expect_levels(number, "0", "1");
+
+  upb_shredder_free(s);
+  upb_status_uninit(&status);
+}
+
+// Reassembles every record of "s" into a second shredder, which should end up
+// with the same columns.
+static void test_assemble() {
+  const upb_msgdef *m = GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO;
+  upb_status status = UPB_STATUS_INIT;
+  upb_shredder *s = upb_shredder_new(m, &status);
+  upb_shredder *s2 = upb_shredder_new(m, &status);
+  ASSERT(s && s2);
+  shred_all(s);
+
+  upb_pipeline pipeline;
+  upb_pipeline_init(&pipeline, NULL, 0, upb_realloc, NULL);
+  upb_sink *sink = upb_pipeline_newsink(&pipeline, upb_shredder_handlers(s2));
+  upb_assembler *a = upb_assembler_new(s);
+  for (int i = 0; i < 3; i++) {
+    upb_sink_reset(sink, s2);
+    ASSERT(upb_assembler_next(a, sink));
+  }
+  ASSERT(!upb_assembler_next(a, sink));
+  ASSERT(upb_ok(upb_pipeline_status(&pipeline)));
+  upb_assembler_free(a);
+  upb_pipeline_uninit(&pipeline);
+
+  ASSERT(upb_shredder_recordcount(s2) == 3);
+  for (size_t i = 0; i < upb_shredder_columncount(s); i++) {
+    const upb_column *c = upb_shredder_column(s, i);
+    const upb_column *c2 = upb_shredder_column(s2, i);
+    size_t size = upb_column_size(c);
+    ASSERT(upb_column_size(c2) == size);
+    ASSERT(memcmp(upb_column_replevels(c), upb_column_replevels(c2),
+                  size) == 0);
+    ASSERT(memcmp(upb_column_deflevels(c), upb_column_deflevels(c2),
+                  size) == 0);
+    size_t n, n2;
+    upb_column_values(c, &n);
+    upb_column_values(c2, &n2);
+    ASSERT(n == n2);
+  }
+
+  upb_shredder_free(s);
+  upb_shredder_free(s2);
+  upb_status_uninit(&status);
+}
+
+static void test_errors() {
+  upb_status status = UPB_STATUS_INIT;
+  ASSERT(!upb_shredder_new(GOOGLE_PROTOBUF_DESCRIPTORPROTO, &status));
+  ASSERT(!upb_ok(&status));
+  upb_status_clear(&status);
+
+  upb_shredder *s = upb_shredder_new(GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO,
+                                     &status);
+  ASSERT(s);
+  ASSERT(SHRED(s, record2));
+
+  // A NamePart without its required name_part is rejected, leaving the
+  // columns as they were.
+  ASSERT(!SHRED(s, "\x18\x05" "\x42\x07" "\xba\x3e\x04" "\x12\x02" "\x10\x01"));
+  // So is a record cut short.
+  ASSERT(!SHRED(s, "\x18\x05" "\x42\x07" "\xba\x3e\x04"));
+  ASSERT(SHRED(s, record2));
+  ASSERT(upb_shredder_recordcount(s) == 2);
+  for (size_t i = 0; i < upb_shredder_columncount(s); i++)
+    ASSERT(upb_column_size(upb_shredder_column(s, i)) == 2);
+  const uint32_t number_path[] = {3};
+  size_t n;
+  const int32_t *numbers =
+      upb_column_values(findcol(s, number_path, 1), &n);
+  ASSERT(n == 2 && numbers[1] == 2);
+
+  upb_shredder_free(s);
+  upb_status_uninit(&status);
+}
+
+static void test_duplicates() {
+  upb_status status = UPB_STATUS_INIT;
+  upb_shredder *s = upb_shredder_new(GOOGLE_PROTOBUF_FIELDDESCRIPTORPROTO,
+                                     &status);
+  ASSERT(s);
+
+  // A scalar or string that appears twice keeps its last value, here
+  // FieldDescriptorProto { name: "b" number: 4 }.
+  ASSERT(SHRED(s, "\x18\x03" "\x0a\x02" "aa" "\x18\x04" "\x0a\x01" "b"));
+  const uint32_t number_path[] = {3};
+  const upb_column *number = findcol(s, number_path, 1);
+  expect_levels(number, "0", "1");
+  size_t n;
+  const int32_t *numbers = upb_column_values(number, &n);
+  ASSERT(n == 1 && numbers[0] == 4);
+  const uint32_t name_path[] = {1};
+  const upb_column *name = findcol(s, name_path, 1);
+  expect_levels(name, "0", "1");
+  const char *names = upb_column_values(name, &n);
+  const uint32_t *ofs = upb_column_stroffsets(name);
+  ASSERT(n == 1 && ofs[0] == 0 && ofs[1] == 1 && names[0] == 'b');
+
+  // So does one inside a repeated submessage, without affecting its siblings:
+  // options { uninterpreted_option { name { name_part: "x" is_extension: 0 }
+  //                                  name { name_part: "y" is_extension: 1 }
+  //                                  identifier_value: "i" } }
+  // with the name_part, is_extension and identifier_value each given twice.
+  ASSERT(SHRED(s, "\x42\x1c" "\xba\x3e\x19"
+                      "\x12\x0a" "\x0a\x01" "q" "\x10\x01"
+                                  "\x0a\x01" "x" "\x10\x00"
+                      "\x1a\x01" "j"
+                      "\x12\x05" "\x0a\x01" "y" "\x10\x01"
+                      "\x1a\x01" "i"));
+  const uint32_t part_path[] = {8, 999, 2, 1};
+  const upb_column *part = findcol(s, part_path, 4);
+  expect_levels(part, "002", "033");
+  const char *parts = upb_column_values(part, &n);
+  ASSERT(n == 2 && memcmp(parts, "xy", 2) == 0);
+  const uint32_t ext_path[] = {8, 999, 2, 2};
+  const uint8_t *exts = upb_column_values(findcol(s, ext_path, 4), &n);
+  ASSERT(n == 2 && exts[0] == 0 && exts[1] == 1);
+  const uint32_t ident_path[] = {8, 999, 3};
+  const char *idents = upb_column_values(findcol(s, ident_path, 3), &n);
+  ASSERT(n == 1 && idents[0] == 'i');
+
+  // A non-repeated submessage that appears twice would have to be merged, so
+  // the record is rejected, leaving the columns as they were.
+  size_t sizes[64];
+  ASSERT(upb_shredder_columncount(s) <= 64);
+  for (size_t i = 0; i < upb_shredder_columncount(s); i++)
+    sizes[i] = upb_column_size(upb_shredder_column(s, i));
+  ASSERT(!SHRED(s, "\x18\x05" "\x42\x02" "\x08\x01"
+                   "\x42\x02" "\x10\x01"));
+  ASSERT(upb_shredder_recordcount(s) == 2);
+  for (size_t i = 0; i < upb_shredder_columncount(s); i++)
+    ASSERT(upb_column_size(upb_shredder_column(s, i)) == sizes[i]);
+  numbers = upb_column_values(number, &n);
+  ASSERT(n == 1 && numbers[0] == 4);
+
+  upb_shredder_free(s);
+  upb_status_uninit(&status);
+}
+
+int run_tests(int argc, char *argv[]) {
+  UPB_UNUSED(argc);
+  UPB_UNUSED(argv);
+  test_levels();
+  test_assemble();
+  test_errors();
+  test_duplicates();
+  return 0;
+}
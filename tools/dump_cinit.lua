@@ -16,15 +16,15 @@ local export = {}
 
 -- A tiny little abstraction that decouples the dump_* functions from
 -- what they're writing to (appending to a string, writing to file I/O, etc).
--- This could possibly matter since naive string building is O(n^2) in the
--- number of appends.
+-- Naive string building is O(n^2) in the number of appends, so strings are
+-- collected in a table and concatenated once.
 function export.str_appender()
-  local str = ""
+  local buf = {}
   local function append(fmt, ...)
-    str = str .. string.format(fmt, ...)
+    buf[#buf + 1] = string.format(fmt, ...)
   end
   local function get()
-    return str
+    return table.concat(buf)
   end
   return append, get
 end
@@ -38,15 +38,22 @@ function export.file_appender(file)
 end
 
 -- const(f, label) -> UPB_LABEL_REPEATED, where f:label() == upb.LABEL_REPEATED
+-- Reverse lookups are cached, since this is called several times per field.
+local const_cache = {}
 function const(obj, name)
   local val = obj[name](obj)
-  for k, v in pairs(upb) do
-    if v == val and string.find(k, "^" .. string.upper(name)) then
-      return "UPB_" .. k
+  local names = const_cache[name]
+  if not names then
+    names = {}
+    for k, v in pairs(upb) do
+      if string.find(k, "^" .. string.upper(name)) then
+        names[v] = "UPB_" .. k
+      end
     end
+    const_cache[name] = names
   end
-  assert(false, "Couldn't find UPB_" .. string.upper(name) ..
-                " constant for value: " .. val)
+  return names[val] or error("Couldn't find UPB_" .. string.upper(name) ..
+                             " constant for value: " .. val)
 end
 
 function constlist(pattern)
@@ -135,103 +142,6 @@ function LinkTable:objs(objtype)
   end
 end
 
---[[
-
-  Dumper: an object that can dump C initializers for several constructs.
-  Uses a LinkTable to resolve references when necessary.
-
---]]
-
-local Dumper = {}
-function Dumper:new(linktab)
-  local obj = {linktab = linktab}
-  setmetatable(obj, {__index = Dumper})  -- Inheritance
-  return obj
-end
-
--- Dumps a _upb_value, eg:
---   UPB_VALUE_INIT_INT32(5)
-function Dumper:_value(val, upbtype)
-  if type(val) == "nil" then
-    return "UPB__VALUE_INIT_NONE"
-  elseif type(val) == "number" then
-    -- Use upbtype to disambiguate what kind of number it is.
-    if upbtype == upbtable.CTYPE_INT32 then
-      return string.format("UPB_VALUE_INIT_INT32(%d)", val)
-    else
-      -- TODO(haberman): add support for these so we can properly support
-      -- default values.
-      error("Unsupported number type " .. upbtype)
-    end
-  elseif type(val) == "string" then
-    return string.format('UPB_VALUE_INIT_CONSTPTR("%s")', val)
-  else
-    -- We take this as an object reference that has an entry in the link table.
-    return string.format("UPB_VALUE_INIT_CONSTPTR(%s)", self.linktab:addr(val))
-  end
-end
-
--- Dumps a table key.
-function Dumper:tabkey(key)
-  if type(key) == "nil" then
-    return "UPB_TABKEY_NONE"
-  elseif type(key) == "string" then
-    return string.format('UPB_TABKEY_STR("%s")', key)
-  else
-    return string.format("UPB_TABKEY_NUM(%d)", key)
-  end
-end
-
--- Dumps a table entry.
-function Dumper:tabent(ent)
-  local key = self:tabkey(ent.key)
-  local val = self:_value(ent.value, ent.valtype)
-  local next = self.linktab:addr(ent.next)
-  return string.format('  {%s, %s, %s},\n', key, val, next)
-end
-
--- Dumps an inttable array entry.  This is almost the same as value() above,
--- except that nil values have a special value to indicate "empty".
-function Dumper:arrayval(val)
-  if val.val then
-    return string.format("  %s,\n", self:_value(val.val, val.valtype))
-  else
-    return "  UPB_ARRAY_EMPTYENT,\n"
-  end
-end
-
--- Dumps an initializer for the given strtable/inttable (respectively).  Its
--- entries must have previously been added to the linktable.
-function Dumper:strtable(t)
-  -- UPB_STRTABLE_INIT(count, mask, type, size_lg2, entries)
-  return string.format(
-      "UPB_STRTABLE_INIT(%d, %d, %d, %d, %s)",
-      t.count, t.mask, t.type, t.size_lg2, self.linktab:addr(t.entries[1].ptr))
-end
-
-function Dumper:inttable(t)
-  local lt = assert(self.linktab)
-  -- UPB_INTTABLE_INIT(count, mask, type, size_lg2, ent, a, asize, acount)
-  local entries = "NULL"
-  if #t.entries > 0 then
-    entries = lt:addr(t.entries[1].ptr)
-  end
-  return string.format(
-      "UPB_INTTABLE_INIT(%d, %d, %d, %d, %s, %s, %d, %d)",
-      t.count, t.mask, t.type, t.size_lg2, entries,
-      lt:addr(t.array[1].ptr), t.array_size, t.array_count)
-end
-
--- A visitor for visiting all tables of a def.  Used first to count entries
--- and later to dump them.
-local function gettables(def)
-  if def:def_type() == upb.DEF_MSG then
-    return {int = upbtable.msgdef_itof(def), str = upbtable.msgdef_ntof(def)}
-  elseif def:def_type() == upb.DEF_ENUM then
-    return {int = upbtable.enumdef_iton(def), str = upbtable.enumdef_ntoi(def)}
-  end
-end
-
 local function emit_file_warning(append)
   append('// This file was generated by upbc (the upb compiler).\n')
   append('// Do not edit -- your changes will be discarded when the file is\n')
@@ -275,54 +185,103 @@ local function dump_defs_c(symtab, basename, append)
     [upb.DEF_MSG] = "msgs",
     [upb.DEF_FIELD] = "fields",
     [upb.DEF_ENUM] = "enums",
-    intentries = "intentries",
-    strentries = "strentries",
-    arrays = "arrays",
   })
   for _, def in ipairs(defs) do
     assert(def:is_frozen(), "can only dump frozen defs.")
     linktab:add(def:def_type(), def)
-    local tables = gettables(def)
-    if tables then
-      for _, e in ipairs(tables.str.entries) do
-        linktab:add("strentries", e.ptr, e)
-      end
-      for _, e in ipairs(tables.int.entries) do
-        linktab:add("intentries", e.ptr, e)
-      end
-      for _, e in ipairs(tables.int.array) do
-        linktab:add("arrays", e.ptr, e)
-      end
-    end
   end
 
-  -- Emit forward declarations.
-  emit_file_warning(append)
-  append('#include "upb/def.h"\n\n')
-  append("const upb_msgdef %s;\n", linktab:cdecl(upb.DEF_MSG))
-  append("const upb_fielddef %s;\n", linktab:cdecl(upb.DEF_FIELD))
-  append("const upb_enumdef %s;\n", linktab:cdecl(upb.DEF_ENUM))
-  append("const upb_tabent %s;\n", linktab:cdecl("strentries"))
-  append("const upb_tabent %s;\n", linktab:cdecl("intentries"))
-  append("const _upb_value %s;\n", linktab:cdecl("arrays"))
-  append("\n")
+  -- The upbtable C helper dumps the hash table entries and arrays of every
+  -- table in bulk, appending to the buffers in "tables" and allocating
+  -- consecutive offsets in the shared arrays.  It resolves references to
+  -- defs through "addrs".
+  local addrs = {}
+  for _, def in ipairs(defs) do
+    addrs[def] = linktab:addr(def)
+  end
+  local tables = {
+    strsym = basename .. "_strentries", strbase = 0, strbuf = {},
+    intsym = basename .. "_intentries", intbase = 0, intbuf = {},
+    arrsym = basename .. "_arrays",     arrbase = 0, arrbuf = {},
+  }
 
-  -- Emit defs.
-  local dumper = Dumper:new(linktab)
+  -- Everything is formatted into "buf" and written with a single append at
+  -- the end, since the forward declarations need the final table sizes.
+  local buf = {}
+  local function add(fmt, ...)
+    buf[#buf + 1] = string.format(fmt, ...)
+  end
 
-  append("const upb_msgdef %s = {\n", linktab:cdecl(upb.DEF_MSG))
+  -- The hot field data of every message, each message's fields contiguous
+  -- and ordered by number, with its extensions last (as build_hot() in
+  -- upb/def.c orders them).
+  local hotsym = basename .. "_hotfields"
+  local hotbuf = {}
+
+  -- The extension ranges of every message, each message's contiguous.
+  local extsym = basename .. "_extranges"
+  local extbuf = {}
+
+  -- Emit defs.
+  add("const upb_msgdef %s = {\n", linktab:cdecl(upb.DEF_MSG))
   for m in linktab:objs(upb.DEF_MSG) do
-    local tables = gettables(m)
-    -- UPB_MSGDEF_INIT(name, itof, ntof)
-    append('  UPB_MSGDEF_INIT("%s", %s, %s, %s),\n',
-           m:full_name(),
-           dumper:inttable(tables.int),
-           dumper:strtable(tables.str),
-           m:_selector_count())
+    local itof, ntof = upbtable.msgdef_cinit(m, addrs, tables)
+    local fields = {}
+    for f in m:fields() do
+      fields[#fields + 1] = f
+    end
+    table.sort(fields, function(a, b)
+      if a:is_extension() ~= b:is_extension() then
+        return b:is_extension()
+      end
+      return a:number() < b:number()
+    end)
+    local hot = "NULL"
+    if #fields > 0 then
+      hot = string.format("&%s[%d]", hotsym, #hotbuf)
+    end
+    local ranges = m:extension_ranges()
+    local ext_ranges = "NULL"
+    if #ranges > 0 then
+      ext_ranges = string.format("&%s[%d]", extsym, #extbuf)
+    end
+    for _, r in ipairs(ranges) do
+      extbuf[#extbuf + 1] = string.format('  {%d, %d},\n', r[1], r[2])
+    end
+    local required = 0
+    local hot_ext_count = 0
+    for _, f in ipairs(fields) do
+      if f:is_extension() then
+        hot_ext_count = hot_ext_count + 1
+      end
+      local subdef = "NULL"
+      if f:has_subdef() then
+        subdef = string.format("upb_upcast(%s)", linktab:addr(f:subdef()))
+      end
+      local required_index = 0
+      if f:label() == upb.LABEL_REQUIRED then
+        required_index = math.min(required, 64)  -- UPB_MAX_REQUIRED
+        required = required + 1
+      end
+      -- UPB_HOTFIELD_INIT(number, selector_base, descriptortype, label,
+      --                   required_index, subdef, f)
+      hotbuf[#hotbuf + 1] = string.format(
+          '  UPB_HOTFIELD_INIT(%d, %d, %s, %s, %d, %s, %s),\n',
+          f:number(), f:_selector_base(), const(f, "descriptor_type"),
+          const(f, "label"), required_index, subdef, linktab:addr(f))
+    end
+    -- UPB_MSGDEF_INIT(name, itof, ntof, hot, hot_count, selector_count,
+    --                 fingerprint, map_entry, ext_ranges, ext_range_count,
+    --                 hot_ext_count)
+    add('  UPB_MSGDEF_INIT("%s", %s, %s, %s, %d, %s, 0x%sULL, %s, %s, %d, ' ..
+        '%d),\n',
+        m:full_name(), itof, ntof, hot, #fields, m:_selector_count(),
+        m:_fingerprint(), boolstr(m:map_entry()), ext_ranges, #ranges,
+        hot_ext_count)
   end
-  append("};\n\n")
+  add("};\n\n")
 
-  append("const upb_fielddef %s = {\n", linktab:cdecl(upb.DEF_FIELD))
+  add("const upb_fielddef %s = {\n", linktab:cdecl(upb.DEF_FIELD))
   for f in linktab:objs(upb.DEF_FIELD) do
     local subdef = "NULL"
     if f:has_subdef() then
@@ -337,48 +296,74 @@ local function dump_defs_c(symtab, basename, append)
     else
       intfmt = "0"
     end
+    local containing_type_name = "NULL"
+    if f:containing_type_name() then
+      containing_type_name = string.format('"%s"', f:containing_type_name())
+    end
     -- UPB_FIELDDEF_INIT(label, type, intfmt, tagdelim, name, num, msgdef,
-    --                   subdef, selector_base, default_value)
-    append('  UPB_FIELDDEF_INIT(%s, %s, %s, %s, "%s", %d, %s, %s, %d, ' ..
-           'UPB_VALUE_INIT_NONE),\n',  -- TODO: support default value
-           const(f, "label"), const(f, "type"), intfmt,
-           boolstr(f:istagdelim()), f:name(),
-           f:number(), linktab:addr(f:msgdef()), subdef,
-           f:_selector_base()
-           )
+    --                   subdef, selector_base, default_value, is_extension,
+    --                   containing_type_name)
+    add('  UPB_FIELDDEF_INIT(%s, %s, %s, %s, "%s", %d, %s, %s, %d, ' ..
+        'UPB_VALUE_INIT_NONE, %s, %s),\n',  -- TODO: support default value
+        const(f, "label"), const(f, "type"), intfmt,
+        boolstr(f:istagdelim()), f:name(),
+        f:number(), linktab:addr(f:msgdef()), subdef,
+        f:_selector_base(), boolstr(f:is_extension()), containing_type_name
+        )
   end
-  append("};\n\n")
+  add("};\n\n")
 
-  append("const upb_enumdef %s = {\n", linktab:cdecl(upb.DEF_ENUM))
+  add("const upb_enumdef %s = {\n", linktab:cdecl(upb.DEF_ENUM))
   for e in linktab:objs(upb.DEF_ENUM) do
-    local tables = gettables(e)
+    local iton, ntoi = upbtable.enumdef_cinit(e, addrs, tables)
     -- UPB_ENUMDEF_INIT(name, ntoi, iton, defaultval)
-    append('  UPB_ENUMDEF_INIT("%s", %s, %s, %d),\n',
-           e:full_name(),
-           dumper:strtable(tables.str),
-           dumper:inttable(tables.int),
-           --e:default())
-           0)
+    add('  UPB_ENUMDEF_INIT("%s", %s, %s, %d),\n',
+        e:full_name(), ntoi, iton,
+        --e:default())
+        0)
   end
-  append("};\n\n")
+  add("};\n\n")
 
-  append("const upb_tabent %s = {\n", linktab:cdecl("strentries"))
-  for ent in linktab:objs("strentries") do
-    append(dumper:tabent(ent))
-  end
-  append("};\n\n");
+  local hotfields = string.format("%s[%d]", hotsym, #hotbuf)
+  add("const upb_hotfield %s = {\n", hotfields)
+  buf[#buf + 1] = table.concat(hotbuf)
+  add("};\n\n")
 
-  append("const upb_tabent %s = {\n", linktab:cdecl("intentries"))
-  for ent in linktab:objs("intentries") do
-    append(dumper:tabent(ent))
-  end
-  append("};\n\n");
+  local extranges = string.format("%s[%d]", extsym, #extbuf)
+  add("const upb_extrange %s = {\n", extranges)
+  buf[#buf + 1] = table.concat(extbuf)
+  add("};\n\n")
 
-  append("const _upb_value %s = {\n", linktab:cdecl("arrays"))
-  for ent in linktab:objs("arrays") do
-    append(dumper:arrayval(ent))
-  end
-  append("};\n\n");
+  local strentries = string.format("%s[%d]", tables.strsym, tables.strbase)
+  local intentries = string.format("%s[%d]", tables.intsym, tables.intbase)
+  local arrays = string.format("%s[%d]", tables.arrsym, tables.arrbase)
+
+  add("const upb_tabent %s = {\n", strentries)
+  buf[#buf + 1] = table.concat(tables.strbuf)
+  add("};\n\n");
+
+  add("const upb_tabent %s = {\n", intentries)
+  buf[#buf + 1] = table.concat(tables.intbuf)
+  add("};\n\n");
+
+  add("const _upb_value %s = {\n", arrays)
+  buf[#buf + 1] = table.concat(tables.arrbuf)
+  add("};\n\n");
+
+  -- Emit forward declarations.
+  emit_file_warning(append)
+  append('#include "upb/def.h"\n\n')
+  append("const upb_msgdef %s;\n", linktab:cdecl(upb.DEF_MSG))
+  append("const upb_fielddef %s;\n", linktab:cdecl(upb.DEF_FIELD))
+  append("const upb_enumdef %s;\n", linktab:cdecl(upb.DEF_ENUM))
+  append("const upb_hotfield %s;\n", hotfields)
+  append("const upb_extrange %s;\n", extranges)
+  append("const upb_tabent %s;\n", strentries)
+  append("const upb_tabent %s;\n", intentries)
+  append("const _upb_value %s;\n", arrays)
+  append("\n")
+
+  append("%s", table.concat(buf))
 
   return linktab
 end
@@ -0,0 +1,260 @@
+--[[
+
+  upb - a minimalist implementation of protocol buffers.
+
+  Copyright (c) 2013 Google Inc.  See LICENSE for details.
+  Author: Josh Haberman <jhaberman@gmail.com>
+
+  Routines for dumping plain C structs for msgdefs, along with a function
+  that registers upb_shim handlers to populate them.  Together these let a
+  .proto file be decoded straight into C structs (and with the JIT, without
+  calling any handler functions for primitive fields).
+
+  Layout of each generated struct:
+    - the hasbits come first, one bit per non-repeated field, so that
+      checking presence touches the first cache line of the message.  They
+      are rounded up to a multiple of 8 bytes if any member needs that
+      alignment.
+    - the remaining members are sorted by decreasing alignment so that no
+      padding is needed between them.
+    - strings are upb_shim_str, repeated fields are upb_shim_arr, and
+      submessages are pointers; all of them point into memory obtained from
+      the upb_shim_alloc given at registration time (typically an arena).
+
+--]]
+
+local upb = require "upb"
+local export = {}
+
+local function join(...)
+  return table.concat({...}, ".")
+end
+
+local function to_cident(...)
+  return string.gsub(join(...), "%.", "_")
+end
+
+local function to_preproc(...)
+  return string.upper(to_cident(...))
+end
+
+local function isrepeated(f)
+  return f:label() == upb.LABEL_REPEATED
+end
+
+local function isstring(f)
+  return f:type() == upb.TYPE_STRING or f:type() == upb.TYPE_BYTES
+end
+
+local function issubmsg(f)
+  return f:type() == upb.TYPE_MESSAGE
+end
+
+-- C type and alignment class (bigger sorts first) of each primitive type.
+-- Pointer-sized members are given the same class as 64-bit ones, which is
+-- conservative on 32-bit platforms.
+local primitive_ctypes = {
+  [upb.TYPE_DOUBLE] = {"double", 8},
+  [upb.TYPE_INT64]  = {"int64_t", 8},
+  [upb.TYPE_UINT64] = {"uint64_t", 8},
+  [upb.TYPE_FLOAT]  = {"float", 4},
+  [upb.TYPE_INT32]  = {"int32_t", 4},
+  [upb.TYPE_UINT32] = {"uint32_t", 4},
+  [upb.TYPE_ENUM]   = {"int32_t", 4},
+  [upb.TYPE_BOOL]   = {"bool", 1},
+}
+
+-- Returns the C type of the struct member for field "f" and its alignment
+-- class.
+local function member_ctype(f)
+  if isrepeated(f) then
+    return "upb_shim_arr", 8
+  elseif isstring(f) then
+    return "upb_shim_str", 8
+  elseif issubmsg(f) then
+    return "struct " .. to_cident(f:subdef():full_name()) .. "*", 8
+  else
+    local t = assert(primitive_ctypes[f:type()], "unknown type " .. f:type())
+    return t[1], t[2]
+  end
+end
+
+-- Returns an array of the message's fields, in struct layout order, with
+-- each entry {field, ctype, hasbit}.  Fields without a hasbit have hasbit -1.
+local function layout(msg)
+  local fields = {}
+  for f in msg:fields() do
+    fields[#fields + 1] = f
+  end
+  table.sort(fields, function(a, b) return a:number() < b:number() end)
+
+  local members = {}
+  local hasbit = 0
+  local maxalign = 1
+  for i, f in ipairs(fields) do
+    local ctype, align = member_ctype(f)
+    local member = {field = f, ctype = ctype, align = align, order = i}
+    if isrepeated(f) then
+      member.hasbit = -1
+    else
+      member.hasbit = hasbit
+      hasbit = hasbit + 1
+    end
+    members[#members + 1] = member
+    maxalign = math.max(maxalign, align)
+  end
+
+  -- table.sort() is not stable, so break ties by field number.
+  table.sort(members, function(a, b)
+    if a.align ~= b.align then
+      return a.align > b.align
+    else
+      return a.order < b.order
+    end
+  end)
+
+  -- The number of uint32_t words of hasbits, padded so that the first member
+  -- is aligned.
+  local hasbit_words = math.ceil(hasbit / 32)
+  if maxalign == 8 and hasbit_words % 2 == 1 then
+    hasbit_words = hasbit_words + 1
+  end
+  return members, hasbit_words
+end
+
+local function emit_file_warning(append)
+  append('// This file was generated by upbc (the upb compiler).\n')
+  append('// Do not edit -- your changes will be discarded when the file is\n')
+  append('// regenerated.\n\n')
+end
+
+local function dump_struct(msg, append)
+  local cident = to_cident(msg:full_name())
+  local members, hasbit_words = layout(msg)
+  append('struct %s {\n', cident)
+  if hasbit_words > 0 then
+    append('  uint32_t _hasbits[%d];\n', hasbit_words)
+  end
+  for _, m in ipairs(members) do
+    append('  %s %s;\n', m.ctype, m.field:name())
+  end
+  if #members == 0 then
+    -- Empty structs are not allowed in C.
+    append('  char _dummy;\n')
+  end
+  append('};\n\n')
+
+  -- Presence accessors.  Hasbits are addressed by byte like upb_shim does, so
+  -- that the layout is independent of endianness.
+  for _, m in ipairs(members) do
+    if m.hasbit >= 0 then
+      append('#define %s_HAS(msg) \\\n', to_preproc(cident, m.field:name()))
+      append('    ((((const uint8_t*)(msg)->_hasbits)[%d] & 0x%02x) != 0)\n',
+             math.floor(m.hasbit / 8), math.floor(2 ^ (m.hasbit % 8)))
+    end
+  end
+  append('\n')
+end
+
+local function dump_sethandlers(msg, append)
+  local cident = to_cident(msg:full_name())
+  local members = layout(msg)
+  append('UPB_INLINE bool %s_sethandlers(upb_handlers *h,\n', cident)
+  append('                               const upb_shim_alloc *a) {\n')
+  append('  const upb_msgdef *md = upb_handlers_msgdef(h);\n')
+  append('  const upb_fielddef *f;\n')
+  append('  UPB_UNUSED(md);\n')
+  append('  UPB_UNUSED(f);\n')
+  append('  UPB_UNUSED(a);\n')
+  for _, m in ipairs(members) do
+    local f = m.field
+    local offset = string.format("offsetof(%s, %s)", cident, f:name())
+    local call
+    if issubmsg(f) then
+      call = string.format("upb_shim_setsubmsg(h, f, %s, %d, sizeof(%s), a)",
+                           offset, m.hasbit,
+                           to_cident(f:subdef():full_name()))
+    elseif isstring(f) then
+      call = string.format("upb_shim_setstr(h, f, %s, %d, a)",
+                           offset, m.hasbit)
+    elseif isrepeated(f) then
+      call = string.format("upb_shim_setrepeated(h, f, %s, a)", offset)
+    else
+      call = string.format("upb_shim_set(h, f, %s, %d)", offset, m.hasbit)
+    end
+    append('  if (!(f = upb_msgdef_itof(md, %d)) || !%s) return false;\n',
+           f:number(), call)
+  end
+  append('  return true;\n')
+  append('}\n\n')
+end
+
+--[[
+
+  Top-level, exported dumper function
+
+--]]
+
+function export.dump_structs(symtab, basename, append)
+  local ucase_basename = string.upper(basename)
+  local msgs = symtab:getdefs(upb.DEF_MSG)
+  table.sort(msgs, function(a, b) return a:full_name() < b:full_name() end)
+
+  emit_file_warning(append)
+  append('#ifndef %s_UPB_STRUCT_H_\n', ucase_basename)
+  append('#define %s_UPB_STRUCT_H_\n\n', ucase_basename)
+  append('#include <stddef.h>\n')
+  append('#include <string.h>\n')
+  append('#include "upb/shim/shim.h"\n\n')
+  append('#ifdef __cplusplus\n')
+  append('extern "C" {\n')
+  append('#endif\n\n')
+
+  -- Forward declarations, since messages may refer to each other cyclically.
+  for _, msg in ipairs(msgs) do
+    local cident = to_cident(msg:full_name())
+    append('typedef struct %s %s;\n', cident, cident)
+  end
+  append('\n')
+
+  for _, msg in ipairs(msgs) do
+    dump_struct(msg, append)
+  end
+
+  -- Per-message registration functions.  These look fields up by number, so
+  -- they work equally well with upbc's static defs and with defs loaded at
+  -- runtime, as long as the schema matches.
+  for _, msg in ipairs(msgs) do
+    dump_sethandlers(msg, append)
+  end
+
+  -- A upb_handlers_callback for upb_handlers_newfrozen() that covers every
+  -- message in the file.  "closure" must be a const upb_shim_alloc*.  The
+  -- callback cannot return an error, and registration only fails if the defs
+  -- do not match the .proto file (or on out-of-memory), so it asserts.
+  append('UPB_INLINE void %s_shimhandlers(void *closure, upb_handlers *h) {\n',
+         basename)
+  append('  const upb_shim_alloc *a = (const upb_shim_alloc*)closure;\n')
+  append('  const char *name = upb_msgdef_fullname(upb_handlers_msgdef(h));\n')
+  append('  bool ok = false;\n')
+  for i, msg in ipairs(msgs) do
+    append('  %sif (strcmp(name, "%s") == 0) {\n',
+           i == 1 and "" or "} else ", msg:full_name())
+    append('    ok = %s_sethandlers(h, a);\n', to_cident(msg:full_name()))
+  end
+  if #msgs > 0 then
+    append('  }\n')
+  else
+    append('  UPB_UNUSED(a);\n')
+    append('  UPB_UNUSED(name);\n')
+  end
+  append('  UPB_ASSERT_VAR(ok, ok);\n')
+  append('}\n\n')
+
+  append('#ifdef __cplusplus\n')
+  append('};  // extern "C"\n')
+  append('#endif\n\n')
+  append('#endif  // %s_UPB_STRUCT_H_\n', ucase_basename)
+end
+
+return export
@@ -7,13 +7,16 @@
 
   The upb compiler.  Unlike the proto2 compiler, this does
   not output any parsing code or generated classes or anything
-  specific to the protobuf binary format at all.  At the moment
-  it only dumps C initializers for upb_defs, so that a .proto
-  file can be represented in a .o file.
+  specific to the protobuf binary format at all.  It dumps C
+  initializers for upb_defs, so that a .proto file can be
+  represented in a .o file, and plain C structs for messages
+  along with a function that registers upb_shim handlers to
+  populate them.
 
 --]]
 
 local dump_cinit = require "dump_cinit"
+local dump_cstruct = require "dump_cstruct"
 local upb = require "upb"
 
 local src = arg[1]
@@ -21,6 +24,7 @@ local outbase = arg[2]
 local basename = arg[3]
 local hfilename = outbase .. ".upb.h"
 local cfilename = outbase .. ".upb.c"
+local sfilename = outbase .. ".upb_struct.h"
 
 if os.getenv("UPBC_VERBOSE") then
   print("upbc:")
@@ -28,6 +32,7 @@ if os.getenv("UPBC_VERBOSE") then
   print(string.format("  output file base=%s", outbase))
   print(string.format("  hfilename=%s", hfilename))
   print(string.format("  cfilename=%s", cfilename))
+  print(string.format("  sfilename=%s", sfilename))
 end
 
 -- Open input/output files.
@@ -39,12 +44,18 @@ symtab:load_descriptor(descriptor)
 os.execute(string.format("mkdir -p `dirname %s`", outbase))
 local hfile = assert(io.open(hfilename, "w"), "couldn't open " .. hfilename)
 local cfile = assert(io.open(cfilename, "w"), "couldn't open " .. cfilename)
+local sfile = assert(io.open(sfilename, "w"), "couldn't open " .. sfilename)
 
 local happend = dump_cinit.file_appender(hfile)
 local cappend = dump_cinit.file_appender(cfile)
+local sappend = dump_cinit.file_appender(sfile)
 
 -- Dump defs
 dump_cinit.dump_defs(symtab, basename, happend, cappend)
 
+-- Dump structs and the shim handlers that populate them.
+dump_cstruct.dump_structs(symtab, basename, sappend)
+
 hfile:close()
 cfile:close()
+sfile:close()
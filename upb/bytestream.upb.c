@@ -7,21 +7,30 @@
 const upb_msgdef upb_bytestream_msgs[1];
 const upb_fielddef upb_bytestream_fields[1];
 const upb_enumdef upb_bytestream_enums[0];
+const upb_hotfield upb_bytestream_hotfields[1];
+const upb_extrange upb_bytestream_extranges[0];
 const upb_tabent upb_bytestream_strentries[4];
 const upb_tabent upb_bytestream_intentries[0];
 const _upb_value upb_bytestream_arrays[3];
 
 const upb_msgdef upb_bytestream_msgs[1] = {
-  UPB_MSGDEF_INIT("upb.ByteStream", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &upb_bytestream_arrays[0], 3, 1), UPB_STRTABLE_INIT(1, 3, 9, 2, &upb_bytestream_strentries[0]), 5),
+  UPB_MSGDEF_INIT("upb.ByteStream", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &upb_bytestream_arrays[0], 3, 1), UPB_STRTABLE_INIT(1, 3, 9, 2, &upb_bytestream_strentries[0]), &upb_bytestream_hotfields[0], 1, 5, 0x74b1b7379a0a9102ULL, false, NULL, 0, 0),
 };
 
 const upb_fielddef upb_bytestream_fields[1] = {
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BYTES, 0, false, "bytes", 1, &upb_bytestream_msgs[0], NULL, 2, UPB_VALUE_INIT_NONE),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BYTES, 0, false, "bytes", 1, &upb_bytestream_msgs[0], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
 };
 
 const upb_enumdef upb_bytestream_enums[0] = {
 };
 
+const upb_hotfield upb_bytestream_hotfields[1] = {
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_BYTES, UPB_LABEL_OPTIONAL, 0, NULL, &upb_bytestream_fields[0]),
+};
+
+const upb_extrange upb_bytestream_extranges[0] = {
+};
+
 const upb_tabent upb_bytestream_strentries[4] = {
   {UPB_TABKEY_NONE, UPB__VALUE_INIT_NONE, NULL},
   {UPB_TABKEY_NONE, UPB__VALUE_INIT_NONE, NULL},
@@ -173,6 +173,223 @@ static bool upb_validate_field(upb_fielddef *f, upb_status *s) {
   return true;
 }
 
+static bool validate_mapentry(const upb_msgdef *m, upb_status *s) {
+  const upb_fielddef *key = upb_msgdef_itof(m, 1);
+  const upb_fielddef *val = upb_msgdef_itof(m, 2);
+  bool ok = upb_msgdef_numfields(m) == 2 && key && val &&
+            upb_fielddef_label(key) == UPB_LABEL_OPTIONAL &&
+            upb_fielddef_label(val) == UPB_LABEL_OPTIONAL;
+  if (ok) {
+    switch (upb_fielddef_type(key)) {
+      case UPB_TYPE_FLOAT:
+      case UPB_TYPE_DOUBLE:
+      case UPB_TYPE_BYTES:
+      case UPB_TYPE_ENUM:
+      case UPB_TYPE_MESSAGE:
+        ok = false;
+        break;
+      default:
+        break;
+    }
+  }
+  if (!ok) {
+    upb_status_seterrf(s, "map entry %s must have only an optional key field "
+                       "(1) of integer, bool or string type and an optional "
+                       "value field (2)", msgdef_name(m));
+  }
+  return ok;
+}
+
+// An extension outside the extension ranges, or an ordinary field inside one,
+// would let the same number mean different fields in different programs.
+static bool validate_extnum(const upb_fielddef *f, upb_status *s) {
+  bool inrange = upb_msgdef_isextnum(f->msgdef, upb_fielddef_number(f));
+  if (inrange == upb_fielddef_isextension(f)) return true;
+  upb_status_seterrf(s, inrange ?
+                     "field %s.%s is in an extension range" :
+                     "extension %s.%s is not in an extension range",
+                     msgdef_name(f->msgdef), upb_fielddef_name(f));
+  return false;
+}
+
+/* Fingerprinting *************************************************************/
+
+// Fingerprints are meant to be persisted, so they may only depend on names,
+// numbers and types (never on pointers or table layout), and fields and enum
+// values are combined in an order-independent way since table iteration order
+// is unspecified.
+
+static uint64_t fp_mix(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+static uint64_t fp_int(uint64_t h, uint64_t val) {
+  return fp_mix(h ^ fp_mix(val + 0x9e3779b97f4a7c15ULL));
+}
+
+static uint64_t fp_str(uint64_t h, const char *str) {
+  // FNV-1a; anonymous defs hash like the empty string.
+  if (str) {
+    for (; *str; str++) {
+      h ^= (uint8_t)*str;
+      h *= 0x100000001b3ULL;
+    }
+  }
+  return fp_mix(h);
+}
+
+// Fingerprint of a single def, covering only the names of its subdefs.
+static uint64_t fp_local(const upb_def *d) {
+  uint64_t h = fp_str(fp_int(0, d->type), d->fullname);
+  uint64_t sum = 0;
+  const upb_msgdef *m = upb_dyncast_msgdef(d);
+  const upb_enumdef *e = upb_dyncast_enumdef(d);
+  if (m) {
+    upb_msg_iter i;
+    for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+      const upb_fielddef *f = upb_msg_iter_field(&i);
+      uint64_t fh = fp_str(fp_int(0, upb_fielddef_number(f)),
+                           upb_fielddef_name(f));
+      fh = fp_int(fh, upb_fielddef_descriptortype(f));
+      fh = fp_int(fh, upb_fielddef_label(f));
+      if (upb_fielddef_hassubdef(f))
+        fh = fp_str(fh, upb_def_fullname(upb_fielddef_subdef(f)));
+      // Extensions get their selectors after the other fields.
+      if (upb_fielddef_isextension(f)) fh = fp_str(fh, "extension");
+      sum += fh;
+    }
+    // Only mixed in when set, so other fingerprints are unchanged.
+    if (upb_msgdef_mapentry(m)) h = fp_str(h, "map_entry");
+  } else if (e) {
+    upb_enum_iter i;
+    for(upb_enum_begin(&i, e); !upb_enum_done(&i); upb_enum_next(&i)) {
+      sum += fp_str(fp_int(0, upb_enum_iter_number(&i)),
+                    upb_enum_iter_name(&i));
+    }
+  }
+  return fp_int(h, sum);
+}
+
+// The fingerprint of a message covers every def reachable from it, so it
+// changes whenever anything that can appear in the message's serialized form
+// changes.  The local fingerprints of the defs being frozen are computed
+// once and cached in "local".
+static bool fp_msgdef(upb_msgdef *m, upb_inttable *local, upb_status *s) {
+  upb_inttable seen;
+  if (!upb_inttable_init(&seen, UPB_CTYPE_BOOL)) goto oom;
+  size_t size = 8, len = 0;
+  const upb_def **queue = malloc(size * sizeof(*queue));
+  if (!queue) goto oom_seen;
+
+  uint64_t sum = 0;
+  queue[len++] = upb_upcast(m);
+  upb_inttable_insertptr(&seen, m, upb_value_bool(true));
+  for (size_t i = 0; i < len; i++) {
+    const upb_def *d = queue[i];
+    upb_value v;
+    uint64_t h;
+    if (upb_inttable_lookupptr(local, d, &v)) {
+      h = upb_value_getuint64(v);
+    } else {
+      h = fp_local(d);
+      if (!upb_inttable_insertptr(local, d, upb_value_uint64(h))) goto oom_q;
+    }
+    sum += h;
+
+    const upb_msgdef *dm = upb_dyncast_msgdef(d);
+    if (!dm) continue;
+    upb_msg_iter j;
+    for(upb_msg_begin(&j, dm); !upb_msg_done(&j); upb_msg_next(&j)) {
+      const upb_fielddef *f = upb_msg_iter_field(&j);
+      if (!upb_fielddef_hassubdef(f)) continue;
+      const upb_def *sub = upb_fielddef_subdef(f);
+      if (upb_inttable_lookupptr(&seen, sub, &v)) continue;
+      if (!upb_inttable_insertptr(&seen, sub, upb_value_bool(true)))
+        goto oom_q;
+      if (len == size) {
+        size *= 2;
+        const upb_def **newq = realloc(queue, size * sizeof(*queue));
+        if (!newq) goto oom_q;
+        queue = newq;
+      }
+      queue[len++] = sub;
+    }
+  }
+
+  upb_value v;
+  upb_inttable_lookupptr(local, m, &v);
+  m->fingerprint_ = fp_int(upb_value_getuint64(v), sum);
+  free(queue);
+  upb_inttable_uninit(&seen);
+  return true;
+
+oom_q:
+  free(queue);
+oom_seen:
+  upb_inttable_uninit(&seen);
+oom:
+  upb_status_seterrliteral(s, "out of memory");
+  return false;
+}
+
+/* Hot fields ****************************************************************/
+
+// Orders the ordinary fields by number, followed by the extensions.
+static int cmp_hotfield(const void *_a, const void *_b) {
+  const upb_hotfield *a = _a;
+  const upb_hotfield *b = _b;
+  bool a_ext = upb_fielddef_isextension(a->f);
+  bool b_ext = upb_fielddef_isextension(b->f);
+  if (a_ext != b_ext) return a_ext ? 1 : -1;
+  return a->number < b->number ? -1 : (a->number > b->number);
+}
+
+static bool build_hot(upb_msgdef *m) {
+  int n = upb_msgdef_numfields(m);
+  if (n == 0) return true;
+  upb_hotfield *hot = malloc(n * sizeof(*hot));
+  if (!hot) return false;
+  upb_hotfield *h = hot;
+  uint32_t ext_count = 0;
+  upb_msg_iter j;
+  for(upb_msg_begin(&j, m); !upb_msg_done(&j); upb_msg_next(&j), h++) {
+    const upb_fielddef *f = upb_msg_iter_field(&j);
+    if (upb_fielddef_isextension(f)) ext_count++;
+    h->number = upb_fielddef_number(f);
+    h->selector_base = 0;  // Assigned by the caller.
+    h->descriptortype = upb_fielddef_descriptortype(f);
+    h->label = upb_fielddef_label(f);
+    h->is_map = upb_fielddef_ismap(f);
+    h->subdef = upb_fielddef_hassubdef(f) ? upb_fielddef_subdef(f) : NULL;
+    h->f = f;
+  }
+  qsort(hot, n, sizeof(*hot), cmp_hotfield);
+  uint32_t required = 0;
+  for (int i = 0; i < n; i++) {
+    hot[i].required_index = 0;
+    if (hot[i].label == UPB_LABEL_REQUIRED) {
+      hot[i].required_index = UPB_MIN(required, UPB_MAX_REQUIRED);
+      required++;
+    }
+  }
+  m->hot = hot;
+  m->hot_count = n;
+  m->hot_ext_count = ext_count;
+  return true;
+}
+
+static void free_hot(upb_msgdef *m) {
+  free((void*)m->hot);
+  m->hot = NULL;
+  m->hot_count = 0;
+  m->hot_ext_count = 0;
+}
+
 bool upb_def_freeze(upb_def *const* defs, int n, upb_status *s) {
   // First perform validation, in two passes so we can check that we have a
   // transitive closure without needing to search.
@@ -197,12 +414,26 @@ bool upb_def_freeze(upb_def *const* defs, int n, upb_status *s) {
     if (m) {
       upb_inttable_compact(&m->itof);
       upb_msg_iter j;
-      uint32_t selector = UPB_STATIC_SELECTOR_COUNT;
       for(upb_msg_begin(&j, m); !upb_msg_done(&j); upb_msg_next(&j)) {
         upb_fielddef *f = upb_msg_iter_field(&j);
         assert(f->msgdef == m);
-        if (!upb_validate_field(f, s)) goto err;
+        if (!upb_validate_field(f, s) || !validate_extnum(f, s)) goto err_hot;
+      }
+      if (m->map_entry_ && !validate_mapentry(m, s)) goto err_hot;
+      if (!build_hot(m)) {
+        upb_status_seterrliteral(s, "out of memory");
+        goto err_hot;
+      }
+      // Selectors are assigned in field number order (extensions last), so
+      // that the handlers of fields that are near each other in the .proto
+      // file (and usually on the wire) are near each other in the handlers
+      // table.
+      uint32_t selector = UPB_STATIC_SELECTOR_COUNT;
+      for (uint32_t k = 0; k < m->hot_count; k++) {
+        upb_hotfield *hot = (upb_hotfield*)&m->hot[k];
+        upb_fielddef *f = (upb_fielddef*)hot->f;
         f->selector_base = selector + upb_handlers_selectorbaseoffset(f);
+        hot->selector_base = f->selector_base;
         selector += upb_handlers_selectorcount(f);
       }
       m->selector_count = selector;
@@ -211,9 +442,32 @@ bool upb_def_freeze(upb_def *const* defs, int n, upb_status *s) {
     }
   }
 
+  // Selectors are assigned and all subdefs are resolved, so fingerprints can
+  // be computed now.
+  upb_inttable local;
+  if (!upb_inttable_init(&local, UPB_CTYPE_UINT64)) {
+    upb_status_seterrliteral(s, "out of memory");
+    goto err_hot;
+  }
+  for (int i = 0; i < n; i++) {
+    upb_msgdef *m = upb_dyncast_msgdef_mutable(defs[i]);
+    if (m && !fp_msgdef(m, &local, s)) {
+      upb_inttable_uninit(&local);
+      goto err_hot;
+    }
+  }
+  upb_inttable_uninit(&local);
+
   // Validation all passed; freeze the defs.
-  return upb_refcounted_freeze((upb_refcounted*const*)defs, n, s);
+  if (upb_refcounted_freeze((upb_refcounted*const*)defs, n, s)) return true;
 
+err_hot:
+  // The hot arrays must not outlive the freeze, since the msgdefs are still
+  // mutable.
+  for (int i = 0; i < n; i++) {
+    upb_msgdef *m = upb_dyncast_msgdef_mutable(defs[i]);
+    if (m) free_hot(m);
+  }
 err:
   for (int i = 0; i < n; i++) {
     defs[i]->came_from_user = false;
@@ -390,6 +644,7 @@ static void freefield(upb_refcounted *r) {
   upb_fielddef_uninit_default(f);
   if (f->subdef_is_symbolic)
     free(f->sub.name);
+  free(f->containing_type_name_);
   upb_def_uninit(upb_upcast(f));
   free(f);
 }
@@ -410,6 +665,8 @@ upb_fielddef *upb_fielddef_new(const void *owner) {
   f->number_ = 0;
   f->type_is_set_ = false;
   f->tagdelim = false;
+  f->is_extension_ = false;
+  f->containing_type_name_ = NULL;
 
   // For the moment we default this to UPB_INTFMT_VARIABLE, since it will work
   // with all integer types and is in some since more "default" since the most
@@ -430,10 +687,11 @@ upb_fielddef *upb_fielddef_dup(const upb_fielddef *f, const void *owner) {
   upb_fielddef_setlabel(newf, upb_fielddef_label(f));
   upb_fielddef_setnumber(newf, upb_fielddef_number(f), NULL);
   upb_fielddef_setname(newf, upb_fielddef_name(f), NULL);
+  upb_fielddef_setisextension(newf, upb_fielddef_isextension(f));
   if (f->default_is_string) {
     str_t *s = upb_value_getptr(upb_fielddef_default(f));
     upb_fielddef_setdefaultstr(newf, s->str, s->len, NULL);
-  } else {
+  } else if (!upb_fielddef_issubmsg(f)) {
     upb_fielddef_setdefault(newf, upb_fielddef_default(f));
   }
 
@@ -444,13 +702,13 @@ upb_fielddef *upb_fielddef_dup(const upb_fielddef *f, const void *owner) {
     srcname = f->sub.def ? upb_def_fullname(f->sub.def) : NULL;
   }
   if (srcname) {
-    char *newname = malloc(strlen(f->sub.def->fullname) + 2);
+    char *newname = malloc(strlen(srcname) + 2);
     if (!newname) {
       upb_fielddef_unref(newf, owner);
       return NULL;
     }
     strcpy(newname, ".");
-    strcat(newname, f->sub.def->fullname);
+    strcat(newname, srcname);
     upb_fielddef_setsubdefname(newf, newname, NULL);
     free(newname);
   }
@@ -851,6 +1109,39 @@ bool upb_fielddef_isprimitive(const upb_fielddef *f) {
   return !upb_fielddef_isstring(f) && !upb_fielddef_issubmsg(f);
 }
 
+bool upb_fielddef_ismap(const upb_fielddef *f) {
+  if (!upb_fielddef_issubmsg(f) || !upb_fielddef_isseq(f) ||
+      f->subdef_is_symbolic) {
+    return false;
+  }
+  const upb_msgdef *m = upb_dyncast_msgdef(upb_fielddef_subdef(f));
+  return m && upb_msgdef_mapentry(m);
+}
+
+bool upb_fielddef_isextension(const upb_fielddef *f) {
+  return f->is_extension_;
+}
+
+void upb_fielddef_setisextension(upb_fielddef *f, bool is_extension) {
+  assert(!upb_fielddef_isfrozen(f));
+  f->is_extension_ = is_extension;
+}
+
+const char *upb_fielddef_containingtypename(const upb_fielddef *f) {
+  return f->containing_type_name_;
+}
+
+bool upb_fielddef_setcontainingtypename(upb_fielddef *f, const char *name,
+                                        upb_status *s) {
+  assert(!upb_fielddef_isfrozen(f));
+  // Like the type names in a descriptor, this may start with a '.'.
+  const char *ident = name[0] == UPB_SYMBOL_SEPARATOR ? name + 1 : name;
+  if (!upb_isident(ident, strlen(ident), true, s)) return false;
+  free(f->containing_type_name_);
+  f->containing_type_name_ = upb_strdup(name);
+  return true;
+}
+
 bool upb_fielddef_hassubdef(const upb_fielddef *f) {
   return upb_fielddef_issubmsg(f) || upb_fielddef_type(f) == UPB_TYPE_ENUM;
 }
@@ -881,6 +1172,8 @@ static void visitmsg(const upb_refcounted *r, upb_refcounted_visit *visit,
 
 static void freemsg(upb_refcounted *r) {
   upb_msgdef *m = (upb_msgdef*)r;
+  free((void*)m->hot);
+  free(m->ext_ranges);
   upb_strtable_uninit(&m->ntof);
   upb_inttable_uninit(&m->itof);
   upb_def_uninit(upb_upcast(m));
@@ -892,6 +1185,14 @@ upb_msgdef *upb_msgdef_new(const void *owner) {
   upb_msgdef *m = malloc(sizeof(*m));
   if (!m) return NULL;
   if (!upb_def_init(upb_upcast(m), UPB_DEF_MSG, &vtbl, owner)) goto err2;
+  m->selector_count = 0;
+  m->fingerprint_ = 0;
+  m->hot = NULL;
+  m->hot_count = 0;
+  m->map_entry_ = false;
+  m->ext_ranges = NULL;
+  m->ext_range_count = 0;
+  m->hot_ext_count = 0;
   if (!upb_inttable_init(&m->itof, UPB_CTYPE_PTR)) goto err2;
   if (!upb_strtable_init(&m->ntof, UPB_CTYPE_PTR)) goto err1;
   return m;
@@ -909,6 +1210,14 @@ upb_msgdef *upb_msgdef_dup(const upb_msgdef *m, const void *owner) {
   bool ok = upb_def_setfullname(upb_upcast(newm),
                                 upb_def_fullname(upb_upcast(m)), NULL);
   UPB_ASSERT_VAR(ok, ok);
+  newm->map_entry_ = m->map_entry_;
+  for (int i = 0; i < upb_msgdef_extrangecount(m); i++) {
+    const upb_extrange *r = upb_msgdef_extrange(m, i);
+    if (!upb_msgdef_addextrange(newm, r->start, r->end, NULL)) {
+      upb_msgdef_unref(newm, owner);
+      return NULL;
+    }
+  }
   upb_msg_iter i;
   for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
     upb_fielddef *f = upb_fielddef_dup(upb_msg_iter_field(&i), &f);
@@ -989,6 +1298,10 @@ bool upb_msgdef_addfield(upb_msgdef *m, upb_fielddef *f, const void *ref_donor,
 }
 
 const upb_fielddef *upb_msgdef_itof(const upb_msgdef *m, uint32_t i) {
+  if (m->hot) {
+    const upb_hotfield *h = upb_msgdef_hotfield(m, i);
+    return h ? h->f : NULL;
+  }
   upb_value val;
   return upb_inttable_lookup32(&m->itof, i, &val) ?
       upb_value_getptr(val) : NULL;
@@ -1012,6 +1325,100 @@ int upb_msgdef_numfields(const upb_msgdef *m) {
   return upb_strtable_count(&m->ntof);
 }
 
+uint64_t upb_msgdef_fingerprint(const upb_msgdef *m) {
+  assert(upb_msgdef_isfrozen(m));
+  return m->fingerprint_;
+}
+
+bool upb_msgdef_mapentry(const upb_msgdef *m) {
+  return m->map_entry_;
+}
+
+void upb_msgdef_setmapentry(upb_msgdef *m, bool map_entry) {
+  assert(!upb_msgdef_isfrozen(m));
+  m->map_entry_ = map_entry;
+}
+
+bool upb_msgdef_addextrange(upb_msgdef *m, uint32_t start, uint32_t end,
+                            upb_status *s) {
+  assert(!upb_msgdef_isfrozen(m));
+  if (start == 0 || start >= end || end > UPB_MAX_FIELDNUMBER + 1) {
+    upb_status_seterrf(s, "invalid extension range [%u, %u)", start, end);
+    return false;
+  }
+  for (uint32_t i = 0; i < m->ext_range_count; i++) {
+    const upb_extrange *r = &m->ext_ranges[i];
+    if (start < r->end && r->start < end) {
+      upb_status_seterrf(s, "extension range [%u, %u) overlaps [%u, %u)",
+                         start, end, r->start, r->end);
+      return false;
+    }
+  }
+  upb_extrange *ranges =
+      realloc(m->ext_ranges, (m->ext_range_count + 1) * sizeof(*ranges));
+  if (!ranges) {
+    upb_status_seterrliteral(s, "out of memory");
+    return false;
+  }
+  ranges[m->ext_range_count].start = start;
+  ranges[m->ext_range_count].end = end;
+  m->ext_ranges = ranges;
+  m->ext_range_count++;
+  return true;
+}
+
+int upb_msgdef_extrangecount(const upb_msgdef *m) {
+  return m->ext_range_count;
+}
+
+const upb_extrange *upb_msgdef_extrange(const upb_msgdef *m, int i) {
+  assert(i >= 0 && (uint32_t)i < m->ext_range_count);
+  return &m->ext_ranges[i];
+}
+
+bool upb_msgdef_isextnum(const upb_msgdef *m, uint32_t number) {
+  for (uint32_t i = 0; i < m->ext_range_count; i++) {
+    const upb_extrange *r = &m->ext_ranges[i];
+    if (number >= r->start && number < r->end) return true;
+  }
+  return false;
+}
+
+// Returns the index of the first of the "n" fields at "hot" whose number is
+// not less than "i".
+static uint32_t hot_lowerbound(const upb_hotfield *hot, uint32_t n,
+                               uint32_t i) {
+  uint32_t lo = 0, hi = n;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (hot[mid].number < i) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+const upb_hotfield *upb_msgdef_hotfield(const upb_msgdef *m, uint32_t i) {
+  assert(upb_msgdef_isfrozen(m));
+  const upb_hotfield *hot = m->hot;
+  uint32_t n = m->hot_count - m->hot_ext_count;
+  // Fields are usually numbered densely from 1, in which case field i is at
+  // index i-1.  Otherwise it can only be before that, since numbers are
+  // unique and positive.
+  uint32_t hi = UPB_MIN(i, n);
+  if (hi > 0 && hot[hi - 1].number == i) return &hot[hi - 1];
+  uint32_t lo = hot_lowerbound(hot, hi, i);
+  if (lo < n && hot[lo].number == i) return &hot[lo];
+  if (m->hot_ext_count == 0) return NULL;
+
+  // Extensions have their own sorted table after the other fields.
+  const upb_hotfield *ext = hot + n;
+  lo = hot_lowerbound(ext, m->hot_ext_count, i);
+  return (lo < m->hot_ext_count && ext[lo].number == i) ? &ext[lo] : NULL;
+}
+
 void upb_msg_begin(upb_msg_iter *iter, const upb_msgdef *m) {
   upb_inttable_begin(iter, &m->itof);
 }
@@ -300,6 +300,24 @@ class upb::FieldDef {
   bool IsSequence() const;
   bool IsPrimitive() const;
 
+  // Whether this is a map field: a repeated field whose message type is a
+  // map entry (see MessageDef::map_entry()).
+  bool IsMap() const;
+
+  // Whether this field is an extension, declared apart from the message it
+  // belongs to.  Its number must be in one of the message's extension ranges
+  // (see MessageDef::AddExtensionRange()).  Extensions are usually named by
+  // their full name, so that they cannot clash with the message's own fields.
+  bool is_extension() const;
+  void set_is_extension(bool is_extension);
+
+  // The full name of the message an extension extends.  This is only needed
+  // for extensions that are added to a upb::SymbolTable by themselves, which
+  // adds them to this message (see SymbolTable::Add()).  NULL if not set.
+  const char* containing_type_name() const;
+  bool set_containing_type_name(const char* name, Status* s);
+  bool set_containing_type_name(const std::string& name, Status* s);
+
   // How integers are encoded.  Only meaningful for integer types.
   // Defaults to UPB_INTFMT_VARIABLE, and is reset when "type" changes.
   IntegerFormat integer_format() const;
@@ -408,13 +426,17 @@ struct upb_fielddef {
   upb_label_t label_;
   uint32_t number_;
   uint32_t selector_base;  // Used to index into a upb::Handlers table.
+  bool is_extension_;
+  char *containing_type_name_;
 };
 
 #define UPB_FIELDDEF_INIT(label, type, intfmt, tagdelim, name, num, \
-                          msgdef, subdef, selector_base, defaultval) \
+                          msgdef, subdef, selector_base, defaultval, \
+                          is_extension, containing_type_name) \
   {UPB_DEF_INIT(name, UPB_DEF_FIELD), defaultval, msgdef, {subdef}, \
    false, type == UPB_TYPE_STRING || type == UPB_TYPE_BYTES, true, \
-   intfmt, tagdelim, type, label, num, selector_base}
+   intfmt, tagdelim, type, label, num, selector_base, is_extension, \
+   containing_type_name}
 
 // Native C API.
 #ifdef __cplusplus
@@ -450,6 +472,9 @@ bool upb_fielddef_issubmsg(const upb_fielddef *f);
 bool upb_fielddef_isstring(const upb_fielddef *f);
 bool upb_fielddef_isseq(const upb_fielddef *f);
 bool upb_fielddef_isprimitive(const upb_fielddef *f);
+bool upb_fielddef_ismap(const upb_fielddef *f);
+bool upb_fielddef_isextension(const upb_fielddef *f);
+const char *upb_fielddef_containingtypename(const upb_fielddef *f);
 upb_value upb_fielddef_default(const upb_fielddef *f);
 const char *upb_fielddef_defaultstr(const upb_fielddef *f, size_t *len);
 bool upb_fielddef_default_is_symbolic(const upb_fielddef *f);
@@ -464,6 +489,9 @@ bool upb_fielddef_setnumber(upb_fielddef *f, uint32_t number, upb_status *s);
 bool upb_fielddef_setname(upb_fielddef *f, const char *name, upb_status *s);
 bool upb_fielddef_setintfmt(upb_fielddef *f, upb_intfmt_t fmt);
 bool upb_fielddef_settagdelim(upb_fielddef *f, bool tag_delim);
+void upb_fielddef_setisextension(upb_fielddef *f, bool is_extension);
+bool upb_fielddef_setcontainingtypename(upb_fielddef *f, const char *name,
+                                        upb_status *s);
 void upb_fielddef_setdefault(upb_fielddef *f, upb_value value);
 bool upb_fielddef_setdefaultstr(upb_fielddef *f, const void *str, size_t len,
                                 upb_status *s);
@@ -484,11 +512,51 @@ bool upb_fielddef_checkintfmt(int32_t fmt);
 }  // extern "C"
 #endif
 
+// The parts of a fielddef that are needed while parsing.  When a msgdef is
+// frozen these are copied out of all of its fielddefs into a single array,
+// ordered by field number, so that a parser touches a few contiguous cache
+// lines per message type instead of one heap object per field.  The rest of
+// the field (name, default, etc.) is reached through "f".
+typedef struct {
+  uint32_t number;
+  uint32_t selector_base;
+  uint8_t descriptortype;  // upb_descriptortype_t
+  uint8_t label;           // upb_label_t
+  bool is_map;             // upb_fielddef_ismap(f)
+  // For required fields, the field's index among the message's required
+  // fields in number order, which is its bit in a decoder's bitmap of the
+  // required fields seen so far.  UPB_MAX_REQUIRED past that many required
+  // fields, and 0 for other fields.
+  uint8_t required_index;
+  const upb_def *subdef;   // NULL if !upb_fielddef_hassubdef(f).
+  const upb_fielddef *f;
+} upb_hotfield;
+
+#define UPB_HOTFIELD_INIT(number, selector_base, descriptortype, label, \
+                          required_index, subdef, f) \
+  {number, selector_base, descriptortype, label, false, required_index, \
+   subdef, f}
+
+UPB_INLINE bool upb_hotfield_isseq(const upb_hotfield *f) {
+  return f->label == UPB_LABEL_REPEATED;
+}
+
+UPB_INLINE bool upb_hotfield_isstring(const upb_hotfield *f) {
+  return f->descriptortype == UPB_DESCRIPTOR_TYPE_STRING ||
+         f->descriptortype == UPB_DESCRIPTOR_TYPE_BYTES;
+}
+
 
 /* upb::MessageDef ************************************************************/
 
 typedef upb_inttable_iter upb_msg_iter;
 
+// A range of field numbers reserved for extensions, [start, end).
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+} upb_extrange;
+
 #ifdef __cplusplus
 
 // Structure that describes a single .proto message type.
@@ -517,6 +585,32 @@ class upb::MessageDef {
   // The number of fields that belong to the MessageDef.
   int field_count() const;
 
+  // A structural fingerprint of this message and every def reachable from it,
+  // computed when the message is frozen.  It depends only on names, numbers
+  // and types, so it is stable across processes and can be used as a cache
+  // key for artifacts compiled from the schema.  Only valid when frozen.
+  uint64_t fingerprint() const;
+
+  // Whether this message type is the entry type of a map field, as protoc
+  // generates for "map<K, V>" (and marks with the map_entry option).  A map
+  // entry must have exactly an optional "key" field numbered 1, of an integer,
+  // bool or string type, and an optional "value" field numbered 2.  Repeated
+  // fields of this type are map fields, which decoders can deliver to a
+  // single map-entry handler (see upb::Handlers::SetMapEntryHandler()).
+  bool map_entry() const;
+  void set_map_entry(bool map_entry);
+
+  // Extension ranges, as declared with "extensions 100 to 199;" in a .proto
+  // file (which is the range [100, 200)).  Ranges may not overlap.  When the
+  // message is frozen, every field with is_extension() must be in a range and
+  // every other field must be outside of them.
+  bool AddExtensionRange(uint32_t start, uint32_t end, Status* s);
+  int extension_range_count() const;
+  const upb_extrange& extension_range(int i) const;
+
+  // Whether "number" is in one of the extension ranges.
+  bool IsExtensionNumber(uint32_t number) const;
+
   // Adds a field (upb_fielddef object) to a msgdef.  Requires that the msgdef
   // and the fielddefs are mutable.  The fielddef's name and number must be
   // set, and the message may not already contain any field with this name or
@@ -575,16 +669,32 @@ struct upb_msgdef {
 #endif
   upb_def base;
   size_t selector_count;
+  uint64_t fingerprint_;
+
+  // Hot field data, built at freeze time; NULL while mutable.
+  const upb_hotfield *hot;
+  uint32_t hot_count;
 
   // Tables for looking up fields by number and name.
   upb_inttable itof;  // int to field
   upb_strtable ntof;  // name to field
 
-  // TODO(haberman): proper extension ranges (there can be multiple).
+  bool map_entry_;
+  upb_extrange *ext_ranges;
+  uint32_t ext_range_count;
+  // The last "hot_ext_count" entries of "hot" are the extensions, sorted by
+  // number apart from the other fields.  Extension numbers are usually large,
+  // and this keeps them from breaking up the dense run of ordinary fields.
+  uint32_t hot_ext_count;
 };
 
-#define UPB_MSGDEF_INIT(name, itof, ntof, selector_count) \
-  {UPB_DEF_INIT(name, UPB_DEF_MSG), selector_count, itof, ntof}
+// The extension ranges are const in a static def, like everything else.
+#define UPB_MSGDEF_INIT(name, itof, ntof, hot, hot_count, selector_count, \
+                        fingerprint, map_entry, ext_ranges, ext_range_count, \
+                        hot_ext_count) \
+  {UPB_DEF_INIT(name, UPB_DEF_MSG), selector_count, fingerprint, hot, \
+   hot_count, itof, ntof, map_entry, (upb_extrange*)ext_ranges, \
+   ext_range_count, hot_ext_count}
 
 #ifdef __cplusplus
 extern "C" {
@@ -614,6 +724,18 @@ const upb_fielddef *upb_msgdef_ntof(const upb_msgdef *m, const char *name);
 upb_fielddef *upb_msgdef_itof_mutable(upb_msgdef *m, uint32_t i);
 upb_fielddef *upb_msgdef_ntof_mutable(upb_msgdef *m, const char *name);
 int upb_msgdef_numfields(const upb_msgdef *m);
+uint64_t upb_msgdef_fingerprint(const upb_msgdef *m);
+bool upb_msgdef_mapentry(const upb_msgdef *m);
+void upb_msgdef_setmapentry(upb_msgdef *m, bool map_entry);
+bool upb_msgdef_addextrange(upb_msgdef *m, uint32_t start, uint32_t end,
+                            upb_status *s);
+int upb_msgdef_extrangecount(const upb_msgdef *m);
+const upb_extrange *upb_msgdef_extrange(const upb_msgdef *m, int i);
+bool upb_msgdef_isextnum(const upb_msgdef *m, uint32_t number);
+
+// Returns the hot data for the field with the given number, or NULL if there
+// is no such field.  Requires that the msgdef is frozen.
+const upb_hotfield *upb_msgdef_hotfield(const upb_msgdef *m, uint32_t i);
 
 // upb_msg_iter i;
 // for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
@@ -947,6 +1069,25 @@ inline bool FieldDef::IsString() const {
 inline bool FieldDef::IsSequence() const {
   return upb_fielddef_isseq(this);
 }
+inline bool FieldDef::IsMap() const {
+  return upb_fielddef_ismap(this);
+}
+inline bool FieldDef::is_extension() const {
+  return upb_fielddef_isextension(this);
+}
+inline void FieldDef::set_is_extension(bool is_extension) {
+  upb_fielddef_setisextension(this, is_extension);
+}
+inline const char* FieldDef::containing_type_name() const {
+  return upb_fielddef_containingtypename(this);
+}
+inline bool FieldDef::set_containing_type_name(const char* name, Status* s) {
+  return upb_fielddef_setcontainingtypename(this, name, s);
+}
+inline bool FieldDef::set_containing_type_name(const std::string& name,
+                                               Status* s) {
+  return upb_fielddef_setcontainingtypename(this, upb_safecstr(name), s);
+}
 inline Value FieldDef::default_value() const {
   return upb_fielddef_default(this);
 }
@@ -1027,6 +1168,28 @@ inline bool MessageDef::set_full_name(const std::string& fullname, Status* s) {
 inline int MessageDef::field_count() const {
   return upb_msgdef_numfields(this);
 }
+inline uint64_t MessageDef::fingerprint() const {
+  return upb_msgdef_fingerprint(this);
+}
+inline bool MessageDef::map_entry() const {
+  return upb_msgdef_mapentry(this);
+}
+inline void MessageDef::set_map_entry(bool map_entry) {
+  upb_msgdef_setmapentry(this, map_entry);
+}
+inline bool MessageDef::AddExtensionRange(uint32_t start, uint32_t end,
+                                          Status* s) {
+  return upb_msgdef_addextrange(this, start, end, s);
+}
+inline int MessageDef::extension_range_count() const {
+  return upb_msgdef_extrangecount(this);
+}
+inline const upb_extrange& MessageDef::extension_range(int i) const {
+  return *upb_msgdef_extrange(this, i);
+}
+inline bool MessageDef::IsExtensionNumber(uint32_t number) const {
+  return upb_msgdef_isextnum(this, number);
+}
 inline bool MessageDef::AddField(upb_fielddef *f, const void *ref_donor,
                                  Status *s) {
   return upb_msgdef_addfield(this, f, ref_donor, s);
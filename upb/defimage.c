@@ -0,0 +1,521 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ * Author: Josh Haberman <jhaberman@gmail.com>
+ *
+ * Layout of an image (all offsets are from the start of the image):
+ *
+ *   header
+ *   defs, tables and strings, in the order the builder happened to emit them
+ *   index:  array of indexent, sorted by name (msgdefs and enumdefs only)
+ *   defs:   array of offsets of every def, including fielddefs
+ *   fixups: array of offsets of every non-NULL pointer in the image
+ *
+ * Every pointer in the image is stored as the offset of its target, with 0
+ * meaning NULL (offset 0 is the header, which nothing points to).  Loading
+ * adds the image's base address to every slot listed in "fixups" and then
+ * turns every def's refcounted header into a static one.
+ */
+
+#include "upb/defimage.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Bump whenever the layout of the image changes in a way that the struct
+// sizes checked in image_abi() would not catch.
+#define IMAGE_VERSION 1
+static const char image_magic[8] = "upbdefs";
+
+// All objects in the image are aligned to this.
+#define IMAGE_ALIGN 8
+
+// Must match the private definition in def.c; string defaults point to one.
+typedef struct {
+  size_t len;
+  char str[1];
+} str_t;
+
+typedef struct {
+  char magic[8];
+  uint32_t abi;
+  bool loaded;
+  uint64_t fingerprint;
+  size_t size;
+  size_t index_ofs, index_count;
+  size_t defs_ofs, defs_count;
+  size_t fixups_ofs, fixups_count;
+} header;
+
+typedef struct {
+  const char *name;
+  const upb_def *def;
+} indexent;
+
+// Images contain raw structs, so they are only usable by a build of upb that
+// lays them out identically.
+static uint32_t image_abi() {
+  const size_t sizes[] = {
+    sizeof(void*), sizeof(size_t), sizeof(upb_refcounted), sizeof(upb_def),
+    sizeof(upb_msgdef), sizeof(upb_fielddef), sizeof(upb_enumdef),
+    sizeof(upb_tabent), sizeof(upb_value), sizeof(header),
+  };
+  const uint16_t one = 1;
+  uint32_t abi = IMAGE_VERSION;
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    abi = abi * 31 + sizes[i];
+  }
+  return abi * 31 + *(const uint8_t*)&one;
+}
+
+
+/* Building ******************************************************************/
+
+typedef struct {
+  char *ptr;
+  size_t len, size;
+  bool oom;
+  upb_inttable objs;     // Source def -> offset in the image.
+  upb_strtable strings;  // Interned string -> offset in the image.
+  size_t *defs;          // Offsets of all defs.
+  size_t defs_len, defs_size;
+  size_t *fixups;        // Offsets of all pointer slots.
+  size_t fixups_len, fixups_size;
+} builder;
+
+static bool b_pushofs(builder *b, size_t **arr, size_t *len, size_t *size,
+                      size_t ofs) {
+  if (*len == *size) {
+    size_t new_size = UPB_MAX(*size * 2, 64);
+    size_t *new_arr = realloc(*arr, new_size * sizeof(size_t));
+    if (!new_arr) {
+      b->oom = true;
+      return false;
+    }
+    *arr = new_arr;
+    *size = new_size;
+  }
+  (*arr)[(*len)++] = ofs;
+  return true;
+}
+
+// Returns the offset of "size" new zeroed bytes, or 0 if out of memory.
+// Offsets remain valid across allocations, but pointers into b->ptr do not.
+static size_t b_alloc(builder *b, size_t size, size_t align) {
+  if (b->oom) return 0;
+  size_t ofs = (b->len + align - 1) & ~(align - 1);
+  if (ofs + size > b->size) {
+    size_t new_size = UPB_MAX(b->size * 2, 4096);
+    while (new_size < ofs + size) new_size *= 2;
+    char *new_ptr = realloc(b->ptr, new_size);
+    if (!new_ptr) {
+      b->oom = true;
+      return 0;
+    }
+    b->ptr = new_ptr;
+    b->size = new_size;
+  }
+  memset(b->ptr + b->len, 0, ofs + size - b->len);
+  b->len = ofs + size;
+  return ofs;
+}
+
+static void b_write(builder *b, size_t ofs, const void *data, size_t len) {
+  if (b->oom) return;
+  memcpy(b->ptr + ofs, data, len);
+}
+
+// Stores a pointer to the object at offset "target" into the slot at "ofs".
+static void b_setptr(builder *b, size_t ofs, size_t target) {
+  if (b->oom) return;
+  uintptr_t val = target;
+  memcpy(b->ptr + ofs, &val, sizeof(val));
+  if (target) b_pushofs(b, &b->fixups, &b->fixups_len, &b->fixups_size, ofs);
+}
+
+// Returns the offset of a copy of the given string, copying it only once.
+static size_t b_str(builder *b, const char *str) {
+  if (!str) return 0;
+  upb_value v;
+  if (upb_strtable_lookup(&b->strings, str, &v))
+    return upb_value_getuint64(v);
+  size_t len = strlen(str) + 1;
+  size_t ofs = b_alloc(b, len, 1);
+  b_write(b, ofs, str, len);
+  if (!b->oom && !upb_strtable_insert(&b->strings, str, upb_value_uint64(ofs)))
+    b->oom = true;
+  return ofs;
+}
+
+// Reserves space for a def so that references to it can be resolved before it
+// is written.
+static size_t b_place(builder *b, const void *def, size_t size) {
+  size_t ofs = b_alloc(b, size, IMAGE_ALIGN);
+  if (!b->oom && !upb_inttable_insertptr(&b->objs, def, upb_value_uint64(ofs)))
+    b->oom = true;
+  b_pushofs(b, &b->defs, &b->defs_len, &b->defs_size, ofs);
+  return ofs;
+}
+
+// Returns the offset of a def that was previously placed, or 0 if it is not
+// part of the image.
+static size_t b_obj(builder *b, const void *def) {
+  upb_value v;
+  if (!def || !upb_inttable_lookupptr(&b->objs, def, &v)) return 0;
+  return upb_value_getuint64(v);
+}
+
+static void b_value(builder *b, size_t ofs, _upb_value val, upb_ctype_t type) {
+  b_write(b, ofs, &val, sizeof(val));
+  if (type == UPB_CTYPE_PTR) {
+    b_setptr(b, ofs, b_obj(b, val.constptr));
+  } else if (type == UPB_CTYPE_CSTR) {
+    b_setptr(b, ofs, b_str(b, val.cstr));
+  }
+}
+
+// Copies the hash part of "t", which is embedded in the object at "ofs".
+static void b_table(builder *b, size_t ofs, const upb_table *t, bool strkeys) {
+  size_t n = upb_table_size(t);
+  size_t ents = n ? b_alloc(b, n * sizeof(upb_tabent), IMAGE_ALIGN) : 0;
+  for (size_t i = 0; i < n; i++) {
+    const upb_tabent *e = &t->entries[i];
+    size_t entofs = ents + i * sizeof(upb_tabent);
+    b_write(b, entofs, e, sizeof(*e));
+    if (!upb_tabent_isempty(e)) {
+      if (strkeys)
+        b_setptr(b, entofs + offsetof(upb_tabent, key), b_str(b, e->key.str));
+      b_value(b, entofs + offsetof(upb_tabent, val), e->val, t->type);
+    }
+    b_setptr(b, entofs + offsetof(upb_tabent, next),
+             e->next ? ents + (e->next - t->entries) * sizeof(upb_tabent) : 0);
+  }
+  b_setptr(b, ofs + offsetof(upb_table, entries), ents);
+}
+
+static void b_inttable(builder *b, size_t ofs, const upb_inttable *t) {
+  b_table(b, ofs + offsetof(upb_inttable, t), &t->t, false);
+  size_t arr = 0;
+  if (t->array_size > 0) {
+    arr = b_alloc(b, t->array_size * sizeof(_upb_value), IMAGE_ALIGN);
+    for (size_t i = 0; i < t->array_size; i++) {
+      size_t valofs = arr + i * sizeof(_upb_value);
+      if (upb_arrhas(t->array[i])) {
+        b_value(b, valofs, t->array[i], t->t.type);
+      } else {
+        b_write(b, valofs, &t->array[i], sizeof(_upb_value));
+      }
+    }
+  }
+  b_setptr(b, ofs + offsetof(upb_inttable, array), arr);
+}
+
+static void b_strtable(builder *b, size_t ofs, const upb_strtable *t) {
+  b_table(b, ofs + offsetof(upb_strtable, t), &t->t, true);
+}
+
+// Writes the parts common to all defs; the refcounted header is left zeroed
+// until the image is loaded.
+static void b_def(builder *b, size_t ofs, const upb_def *d, size_t size) {
+  b_write(b, ofs, d, size);
+  upb_refcounted zero;
+  memset(&zero, 0, sizeof(zero));
+  b_write(b, ofs + offsetof(upb_def, base), &zero, sizeof(zero));
+  b_setptr(b, ofs + offsetof(upb_def, fullname), b_str(b, d->fullname));
+}
+
+static bool b_fielddef(builder *b, const upb_fielddef *f, upb_status *s) {
+  size_t ofs = b_obj(b, f);
+  b_def(b, ofs, upb_upcast(f), sizeof(*f));
+  b_setptr(b, ofs + offsetof(upb_fielddef, msgdef), b_obj(b, f->msgdef));
+
+  size_t sub = 0;
+  if (upb_fielddef_hassubdef(f)) {
+    sub = b_obj(b, upb_fielddef_subdef(f));
+    if (!sub) {
+      upb_status_seterrf(s, "field %s.%s refers to a def outside the symtab",
+                         upb_msgdef_fullname(f->msgdef),
+                         upb_fielddef_name(f));
+      return false;
+    }
+  }
+  b_setptr(b, ofs + offsetof(upb_fielddef, sub), sub);
+  b_setptr(b, ofs + offsetof(upb_fielddef, containing_type_name_),
+           b_str(b, f->containing_type_name_));
+
+  const str_t *str = f->defaultval.val.ptr;
+  if (f->default_is_string && str) {
+    size_t strofs = b_alloc(b, offsetof(str_t, str) + str->len + 1,
+                            IMAGE_ALIGN);
+    b_write(b, strofs, str, offsetof(str_t, str) + str->len + 1);
+    b_setptr(b, ofs + offsetof(upb_fielddef, defaultval), strofs);
+  }
+  return true;
+}
+
+static bool b_msgdef(builder *b, const upb_msgdef *m, upb_status *s) {
+  size_t ofs = b_obj(b, m);
+  b_def(b, ofs, upb_upcast(m), sizeof(*m));
+  b_inttable(b, ofs + offsetof(upb_msgdef, itof), &m->itof);
+  b_strtable(b, ofs + offsetof(upb_msgdef, ntof), &m->ntof);
+  size_t hot = 0;
+  if (m->hot_count > 0) {
+    hot = b_alloc(b, m->hot_count * sizeof(upb_hotfield), IMAGE_ALIGN);
+    for (uint32_t i = 0; i < m->hot_count; i++) {
+      const upb_hotfield *h = &m->hot[i];
+      size_t hofs = hot + i * sizeof(upb_hotfield);
+      b_write(b, hofs, h, sizeof(*h));
+      b_setptr(b, hofs + offsetof(upb_hotfield, subdef), b_obj(b, h->subdef));
+      b_setptr(b, hofs + offsetof(upb_hotfield, f), b_obj(b, h->f));
+    }
+  }
+  b_setptr(b, ofs + offsetof(upb_msgdef, hot), hot);
+  size_t ranges = 0;
+  if (m->ext_range_count > 0) {
+    size_t len = m->ext_range_count * sizeof(upb_extrange);
+    ranges = b_alloc(b, len, IMAGE_ALIGN);
+    b_write(b, ranges, m->ext_ranges, len);
+  }
+  b_setptr(b, ofs + offsetof(upb_msgdef, ext_ranges), ranges);
+  upb_msg_iter i;
+  for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+    if (!b_fielddef(b, upb_msg_iter_field(&i), s)) return false;
+  }
+  return true;
+}
+
+static void b_enumdef(builder *b, const upb_enumdef *e) {
+  size_t ofs = b_obj(b, e);
+  b_def(b, ofs, upb_upcast(e), sizeof(*e));
+  b_strtable(b, ofs + offsetof(upb_enumdef, ntoi), &e->ntoi);
+  b_inttable(b, ofs + offsetof(upb_enumdef, iton), &e->iton);
+}
+
+// Writes an array of offsets into the image, returning its offset.
+static size_t b_ofsarray(builder *b, const size_t *arr, size_t len) {
+  size_t ofs = b_alloc(b, len * sizeof(size_t), IMAGE_ALIGN);
+  b_write(b, ofs, arr, len * sizeof(size_t));
+  return ofs;
+}
+
+static int cmp_defname(const void *_a, const void *_b) {
+  const upb_def *a = *(const upb_def**)_a;
+  const upb_def *b = *(const upb_def**)_b;
+  return strcmp(upb_def_fullname(a), upb_def_fullname(b));
+}
+
+void *upb_defimage_build(const upb_symtab *s, size_t *len, upb_status *status) {
+  builder b;
+  memset(&b, 0, sizeof(b));
+  if (!upb_inttable_init(&b.objs, UPB_CTYPE_UINT64)) goto oom;
+  if (!upb_strtable_init(&b.strings, UPB_CTYPE_UINT64)) {
+    upb_inttable_uninit(&b.objs);
+    goto oom;
+  }
+
+  int n;
+  const upb_def **defs = upb_symtab_getdefs(s, UPB_DEF_ANY, &b, &n);
+  if (!defs) {
+    b.oom = true;
+    n = 0;
+  }
+  qsort(defs, n, sizeof(*defs), cmp_defname);
+
+  size_t hdr = b_alloc(&b, sizeof(header), IMAGE_ALIGN);
+  UPB_ASSERT_VAR(hdr, hdr == 0);
+
+  // Place every def (and every msgdef's fields) first, so that cyclic
+  // references can be resolved while writing them.
+  int indexed = 0;
+  uint64_t fingerprint = 0;
+  for (int i = 0; i < n; i++) {
+    const upb_msgdef *m = upb_dyncast_msgdef(defs[i]);
+    const upb_enumdef *e = upb_dyncast_enumdef(defs[i]);
+    if (m) {
+      b_place(&b, m, sizeof(*m));
+      upb_msg_iter j;
+      for(upb_msg_begin(&j, m); !upb_msg_done(&j); upb_msg_next(&j)) {
+        const upb_fielddef *f = upb_msg_iter_field(&j);
+        b_place(&b, f, sizeof(*f));
+      }
+      fingerprint += upb_msgdef_fingerprint(m);
+      defs[indexed++] = defs[i];
+    } else if (e) {
+      b_place(&b, e, sizeof(*e));
+      defs[indexed++] = defs[i];
+    } else {
+      upb_def_unref(defs[i], &b);
+    }
+  }
+
+  bool ok = true;
+  for (int i = 0; i < indexed && ok; i++) {
+    const upb_msgdef *m = upb_dyncast_msgdef(defs[i]);
+    if (m) {
+      ok = b_msgdef(&b, m, status);
+    } else {
+      b_enumdef(&b, upb_downcast_enumdef(defs[i]));
+    }
+  }
+
+  size_t index = b_alloc(&b, indexed * sizeof(indexent), IMAGE_ALIGN);
+  for (int i = 0; i < indexed; i++) {
+    size_t entofs = index + i * sizeof(indexent);
+    b_setptr(&b, entofs + offsetof(indexent, name),
+             b_str(&b, upb_def_fullname(defs[i])));
+    b_setptr(&b, entofs + offsetof(indexent, def), b_obj(&b, defs[i]));
+  }
+
+  header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, image_magic, sizeof(image_magic));
+  h.abi = image_abi();
+  h.fingerprint = fingerprint;
+  h.index_ofs = index;
+  h.index_count = indexed;
+  h.defs_ofs = b_ofsarray(&b, b.defs, b.defs_len);
+  h.defs_count = b.defs_len;
+  // Nothing after this adds fixups.
+  h.fixups_ofs = b_ofsarray(&b, b.fixups, b.fixups_len);
+  h.fixups_count = b.fixups_len;
+  h.size = b.len;
+  b_write(&b, 0, &h, sizeof(h));
+
+  for (int i = 0; i < indexed; i++) {
+    upb_def_unref(defs[i], &b);
+  }
+  free(defs);
+  upb_inttable_uninit(&b.objs);
+  upb_strtable_uninit(&b.strings);
+  free(b.defs);
+  free(b.fixups);
+  if (!ok) {
+    free(b.ptr);
+    return NULL;
+  }
+  if (b.oom) goto oom;
+  *len = b.len;
+  return b.ptr;
+
+oom:
+  free(b.ptr);
+  upb_status_seterrliteral(status, "out of memory");
+  return NULL;
+}
+
+
+/* Loading *******************************************************************/
+
+static bool inbounds(size_t ofs, size_t count, size_t size, size_t len) {
+  return ofs <= len && count <= (len - ofs) / size;
+}
+
+bool upb_defimage_load(void *buf, size_t len, upb_status *status) {
+  header *h = buf;
+  char *base = buf;
+  if (len < sizeof(header) ||
+      memcmp(h->magic, image_magic, sizeof(image_magic)) != 0) {
+    upb_status_seterrliteral(status, "not a upb def image");
+    return false;
+  }
+  if (h->abi != image_abi()) {
+    upb_status_seterrliteral(status,
+                             "def image was built by an incompatible upb");
+    return false;
+  }
+  if (h->loaded) return true;
+  if (h->size != len ||
+      !inbounds(h->index_ofs, h->index_count, sizeof(indexent), len) ||
+      !inbounds(h->defs_ofs, h->defs_count, sizeof(size_t), len) ||
+      !inbounds(h->fixups_ofs, h->fixups_count, sizeof(size_t), len)) {
+    upb_status_seterrliteral(status, "def image is truncated");
+    return false;
+  }
+
+  const size_t *fixups = (const size_t*)(base + h->fixups_ofs);
+  const size_t *defs = (const size_t*)(base + h->defs_ofs);
+  for (size_t i = 0; i < h->defs_count; i++) {
+    if (!inbounds(defs[i], 1, sizeof(upb_def), len)) {
+      upb_status_seterrliteral(status, "def image is corrupt");
+      return false;
+    }
+  }
+  for (size_t i = 0; i < h->fixups_count; i++) {
+    if (!inbounds(fixups[i], 1, sizeof(uintptr_t), len)) {
+      upb_status_seterrliteral(status, "def image is corrupt");
+      return false;
+    }
+  }
+  for (size_t i = 0; i < h->fixups_count; i++) {
+    *(uintptr_t*)(base + fixups[i]) += (uintptr_t)base;
+  }
+
+  upb_refcounted init = UPB_REFCOUNT_INIT;
+  for (size_t i = 0; i < h->defs_count; i++) {
+    upb_def *d = (upb_def*)(base + defs[i]);
+    d->base = init;
+  }
+
+  h->loaded = true;
+  return true;
+}
+
+void *upb_defimage_mapfile(const char *filename, size_t *len,
+                           upb_status *status) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    upb_status_seterrf(status, "couldn't open %s", filename);
+    return NULL;
+  }
+  struct stat st;
+  void *buf = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    buf = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (buf == MAP_FAILED) {
+    upb_status_seterrf(status, "couldn't map %s", filename);
+    return NULL;
+  }
+  if (!upb_defimage_load(buf, st.st_size, status)) {
+    munmap(buf, st.st_size);
+    return NULL;
+  }
+  *len = st.st_size;
+  return buf;
+}
+
+void upb_defimage_unmapfile(void *buf, size_t len) { munmap(buf, len); }
+
+
+/* Lookup ********************************************************************/
+
+uint64_t upb_defimage_fingerprint(const void *buf) {
+  const header *h = buf;
+  assert(h->loaded);
+  return h->fingerprint;
+}
+
+static int cmp_index(const void *key, const void *ent) {
+  return strcmp(key, ((const indexent*)ent)->name);
+}
+
+const upb_def *upb_defimage_lookup(const void *buf, const char *sym) {
+  const header *h = buf;
+  assert(h->loaded);
+  const indexent *e = bsearch(sym, (const char*)buf + h->index_ofs,
+                              h->index_count, sizeof(indexent), cmp_index);
+  return e ? e->def : NULL;
+}
+
+const upb_msgdef *upb_defimage_lookupmsg(const void *buf, const char *sym) {
+  const upb_def *def = upb_defimage_lookup(buf, sym);
+  return def ? upb_dyncast_msgdef(def) : NULL;
+}
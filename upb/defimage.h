@@ -0,0 +1,63 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ * Author: Josh Haberman <jhaberman@gmail.com>
+ *
+ * A def image is a compact binary serialization of the frozen defs of a
+ * upb_symtab that can be mmap'd and used in place: all pointers in the image
+ * are stored as offsets from the start of the image and are swizzled back into
+ * pointers by a single linear pass when the image is loaded.  This is the
+ * runtime analogue of the static initializers that upbc generates; like those,
+ * the loaded defs are frozen and refcounting them is a no-op.
+ *
+ * Loading an image skips parsing descriptors, building defs, resolving names
+ * and freezing, which lets a process that uses a large schema start up with a
+ * single mmap.  Images are specific to the upb build that produced them (they
+ * contain raw structs) and are rejected by upb_defimage_load() otherwise.
+ * They are not validated beyond that, so they must come from a trusted source.
+ *
+ * Each image records a fingerprint of its schema (derived from
+ * upb_msgdef_fingerprint()) so that a cached image can be checked against the
+ * schema it is meant to stand in for.
+ */
+
+#ifndef UPB_DEFIMAGE_H_
+#define UPB_DEFIMAGE_H_
+
+#include "upb/symtab.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Serializes all defs in the given symtab into a newly-allocated image, which
+// the caller owns and must free().  Returns NULL on failure and sets status (if
+// non-NULL).
+void *upb_defimage_build(const upb_symtab *s, size_t *len, upb_status *status);
+
+// Prepares an image for use in place.  "buf" must be writable (for example a
+// private mapping of the file), aligned for any type, and must outlive all
+// uses of the defs inside it.  Loading an already-loaded image is a no-op.
+// Returns false and sets status (if non-NULL) if the image is malformed or was
+// built by an incompatible version of upb.
+bool upb_defimage_load(void *buf, size_t len, upb_status *status);
+
+// Maps the given file privately and loads it.  The returned image must be
+// released with upb_defimage_unmapfile().  Returns NULL on failure.
+void *upb_defimage_mapfile(const char *filename, size_t *len,
+                           upb_status *status);
+void upb_defimage_unmapfile(void *buf, size_t len);
+
+// These require an image that has been loaded.  Lookups return NULL if the
+// symbol is not present.  Since the defs are not refcounted, no owner is
+// required; the defs live as long as the image does.
+uint64_t upb_defimage_fingerprint(const void *buf);
+const upb_def *upb_defimage_lookup(const void *buf, const char *sym);
+const upb_msgdef *upb_defimage_lookupmsg(const void *buf, const char *sym);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif  /* UPB_DEFIMAGE_H_ */
@@ -7,107 +7,109 @@
 const upb_msgdef google_protobuf_msgs[20];
 const upb_fielddef google_protobuf_fields[73];
 const upb_enumdef google_protobuf_enums[4];
+const upb_hotfield google_protobuf_hotfields[73];
+const upb_extrange google_protobuf_extranges[7];
 const upb_tabent google_protobuf_strentries[192];
 const upb_tabent google_protobuf_intentries[66];
 const _upb_value google_protobuf_arrays[97];
 
 const upb_msgdef google_protobuf_msgs[20] = {
-  UPB_MSGDEF_INIT("google.protobuf.DescriptorProto", UPB_INTTABLE_INIT(2, 3, 9, 2, &google_protobuf_intentries[0], &google_protobuf_arrays[0], 6, 5), UPB_STRTABLE_INIT(7, 15, 9, 4, &google_protobuf_strentries[0]), 33),
-  UPB_MSGDEF_INIT("google.protobuf.DescriptorProto.ExtensionRange", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[6], 4, 2), UPB_STRTABLE_INIT(2, 3, 9, 2, &google_protobuf_strentries[16]), 4),
-  UPB_MSGDEF_INIT("google.protobuf.EnumDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[10], 4, 3), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[20]), 13),
-  UPB_MSGDEF_INIT("google.protobuf.EnumOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[4], &google_protobuf_arrays[14], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[24]), 7),
-  UPB_MSGDEF_INIT("google.protobuf.EnumValueDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[15], 4, 3), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[28]), 9),
-  UPB_MSGDEF_INIT("google.protobuf.EnumValueOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[6], &google_protobuf_arrays[19], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[32]), 7),
-  UPB_MSGDEF_INIT("google.protobuf.FieldDescriptorProto", UPB_INTTABLE_INIT(3, 3, 9, 2, &google_protobuf_intentries[8], &google_protobuf_arrays[20], 6, 5), UPB_STRTABLE_INIT(8, 15, 9, 4, &google_protobuf_strentries[36]), 20),
-  UPB_MSGDEF_INIT("google.protobuf.FieldOptions", UPB_INTTABLE_INIT(2, 3, 9, 2, &google_protobuf_intentries[12], &google_protobuf_arrays[26], 5, 3), UPB_STRTABLE_INIT(5, 7, 9, 3, &google_protobuf_strentries[52]), 13),
-  UPB_MSGDEF_INIT("google.protobuf.FileDescriptorProto", UPB_INTTABLE_INIT(4, 7, 9, 3, &google_protobuf_intentries[16], &google_protobuf_arrays[31], 6, 5), UPB_STRTABLE_INIT(9, 15, 9, 4, &google_protobuf_strentries[60]), 39),
-  UPB_MSGDEF_INIT("google.protobuf.FileDescriptorSet", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[37], 3, 1), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[76]), 7),
-  UPB_MSGDEF_INIT("google.protobuf.FileOptions", UPB_INTTABLE_INIT(8, 15, 9, 4, &google_protobuf_intentries[24], &google_protobuf_arrays[40], 6, 1), UPB_STRTABLE_INIT(9, 15, 9, 4, &google_protobuf_strentries[80]), 19),
-  UPB_MSGDEF_INIT("google.protobuf.MessageOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[40], &google_protobuf_arrays[46], 4, 2), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[96]), 9),
-  UPB_MSGDEF_INIT("google.protobuf.MethodDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[50], 5, 4), UPB_STRTABLE_INIT(4, 7, 9, 3, &google_protobuf_strentries[100]), 14),
-  UPB_MSGDEF_INIT("google.protobuf.MethodOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[42], &google_protobuf_arrays[55], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[108]), 7),
-  UPB_MSGDEF_INIT("google.protobuf.ServiceDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[56], 4, 3), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[112]), 13),
-  UPB_MSGDEF_INIT("google.protobuf.ServiceOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[44], &google_protobuf_arrays[60], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[116]), 7),
-  UPB_MSGDEF_INIT("google.protobuf.SourceCodeInfo", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[61], 3, 1), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[120]), 7),
-  UPB_MSGDEF_INIT("google.protobuf.SourceCodeInfo.Location", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[64], 4, 2), UPB_STRTABLE_INIT(2, 3, 9, 2, &google_protobuf_strentries[124]), 8),
-  UPB_MSGDEF_INIT("google.protobuf.UninterpretedOption", UPB_INTTABLE_INIT(3, 3, 9, 2, &google_protobuf_intentries[46], &google_protobuf_arrays[68], 6, 4), UPB_STRTABLE_INIT(7, 15, 9, 4, &google_protobuf_strentries[128]), 19),
-  UPB_MSGDEF_INIT("google.protobuf.UninterpretedOption.NamePart", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[74], 4, 2), UPB_STRTABLE_INIT(2, 3, 9, 2, &google_protobuf_strentries[144]), 6),
+  UPB_MSGDEF_INIT("google.protobuf.DescriptorProto", UPB_INTTABLE_INIT(2, 3, 9, 2, &google_protobuf_intentries[0], &google_protobuf_arrays[0], 6, 5), UPB_STRTABLE_INIT(7, 15, 9, 4, &google_protobuf_strentries[0]), &google_protobuf_hotfields[0], 7, 33, 0x983463a580748cbaULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.DescriptorProto.ExtensionRange", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[6], 4, 2), UPB_STRTABLE_INIT(2, 3, 9, 2, &google_protobuf_strentries[16]), &google_protobuf_hotfields[7], 2, 4, 0x089b2df6e45b3ca8ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.EnumDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[10], 4, 3), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[20]), &google_protobuf_hotfields[9], 3, 13, 0x448cbabcf7faf736ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.EnumOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[4], &google_protobuf_arrays[14], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[24]), &google_protobuf_hotfields[12], 1, 7, 0x1a24ca94fc1bd61fULL, false, &google_protobuf_extranges[0], 1, 0),
+  UPB_MSGDEF_INIT("google.protobuf.EnumValueDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[15], 4, 3), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[28]), &google_protobuf_hotfields[13], 3, 9, 0x6c12efa910a9842dULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.EnumValueOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[6], &google_protobuf_arrays[19], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[32]), &google_protobuf_hotfields[16], 1, 7, 0x8066f43dc25c903eULL, false, &google_protobuf_extranges[1], 1, 0),
+  UPB_MSGDEF_INIT("google.protobuf.FieldDescriptorProto", UPB_INTTABLE_INIT(3, 3, 9, 2, &google_protobuf_intentries[8], &google_protobuf_arrays[20], 6, 5), UPB_STRTABLE_INIT(8, 15, 9, 4, &google_protobuf_strentries[36]), &google_protobuf_hotfields[17], 8, 20, 0x8a9c30fd712aa982ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.FieldOptions", UPB_INTTABLE_INIT(2, 3, 9, 2, &google_protobuf_intentries[12], &google_protobuf_arrays[26], 5, 3), UPB_STRTABLE_INIT(5, 7, 9, 3, &google_protobuf_strentries[52]), &google_protobuf_hotfields[25], 5, 13, 0x31d5825ceb20a260ULL, false, &google_protobuf_extranges[2], 1, 0),
+  UPB_MSGDEF_INIT("google.protobuf.FileDescriptorProto", UPB_INTTABLE_INIT(4, 7, 9, 3, &google_protobuf_intentries[16], &google_protobuf_arrays[31], 6, 5), UPB_STRTABLE_INIT(9, 15, 9, 4, &google_protobuf_strentries[60]), &google_protobuf_hotfields[30], 9, 39, 0x2524532fc4e2254bULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.FileDescriptorSet", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[37], 3, 1), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[76]), &google_protobuf_hotfields[39], 1, 7, 0x599aa0e46c1d3e7cULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.FileOptions", UPB_INTTABLE_INIT(8, 15, 9, 4, &google_protobuf_intentries[24], &google_protobuf_arrays[40], 6, 1), UPB_STRTABLE_INIT(9, 15, 9, 4, &google_protobuf_strentries[80]), &google_protobuf_hotfields[40], 9, 19, 0x30f7eea55a617b4cULL, false, &google_protobuf_extranges[3], 1, 0),
+  UPB_MSGDEF_INIT("google.protobuf.MessageOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[40], &google_protobuf_arrays[46], 4, 2), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[96]), &google_protobuf_hotfields[49], 3, 9, 0x099db54ddbbeb0d9ULL, false, &google_protobuf_extranges[4], 1, 0),
+  UPB_MSGDEF_INIT("google.protobuf.MethodDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[50], 5, 4), UPB_STRTABLE_INIT(4, 7, 9, 3, &google_protobuf_strentries[100]), &google_protobuf_hotfields[52], 4, 14, 0x5b441b94a0cc6278ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.MethodOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[42], &google_protobuf_arrays[55], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[108]), &google_protobuf_hotfields[56], 1, 7, 0x63ee2f32a97e16ceULL, false, &google_protobuf_extranges[5], 1, 0),
+  UPB_MSGDEF_INIT("google.protobuf.ServiceDescriptorProto", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[56], 4, 3), UPB_STRTABLE_INIT(3, 3, 9, 2, &google_protobuf_strentries[112]), &google_protobuf_hotfields[57], 3, 13, 0x68e4e9be0162b069ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.ServiceOptions", UPB_INTTABLE_INIT(1, 1, 9, 1, &google_protobuf_intentries[44], &google_protobuf_arrays[60], 1, 0), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[116]), &google_protobuf_hotfields[60], 1, 7, 0x051d69ac281dbe81ULL, false, &google_protobuf_extranges[6], 1, 0),
+  UPB_MSGDEF_INIT("google.protobuf.SourceCodeInfo", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[61], 3, 1), UPB_STRTABLE_INIT(1, 3, 9, 2, &google_protobuf_strentries[120]), &google_protobuf_hotfields[61], 1, 7, 0x6075d18aec09e077ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.SourceCodeInfo.Location", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[64], 4, 2), UPB_STRTABLE_INIT(2, 3, 9, 2, &google_protobuf_strentries[124]), &google_protobuf_hotfields[62], 2, 8, 0x102113f0e4f4d235ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.UninterpretedOption", UPB_INTTABLE_INIT(3, 3, 9, 2, &google_protobuf_intentries[46], &google_protobuf_arrays[68], 6, 4), UPB_STRTABLE_INIT(7, 15, 9, 4, &google_protobuf_strentries[128]), &google_protobuf_hotfields[64], 7, 19, 0xedc7edb0ec53b6a1ULL, false, NULL, 0, 0),
+  UPB_MSGDEF_INIT("google.protobuf.UninterpretedOption.NamePart", UPB_INTTABLE_INIT(0, 0, 9, 0, NULL, &google_protobuf_arrays[74], 4, 2), UPB_STRTABLE_INIT(2, 3, 9, 2, &google_protobuf_strentries[144]), &google_protobuf_hotfields[71], 2, 6, 0x4eeda03947a8699aULL, false, NULL, 0, 0),
 };
 
 const upb_fielddef google_protobuf_fields[73] = {
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "aggregate_value", 8, &google_protobuf_msgs[18], NULL, 12, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "cc_generic_services", 16, &google_protobuf_msgs[10], NULL, 5, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "ctype", 1, &google_protobuf_msgs[7], upb_upcast(&google_protobuf_enums[2]), 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "default_value", 7, &google_protobuf_msgs[6], NULL, 17, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_STRING, 0, false, "dependency", 3, &google_protobuf_msgs[8], NULL, 10, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "deprecated", 3, &google_protobuf_msgs[7], NULL, 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_DOUBLE, 0, false, "double_value", 6, &google_protobuf_msgs[18], NULL, 15, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "end", 2, &google_protobuf_msgs[1], NULL, 3, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "enum_type", 4, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[2]), 17, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "enum_type", 5, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[2]), 20, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "experimental_map_key", 9, &google_protobuf_msgs[7], NULL, 5, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "extendee", 2, &google_protobuf_msgs[6], NULL, 5, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "extension", 7, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[6]), 36, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "extension", 6, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[6]), 27, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "extension_range", 5, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[1]), 22, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "field", 2, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[6]), 7, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "file", 1, &google_protobuf_msgs[9], upb_upcast(&google_protobuf_msgs[8]), 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "identifier_value", 3, &google_protobuf_msgs[18], NULL, 7, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "input_type", 2, &google_protobuf_msgs[12], NULL, 5, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REQUIRED, UPB_TYPE_BOOL, 0, false, "is_extension", 2, &google_protobuf_msgs[19], NULL, 5, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "java_generate_equals_and_hash", 20, &google_protobuf_msgs[10], NULL, 8, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "java_generic_services", 17, &google_protobuf_msgs[10], NULL, 6, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "java_multiple_files", 10, &google_protobuf_msgs[10], NULL, 18, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "java_outer_classname", 8, &google_protobuf_msgs[10], NULL, 14, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "java_package", 1, &google_protobuf_msgs[10], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "label", 4, &google_protobuf_msgs[6], upb_upcast(&google_protobuf_enums[0]), 9, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "location", 1, &google_protobuf_msgs[16], upb_upcast(&google_protobuf_msgs[17]), 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "message_set_wire_format", 1, &google_protobuf_msgs[11], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "message_type", 4, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[0]), 15, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "method", 2, &google_protobuf_msgs[14], upb_upcast(&google_protobuf_msgs[12]), 7, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[12], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[4], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[14], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[2], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[6], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "name", 2, &google_protobuf_msgs[18], upb_upcast(&google_protobuf_msgs[19]), 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[0], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[8], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REQUIRED, UPB_TYPE_STRING, 0, false, "name_part", 1, &google_protobuf_msgs[19], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT64, UPB_INTFMT_VARIABLE, false, "negative_int_value", 5, &google_protobuf_msgs[18], NULL, 11, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "nested_type", 3, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[0]), 12, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "no_standard_descriptor_accessor", 2, &google_protobuf_msgs[11], NULL, 3, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "number", 2, &google_protobuf_msgs[4], NULL, 5, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "number", 3, &google_protobuf_msgs[6], NULL, 8, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "optimize_for", 9, &google_protobuf_msgs[10], upb_upcast(&google_protobuf_enums[3]), 17, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 4, &google_protobuf_msgs[12], upb_upcast(&google_protobuf_msgs[13]), 11, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 3, &google_protobuf_msgs[14], upb_upcast(&google_protobuf_msgs[15]), 10, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 8, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[10]), 23, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 3, &google_protobuf_msgs[2], upb_upcast(&google_protobuf_msgs[3]), 10, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 7, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[11]), 30, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 8, &google_protobuf_msgs[6], upb_upcast(&google_protobuf_msgs[7]), 11, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 3, &google_protobuf_msgs[4], upb_upcast(&google_protobuf_msgs[5]), 6, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "output_type", 3, &google_protobuf_msgs[12], NULL, 8, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "package", 2, &google_protobuf_msgs[8], NULL, 5, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "packed", 2, &google_protobuf_msgs[7], NULL, 3, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "path", 1, &google_protobuf_msgs[17], NULL, 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_UINT64, UPB_INTFMT_VARIABLE, false, "positive_int_value", 4, &google_protobuf_msgs[18], NULL, 10, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "py_generic_services", 18, &google_protobuf_msgs[10], NULL, 7, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "service", 6, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[14]), 31, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "source_code_info", 9, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[16]), 26, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "span", 2, &google_protobuf_msgs[17], NULL, 7, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "start", 1, &google_protobuf_msgs[1], NULL, 2, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BYTES, 0, false, "string_value", 7, &google_protobuf_msgs[18], NULL, 16, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "type", 5, &google_protobuf_msgs[6], upb_upcast(&google_protobuf_enums[1]), 10, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "type_name", 6, &google_protobuf_msgs[6], NULL, 14, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[15], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[11], upb_upcast(&google_protobuf_msgs[18]), 6, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[13], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[10], upb_upcast(&google_protobuf_msgs[18]), 11, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[7], upb_upcast(&google_protobuf_msgs[18]), 10, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[3], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[5], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE),
-  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "value", 2, &google_protobuf_msgs[2], upb_upcast(&google_protobuf_msgs[4]), 7, UPB_VALUE_INIT_NONE),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "aggregate_value", 8, &google_protobuf_msgs[18], NULL, 16, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "cc_generic_services", 16, &google_protobuf_msgs[10], NULL, 10, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "ctype", 1, &google_protobuf_msgs[7], upb_upcast(&google_protobuf_enums[2]), 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "default_value", 7, &google_protobuf_msgs[6], NULL, 14, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_STRING, 0, false, "dependency", 3, &google_protobuf_msgs[8], NULL, 10, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "deprecated", 3, &google_protobuf_msgs[7], NULL, 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_DOUBLE, 0, false, "double_value", 6, &google_protobuf_msgs[18], NULL, 12, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "end", 2, &google_protobuf_msgs[1], NULL, 3, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "enum_type", 4, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[2]), 17, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "enum_type", 5, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[2]), 20, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "experimental_map_key", 9, &google_protobuf_msgs[7], NULL, 5, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "extendee", 2, &google_protobuf_msgs[6], NULL, 5, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "extension", 7, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[6]), 30, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "extension", 6, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[6]), 27, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "extension_range", 5, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[1]), 22, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "field", 2, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[6]), 7, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "file", 1, &google_protobuf_msgs[9], upb_upcast(&google_protobuf_msgs[8]), 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "identifier_value", 3, &google_protobuf_msgs[18], NULL, 7, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "input_type", 2, &google_protobuf_msgs[12], NULL, 5, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REQUIRED, UPB_TYPE_BOOL, 0, false, "is_extension", 2, &google_protobuf_msgs[19], NULL, 5, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "java_generate_equals_and_hash", 20, &google_protobuf_msgs[10], NULL, 13, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "java_generic_services", 17, &google_protobuf_msgs[10], NULL, 11, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "java_multiple_files", 10, &google_protobuf_msgs[10], NULL, 9, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "java_outer_classname", 8, &google_protobuf_msgs[10], NULL, 5, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "java_package", 1, &google_protobuf_msgs[10], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "label", 4, &google_protobuf_msgs[6], upb_upcast(&google_protobuf_enums[0]), 9, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "location", 1, &google_protobuf_msgs[16], upb_upcast(&google_protobuf_msgs[17]), 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "message_set_wire_format", 1, &google_protobuf_msgs[11], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "message_type", 4, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[0]), 15, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "method", 2, &google_protobuf_msgs[14], upb_upcast(&google_protobuf_msgs[12]), 7, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[12], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[4], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[14], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[2], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[6], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "name", 2, &google_protobuf_msgs[18], upb_upcast(&google_protobuf_msgs[19]), 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[0], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "name", 1, &google_protobuf_msgs[8], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REQUIRED, UPB_TYPE_STRING, 0, false, "name_part", 1, &google_protobuf_msgs[19], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT64, UPB_INTFMT_VARIABLE, false, "negative_int_value", 5, &google_protobuf_msgs[18], NULL, 11, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "nested_type", 3, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[0]), 12, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "no_standard_descriptor_accessor", 2, &google_protobuf_msgs[11], NULL, 3, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "number", 2, &google_protobuf_msgs[4], NULL, 5, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "number", 3, &google_protobuf_msgs[6], NULL, 8, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "optimize_for", 9, &google_protobuf_msgs[10], upb_upcast(&google_protobuf_enums[3]), 8, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 4, &google_protobuf_msgs[12], upb_upcast(&google_protobuf_msgs[13]), 11, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 3, &google_protobuf_msgs[14], upb_upcast(&google_protobuf_msgs[15]), 10, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 8, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[10]), 33, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 3, &google_protobuf_msgs[2], upb_upcast(&google_protobuf_msgs[3]), 10, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 7, &google_protobuf_msgs[0], upb_upcast(&google_protobuf_msgs[11]), 30, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 8, &google_protobuf_msgs[6], upb_upcast(&google_protobuf_msgs[7]), 17, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "options", 3, &google_protobuf_msgs[4], upb_upcast(&google_protobuf_msgs[5]), 6, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "output_type", 3, &google_protobuf_msgs[12], NULL, 8, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "package", 2, &google_protobuf_msgs[8], NULL, 5, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "packed", 2, &google_protobuf_msgs[7], NULL, 3, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "path", 1, &google_protobuf_msgs[17], NULL, 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_UINT64, UPB_INTFMT_VARIABLE, false, "positive_int_value", 4, &google_protobuf_msgs[18], NULL, 10, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BOOL, 0, false, "py_generic_services", 18, &google_protobuf_msgs[10], NULL, 12, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "service", 6, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[14]), 25, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_MESSAGE, 0, false, "source_code_info", 9, &google_protobuf_msgs[8], upb_upcast(&google_protobuf_msgs[16]), 36, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "span", 2, &google_protobuf_msgs[17], NULL, 7, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_INT32, UPB_INTFMT_VARIABLE, false, "start", 1, &google_protobuf_msgs[1], NULL, 2, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_BYTES, 0, false, "string_value", 7, &google_protobuf_msgs[18], NULL, 13, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_ENUM, 0, false, "type", 5, &google_protobuf_msgs[6], upb_upcast(&google_protobuf_enums[1]), 10, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_OPTIONAL, UPB_TYPE_STRING, 0, false, "type_name", 6, &google_protobuf_msgs[6], NULL, 11, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[15], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[11], upb_upcast(&google_protobuf_msgs[18]), 6, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[13], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[10], upb_upcast(&google_protobuf_msgs[18]), 16, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[7], upb_upcast(&google_protobuf_msgs[18]), 10, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[3], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "uninterpreted_option", 999, &google_protobuf_msgs[5], upb_upcast(&google_protobuf_msgs[18]), 4, UPB_VALUE_INIT_NONE, false, NULL),
+  UPB_FIELDDEF_INIT(UPB_LABEL_REPEATED, UPB_TYPE_MESSAGE, 0, false, "value", 2, &google_protobuf_msgs[2], upb_upcast(&google_protobuf_msgs[4]), 7, UPB_VALUE_INIT_NONE, false, NULL),
 };
 
 const upb_enumdef google_protobuf_enums[4] = {
@@ -117,6 +119,92 @@ const upb_enumdef google_protobuf_enums[4] = {
   UPB_ENUMDEF_INIT("google.protobuf.FileOptions.OptimizeMode", UPB_STRTABLE_INIT(3, 3, 1, 2, &google_protobuf_strentries[188]), UPB_INTTABLE_INIT(0, 0, 8, 0, NULL, &google_protobuf_arrays[93], 4, 3), 0),
 };
 
+const upb_hotfield google_protobuf_hotfields[73] = {
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[36]),
+  UPB_HOTFIELD_INIT(2, 7, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[6]), &google_protobuf_fields[15]),
+  UPB_HOTFIELD_INIT(3, 12, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[0]), &google_protobuf_fields[40]),
+  UPB_HOTFIELD_INIT(4, 17, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[2]), &google_protobuf_fields[8]),
+  UPB_HOTFIELD_INIT(5, 22, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[1]), &google_protobuf_fields[14]),
+  UPB_HOTFIELD_INIT(6, 27, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[6]), &google_protobuf_fields[13]),
+  UPB_HOTFIELD_INIT(7, 30, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[11]), &google_protobuf_fields[49]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_INT32, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[61]),
+  UPB_HOTFIELD_INIT(2, 3, UPB_DESCRIPTOR_TYPE_INT32, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[7]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[33]),
+  UPB_HOTFIELD_INIT(2, 7, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[4]), &google_protobuf_fields[72]),
+  UPB_HOTFIELD_INIT(3, 10, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[3]), &google_protobuf_fields[48]),
+  UPB_HOTFIELD_INIT(999, 4, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[18]), &google_protobuf_fields[70]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[31]),
+  UPB_HOTFIELD_INIT(2, 5, UPB_DESCRIPTOR_TYPE_INT32, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[42]),
+  UPB_HOTFIELD_INIT(3, 6, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[5]), &google_protobuf_fields[51]),
+  UPB_HOTFIELD_INIT(999, 4, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[18]), &google_protobuf_fields[71]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[34]),
+  UPB_HOTFIELD_INIT(2, 5, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[11]),
+  UPB_HOTFIELD_INIT(3, 8, UPB_DESCRIPTOR_TYPE_INT32, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[43]),
+  UPB_HOTFIELD_INIT(4, 9, UPB_DESCRIPTOR_TYPE_ENUM, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_enums[0]), &google_protobuf_fields[25]),
+  UPB_HOTFIELD_INIT(5, 10, UPB_DESCRIPTOR_TYPE_ENUM, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_enums[1]), &google_protobuf_fields[63]),
+  UPB_HOTFIELD_INIT(6, 11, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[64]),
+  UPB_HOTFIELD_INIT(7, 14, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[3]),
+  UPB_HOTFIELD_INIT(8, 17, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[7]), &google_protobuf_fields[50]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_ENUM, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_enums[2]), &google_protobuf_fields[2]),
+  UPB_HOTFIELD_INIT(2, 3, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[54]),
+  UPB_HOTFIELD_INIT(3, 4, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[5]),
+  UPB_HOTFIELD_INIT(9, 5, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[10]),
+  UPB_HOTFIELD_INIT(999, 10, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[18]), &google_protobuf_fields[69]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[37]),
+  UPB_HOTFIELD_INIT(2, 5, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[53]),
+  UPB_HOTFIELD_INIT(3, 10, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_REPEATED, 0, NULL, &google_protobuf_fields[4]),
+  UPB_HOTFIELD_INIT(4, 15, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[0]), &google_protobuf_fields[28]),
+  UPB_HOTFIELD_INIT(5, 20, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[2]), &google_protobuf_fields[9]),
+  UPB_HOTFIELD_INIT(6, 25, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[14]), &google_protobuf_fields[58]),
+  UPB_HOTFIELD_INIT(7, 30, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[6]), &google_protobuf_fields[12]),
+  UPB_HOTFIELD_INIT(8, 33, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[10]), &google_protobuf_fields[47]),
+  UPB_HOTFIELD_INIT(9, 36, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[16]), &google_protobuf_fields[59]),
+  UPB_HOTFIELD_INIT(1, 4, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[8]), &google_protobuf_fields[16]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[24]),
+  UPB_HOTFIELD_INIT(8, 5, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[23]),
+  UPB_HOTFIELD_INIT(9, 8, UPB_DESCRIPTOR_TYPE_ENUM, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_enums[3]), &google_protobuf_fields[44]),
+  UPB_HOTFIELD_INIT(10, 9, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[22]),
+  UPB_HOTFIELD_INIT(16, 10, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[1]),
+  UPB_HOTFIELD_INIT(17, 11, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[21]),
+  UPB_HOTFIELD_INIT(18, 12, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[57]),
+  UPB_HOTFIELD_INIT(20, 13, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[20]),
+  UPB_HOTFIELD_INIT(999, 16, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[18]), &google_protobuf_fields[68]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[27]),
+  UPB_HOTFIELD_INIT(2, 3, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[41]),
+  UPB_HOTFIELD_INIT(999, 6, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[18]), &google_protobuf_fields[66]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[30]),
+  UPB_HOTFIELD_INIT(2, 5, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[18]),
+  UPB_HOTFIELD_INIT(3, 8, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[52]),
+  UPB_HOTFIELD_INIT(4, 11, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[13]), &google_protobuf_fields[45]),
+  UPB_HOTFIELD_INIT(999, 4, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[18]), &google_protobuf_fields[67]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[32]),
+  UPB_HOTFIELD_INIT(2, 7, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[12]), &google_protobuf_fields[29]),
+  UPB_HOTFIELD_INIT(3, 10, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_OPTIONAL, 0, upb_upcast(&google_protobuf_msgs[15]), &google_protobuf_fields[46]),
+  UPB_HOTFIELD_INIT(999, 4, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[18]), &google_protobuf_fields[65]),
+  UPB_HOTFIELD_INIT(1, 4, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[17]), &google_protobuf_fields[26]),
+  UPB_HOTFIELD_INIT(1, 4, UPB_DESCRIPTOR_TYPE_INT32, UPB_LABEL_REPEATED, 0, NULL, &google_protobuf_fields[55]),
+  UPB_HOTFIELD_INIT(2, 7, UPB_DESCRIPTOR_TYPE_INT32, UPB_LABEL_REPEATED, 0, NULL, &google_protobuf_fields[60]),
+  UPB_HOTFIELD_INIT(2, 4, UPB_DESCRIPTOR_TYPE_MESSAGE, UPB_LABEL_REPEATED, 0, upb_upcast(&google_protobuf_msgs[19]), &google_protobuf_fields[35]),
+  UPB_HOTFIELD_INIT(3, 7, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[17]),
+  UPB_HOTFIELD_INIT(4, 10, UPB_DESCRIPTOR_TYPE_UINT64, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[56]),
+  UPB_HOTFIELD_INIT(5, 11, UPB_DESCRIPTOR_TYPE_INT64, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[39]),
+  UPB_HOTFIELD_INIT(6, 12, UPB_DESCRIPTOR_TYPE_DOUBLE, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[6]),
+  UPB_HOTFIELD_INIT(7, 13, UPB_DESCRIPTOR_TYPE_BYTES, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[62]),
+  UPB_HOTFIELD_INIT(8, 16, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_OPTIONAL, 0, NULL, &google_protobuf_fields[0]),
+  UPB_HOTFIELD_INIT(1, 2, UPB_DESCRIPTOR_TYPE_STRING, UPB_LABEL_REQUIRED, 0, NULL, &google_protobuf_fields[38]),
+  UPB_HOTFIELD_INIT(2, 5, UPB_DESCRIPTOR_TYPE_BOOL, UPB_LABEL_REQUIRED, 1, NULL, &google_protobuf_fields[19]),
+};
+
+const upb_extrange google_protobuf_extranges[7] = {
+  {1000, 536870912},
+  {1000, 536870912},
+  {1000, 536870912},
+  {1000, 536870912},
+  {1000, 536870912},
+  {1000, 536870912},
+  {1000, 536870912},
+};
+
 const upb_tabent google_protobuf_strentries[192] = {
   {UPB_TABKEY_STR("extension"), UPB_VALUE_INIT_CONSTPTR(&google_protobuf_fields[13]), NULL},
   {UPB_TABKEY_NONE, UPB__VALUE_INIT_NONE, NULL},
@@ -128,6 +128,7 @@ struct upb_descreader {
   int stack_len;
 
   uint32_t number;
+  uint32_t end;  // Of an extension range, whose start is in "number".
   char *name;
   bool saw_number;
   bool saw_name;
@@ -137,7 +138,7 @@ struct upb_descreader {
   upb_fielddef *f;
 };
 
-void upb_descreader_init(void *self, upb_pipeline *p);
+bool upb_descreader_init(void *self, upb_pipeline *p);
 void upb_descreader_uninit(void *self);
 
 const upb_frametype upb_descreader_frametype = {
@@ -158,12 +159,13 @@ const upb_handlers *upb_descreader_gethandlers(const void *owner);
 
 /* upb_descreader  ************************************************************/
 
-void upb_descreader_init(void *self, upb_pipeline *pipeline) {
+bool upb_descreader_init(void *self, upb_pipeline *pipeline) {
   upb_descreader *r = self;
   upb_deflist_init(&r->defs, pipeline);
   r->stack_len = 0;
   r->name = NULL;
   r->default_string = NULL;
+  return true;
 }
 
 void upb_descreader_uninit(void *self) {
@@ -468,6 +470,17 @@ static size_t field_ontypename(void *closure, const void *hd, const char *buf,
   return n;
 }
 
+static size_t field_onextendee(void *closure, const void *hd, const char *buf,
+                               size_t n) {
+  UPB_UNUSED(hd);
+  upb_descreader *r = closure;
+  // XXX: see comment at the top of the file.
+  char *name = upb_strndup(buf, n);
+  upb_fielddef_setcontainingtypename(r->f, name, NULL);
+  free(name);
+  return n;
+}
+
 static size_t field_ondefaultval(void *closure, const void *hd,
                                  const char *buf, size_t n) {
   UPB_UNUSED(hd);
@@ -522,15 +535,48 @@ static bool msg_onendfield(void *closure, const void *hd) {
   return true;
 }
 
-static bool discardfield(void *closure, const void *hd) {
+// Extensions become defs of their own, qualified by the scope they are
+// declared in; upb_symtab_add() adds them to the messages they extend.
+static bool onendextension(void *closure, const void *hd) {
   UPB_UNUSED(hd);
   upb_descreader *r = closure;
-  // Discard extension field so we don't leak it.
-  upb_fielddef_unref(r->f, &r->defs);
+  upb_fielddef_setisextension(r->f, true);
+  upb_deflist_push(&r->defs, upb_upcast(r->f));
   r->f = NULL;
   return true;
 }
 
+// Handlers for google.protobuf.DescriptorProto.ExtensionRange.
+static bool extrange_startmsg(void *closure, const void *hd) {
+  UPB_UNUSED(hd);
+  upb_descreader *r = closure;
+  r->number = 0;
+  r->end = 0;
+  return true;
+}
+
+static bool extrange_onstart(void *closure, const void *hd, int32_t val) {
+  UPB_UNUSED(hd);
+  upb_descreader *r = closure;
+  r->number = val;
+  return true;
+}
+
+static bool extrange_onend(void *closure, const void *hd, int32_t val) {
+  UPB_UNUSED(hd);
+  upb_descreader *r = closure;
+  r->end = val;
+  return true;
+}
+
+static bool extrange_endmsg(void *closure, const void *hd,
+                            upb_status *status) {
+  UPB_UNUSED(hd);
+  upb_descreader *r = closure;
+  return upb_msgdef_addextrange(upb_descreader_top(r), r->number, r->end,
+                                status);
+}
+
 static const upb_fielddef *f(const upb_handlers *h, const char *name) {
   const upb_fielddef *ret = upb_msgdef_ntof(upb_handlers_msgdef(h), name);
   assert(ret);
@@ -546,14 +592,19 @@ static void reghandlers(void *closure, upb_handlers *h) {
     upb_handlers_setendmsg(h, &msg_endmsg, NULL, NULL);
     upb_handlers_setstring(h,    f(h, "name"),  &msg_onname, NULL, NULL);
     upb_handlers_setendsubmsg(h, f(h, "field"), &msg_onendfield, NULL, NULL);
-    // TODO: support extensions
-    upb_handlers_setendsubmsg(h, f(h, "extension"), &discardfield, NULL, NULL);
+    upb_handlers_setendsubmsg(h, f(h, "extension"), &onendextension, NULL,
+                              NULL);
+  } else if (m == GOOGLE_PROTOBUF_DESCRIPTORPROTO_EXTENSIONRANGE) {
+    upb_handlers_setstartmsg(h, &extrange_startmsg, NULL, NULL);
+    upb_handlers_setendmsg(h, &extrange_endmsg, NULL, NULL);
+    upb_handlers_setint32(h, f(h, "start"), &extrange_onstart, NULL, NULL);
+    upb_handlers_setint32(h, f(h, "end"),   &extrange_onend, NULL, NULL);
   } else if (m == GOOGLE_PROTOBUF_FILEDESCRIPTORPROTO) {
     upb_handlers_setstartmsg(h, &file_startmsg, NULL, NULL);
     upb_handlers_setendmsg(h, &file_endmsg, NULL, NULL);
     upb_handlers_setstring(h, f(h, "package"), &file_onpackage, NULL, NULL);
-    // TODO: support extensions
-    upb_handlers_setendsubmsg(h, f(h, "extension"), &discardfield, NULL, NULL);
+    upb_handlers_setendsubmsg(h, f(h, "extension"), &onendextension, NULL,
+                              NULL);
   } else if (m == GOOGLE_PROTOBUF_ENUMVALUEDESCRIPTORPROTO) {
     upb_handlers_setstartmsg(h, &enumval_startmsg, NULL, NULL);
     upb_handlers_setendmsg(h, &enumval_endmsg, NULL, NULL);
@@ -571,6 +622,7 @@ static void reghandlers(void *closure, upb_handlers *h) {
     upb_handlers_setint32 (h, f(h, "number"),    &field_onnumber, NULL, NULL);
     upb_handlers_setstring(h, f(h, "name"),      &field_onname, NULL, NULL);
     upb_handlers_setstring(h, f(h, "type_name"), &field_ontypename, NULL, NULL);
+    upb_handlers_setstring(h, f(h, "extendee"),  &field_onextendee, NULL, NULL);
     upb_handlers_setstring(h, f(h, "default_value"), &field_ondefaultval, NULL,
                            NULL);
   }
@@ -47,10 +47,9 @@ class me::Defs {
     for (upb::MessageDef::ConstIterator i(md); !i.Done(); i.Next()) {
       const upb::FieldDef* upb_f = i.field();
       const goog::FieldDescriptor* proto2_f =
-          d->FindFieldByNumber(upb_f->number());
-      if (!proto2_f) {
-        proto2_f = d->file()->pool()->FindExtensionByNumber(d, upb_f->number());
-      }
+          upb_f->is_extension()
+              ? d->file()->pool()->FindExtensionByNumber(d, upb_f->number())
+              : d->FindFieldByNumber(upb_f->number());
       assert(proto2_f);
       if (!upb::google::TrySetWriteHandlers(proto2_f, m, upb_f, h)
 #ifdef UPB_GOOGLE3
@@ -125,7 +124,9 @@ FieldDef* AddFieldDef(const goog::Message& m, const goog::FieldDescriptor* f,
   upb::FieldDef* upb_f = upb::FieldDef::New(&upb_f);
   upb::Status status;
   upb_f->set_number(f->number(), &status);
-  upb_f->set_name(f->name(), &status);
+  // Extensions use their full name, which cannot clash with a field's.
+  upb_f->set_name(f->is_extension() ? f->full_name() : f->name(), &status);
+  upb_f->set_is_extension(f->is_extension());
   upb_f->set_label(upb::FieldDef::ConvertLabel(f->label()));
   upb_f->set_descriptor_type(
       weak_prototype ? UPB_DESCRIPTOR_TYPE_MESSAGE
@@ -211,6 +212,11 @@ static upb::MessageDef* NewMessageDef(const goog::Message& m, const void* owner,
   upb::Status status;
   md->set_full_name(m.GetDescriptor()->full_name(), &status);
 
+  for (int i = 0; i < d->extension_range_count(); i++) {
+    const goog::Descriptor::ExtensionRange* r = d->extension_range(i);
+    md->AddExtensionRange(r->start, r->end, &status);
+  }
+
   // Must do this before processing submessages to prevent infinite recursion.
   defs->AddMessage(&m, md);
 
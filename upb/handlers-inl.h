@@ -455,6 +455,13 @@ inline bool Handlers::SetEndSequenceHandler(const FieldDef *f,
   return upb_handlers_setendseq(this, f, handler.handler_, handler.data_,
                                 handler.cleanup_);
 }
+inline bool Handlers::SetMapEntryHandler(const FieldDef *f,
+                                         const MapEntryHandler &handler) {
+  assert(!handler.registered_);
+  handler.registered_ = true;
+  return upb_handlers_setmapentry(this, f, handler.handler_, handler.data_,
+                                  handler.cleanup_);
+}
 inline bool Handlers::SetSubHandlers(const FieldDef *f, const Handlers *sub) {
   return upb_handlers_setsubhandlers(this, f, sub);
 }
@@ -478,6 +485,15 @@ inline Handlers::GenericFunction *Handlers::GetHandler(
 inline const void *Handlers::GetHandlerData(Handlers::Selector selector) {
   return upb_handlers_gethandlerdata(this, selector);
 }
+inline bool Handlers::HasHandler(Handlers::Selector selector) const {
+  return upb_handlers_hashandler(this, selector);
+}
+inline uint32_t Handlers::MaxDepth() const {
+  return upb_handlers_maxdepth(this);
+}
+inline uint64_t Handlers::RequiredMask() const {
+  return upb_handlers_requiredmask(this);
+}
 
 }  // namespace upb
 
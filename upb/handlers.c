@@ -94,9 +94,128 @@ oom:
 
 // This wastes a bit of space since the "func" member of this slot is unused,
 // but the code is simpler.  Worst-case overhead is 20% (messages with only
-// non-repeated submessage fields).  Can change later if necessary.
+// non-repeated submessage fields).  Can change later if necessary.  Only
+// valid while mutable; see getent() for frozen handlers.
 #define SUBH(h, field_base) h->table[field_base + 2].data
 
+// Number of table entries and mask words allocated for "m"'s handlers.
+static size_t tablesize(const upb_msgdef *m) { return m->selector_count + 100; }
+static size_t maskwords(const upb_msgdef *m) {
+  return (m->selector_count + 63) / 64;
+}
+
+static int popcount64(uint64_t x) {
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  int ret = 0;
+  for (; x; x &= x - 1) ret++;
+  return ret;
+#endif
+}
+
+static bool isset(const upb_handlers_tabent *e) { return e->func || e->data; }
+
+// Returns the table entry for selector "s", or NULL if no handler is set.
+static const upb_handlers_tabent *getent(const upb_handlers *h,
+                                         upb_selector_t s) {
+  if (!h->setmask) return &h->table[s];
+  uint64_t word = h->setmask[s / 64];
+  uint64_t bit = 1ULL << (s % 64);
+  if (!(word & bit)) return NULL;
+  return &h->table[h->rank[s / 64] + popcount64(word & (bit - 1))];
+}
+
+// Returns the number of frames that input for "m" can push on top of m's own
+// frame, or -1 if m is recursive.  "memo" maps msgdefs to their depth, and
+// holds -1 for msgdefs that are still being visited so that cycles are
+// detected.
+static int32_t msgdepth(const upb_msgdef *m, upb_inttable *memo) {
+  upb_value v;
+  if (upb_inttable_lookupptr(memo, m, &v)) return upb_value_getint32(v);
+  if (!upb_inttable_insertptr(memo, m, upb_value_int32(-1))) return -1;
+
+  int32_t depth = 0;
+  upb_msg_iter i;
+  for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    int32_t d = 0;
+    if (upb_fielddef_issubmsg(f)) {
+      d = msgdepth(upb_downcast_msgdef(upb_fielddef_subdef(f)), memo);
+      if (d < 0) {
+        depth = -1;
+        break;
+      }
+      d++;
+    } else if (upb_fielddef_isstring(f)) {
+      d = 1;
+    }
+    if (upb_fielddef_isseq(f)) d++;
+    depth = UPB_MAX(depth, d);
+  }
+
+  upb_inttable_removeptr(memo, m, NULL);
+  upb_inttable_insertptr(memo, m, upb_value_int32(depth));
+  return depth;
+}
+
+// Squeezes the unset entries out of a newly-frozen handlers object, builds its
+// bitmask and computes its stack depth and required field mask, then does the
+// same for all subhandlers.  Since selectors are assigned in field number
+// order, the handlers of neighboring fields end up adjacent no matter how
+// sparsely the handlers were set.  "memo" is shared across calls for msgdepth().
+static void compact(upb_handlers *h, upb_inttable *memo) {
+  assert(upb_handlers_isfrozen(h));
+  if (h->setmask) return;
+  int32_t depth = memo ? msgdepth(h->msg, memo) : -1;
+  h->max_depth = depth < 0 ? 0 : UPB_MIN(depth + 1, UPB_MAX_NESTING);
+  h->required_mask = 0;
+  for (uint32_t i = 0; i < h->msg->hot_count; i++) {
+    const upb_hotfield *f = &h->msg->hot[i];
+    if (f->label == UPB_LABEL_REQUIRED && f->required_index < UPB_MAX_REQUIRED)
+      h->required_mask |= 1ULL << f->required_index;
+  }
+  size_t words = maskwords(h->msg);
+  uint64_t *mask = (uint64_t*)&h->table[tablesize(h->msg)];
+  uint32_t *rank = (uint32_t*)(mask + words);
+  uint32_t n = 0;
+  for (size_t w = 0; w < words; w++) {
+    mask[w] = 0;
+    rank[w] = n;
+  }
+  for (uint32_t sel = 0; sel < h->msg->selector_count; sel++) {
+    if (isset(&h->table[sel])) {
+      mask[sel / 64] |= 1ULL << (sel % 64);
+      h->table[n++] = h->table[sel];
+    }
+  }
+  for (size_t w = 1; w < words; w++) {
+    rank[w] = rank[w - 1] + popcount64(mask[w - 1]);
+  }
+  memset(&h->table[n], 0, (h->msg->selector_count - n) * sizeof(*h->table));
+  h->setmask = mask;
+  h->rank = rank;
+
+  upb_msg_iter i;
+  for(upb_msg_begin(&i, h->msg); !upb_msg_done(&i); upb_msg_next(&i)) {
+    upb_fielddef *f = upb_msg_iter_field(&i);
+    if (!upb_fielddef_issubmsg(f)) continue;
+    const upb_handlers *sub = upb_handlers_getsubhandlers(h, f);
+    if (sub) compact((upb_handlers*)sub, memo);
+  }
+}
+
+static void compact_all(upb_handlers *const*handlers, int n) {
+  // If the memo table cannot be allocated, all depths are reported as
+  // unbounded, which is always safe.
+  upb_inttable memo;
+  bool have_memo = upb_inttable_init(&memo, UPB_CTYPE_INT32);
+  for (int i = 0; i < n; i++) {
+    compact(handlers[i], have_memo ? &memo : NULL);
+  }
+  if (have_memo) upb_inttable_uninit(&memo);
+}
+
 static int32_t getsel(upb_handlers *h, const upb_fielddef *f,
                       upb_handlertype_t type) {
   upb_selector_t sel;
@@ -178,7 +297,9 @@ upb_handlers *upb_handlers_new(const upb_msgdef *md, const upb_frametype *ft,
                                const void *owner) {
   assert(upb_msgdef_isfrozen(md));
 
-  int extra = sizeof(upb_handlers_tabent) * (md->selector_count - 1 + 100);
+  // The mask and rank arrays built by compact() follow the table.
+  size_t extra = sizeof(upb_handlers_tabent) * (tablesize(md) - 1) +
+                 (sizeof(uint64_t) + sizeof(uint32_t)) * maskwords(md);
   upb_handlers *h = calloc(sizeof(*h) + extra, 1);
   if (!h) return NULL;
 
@@ -220,6 +341,7 @@ const upb_handlers *upb_handlers_newfrozen(const upb_msgdef *m,
   upb_refcounted *r = upb_upcast(ret);
   bool ok = upb_refcounted_freeze(&r, 1, NULL);
   UPB_ASSERT_VAR(ok, ok);
+  compact_all(&ret, 1);
 
   return ret;
 }
@@ -259,6 +381,21 @@ SETTER(endseq,      upb_endfield_handler*,    UPB_HANDLER_ENDSEQ);
 
 #undef SETTER
 
+bool upb_handlers_setmapentry(upb_handlers *h, const upb_fielddef *f,
+                              upb_mapentry_handler *func, void *data,
+                              upb_handlerfree *cleanup) {
+  int32_t sel = getsel(h, f, UPB_HANDLER_MAPENTRY);
+  if (sel < 0) return false;
+  // A message value has no single value to pass.
+  const upb_msgdef *entry = upb_downcast_msgdef(upb_fielddef_subdef(f));
+  if (upb_fielddef_issubmsg(upb_msgdef_itof(entry, 2))) {
+    upb_status_seterrf(h->status_, "map field %s has message values",
+                       upb_fielddef_name(f));
+    return false;
+  }
+  return doset(h, sel, (upb_func*)func, data, cleanup);
+}
+
 bool upb_handlers_setstartmsg(upb_handlers *h, upb_startmsg_handler *handler,
                               void *d, upb_handlerfree *cleanup) {
   return doset(h, UPB_STARTMSG_SELECTOR, (upb_func*)handler, d, cleanup);
@@ -287,13 +424,14 @@ bool upb_handlers_setsubhandlers(upb_handlers *h, const upb_fielddef *f,
 const upb_handlers *upb_handlers_getsubhandlers(const upb_handlers *h,
                                                 const upb_fielddef *f) {
   assert(upb_fielddef_issubmsg(f));
-  return SUBH(h, f->selector_base);
+  return upb_handlers_getsubhandlers_sel(h, f->selector_base);
 }
 
 const upb_handlers *upb_handlers_getsubhandlers_sel(const upb_handlers *h,
                                                     upb_selector_t sel) {
   // STARTSUBMSG selector in sel is the field's selector base.
-  return SUBH(h, sel);
+  const upb_handlers_tabent *e = getent(h, sel + 2);
+  return e ? e->data : NULL;
 }
 
 const upb_msgdef *upb_handlers_msgdef(const upb_handlers *h) { return h->msg; }
@@ -303,12 +441,34 @@ const upb_frametype *upb_handlers_frametype(const upb_handlers *h) {
 }
 
 upb_func *upb_handlers_gethandler(const upb_handlers *h, upb_selector_t s) {
-  return (upb_func *)h->table[s].func;
+  const upb_handlers_tabent *e = getent(h, s);
+  return e ? (upb_func *)e->func : NULL;
 }
 
 const void *upb_handlers_gethandlerdata(const upb_handlers *h,
                                         upb_selector_t s) {
-  return h->table[s].data;
+  const upb_handlers_tabent *e = getent(h, s);
+  return e ? e->data : NULL;
+}
+
+const upb_handlers_tabent *upb_handlers_getentry(const upb_handlers *h,
+                                                 upb_selector_t s) {
+  const upb_handlers_tabent *e = getent(h, s);
+  return e && isset(e) ? e : NULL;
+}
+
+uint32_t upb_handlers_maxdepth(const upb_handlers *h) {
+  // Zero until frozen.
+  return h->max_depth;
+}
+
+uint64_t upb_handlers_requiredmask(const upb_handlers *h) {
+  return h->required_mask;
+}
+
+bool upb_handlers_hashandler(const upb_handlers *h, upb_selector_t s) {
+  if (!h->setmask) return isset(&h->table[s]);
+  return (h->setmask[s / 64] >> (s % 64)) & 1;
 }
 
 /* "Static" methods ***********************************************************/
@@ -333,6 +493,7 @@ bool upb_handlers_freeze(upb_handlers *const*handlers, int n, upb_status *s) {
     free(handlers[i]->status_);
     handlers[i]->status_ = NULL;
   }
+  compact_all(handlers, n);
   return true;
 }
 
@@ -394,6 +555,10 @@ bool upb_handlers_getselector(const upb_fielddef *f, upb_handlertype_t type,
       *s = f->selector_base + 1;
       break;
     // Subhandler slot is selector_base + 2.
+    case UPB_HANDLER_MAPENTRY:
+      if (!upb_fielddef_ismap(f)) return false;
+      *s = f->selector_base + 3;
+      break;
   }
   assert(*s < upb_fielddef_msgdef(f)->selector_count);
   return true;
@@ -408,5 +573,6 @@ uint32_t upb_handlers_selectorcount(const upb_fielddef *f) {
   if (upb_fielddef_isseq(f)) ret += 2;    // STARTSEQ/ENDSEQ
   if (upb_fielddef_isstring(f)) ret += 2; // [STARTSTR]/STRING/ENDSTR
   if (upb_fielddef_issubmsg(f)) ret += 2;   // [STARTSUBMSG]/ENDSUBMSG/SUBH
+  if (upb_fielddef_ismap(f)) ret += 1;      // MAPENTRY
   return ret;
 }
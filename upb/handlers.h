@@ -67,9 +67,10 @@ typedef enum {
   UPB_HANDLER_ENDSUBMSG,
   UPB_HANDLER_STARTSEQ,
   UPB_HANDLER_ENDSEQ,
+  UPB_HANDLER_MAPENTRY,
 } upb_handlertype_t;
 
-#define UPB_HANDLER_MAX (UPB_HANDLER_ENDSEQ+1)
+#define UPB_HANDLER_MAX (UPB_HANDLER_MAPENTRY+1)
 
 #define UPB_BREAK NULL
 
@@ -86,6 +87,15 @@ typedef int32_t upb_selector_t;
 #define UPB_ENDMSG_SELECTOR 1
 #define UPB_STATIC_SELECTOR_COUNT 2
 
+// The key or value of a map entry, as passed to a MAPENTRY handler.  "val"
+// holds the value for every type but strings, which are in "str" and "len"
+// and point into the input, so they are only valid during the call.
+typedef struct {
+  upb_value val;
+  const char *str;
+  size_t len;
+} upb_mapitem;
+
 #ifdef __cplusplus
 
 // A upb::Handlers object represents the set of handlers associated with a
@@ -111,6 +121,8 @@ class upb::Handlers {
   typedef Handler<void *(*)(void *, const void *, size_t)> StartStringHandler;
   typedef Handler<size_t(*)(void *, const void *, const char *, size_t)>
       StringHandler;
+  typedef Handler<bool(*)(void *, const void *, const upb_mapitem *,
+                          const upb_mapitem *)> MapEntryHandler;
 
   template <class T> struct ValueHandler {
     typedef Handler<bool(*)(void *, const void *, T)> H;
@@ -324,6 +336,22 @@ class upb::Handlers {
   // repeated field.
   bool SetEndSequenceHandler(const FieldDef* f, const EndFieldHandler& h);
 
+  // Sets the map entry handler for a map field (see FieldDef::IsMap()), which
+  // is defined as follows:
+  //
+  //   bool mapentry(MyClosure* c, const MyHandlerData* d,
+  //                 const upb_mapitem* key, const upb_mapitem* val) {
+  //     // Called once for each entry of the map, with its decoded key and
+  //     // value.  A key or value missing from the entry has its default.
+  //     // Returns true to continue processing.
+  //     return true;
+  //   }
+  //
+  // When this is set, decoders may deliver each entry with this one call
+  // instead of as a submessage, so the entry's own handlers do not run.
+  // Returns "false" if "f" is not a map field or its values are messages.
+  bool SetMapEntryHandler(const FieldDef* f, const MapEntryHandler& h);
+
   // Sets or gets the object that specifies handlers for the given field, which
   // must be a submessage or group.  Returns NULL if no handlers are set.
   bool SetSubHandlers(const FieldDef* f, const Handlers* sub);
@@ -351,6 +379,26 @@ class upb::Handlers {
   // Returns the handler data that was registered with this handler.
   const void* GetHandlerData(Selector selector);
 
+  // Returns true if a handler is registered for this selector.  For frozen
+  // Handlers this only tests a bitmask, without touching the handler table,
+  // so it is a cheap way for a producer to skip work nobody will consume.
+  bool HasHandler(Selector selector) const;
+
+  // Returns the number of stack frames needed to process any input for these
+  // Handlers: one for the message itself plus one for each sequence, string
+  // or submessage that can be open at the same time.  Returns 0 if the message
+  // is recursive, in which case only UPB_MAX_NESTING bounds the depth, or if
+  // the Handlers are not frozen yet.
+  uint32_t MaxDepth() const;
+
+  // Returns a mask with one bit for each required field of the message, at
+  // the bit given by the field's upb_hotfield.required_index.  A decoder that
+  // sets these bits as it sees the fields can tell at the end of the message
+  // whether any are missing, without a pass over the result afterwards.  The
+  // mask only covers the first UPB_MAX_REQUIRED required fields, and is 0
+  // until the Handlers are frozen.
+  uint64_t RequiredMask() const;
+
   // Could add any of the following functions as-needed, with some minor
   // implementation changes:
   //
@@ -372,6 +420,14 @@ struct upb_handlers {
     void (*cleanup)(void*);
   } *cleanup;
   size_t cleanup_len, cleanup_size;
+  // Built when frozen: bit i of "setmask" is set iff selector i has a handler
+  // (or subhandlers), and rank[w] is the number of bits set in the words
+  // before setmask[w].  From then on "table" holds only the set entries, in
+  // selector order.  Both point into the tail of this allocation.
+  const uint64_t *setmask;
+  const uint32_t *rank;
+  uint32_t max_depth;  // Set when frozen; see upb_handlers_maxdepth().
+  uint64_t required_mask;  // Likewise; see upb_handlers_requiredmask().
   upb_handlers_tabent table[1];  // Dynamically-sized field handler array.
 };
 
@@ -558,6 +614,9 @@ typedef bool upb_bool_handler(void *c, const void *hd, bool val);
 typedef void* upb_startstr_handler(void *c, const void *hd, size_t size_hint);
 typedef size_t upb_string_handler(void *c, const void *hd, const char *buf,
                                   size_t n);
+typedef bool upb_mapentry_handler(void *c, const void *hd,
+                                  const upb_mapitem *key,
+                                  const upb_mapitem *val);
 
 upb_handlers *upb_handlers_new(const upb_msgdef *m,
                                const upb_frametype *ft,
@@ -626,6 +685,9 @@ bool upb_handlers_setendsubmsg(upb_handlers *h, const upb_fielddef *f,
 bool upb_handlers_setendseq(upb_handlers *h, const upb_fielddef *f,
                             upb_endfield_handler *handler, void *d,
                             upb_handlerfree *fr);
+bool upb_handlers_setmapentry(upb_handlers *h, const upb_fielddef *f,
+                              upb_mapentry_handler *handler, void *d,
+                              upb_handlerfree *fr);
 bool upb_handlers_setsubhandlers(upb_handlers *h, const upb_fielddef *f,
                                  const upb_handlers *sub);
 const upb_handlers *upb_handlers_getsubhandlers(const upb_handlers *h,
@@ -635,6 +697,13 @@ const upb_handlers *upb_handlers_getsubhandlers_sel(const upb_handlers *h,
 upb_func *upb_handlers_gethandler(const upb_handlers *h, upb_selector_t s);
 const void *upb_handlers_gethandlerdata(const upb_handlers *h,
                                         upb_selector_t s);
+// The handler and its data together, or NULL if neither is set; for callers
+// that need both, this looks the selector up only once.
+const upb_handlers_tabent *upb_handlers_getentry(const upb_handlers *h,
+                                                 upb_selector_t s);
+bool upb_handlers_hashandler(const upb_handlers *h, upb_selector_t s);
+uint32_t upb_handlers_maxdepth(const upb_handlers *h);
+uint64_t upb_handlers_requiredmask(const upb_handlers *h);
 
 // "Static" methods
 bool upb_handlers_freeze(upb_handlers *const *handlers, int n, upb_status *s);
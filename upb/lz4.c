@@ -0,0 +1,279 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * An LZ4 block is a series of sequences, each of which is:
+ *
+ *   token:u8       literal length (high nibble), match length - 4 (low nibble)
+ *   [u8...]        if a length nibble is 15: bytes added to it, up to the
+ *                  first byte that is not 255
+ *   literals       copied to the output
+ *   offset:u16le   distance back in the output to copy the match from
+ *   [u8...]        match length bytes, as above
+ *
+ * The last sequence ends after its literals.  Since the input arrives in
+ * arbitrary pieces, it is parsed by a state machine that can stop anywhere.
+ */
+
+#include "upb/lz4.h"
+
+#include <string.h>
+#include "upb/bytestream.h"
+
+typedef enum {
+  STATE_TOKEN,
+  STATE_LITLEN,
+  STATE_LITERALS,
+  STATE_OFFSET,
+  STATE_MATCHLEN,
+  STATE_COPY,
+} state_t;
+
+struct upb_lz4decoder {
+  upb_pipeline *pipeline;
+  upb_sink *sink;
+  char *window;    // Ring of UPB_LZ4_WINDOW_SIZE bytes.
+  size_t pos;      // Where the next output byte goes in the ring.
+  size_t pending;  // Bytes before "pos" not yet passed to the sink.
+  uint64_t total;  // Bytes output in this block.
+
+  state_t state;
+  uint32_t lit;         // Literal bytes left to copy.
+  uint32_t match;       // Match length, less 4.
+  uint32_t offset;
+  int offset_bytes;     // Bytes of the offset read so far.
+  uint64_t copy;        // Match bytes left to copy.
+  size_t resent;        // Decoded input bytes reported as not consumed.
+};
+
+static upb_status *status(upb_lz4decoder *d) {
+  return &d->pipeline->status_;
+}
+
+static bool corrupt(upb_lz4decoder *d) {
+  upb_status_seterrliteral(status(d), "Corrupt LZ4 data");
+  return false;
+}
+
+// Passes the pending output to the sink.  Returns false if the sink took
+// less than it was given, leaving the rest pending.
+static bool flush(upb_lz4decoder *d) {
+  size_t start = (d->pos + UPB_LZ4_WINDOW_SIZE - d->pending) %
+                 UPB_LZ4_WINDOW_SIZE;
+  while (d->pending > 0) {
+    size_t n = UPB_MIN(d->pending, UPB_LZ4_WINDOW_SIZE - start);
+    size_t written = upb_sink_putstring(d->sink, UPB_BYTESTREAM_BYTES_STRING,
+                                        d->window + start, n);
+    d->pending -= written;
+    if (written < n) return false;
+    start = 0;
+  }
+  return true;
+}
+
+// Returns how many bytes can be written at "pos" without wrapping or passing
+// a full chunk to the sink.
+static size_t room(upb_lz4decoder *d) {
+  if (d->pending == UPB_LZ4_CHUNK_SIZE && !flush(d)) return 0;
+  return UPB_MIN(UPB_LZ4_WINDOW_SIZE - d->pos,
+                 UPB_LZ4_CHUNK_SIZE - d->pending);
+}
+
+static void advance(upb_lz4decoder *d, size_t n) {
+  d->pos += n;
+  if (d->pos == UPB_LZ4_WINDOW_SIZE) d->pos = 0;
+  d->pending += n;
+  d->total += n;
+}
+
+// Copies up to "len" literal bytes to the output, and returns how many it
+// copied before the sink stopped taking output.
+static size_t putliterals(upb_lz4decoder *d, const char *buf, size_t len) {
+  size_t copied = 0;
+  while (copied < len) {
+    size_t avail = room(d);
+    if (avail == 0) break;
+    size_t n = UPB_MIN(len - copied, avail);
+    memcpy(d->window + d->pos, buf + copied, n);
+    advance(d, n);
+    copied += n;
+  }
+  return copied;
+}
+
+static void startcopy(upb_lz4decoder *d) {
+  if (d->offset == 0 || d->offset > d->total) {
+    corrupt(d);
+    return;
+  }
+  d->copy = (uint64_t)d->match + 4;
+  d->state = STATE_COPY;
+}
+
+// Copies the rest of the match.  Returns false if the sink stopped taking
+// output first.
+static bool copymatch(upb_lz4decoder *d) {
+  while (d->copy > 0) {
+    size_t avail = room(d);
+    if (avail == 0) return false;
+    size_t n = UPB_MIN(d->copy, avail);
+    size_t src = (d->pos + UPB_LZ4_WINDOW_SIZE - d->offset) %
+                 UPB_LZ4_WINDOW_SIZE;
+    n = UPB_MIN(n, UPB_LZ4_WINDOW_SIZE - src);
+    char *to = d->window + d->pos;
+    const char *from = d->window + src;
+    if (d->offset >= n) {
+      memcpy(to, from, n);
+    } else {
+      // The match overlaps its own output, repeating the last "offset" bytes.
+      for (size_t i = 0; i < n; i++) to[i] = from[i];
+    }
+    advance(d, n);
+    d->copy -= n;
+  }
+  d->state = STATE_TOKEN;
+  return true;
+}
+
+// Adds a length extension byte to "*len".  Returns false when it is the last.
+static bool addlen(upb_lz4decoder *d, uint32_t *len, uint8_t byte) {
+  if (*len > UINT32_MAX - 255) {
+    corrupt(d);
+    return false;
+  }
+  *len += byte;
+  return byte == 255;
+}
+
+static void *startstr(void *closure, const void *hd, size_t size_hint) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(size_hint);
+  upb_lz4decoder *d = closure;
+  assert(d->sink);
+  if (!d->window) {
+    upb_status_seterrliteral(status(d), "Out of memory");
+    return UPB_BREAK;
+  }
+  d->pos = 0;
+  d->pending = 0;
+  d->total = 0;
+  d->state = STATE_TOKEN;
+  d->resent = 0;
+  if (!upb_sink_startmsg(d->sink) ||
+      !upb_sink_startstr(d->sink, UPB_BYTESTREAM_BYTES_STARTSTR, 0)) {
+    return UPB_BREAK;
+  }
+  return d;
+}
+
+// When the sink takes less output than it is given, whether to apply
+// backpressure or because it has stopped, this returns a short count in turn
+// and goes on from the output still pending when the rest is passed again.
+static size_t decompress(void *closure, const void *hd, const char *buf,
+                         size_t n) {
+  UPB_UNUSED(hd);
+  upb_lz4decoder *d = closure;
+  if (!upb_ok(status(d)) || !flush(d) ||
+      (d->state == STATE_COPY && !copymatch(d))) {
+    return 0;
+  }
+  // Skip the bytes that were decoded already, but not reported consumed.
+  size_t skip = UPB_MIN(d->resent, n);
+  d->resent -= skip;
+  const char *p = buf + skip, *end = buf + n;
+  bool blocked = false;
+  while (p < end && !blocked && upb_ok(status(d))) {
+    switch (d->state) {
+      case STATE_TOKEN: {
+        uint8_t token = *p++;
+        d->lit = token >> 4;
+        d->match = token & 15;
+        d->state = d->lit == 15 ? STATE_LITLEN : STATE_LITERALS;
+        break;
+      }
+      case STATE_LITLEN:
+        if (!addlen(d, &d->lit, *p++)) d->state = STATE_LITERALS;
+        break;
+      case STATE_LITERALS: {
+        size_t len = UPB_MIN(d->lit, (size_t)(end - p));
+        size_t copied = putliterals(d, p, len);
+        blocked = copied < len;
+        p += copied;
+        d->lit -= copied;
+        break;
+      }
+      case STATE_OFFSET:
+        if (d->offset_bytes == 0) d->offset = 0;
+        d->offset |= (uint32_t)(uint8_t)*p++ << (8 * d->offset_bytes);
+        if (++d->offset_bytes < 2) break;
+        if (d->match == 15) {
+          d->state = STATE_MATCHLEN;
+        } else {
+          startcopy(d);
+        }
+        break;
+      case STATE_MATCHLEN:
+        if (!addlen(d, &d->match, *p++) && upb_ok(status(d))) startcopy(d);
+        break;
+      case STATE_COPY:
+        assert(false);  // Always finished or blocked below.
+        break;
+    }
+    if (d->state == STATE_COPY) blocked = !copymatch(d);
+    // Literals are followed by an offset even when there are none, so that
+    // the end of the last sequence is always found in the same state.
+    if (d->state == STATE_LITERALS && d->lit == 0) {
+      d->state = STATE_OFFSET;
+      d->offset_bytes = 0;
+    }
+  }
+  if (!upb_ok(status(d)) || p < end) return p - buf;
+  // All of the output is passed on before all of the input is reported
+  // consumed, so that the string is not ended with output left over.  If the
+  // sink does not take it, the last byte is reported as not consumed, and is
+  // skipped when passed again.
+  if (!blocked && flush(d)) return n;
+  d->resent = 1;
+  return n - 1;
+}
+
+static bool endstr(void *closure, const void *hd) {
+  UPB_UNUSED(hd);
+  upb_lz4decoder *d = closure;
+  if (!upb_ok(status(d))) return false;
+  // The sink did not take all of the output.
+  if (d->pending > 0 || d->resent > 0) return false;
+  if (d->state != STATE_OFFSET || d->offset_bytes != 0) return corrupt(d);
+  if (!upb_sink_endstr(d->sink, UPB_BYTESTREAM_BYTES_ENDSTR)) return false;
+  upb_sink_endmsg(d->sink);
+  return true;
+}
+
+static bool init(void *obj, upb_pipeline *p) {
+  upb_lz4decoder *d = obj;
+  d->pipeline = p;
+  d->sink = NULL;
+  d->window = upb_pipeline_alloc(p, UPB_LZ4_WINDOW_SIZE);
+  return d->window != NULL;
+}
+
+static const upb_frametype lz4decoder_frametype = {
+  sizeof(upb_lz4decoder),
+  init,
+  NULL,
+  NULL,
+};
+
+const upb_handlers *upb_lz4decoder_newhandlers(const void *owner) {
+  upb_handlers *h =
+      upb_handlers_new(UPB_BYTESTREAM, &lz4decoder_frametype, owner);
+  upb_handlers_setstartstr(h, UPB_BYTESTREAM_BYTES, startstr, NULL, NULL);
+  upb_handlers_setstring(h, UPB_BYTESTREAM_BYTES, decompress, NULL, NULL);
+  upb_handlers_setendstr(h, UPB_BYTESTREAM_BYTES, endstr, NULL, NULL);
+  return h;
+}
+
+void upb_lz4decoder_resetsink(upb_lz4decoder *d, upb_sink *sink) {
+  d->sink = sink;
+}
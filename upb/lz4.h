@@ -0,0 +1,91 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * upb::Lz4Decoder is a pipeline stage that decompresses LZ4 blocks (the raw
+ * block format of https://github.com/lz4/lz4, without the frame format) and
+ * passes the result on to another upb::ByteStream sink, normally a
+ * upb::pb::Decoder:
+ *
+ *   upb_sink *lz4 = upb_pipeline_newsink(&pipeline, lz4_handlers);
+ *   upb_sink *decoder = upb_pipeline_newsink(&pipeline, decoder_handlers);
+ *   upb_lz4decoder_resetsink(upb_sink_getobj(lz4), decoder);
+ *   upb_bytestream_putstr(lz4, compressed, len);
+ *
+ * Each string is one compressed block, and becomes one string on the output
+ * sink.  The input may arrive in any number of pieces, so the stage can sit
+ * behind a reader that does not have the whole block at once, like
+ * upb::pb::RecordCursor::Decode() for a record file of compressed records.
+ *
+ * The output is produced into a ring of UPB_LZ4_WINDOW_SIZE bytes and passed
+ * on in pieces of at most UPB_LZ4_CHUNK_SIZE bytes, while they are still in
+ * cache.  Memory use is fixed by the window, however large the blocks are.
+ *
+ * Malformed input is an error in the pipeline status.  If the output sink
+ * takes less than it is given, whether it is applying backpressure or has
+ * stopped early (like a decoder with terminal fields), the stage's string
+ * handler returns a short count too, and goes on from the output it still
+ * holds when the rest of the input is passed again.  Ending the string
+ * before then fails.
+ */
+
+#ifndef UPB_LZ4_H_
+#define UPB_LZ4_H_
+
+#include "upb/sink.h"
+
+#ifdef __cplusplus
+namespace upb {
+class Lz4Decoder;
+}  // namespace upb
+typedef upb::Lz4Decoder upb_lz4decoder;
+#else
+struct upb_lz4decoder;
+typedef struct upb_lz4decoder upb_lz4decoder;
+#endif
+
+// LZ4 matches reach back at most 64k, so the ring holds that much history
+// plus one chunk of output that has not been passed on yet.
+#define UPB_LZ4_CHUNK_SIZE (16 * 1024)
+#define UPB_LZ4_WINDOW_SIZE (64 * 1024 + UPB_LZ4_CHUNK_SIZE)
+
+#ifdef __cplusplus
+
+class upb::Lz4Decoder {
+ public:
+  // Returns handlers for an Lz4Decoder, which take a upb::ByteStream.
+  static const Handlers* NewHandlers(const void* owner);
+
+  // Sets the sink that gets the decompressed bytes, which takes a
+  // upb::ByteStream and must be from the same pipeline.  This must be called
+  // before the decoder is used.
+  void ResetSink(Sink* sink);
+
+ private:
+  UPB_DISALLOW_POD_OPS(Lz4Decoder);
+};
+
+extern "C" {
+#endif
+
+const upb_handlers *upb_lz4decoder_newhandlers(const void *owner);
+void upb_lz4decoder_resetsink(upb_lz4decoder *d, upb_sink *sink);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+
+namespace upb {
+
+inline const Handlers* Lz4Decoder::NewHandlers(const void* owner) {
+  return upb_lz4decoder_newhandlers(owner);
+}
+inline void Lz4Decoder::ResetSink(Sink* sink) {
+  upb_lz4decoder_resetsink(this, sink);
+}
+
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_LZ4_H_ */
@@ -0,0 +1,156 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * An optional C++20 coroutine front end for upb::pb::Decoder, for decoding
+ * from an asynchronous byte source without blocking a thread or buffering the
+ * whole message first:
+ *
+ *   upb::pb::AsyncDecode Serve(upb::Sink* decoder, Connection* conn) {
+ *     if (!co_await upb::pb::DecodeAsync(decoder, conn)) { ... }
+ *   }
+ *
+ * The decoder itself is unchanged: when a buffer ends in the middle of a value
+ * it saves the partial bytes in its residual buffer and returns, just as it
+ * does for synchronous callers.  DecodeAsync() then co_awaits the next buffer
+ * from the source, so the coroutine is suspended exactly at the buffer seams
+ * and resumed when the source has more data.
+ *
+ * A source is any object with a Read() member that returns an awaitable whose
+ * result has "data" and "size" members (like upb::pb::AsyncBuffer).  The data
+ * must stay valid until the next Read().  A size of zero means end of stream.
+ *
+ * When the decoder's sinks apply backpressure (a string handler takes only
+ * part of its data), the rest of the buffer is passed again.  If the source
+ * has a WaitForConsumer() member returning an awaitable, that is awaited
+ * first.  Otherwise the rest is passed again immediately if the sink took
+ * some of the data; if it took none, the decode fails (with the pipeline's
+ * status still ok), since there is nothing to wait on before trying again.
+ *
+ * The sink must be a upb::pb::Decoder sink (or any other sink for
+ * upb::ByteStream) from an ordinary upb::Pipeline; errors are reported in the
+ * pipeline's status as usual.  Like pipelines, none of this is thread-safe.
+ *
+ * This header is not included by the rest of upb and requires a compiler
+ * with coroutine support (for example g++ -std=c++20).
+ */
+
+#ifndef UPB_PB_ASYNC_H_
+#define UPB_PB_ASYNC_H_
+
+#if !defined(__cpp_impl_coroutine)
+#error "upb/pb/async.h requires C++20 coroutines."
+#endif
+
+#include <coroutine>
+#include <exception>
+#include "upb/bytestream.h"
+
+namespace upb {
+namespace pb {
+
+// A buffer of input, as returned by an async source's Read().
+struct AsyncBuffer {
+  const char* data;
+  size_t size;
+};
+
+// The coroutine type of DecodeAsync().  It starts running when it is first
+// co_awaited (or Resume()d), and its result is true if the whole stream was
+// decoded successfully.
+class AsyncDecode {
+ public:
+  struct promise_type;
+  typedef std::coroutine_handle<promise_type> Handle;
+
+  AsyncDecode(AsyncDecode&& other) : h_(other.h_) { other.h_ = nullptr; }
+  ~AsyncDecode() { if (h_) h_.destroy(); }
+
+  // For driving the coroutine from code that is not itself a coroutine:
+  // Resume() runs it until it next suspends.
+  void Resume() { h_.resume(); }
+  bool done() const { return h_.done(); }
+  bool result() const { return h_.promise().result; }
+
+  // Awaiting runs the coroutine, resuming the awaiter when it finishes.
+  bool await_ready() const { return false; }
+  std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) {
+    h_.promise().continuation = awaiter;
+    return h_;
+  }
+  bool await_resume() const { return result(); }
+
+  struct promise_type {
+    bool result = false;
+    std::coroutine_handle<> continuation;
+
+    AsyncDecode get_return_object() {
+      return AsyncDecode(Handle::from_promise(*this));
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+      bool await_ready() noexcept { return false; }
+      std::coroutine_handle<> await_suspend(Handle h) noexcept {
+        std::coroutine_handle<> c = h.promise().continuation;
+        if (c) return c;
+        return std::noop_coroutine();
+      }
+      void await_resume() noexcept {}
+    };
+    FinalAwaiter final_suspend() noexcept { return {}; }
+
+    void return_value(bool ok) { result = ok; }
+    void unhandled_exception() { std::terminate(); }
+  };
+
+ private:
+  explicit AsyncDecode(Handle h) : h_(h) {}
+  AsyncDecode(const AsyncDecode&) = delete;
+  void operator=(const AsyncDecode&) = delete;
+
+  Handle h_;
+};
+
+// Decodes the whole stream from "source" into "sink", which must be reset
+// and ready to start a message.
+template <class Source>
+AsyncDecode DecodeAsync(Sink* sink, Source* source) {
+  if (!sink->StartMessage() ||
+      !sink->StartString(UPB_BYTESTREAM_BYTES_STARTSTR, 0)) {
+    co_return false;
+  }
+
+  while (true) {
+    auto buf = co_await source->Read();
+    if (buf.size == 0) break;
+
+    const char* ptr = buf.data;
+    size_t left = buf.size;
+    while (left > 0) {
+      size_t n = sink->PutStringBuffer(UPB_BYTESTREAM_BYTES_STRING, ptr, left);
+      if (!upb_ok(upb_pipeline_status(sink->pipeline()))) co_return false;
+      ptr += n;
+      left -= n;
+      if (left > 0) {
+        // Backpressure: the rest must be passed again once downstream can
+        // take more.
+        if constexpr (requires { source->WaitForConsumer(); }) {
+          co_await source->WaitForConsumer();
+        } else if (n == 0) {
+          // Retrying at once would just spin until downstream took something.
+          co_return false;
+        }
+      }
+    }
+  }
+
+  co_return sink->EndString(UPB_BYTESTREAM_BYTES_ENDSTR) &&
+            sink->EndMessage();
+}
+
+}  // namespace pb
+}  // namespace upb
+
+#endif  /* UPB_PB_ASYNC_H_ */
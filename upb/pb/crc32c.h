@@ -0,0 +1,28 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * CRC32C (the Castagnoli polynomial, as used by iSCSI, ext4 and many record
+ * formats), for checksumming serialized data.
+ */
+
+#ifndef UPB_PB_CRC32C_H_
+#define UPB_PB_CRC32C_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Extends "crc", the CRC32C of some preceding data (0 for none), with the next
+// "len" bytes of the data.
+uint32_t upb_crc32c(uint32_t crc, const void *buf, size_t len);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+#endif
+
+#endif  /* UPB_PB_CRC32C_H_ */
@@ -8,10 +8,12 @@
 #include <inttypes.h>
 #include <setjmp.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include "upb/bytestream.h"
 #include "upb/pb/decoder.h"
 #include "upb/pb/varint.h"
+#include "upb/probes.h"
 
 #define UPB_NONDELIMITED (0xffffffffffffffffULL)
 
@@ -20,11 +22,15 @@
 struct dasm_State;
 
 typedef struct {
-  const upb_fielddef *f;
+  const upb_hotfield *f;
   uint64_t end_ofs;
   uint32_t group_fieldnum;  // UINT32_MAX for non-groups.
   bool is_sequence;   // frame represents seq or submsg/str? (f might be both).
   bool is_packed;     // true for packed primitive sequences.
+  bool is_mapentry;   // true for a map entry being collected into mapbuf.
+  // For message frames, the bits of the required fields seen so far (see
+  // upb_handlers_requiredmask()).
+  uint64_t required_seen;
 } frame;
 
 struct upb_pbdecoder {
@@ -63,9 +69,28 @@ struct upb_pbdecoder {
   const void *saved_rbp;
 #endif
 
-  // Our internal stack.
-  frame *top, *limit;
-  frame stack[UPB_MAX_NESTING];
+  // Our internal stack.  It is sized for the sink's handlers when the sink is
+  // set, and only grows (up to UPB_MAX_NESTING) for recursive types.
+  frame *top, *limit, *stack;
+  upb_pipeline *pipeline;
+
+  // The plan's terminal fields (see upb_pbdecoder_getterminalhandlers()), and
+  // a bit for each one that has not been seen yet.
+  const upb_hotfield *const *terminal;
+  uint32_t terminal_count;
+  uint64_t terminal_left;
+
+  // Whether the end of each message is checked for missing required fields
+  // (see upb_pbdecoder_getvalidatinghandlers()).
+  bool check_required;
+
+  // A map entry that spans buffers is collected here before it is delivered.
+  char *mapbuf;
+  size_t mapbuf_len, mapbuf_size;
+
+  // Set once decoding has stopped early, after all terminal fields have been
+  // seen or when a handler returned false; no more input is consumed.
+  bool finished;
 
   // For exiting the decoder on error.
   jmp_buf exitjmp;
@@ -75,6 +100,13 @@ typedef struct {
   // The top-level handlers that this plan calls into.  We own a ref.
   const upb_handlers *dest_handlers;
 
+  // Top-level fields after which decoding stops, if any.
+  const upb_hotfield *terminal[UPB_PBDECODER_MAXTERMINAL];
+  uint32_t terminal_count;
+
+  // Whether missing required fields are an error.
+  bool check_required;
+
 #ifdef UPB_USE_JIT_X64
   // JIT-generated machine code (else NULL).
   char *jit_code;
@@ -105,38 +137,25 @@ typedef struct {
 #endif
 } decoderplan;
 
-typedef struct {
-  uint8_t native_wire_type;
-  bool is_numeric;
-} upb_decoder_typeinfo;
-
-static const upb_decoder_typeinfo upb_decoder_types[] = {
-  {UPB_WIRE_TYPE_END_GROUP,   false},  // ENDGROUP
-  {UPB_WIRE_TYPE_64BIT,       true},   // DOUBLE
-  {UPB_WIRE_TYPE_32BIT,       true},   // FLOAT
-  {UPB_WIRE_TYPE_VARINT,      true},   // INT64
-  {UPB_WIRE_TYPE_VARINT,      true},   // UINT64
-  {UPB_WIRE_TYPE_VARINT,      true},   // INT32
-  {UPB_WIRE_TYPE_64BIT,       true},   // FIXED64
-  {UPB_WIRE_TYPE_32BIT,       true},   // FIXED32
-  {UPB_WIRE_TYPE_VARINT,      true},   // BOOL
-  {UPB_WIRE_TYPE_DELIMITED,   false},  // STRING
-  {UPB_WIRE_TYPE_START_GROUP, false},  // GROUP
-  {UPB_WIRE_TYPE_DELIMITED,   false},  // MESSAGE
-  {UPB_WIRE_TYPE_DELIMITED,   false},  // BYTES
-  {UPB_WIRE_TYPE_VARINT,      true},   // UINT32
-  {UPB_WIRE_TYPE_VARINT,      true},   // ENUM
-  {UPB_WIRE_TYPE_32BIT,       true},   // SFIXED32
-  {UPB_WIRE_TYPE_64BIT,       true},   // SFIXED64
-  {UPB_WIRE_TYPE_VARINT,      true},   // SINT32
-  {UPB_WIRE_TYPE_VARINT,      true},   // SINT64
-};
-
-static upb_selector_t getselector(const upb_fielddef *f,
+// Equivalent to upb_handlers_getselector(), but computed from the hot field
+// data alone so that the fielddef itself stays out of the cache.  The decoder
+// only asks for selectors that are valid for the field's type.
+static upb_selector_t getselector(const upb_hotfield *f,
                                   upb_handlertype_t type) {
-  upb_selector_t selector;
-  bool ok = upb_handlers_getselector(f, type, &selector);
-  UPB_ASSERT_VAR(ok, ok);
+  upb_selector_t selector = f->selector_base;
+  switch (type) {
+    case UPB_HANDLER_STARTSTR:
+    case UPB_HANDLER_ENDSUBMSG: selector += 1; break;
+    case UPB_HANDLER_ENDSTR:    selector += 2; break;
+    case UPB_HANDLER_STARTSEQ:  selector -= 2; break;
+    case UPB_HANDLER_ENDSEQ:    selector -= 1; break;
+    case UPB_HANDLER_MAPENTRY:  selector += 3; break;
+    default: break;
+  }
+#ifndef NDEBUG
+  upb_selector_t check;
+  assert(upb_handlers_getselector(f->f, type, &check) && check == selector);
+#endif
   return selector;
 }
 
@@ -212,6 +231,12 @@ static bool in_residual_buf(const upb_pbdecoder *d, const char *p);
 #define FORCEINLINE static inline __attribute__((always_inline))
 #define NOINLINE static __attribute__((noinline))
 
+#ifdef __GNUC__
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr)
+#endif
+
 static upb_status *decoder_status(upb_pbdecoder *d) {
   // TODO(haberman): encapsulate this access to pipeline->status, but not sure
   // exactly what that interface should look like.
@@ -222,12 +247,17 @@ UPB_NORETURN static void exitjmp(upb_pbdecoder *d) {
   _longjmp(d->exitjmp, 1);
 }
 
-UPB_NORETURN static void abortjmp(upb_pbdecoder *d, const char *msg) {
+// Exits with an error that is already in the status.
+UPB_NORETURN static void errorjmp(upb_pbdecoder *d) {
   d->ret = in_residual_buf(d, d->checkpoint) ? 0 : (d->checkpoint - d->buf);
-  upb_status_seterrliteral(decoder_status(d), msg);
   exitjmp(d);
 }
 
+UPB_NORETURN static void abortjmp(upb_pbdecoder *d, const char *msg) {
+  upb_status_seterrliteral(decoder_status(d), msg);
+  errorjmp(d);
+}
+
 /* Buffering ******************************************************************/
 
 // We operate on one buffer at a time, which is either the user's buffer passed
@@ -288,11 +318,22 @@ static void switchtobuf(upb_pbdecoder *d, const char *buf, const char *end) {
 #endif
 }
 
-static void suspendjmp(upb_pbdecoder *d) {
+UPB_NORETURN static void suspendjmp(upb_pbdecoder *d) {
   switchtobuf(d, d->residual, d->residual_end);
   exitjmp(d);
 }
 
+// Stops decoding because a handler returned false.  The value it was given has
+// been consumed, but nothing after it is, even if passed again; the caller can
+// tell from the pipeline status whether the handler considered it an error.
+UPB_NORETURN static void halt(upb_pbdecoder *d) {
+  d->finished = true;
+  d->ret = in_residual_buf(d, d->ptr) ? 0 : d->ptr - d->buf_param;
+  d->bufstart_ofs = offset(d);
+  d->residual_end = d->residual;
+  suspendjmp(d);
+}
+
 static void advancetobuf(upb_pbdecoder *d, const char *buf, size_t len) {
   assert(d->ptr == d->end);
   d->bufstart_ofs += (d->ptr - d->buf);
@@ -445,42 +486,96 @@ FORCEINLINE uint64_t decode_fixed64(upb_pbdecoder *d) {
   return u64;  // TODO: proper byte swapping for big-endian machines.
 }
 
-static void push(upb_pbdecoder *d, const upb_fielddef *f, bool is_sequence,
+// Resizes the stack to hold "size" frames, which must not be fewer than the
+// number in use.
+static bool resizestack(upb_pbdecoder *d, size_t size) {
+  size_t oldsize = d->limit - d->stack;
+  frame *stack = upb_pipeline_realloc(d->pipeline, d->stack,
+                                      oldsize * sizeof(frame),
+                                      size * sizeof(frame));
+  if (!stack) return false;
+  d->top = stack + (d->top - d->stack);
+  d->stack = stack;
+  d->limit = stack + size;
+  return true;
+}
+
+static void push(upb_pbdecoder *d, const upb_hotfield *f, bool is_sequence,
                  bool is_packed, int32_t group_fieldnum, uint64_t end) {
   frame *fr = d->top + 1;
-  if (fr >= d->limit) abortjmp(d, "Nesting too deep.");
+  if (fr >= d->limit) {
+    size_t size = d->limit - d->stack;
+    if (size >= UPB_MAX_NESTING) abortjmp(d, "Nesting too deep.");
+    if (!resizestack(d, UPB_MIN(size * 2, UPB_MAX_NESTING)))
+      abortjmp(d, "Out of memory.");
+    fr = d->top + 1;
+  }
   fr->f = f;
   fr->is_sequence = is_sequence;
   fr->is_packed = is_packed;
+  fr->is_mapentry = false;
+  fr->required_seen = 0;
   fr->end_ofs = end;
   fr->group_fieldnum = group_fieldnum;
   d->top = fr;
   set_delim_end(d);
 }
 
-static void push_msg(upb_pbdecoder *d, const upb_fielddef *f, uint64_t end) {
+static void push_msg(upb_pbdecoder *d, const upb_hotfield *f, uint64_t end) {
   if (!upb_sink_startsubmsg(d->sink, getselector(f, UPB_HANDLER_STARTSUBMSG)))
     abortjmp(d, "startsubmsg failed.");
   int32_t group_fieldnum = (end == UPB_NONDELIMITED) ?
-      (int32_t)upb_fielddef_number(f) : -1;
+      (int32_t)f->number : -1;
   push(d, f, false, false, group_fieldnum, end);
 }
 
-static void push_seq(upb_pbdecoder *d, const upb_fielddef *f, bool packed,
+static void push_seq(upb_pbdecoder *d, const upb_hotfield *f, bool packed,
                      uint64_t end_ofs) {
   if (!upb_sink_startseq(d->sink, getselector(f, UPB_HANDLER_STARTSEQ)))
     abortjmp(d, "startseq failed.");
   push(d, f, true, packed, -1, end_ofs);
 }
 
-static void push_str(upb_pbdecoder *d, const upb_fielddef *f, size_t len,
+static void push_str(upb_pbdecoder *d, const upb_hotfield *f, size_t len,
                      uint64_t end) {
   if (!upb_sink_startstr(d->sink, getselector(f, UPB_HANDLER_STARTSTR), len))
     abortjmp(d, "startseq failed.");
   push(d, f, false, false, -1, end);
 }
 
+// Sets an error naming the first required field in "missing" (bits of the
+// message on top of the stack), with the path to it from the top level.
+NOINLINE void seterr_required(upb_pbdecoder *d, uint64_t missing) {
+  const upb_hotfield *f = upb_handlers_msgdef(d->sink->top->h)->hot;
+  while (f->label != UPB_LABEL_REQUIRED ||
+         f->required_index >= UPB_MAX_REQUIRED ||
+         !(missing & (1ULL << f->required_index))) {
+    f++;
+  }
+  char path[256];
+  size_t len = 0;
+  for (const frame *fr = d->stack + 1; fr <= d->top; fr++) {
+    if (fr->is_sequence || len >= sizeof(path)) continue;
+    len += snprintf(path + len, sizeof(path) - len, "%s.",
+                    upb_fielddef_name(fr->f->f));
+  }
+  upb_status_seterrf(decoder_status(d), "Missing required field %.*s%s",
+                     (int)UPB_MIN(len, sizeof(path)), path,
+                     upb_fielddef_name(f->f));
+}
+
+// Returns false (with an error set) if the message on top of the stack is
+// missing any required fields.
+FORCEINLINE bool check_required(upb_pbdecoder *d) {
+  uint64_t missing =
+      upb_handlers_requiredmask(d->sink->top->h) & ~d->top->required_seen;
+  if (missing == 0) return true;
+  seterr_required(d, missing);
+  return false;
+}
+
 static void pop_submsg(upb_pbdecoder *d) {
+  if (d->check_required && !check_required(d)) errorjmp(d);
   upb_sink_endsubmsg(d->sink, getselector(d->top->f, UPB_HANDLER_ENDSUBMSG));
   d->top--;
   set_delim_end(d);
@@ -493,9 +588,11 @@ static void pop_seq(upb_pbdecoder *d) {
 }
 
 static void pop_string(upb_pbdecoder *d) {
-  upb_sink_endstr(d->sink, getselector(d->top->f, UPB_HANDLER_ENDSTR));
+  bool ok = upb_sink_endstr(d->sink,
+                            getselector(d->top->f, UPB_HANDLER_ENDSTR));
   d->top--;
   set_delim_end(d);
+  if (!ok) halt(d);
 }
 
 static void checkdelim(upb_pbdecoder *d) {
@@ -520,10 +617,22 @@ static void checkdelim(upb_pbdecoder *d) {
 // properly sign-extended.  We could detect this and error about the data loss,
 // but proto2 does not do this, so we pass.
 
+// The value is always consumed, but the handler is only called if one is
+// actually registered; for handlers that only cover a few fields this skips
+// most of the work for the rest.  The handler is called directly rather than
+// through upb_sink_put*(), so that the selector is looked up only once.
 #define T(type, sel, wt, name, convfunc) \
-  static void decode_ ## type(upb_pbdecoder *d, const upb_fielddef *f) { \
-    upb_sink_put ## name(d->sink, getselector(f, UPB_HANDLER_ ## sel), \
-                         (convfunc)(decode_ ## wt(d))); \
+  static void decode_ ## type(upb_pbdecoder *d, const upb_hotfield *f) { \
+    upb_sinkframe *top = d->sink->top; \
+    const upb_handlers_tabent *e = \
+        upb_handlers_getentry(top->h, getselector(f, UPB_HANDLER_ ## sel)); \
+    if (e && e->func) { \
+      upb_ ## name ## _handler *handler = (upb_ ## name ## _handler*)e->func; \
+      if (!handler(top->closure, e->data, (convfunc)(decode_ ## wt(d)))) \
+        halt(d); \
+    } else { \
+      decode_ ## wt(d); \
+    } \
   } \
 
 static double  upb_asdouble(uint64_t n) { double d; memcpy(&d, &n, 8); return d; }
@@ -545,58 +654,296 @@ T(SINT32,   INT32,  varint,  int32,  upb_zzdec_32)
 T(SINT64,   INT64,  varint,  int64,  upb_zzdec_64)
 #undef T
 
-static void decode_GROUP(upb_pbdecoder *d, const upb_fielddef *f) {
+static void decode_GROUP(upb_pbdecoder *d, const upb_hotfield *f) {
   push_msg(d, f, UPB_NONDELIMITED);
 }
 
-static void decode_MESSAGE(upb_pbdecoder *d, const upb_fielddef *f) {
+// Reads a varint of a map entry from "*p", which must not pass "end".
+static uint64_t entry_varint(upb_pbdecoder *d, const char **p,
+                             const char *end) {
+  uint64_t val = 0;
+  for (int bitpos = 0; bitpos < 70 && *p < end; bitpos += 7) {
+    uint8_t byte = *(*p)++;
+    val |= (uint64_t)(byte & 0x7f) << bitpos;
+    if ((byte & 0x80) == 0) return val;
+  }
+  abortjmp(d, "Bad map entry");
+}
+
+// Sets "item" from the wire value "raw" of a field of the given type.  Strings
+// are set by the caller.
+static void setmapitem(upb_mapitem *item, upb_descriptortype_t type,
+                       uint64_t raw) {
+  switch (type) {
+    case UPB_DESCRIPTOR_TYPE_DOUBLE:
+      upb_value_setdouble(&item->val, upb_asdouble(raw));
+      break;
+    case UPB_DESCRIPTOR_TYPE_FLOAT:
+      upb_value_setfloat(&item->val, upb_asfloat((uint32_t)raw));
+      break;
+    case UPB_DESCRIPTOR_TYPE_INT64:
+    case UPB_DESCRIPTOR_TYPE_SFIXED64:
+      upb_value_setint64(&item->val, (int64_t)raw);
+      break;
+    case UPB_DESCRIPTOR_TYPE_SINT64:
+      upb_value_setint64(&item->val, upb_zzdec_64(raw));
+      break;
+    case UPB_DESCRIPTOR_TYPE_UINT64:
+    case UPB_DESCRIPTOR_TYPE_FIXED64:
+      upb_value_setuint64(&item->val, raw);
+      break;
+    case UPB_DESCRIPTOR_TYPE_INT32:
+    case UPB_DESCRIPTOR_TYPE_SFIXED32:
+    case UPB_DESCRIPTOR_TYPE_ENUM:
+      upb_value_setint32(&item->val, (int32_t)raw);
+      break;
+    case UPB_DESCRIPTOR_TYPE_SINT32:
+      upb_value_setint32(&item->val, upb_zzdec_32((uint32_t)raw));
+      break;
+    case UPB_DESCRIPTOR_TYPE_UINT32:
+    case UPB_DESCRIPTOR_TYPE_FIXED32:
+      upb_value_setuint32(&item->val, (uint32_t)raw);
+      break;
+    case UPB_DESCRIPTOR_TYPE_BOOL:
+      upb_value_setbool(&item->val, raw != 0);
+      break;
+    default:
+      break;
+  }
+}
+
+// Decodes the map entry in [p, p+len) and passes it to the field's MAPENTRY
+// handler.  Missing keys and values get their defaults, and like any other
+// message the last of a repeated key or value wins.
+static void decode_mapentry(upb_pbdecoder *d, const upb_hotfield *f,
+                            const char *p, size_t len) {
+  const upb_msgdef *entry = upb_downcast_msgdef(f->subdef);
+  const upb_hotfield *fields[2] = {
+    upb_msgdef_hotfield(entry, 1), upb_msgdef_hotfield(entry, 2)
+  };
+  upb_mapitem items[2];
+  memset(items, 0, sizeof(items));
+  for (int i = 0; i < 2; i++) {
+    setmapitem(&items[i], fields[i]->descriptortype, 0);
+    items[i].str = "";
+  }
+  const char *end = p + len;
+  while (p < end) {
+    uint64_t tag = entry_varint(d, &p, end);
+    uint32_t fieldnum = tag >> 3;
+    uint8_t wire_type = tag & 0x7;
+    uint64_t raw = 0;
+    const char *str = "";
+    size_t strlen = 0;
+    switch (wire_type) {
+      case UPB_WIRE_TYPE_VARINT:
+        raw = entry_varint(d, &p, end);
+        break;
+      case UPB_WIRE_TYPE_64BIT:
+        if (end - p < 8) abortjmp(d, "Bad map entry");
+        memcpy(&raw, p, 8);
+        p += 8;
+        break;
+      case UPB_WIRE_TYPE_32BIT: {
+        uint32_t u32;
+        if (end - p < 4) abortjmp(d, "Bad map entry");
+        memcpy(&u32, p, 4);
+        raw = u32;
+        p += 4;
+        break;
+      }
+      case UPB_WIRE_TYPE_DELIMITED:
+        raw = entry_varint(d, &p, end);
+        if (raw > (uint64_t)(end - p)) abortjmp(d, "Bad map entry");
+        str = p;
+        strlen = raw;
+        p += raw;
+        break;
+      default:
+        abortjmp(d, "Bad map entry");
+    }
+    // Unknown fields are skipped, as are keys or values of the wrong type.
+    if (fieldnum < 1 || fieldnum > 2) continue;
+    const upb_hotfield *field = fields[fieldnum - 1];
+    if (wire_type != upb_pb_types[field->descriptortype].native_wire_type)
+      continue;
+    upb_mapitem *item = &items[fieldnum - 1];
+    setmapitem(item, field->descriptortype, raw);
+    item->str = str;
+    item->len = strlen;
+  }
+  upb_selector_t sel = getselector(f, UPB_HANDLER_MAPENTRY);
+  if (!upb_sink_putmapentry(d->sink, sel, &items[0], &items[1])) halt(d);
+}
+
+// Collects the map entry on top of the stack into mapbuf, across the residual
+// and user buffers, and delivers it once it is complete.  Suspends if the input
+// runs out first.  mapbuf grows as the bytes arrive rather than to the entry's
+// length up front, which the input could make arbitrarily large.
+static void deliver_mapentry(upb_pbdecoder *d) {
+  while (1) {
+    size_t left = d->top->end_ofs - offset(d);
+    size_t n = UPB_MIN(bufleft(d), left);
+    if (d->mapbuf_len + n > d->mapbuf_size) {
+      size_t size = UPB_MAX(d->mapbuf_len + n, d->mapbuf_size * 2);
+      size = UPB_MIN(size, d->mapbuf_len + left);
+      char *buf = upb_pipeline_realloc(d->pipeline, d->mapbuf,
+                                       d->mapbuf_size, size);
+      if (!buf) abortjmp(d, "Out of memory.");
+      d->mapbuf = buf;
+      d->mapbuf_size = size;
+    }
+    if (n > 0) memcpy(d->mapbuf + d->mapbuf_len, d->ptr, n);
+    d->mapbuf_len += n;
+    advance(d, n);
+    if (n == left) {
+      const upb_hotfield *f = d->top->f;
+      d->top--;
+      set_delim_end(d);
+      checkpoint(d);
+      decode_mapentry(d, f, d->mapbuf, d->mapbuf_len);
+      return;
+    }
+    if (in_residual_buf(d, d->ptr) && d->userbuf_remaining) {
+      advancetobuf(d, d->buf_param, d->size_param);
+      d->userbuf_remaining = 0;
+    } else {
+      d->bufstart_ofs = offset(d);
+      d->residual_end = d->residual;
+      suspendjmp(d);
+    }
+  }
+}
+
+static void decode_MESSAGE(upb_pbdecoder *d, const upb_hotfield *f) {
   uint32_t len = decode_v32(d);
+  if (f->is_map &&
+      upb_handlers_hashandler(d->sink->top->h,
+                              getselector(f, UPB_HANDLER_MAPENTRY))) {
+    // The entry goes to a single handler call instead of being pushed as a
+    // submessage.
+    if (len <= bufleft(d)) {
+      const char *entry = d->ptr;
+      advance(d, len);
+      decode_mapentry(d, f, entry, len);
+    } else {
+      d->mapbuf_len = 0;
+      push(d, f, false, false, -1, offset(d) + len);
+      d->top->is_mapentry = true;
+      deliver_mapentry(d);
+    }
+    return;
+  }
   push_msg(d, f, offset(d) + len);
 }
 
-static void decode_STRING(upb_pbdecoder *d, const upb_fielddef *f) {
+// Suspends after a string handler consumed only part of the data it was
+// given.  Everything before d->ptr has been consumed; decode() returns how much
+// of the user's buffer that covers, and the caller must pass the rest again
+// (once downstream can take more) to resume in the middle of the string.
+UPB_NORETURN static void suspend_partial(upb_pbdecoder *d) {
+  d->bufstart_ofs = offset(d);
+  if (in_residual_buf(d, d->ptr)) {
+    // None of the user's buffer was consumed.  Keep the residual bytes that
+    // were not.
+    size_t keep = d->residual_end - d->ptr;
+    memmove(d->residual, d->ptr, keep);
+    d->residual_end = d->residual + keep;
+    d->ret = 0;
+  } else {
+    d->residual_end = d->residual;
+    d->ret = d->ptr - d->buf_param;
+  }
+  suspendjmp(d);
+}
+
+// Delivers string data for the string frame on top of the stack, across the
+// residual and user buffers, and pops the frame when the string is complete.
+// Suspends if the input runs out or if the string handler applies
+// backpressure by consuming less than it was given.
+static void deliver_string(upb_pbdecoder *d) {
+  upb_selector_t sel = getselector(d->top->f, UPB_HANDLER_STRING);
+  while (1) {
+    size_t left = d->top->end_ofs - offset(d);
+    size_t avail = UPB_MIN(bufleft(d), left);
+    if (avail > 0) {
+      size_t n = upb_sink_putstring(d->sink, sel, d->ptr, avail);
+      assert(n <= avail);
+      advance(d, n);
+      if (n < avail) suspend_partial(d);
+      left -= n;
+    }
+    if (left == 0) {
+      pop_string(d);
+      if (in_residual_buf(d, d->ptr) && d->ptr != d->residual) {
+        // Only happens when resuming from suspend_partial(); drop the
+        // consumed residual bytes so that the buffering code can assume the
+        // residual buffer starts at a checkpoint.
+        size_t keep = d->residual_end - d->ptr;
+        d->bufstart_ofs = offset(d);
+        memmove(d->residual, d->ptr, keep);
+        d->residual_end = d->residual + keep;
+        switchtobuf(d, d->residual, d->residual_end);
+      }
+      return;
+    }
+    if (in_residual_buf(d, d->ptr) && d->userbuf_remaining) {
+      advancetobuf(d, d->buf_param, d->size_param);
+      d->userbuf_remaining = 0;
+    } else {
+      // Out of input in the middle of the string.
+      d->bufstart_ofs = offset(d);
+      d->residual_end = d->residual;
+      suspendjmp(d);
+    }
+  }
+}
+
+static void decode_STRING(upb_pbdecoder *d, const upb_hotfield *f) {
   uint32_t strlen = decode_v32(d);
   if (strlen <= bufleft(d)) {
     upb_sink_startstr(d->sink, getselector(f, UPB_HANDLER_STARTSTR), strlen);
+    size_t n = 0;
     if (strlen)
-      upb_sink_putstring(d->sink, getselector(f, UPB_HANDLER_STRING),
-                         d->ptr, strlen);
-    upb_sink_endstr(d->sink, getselector(f, UPB_HANDLER_ENDSTR));
+      n = upb_sink_putstring(d->sink, getselector(f, UPB_HANDLER_STRING),
+                             d->ptr, strlen);
+    if (n < strlen) {
+      // Backpressure; the rest of the string is delivered from a frame like
+      // a string that spans buffers (startstr was already called).
+      push(d, f, false, false, -1, offset(d) + strlen);
+      advance(d, n);
+      suspend_partial(d);
+    }
     advance(d, strlen);
+    if (!upb_sink_endstr(d->sink, getselector(f, UPB_HANDLER_ENDSTR)))
+      halt(d);
   } else {
     // Buffer ends in the middle of the string; need to push a decoder frame
     // for it.
     push_str(d, f, strlen, offset(d) + strlen);
-    if (bufleft(d)) {
-      upb_sink_putstring(d->sink, getselector(f, UPB_HANDLER_STRING),
-                         d->ptr, bufleft(d));
-      advance(d, bufleft(d));
-    }
-    d->bufstart_ofs = offset(d);
-    d->residual_end = d->residual;
-    suspendjmp(d);
+    deliver_string(d);
   }
 }
 
 
 /* The main decoding loop *****************************************************/
 
-static const upb_fielddef *decode_tag(upb_pbdecoder *d) {
+static const upb_hotfield *decode_tag(upb_pbdecoder *d) {
   while (1) {
     uint32_t tag = decode_v32(d);
     uint8_t wire_type = tag & 0x7;
-    uint32_t fieldnum = tag >> 3; const upb_fielddef *f = NULL;
+    uint32_t fieldnum = tag >> 3; const upb_hotfield *f = NULL;
     const upb_handlers *h = d->sink->top->h;  // TODO(haberman): rm
-    f = upb_msgdef_itof(upb_handlers_msgdef(h), fieldnum);
+    f = upb_msgdef_hotfield(upb_handlers_msgdef(h), fieldnum);
     bool packed = false;
 
     if (f) {
       // Wire type check.
-      upb_descriptortype_t type = upb_fielddef_descriptortype(f);
-      if (wire_type == upb_decoder_types[type].native_wire_type) {
+      upb_descriptortype_t type = f->descriptortype;
+      if (wire_type == upb_pb_types[type].native_wire_type) {
         // Wire type is ok.
       } else if ((wire_type == UPB_WIRE_TYPE_DELIMITED &&
-                 upb_decoder_types[type].is_numeric)) {
+                 upb_pb_types[type].is_numeric)) {
         // Wire type is ok (and packed).
         packed = true;
       } else {
@@ -613,7 +960,7 @@ static const upb_fielddef *decode_tag(upb_pbdecoder *d) {
       fr = d->top;
     }
 
-    if (f && upb_fielddef_isseq(f) && !fr->is_sequence) {
+    if (f && upb_hotfield_isseq(f) && !fr->is_sequence) {
       if (packed) {
         uint32_t len = decode_v32(d);
         push_seq(d, f, true, offset(d) + len);
@@ -649,19 +996,101 @@ static const upb_fielddef *decode_tag(upb_pbdecoder *d) {
   }
 }
 
+// Stops decoding because every terminal field has been delivered.  The input
+// after d->ptr is left unconsumed, and so is any input passed later.
+UPB_NORETURN static void terminate(upb_pbdecoder *d) {
+  if (d->top != d->stack) pop_seq(d);
+  upb_status_seteof(decoder_status(d));
+  halt(d);
+}
+
+// Whether the next tag belongs to the top-level message, whose fields are the
+// only ones that can be terminal.
+static bool at_toplevel(const upb_pbdecoder *d) {
+  return d->top == d->stack ||
+         (d->top == d->stack + 1 && d->top->is_sequence);
+}
+
+static void mark_terminal(upb_pbdecoder *d, const upb_hotfield *f) {
+  for (uint32_t i = 0; i < d->terminal_count; i++) {
+    if (d->terminal[i] == f) d->terminal_left &= ~(1ULL << i);
+  }
+}
+
+// Decodes one field of the current message, or one value of the current packed
+// field.
+FORCEINLINE void decode_field(upb_pbdecoder *d) {
+  checkdelim(d);
+  const upb_hotfield *f;
+  bool check_terminal = false;
+  if (d->top->is_packed) {
+    f = d->top->f;
+  } else {
+    if (d->terminal_count > 0 && at_toplevel(d)) {
+      if (d->terminal_left == 0) terminate(d);
+      check_terminal = true;
+    }
+    f = decode_tag(d);
+    // A required field is never repeated, so its message is on top.
+    if (d->check_required && f->label == UPB_LABEL_REQUIRED &&
+        f->required_index < UPB_MAX_REQUIRED) {
+      d->top->required_seen |= 1ULL << f->required_index;
+    }
+  }
+  switch (f->descriptortype) {
+    case UPB_DESCRIPTOR_TYPE_DOUBLE:   decode_DOUBLE(d, f);   break;
+    case UPB_DESCRIPTOR_TYPE_FLOAT:    decode_FLOAT(d, f);    break;
+    case UPB_DESCRIPTOR_TYPE_INT64:    decode_INT64(d, f);    break;
+    case UPB_DESCRIPTOR_TYPE_UINT64:   decode_UINT64(d, f);   break;
+    case UPB_DESCRIPTOR_TYPE_INT32:    decode_INT32(d, f);    break;
+    case UPB_DESCRIPTOR_TYPE_FIXED64:  decode_FIXED64(d, f);  break;
+    case UPB_DESCRIPTOR_TYPE_FIXED32:  decode_FIXED32(d, f);  break;
+    case UPB_DESCRIPTOR_TYPE_BOOL:     decode_BOOL(d, f);     break;
+    case UPB_DESCRIPTOR_TYPE_STRING:   UPB_FALLTHROUGH_INTENDED;
+    case UPB_DESCRIPTOR_TYPE_BYTES:    decode_STRING(d, f);   break;
+    case UPB_DESCRIPTOR_TYPE_GROUP:    decode_GROUP(d, f);    break;
+    case UPB_DESCRIPTOR_TYPE_MESSAGE:  decode_MESSAGE(d, f);  break;
+    case UPB_DESCRIPTOR_TYPE_UINT32:   decode_UINT32(d, f);   break;
+    case UPB_DESCRIPTOR_TYPE_ENUM:     decode_ENUM(d, f);     break;
+    case UPB_DESCRIPTOR_TYPE_SFIXED32: decode_SFIXED32(d, f); break;
+    case UPB_DESCRIPTOR_TYPE_SFIXED64: decode_SFIXED64(d, f); break;
+    case UPB_DESCRIPTOR_TYPE_SINT32:   decode_SINT32(d, f);   break;
+    case UPB_DESCRIPTOR_TYPE_SINT64:   decode_SINT64(d, f);   break;
+  }
+  // Only marked once the value has been delivered, since a value cut off by
+  // the end of the buffer is decoded again from its tag.  Repeated fields are
+  // done after their first element (or first packed run), and submessages
+  // once decoding is back at the top level.
+  if (check_terminal) mark_terminal(d, f);
+  checkpoint(d);
+}
+
 void *start(void *closure, const void *handler_data, size_t size_hint) {
-  UPB_UNUSED(handler_data);
   UPB_UNUSED(size_hint);
   upb_pbdecoder *d = closure;
+  const decoderplan *plan = handler_data;
   assert(d);
   assert(d->sink);
+  d->terminal = plan->terminal;
+  d->terminal_count = plan->terminal_count;
+  d->terminal_left = (1ULL << plan->terminal_count) - 1;
+  d->check_required = plan->check_required;
+  d->top->required_seen = 0;
+  UPB_PROBE2(decode_start, d, size_hint);
   upb_sink_startmsg(d->sink);
   return d;
 }
 
-bool end(void *closure, const void *handler_data) {
-  UPB_UNUSED(handler_data);
-  upb_pbdecoder *d = closure;
+static bool finish(upb_pbdecoder *d) {
+  if (d->finished) {
+    // Stopped early; the rest of the input does not matter.  If a handler
+    // stopped decoding inside a field, the message can't be ended.
+    return d->top == d->stack && upb_sink_endmsg(d->sink);
+  }
+
+  // An error found while decoding the last bytes (like a submessage missing
+  // a required field) does not shorten the count of bytes consumed.
+  if (!upb_ok(decoder_status(d))) return false;
 
   if (d->residual_end > d->residual) {
     // We have preserved bytes.
@@ -680,24 +1109,35 @@ bool end(void *closure, const void *handler_data) {
         decoder_status(d), "Ended inside delimited field.");
     return false;
   }
+  if (d->check_required && !check_required(d)) return false;
   upb_sink_endmsg(d->sink);
   return true;
 }
 
+bool end(void *closure, const void *handler_data) {
+  UPB_UNUSED(handler_data);
+  upb_pbdecoder *d = closure;
+  bool ok = finish(d);
+  UPB_PROBE3(decode_end, d, offset(d), ok);
+  return ok;
+}
+
 size_t decode(void *closure, const void *hd, const char *buf, size_t size) {
   upb_pbdecoder *d = closure;
   const decoderplan *plan = hd;
   UPB_UNUSED(plan);
-  assert(d->sink->top->h == plan->dest_handlers);
+  assert(d->sink->stack[0].h == plan->dest_handlers);
 
-  if (size == 0) return 0;
+  if (size == 0 || d->finished) return 0;
   // Assume we'll consume the whole buffer unless this is overwritten.
   d->ret = size;
   d->buf_param = buf;
   d->size_param = size;
+  UPB_PROBE3(decode_resume, d, size, d->residual_end - d->residual);
 
   if (_setjmp(d->exitjmp)) {
     // Hit end-of-buffer or error.
+    UPB_PROBE3(decode_suspend, d, d->ret, d->residual_end - d->residual);
     return d->ret;
   }
 
@@ -707,72 +1147,130 @@ size_t decode(void *closure, const void *hd, const char *buf, size_t size) {
   } else {
     d->userbuf_remaining = 0;
     advancetobuf(d, buf, d->size_param);
+  }
 
-    if (d->top != d->stack &&
-        upb_fielddef_isstring(d->top->f) &&
-        !d->top->is_sequence) {
-      // Last buffer ended in the middle of a string; deliver more of it.
-      size_t len = d->top->end_ofs - offset(d);
-      if (d->size_param >= len) {
-        upb_sink_putstring(d->sink, getselector(d->top->f, UPB_HANDLER_STRING),
-                           d->ptr, len);
-        advance(d, len);
-        pop_string(d);
-      } else {
-        upb_sink_putstring(d->sink, getselector(d->top->f, UPB_HANDLER_STRING),
-                           d->ptr, d->size_param);
-        advance(d, d->size_param);
-        d->residual_end = d->residual;
-        advancetobuf(d, d->residual, 0);
-        return d->size_param;
-      }
-    }
+  if (d->top != d->stack && d->top->is_mapentry) {
+    // Last buffer ended in the middle of a map entry.
+    const upb_hotfield *f = d->top->f;
+    deliver_mapentry(d);
+    if (d->terminal_count > 0 && at_toplevel(d)) mark_terminal(d, f);
+  } else if (d->top != d->stack &&
+             upb_hotfield_isstring(d->top->f) &&
+             !d->top->is_sequence) {
+    // Last buffer ended in the middle of a string (or the string handler
+    // did not take all of it); deliver more of it.
+    const upb_hotfield *f = d->top->f;
+    deliver_string(d);
+    if (d->terminal_count > 0 && at_toplevel(d)) mark_terminal(d, f);
   }
   checkpoint(d);
 
-  const upb_fielddef *f = d->top->f;
   while(1) {
 #ifdef UPB_USE_JIT_X64
+    UPB_PROBE2(jit_enter, d, offset(d));
     upb_decoder_enterjit(d, plan);
+    UPB_PROBE2(jit_exit, d, offset(d));
     checkpoint(d);
     set_delim_end(d);  // JIT doesn't keep this current.
 #endif
-    checkdelim(d);
-    if (!d->top->is_packed) {
-      f = decode_tag(d);
-    }
+    decode_field(d);
+  }
+}
 
-    switch (upb_fielddef_descriptortype(f)) {
-      case UPB_DESCRIPTOR_TYPE_DOUBLE:   decode_DOUBLE(d, f);   break;
-      case UPB_DESCRIPTOR_TYPE_FLOAT:    decode_FLOAT(d, f);    break;
-      case UPB_DESCRIPTOR_TYPE_INT64:    decode_INT64(d, f);    break;
-      case UPB_DESCRIPTOR_TYPE_UINT64:   decode_UINT64(d, f);   break;
-      case UPB_DESCRIPTOR_TYPE_INT32:    decode_INT32(d, f);    break;
-      case UPB_DESCRIPTOR_TYPE_FIXED64:  decode_FIXED64(d, f);  break;
-      case UPB_DESCRIPTOR_TYPE_FIXED32:  decode_FIXED32(d, f);  break;
-      case UPB_DESCRIPTOR_TYPE_BOOL:     decode_BOOL(d, f);     break;
-      case UPB_DESCRIPTOR_TYPE_STRING:   UPB_FALLTHROUGH_INTENDED;
-      case UPB_DESCRIPTOR_TYPE_BYTES:    decode_STRING(d, f);   break;
-      case UPB_DESCRIPTOR_TYPE_GROUP:    decode_GROUP(d, f);    break;
-      case UPB_DESCRIPTOR_TYPE_MESSAGE:  decode_MESSAGE(d, f);  break;
-      case UPB_DESCRIPTOR_TYPE_UINT32:   decode_UINT32(d, f);   break;
-      case UPB_DESCRIPTOR_TYPE_ENUM:     decode_ENUM(d, f);     break;
-      case UPB_DESCRIPTOR_TYPE_SFIXED32: decode_SFIXED32(d, f); break;
-      case UPB_DESCRIPTOR_TYPE_SFIXED64: decode_SFIXED64(d, f); break;
-      case UPB_DESCRIPTOR_TYPE_SINT32:   decode_SINT32(d, f);   break;
-      case UPB_DESCRIPTOR_TYPE_SINT64:   decode_SINT64(d, f);   break;
+// How many messages upb_pbdecoder_decodebatch() interleaves at once.  Beyond
+// this many outstanding cache misses there is little left to gain, and the
+// decoders of the batch are then likely to evict each other's state.
+#define MAX_BATCH 16
+
+static bool decodebatch(upb_sink *const *sinks, const char *const *bufs,
+                        const size_t *lens, size_t k) {
+  assert(k <= MAX_BATCH);
+  upb_pbdecoder *ds[MAX_BATCH];
+  upb_sink *dsinks[MAX_BATCH];
+  // Updated after _setjmp() returns for the second time, so they must not be
+  // cached in registers.
+  volatile size_t active = 0;
+  volatile bool ok = true;
+
+  for (size_t i = 0; i < k; i++) {
+    if (!upb_sink_startmsg(sinks[i])) {
+      ok = false;
+      continue;
+    }
+    if (!upb_sink_startstr(sinks[i], UPB_BYTESTREAM_BYTES_STARTSTR, lens[i])) {
+      // Don't leave this sink inside a message that will never be ended.
+      upb_sink_endmsg(sinks[i]);
+      ok = false;
+      continue;
     }
+    upb_pbdecoder *d = upb_sink_getobj(sinks[i]);
+    assert(d->residual_end == d->residual);
+    assert(d->top == d->stack);
+    assert(active == 0 ||
+           d->sink->stack[0].h == ds[0]->sink->stack[0].h);
+    d->ret = lens[i];
+    d->buf_param = bufs[i];
+    d->size_param = lens[i];
+    d->userbuf_remaining = 0;
+    advancetobuf(d, bufs[i], lens[i]);
     checkpoint(d);
+    ds[active] = d;
+    dsinks[active] = sinks[i];
+    active++;
+  }
+
+  // Round-robin, one field per message per turn.  A decoder leaves the batch
+  // when it longjmps out, which for a complete buffer happens at its end (or
+  // on error).
+  volatile size_t i = 0;
+  while (active > 0) {
+    if (i >= active) i = 0;
+    upb_pbdecoder *d = ds[i];
+    if (_setjmp(d->exitjmp)) {
+      upb_sink *sink = dsinks[i];
+      ok &= upb_ok(decoder_status(d)) &&
+            upb_sink_endstr(sink, UPB_BYTESTREAM_BYTES_ENDSTR) &&
+            upb_sink_endmsg(sink);
+      active--;
+      ds[i] = ds[active];
+      dsinks[i] = dsinks[active];
+      continue;
+    }
+    decode_field(d);
+    // We will not be back to this message until the others have had their
+    // turn, which gives these time to arrive.
+    PREFETCH(d->ptr + 64);
+    PREFETCH(d->sink->top->closure);
+    i++;
+  }
+  return ok;
+}
+
+bool upb_pbdecoder_decodebatch(upb_sink *const *sinks, const char *const *bufs,
+                               const size_t *lens, size_t k) {
+  bool ok = true;
+  for (size_t i = 0; i < k; i += MAX_BATCH) {
+    ok &= decodebatch(sinks + i, bufs + i, lens + i, UPB_MIN(k - i, MAX_BATCH));
   }
+  return ok;
 }
 
-void init(void *_d, upb_pipeline *p) {
-  UPB_UNUSED(p);
+bool init(void *_d, upb_pipeline *p) {
   upb_pbdecoder *d = _d;
-  d->limit = &d->stack[UPB_MAX_NESTING];
+  // Enough for the top-level frame; upb_pbdecoder_resetsink() sizes the stack
+  // for the sink's handlers.
+  d->pipeline = p;
+  d->stack = upb_pipeline_alloc(p, sizeof(frame));
+  if (!d->stack) return false;
+  d->top = d->stack;
+  d->limit = d->stack + 1;
+  d->mapbuf = NULL;
+  d->mapbuf_len = 0;
+  d->mapbuf_size = 0;
   d->sink = NULL;
   // reset() must be called before decoding; this is guaranteed by assert() in
   // start().
+  return true;
 }
 
 void reset(void *_d) {
@@ -780,6 +1278,8 @@ void reset(void *_d) {
   d->top = d->stack;
   d->top->is_sequence = false;
   d->top->is_packed = false;
+  d->top->is_mapentry = false;
+  d->top->required_seen = 0;
   d->top->group_fieldnum = UINT32_MAX;
   d->top->end_ofs = UPB_NONDELIMITED;
   d->bufstart_ofs = 0;
@@ -787,11 +1287,20 @@ void reset(void *_d) {
   d->buf = d->residual;
   d->end = d->residual;
   d->residual_end = d->residual;
+  d->finished = false;
+}
+
+uint64_t upb_pbdecoder_bytesparsed(const upb_pbdecoder *d) {
+  return offset(d);
 }
 
 bool upb_pbdecoder_resetsink(upb_pbdecoder *d, upb_sink* sink) {
   // TODO(haberman): typecheck the sink, and test whether the decoder is in the
   // middle of decoding.  Return false if either assumption is violated.
+  uint32_t depth = upb_handlers_maxdepth(sink->stack[0].h);
+  if (depth == 0) depth = UPB_INITIAL_NESTING;
+  if (depth > (size_t)(d->limit - d->stack) && !resizestack(d, depth))
+    return false;
   d->sink = sink;
   reset(d);
   return true;
@@ -808,23 +1317,107 @@ const upb_frametype *upb_pbdecoder_getframetype() {
   return &upb_pbdecoder_frametype;
 }
 
-const upb_handlers *upb_pbdecoder_gethandlers(const upb_handlers *dest,
-                                              bool allowjit,
-                                              const void *owner) {
+#ifdef UPB_USE_JIT_X64
+static bool hasmapentry_r(const upb_handlers *h, upb_inttable *seen) {
+  if (upb_inttable_lookupptr(seen, h, NULL)) return false;
+  upb_inttable_insertptr(seen, h, upb_value_bool(true));
+  upb_msg_iter i;
+  for(upb_msg_begin(&i, upb_handlers_msgdef(h)); !upb_msg_done(&i);
+      upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    upb_selector_t sel;
+    if (upb_handlers_getselector(f, UPB_HANDLER_MAPENTRY, &sel) &&
+        upb_handlers_gethandler(h, sel)) {
+      return true;
+    }
+    const upb_handlers *sub =
+        upb_fielddef_issubmsg(f) ? upb_handlers_getsubhandlers(h, f) : NULL;
+    if (sub && hasmapentry_r(sub, seen)) return true;
+  }
+  return false;
+}
+
+// The JIT has no map entry fast path, so handlers that rely on it are left to
+// the interpreter.
+static bool hasmapentry(const upb_handlers *h) {
+  upb_inttable seen;
+  upb_inttable_init(&seen, UPB_CTYPE_BOOL);
+  bool ret = hasmapentry_r(h, &seen);
+  upb_inttable_uninit(&seen);
+  return ret;
+}
+#endif
+
+static const upb_handlers *newhandlers(const upb_handlers *dest,
+                                       bool allowjit,
+                                       const upb_fielddef *const *terminal,
+                                       size_t n, bool check_required,
+                                       const void *owner) {
   UPB_UNUSED(allowjit);
   decoderplan *p = malloc(sizeof(*p));
   assert(upb_handlers_isfrozen(dest));
   p->dest_handlers = dest;
   upb_handlers_ref(dest, p);
+  const upb_msgdef *m = upb_handlers_msgdef(dest);
+  assert(n <= UPB_PBDECODER_MAXTERMINAL);
+  p->terminal_count = n;
+  for (size_t i = 0; i < n; i++) {
+    assert(upb_fielddef_msgdef(terminal[i]) == m);
+    p->terminal[i] = upb_msgdef_hotfield(m, upb_fielddef_number(terminal[i]));
+  }
+  p->check_required = check_required;
 #ifdef UPB_USE_JIT_X64
   p->jit_code = NULL;
-  if (allowjit) upb_decoderplan_makejit(p);
+  if (allowjit && !hasmapentry(dest)) upb_decoderplan_makejit(p);
 #endif
 
   upb_handlers *h = upb_handlers_new(
       UPB_BYTESTREAM, &upb_pbdecoder_frametype, owner);
-  upb_handlers_setstartstr(h, UPB_BYTESTREAM_BYTES, start, NULL, NULL);
+  upb_handlers_setstartstr(h, UPB_BYTESTREAM_BYTES, start, p, NULL);
   upb_handlers_setstring(h, UPB_BYTESTREAM_BYTES, decode, p, freeplan);
   upb_handlers_setendstr(h, UPB_BYTESTREAM_BYTES, end, NULL, NULL);
   return h;
 }
+
+const upb_handlers *upb_pbdecoder_gethandlers(const upb_handlers *dest,
+                                              bool allowjit,
+                                              const void *owner) {
+  return newhandlers(dest, allowjit, NULL, 0, false, owner);
+}
+
+const upb_handlers *upb_pbdecoder_getterminalhandlers(
+    const upb_handlers *dest, const upb_fielddef *const *terminal, size_t n,
+    const void *owner) {
+  // The JIT does not check for terminal fields.
+  return newhandlers(dest, false, terminal, n, false, owner);
+}
+
+// Returns true if "h" or any handlers below it are for a message with more
+// required fields than a frame's bitmap can track.
+static bool hastoomanyrequired_r(const upb_handlers *h, upb_inttable *seen) {
+  if (upb_inttable_lookupptr(seen, h, NULL)) return false;
+  upb_inttable_insertptr(seen, h, upb_value_bool(true));
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  for (uint32_t i = 0; i < m->hot_count; i++) {
+    const upb_hotfield *f = &m->hot[i];
+    if (f->label == UPB_LABEL_REQUIRED &&
+        f->required_index >= UPB_MAX_REQUIRED) {
+      return true;
+    }
+    const upb_handlers *sub = upb_fielddef_issubmsg(f->f) ?
+        upb_handlers_getsubhandlers(h, f->f) : NULL;
+    if (sub && hastoomanyrequired_r(sub, seen)) return true;
+  }
+  return false;
+}
+
+const upb_handlers *upb_pbdecoder_getvalidatinghandlers(
+    const upb_handlers *dest, const void *owner) {
+  upb_inttable seen;
+  upb_inttable_init(&seen, UPB_CTYPE_BOOL);
+  bool toomany = hastoomanyrequired_r(dest, &seen);
+  upb_inttable_uninit(&seen);
+  if (toomany) return NULL;
+  // The JIT does not track which required fields it has seen.
+  return newhandlers(dest, false, NULL, 0, true, owner);
+}
@@ -7,6 +7,24 @@
  * upb::Decoder implements a high performance, streaming decoder for protobuf
  * data that works by parsing input data one buffer at a time and calling into
  * a upb::Handlers.
+ *
+ * The decoder honors backpressure: if a string handler consumes fewer bytes
+ * than it was given, the decoder suspends and its own string handler returns
+ * the number of input bytes it has consumed so far.  The caller should pass
+ * the remaining bytes again (once the downstream consumer is ready); decoding
+ * resumes with the unconsumed part of the string.
+ *
+ * A decoder can also stop early, once some given top-level fields have been
+ * seen (see GetTerminalDecoderHandlers()).  This is for callers that only
+ * need a few fields (like a sort or routing key) from a large message.
+ *
+ * Likewise, if a value handler (or an end-of-string handler) returns false,
+ * decoding stops right after that value: the decoder's string handler returns
+ * a short count and consumes nothing more until it is reset.  The handler
+ * should set an error in the pipeline status if stopping is an error.  Only
+ * the interpreter does this: JIT code treats a false return as an error, so
+ * handlers that return false to stop decoding (like upb::pb::Filter's) must
+ * get their decoder handlers with allowjit false.
  */
 
 #ifndef UPB_DECODER_H_
@@ -14,6 +32,9 @@
 
 #include "upb/sink.h"
 
+// The most terminal fields a decoder plan can have.
+#define UPB_PBDECODER_MAXTERMINAL 32
+
 #ifdef __cplusplus
 namespace upb {
 namespace pb {
@@ -33,6 +54,53 @@ inline const upb::Handlers *GetDecoderHandlers(const upb::Handlers *dest,
                                                bool allowjit,
                                                const void *owner);
 
+// Like GetDecoderHandlers(), but decoding stops as soon as each of the "n"
+// given "terminal" fields (fields of dest's message type, at most
+// UPB_PBDECODER_MAXTERMINAL) has been delivered at the top level; a repeated
+// field counts once its first element (or first packed run) is delivered.
+//
+// The decoder's string handler then returns a short count, covering only the
+// input up to the end of the last terminal field (plus any unknown fields
+// before it), and consumes nothing more until it is reset.  This is not an
+// error: the pipeline status has its EOF flag set, and the end of the string
+// still calls EndMessage() on the destination.  BytesParsed() gives the
+// offset in the stream where decoding stopped.  These handlers are never JIT'd.
+inline const upb::Handlers *GetTerminalDecoderHandlers(
+    const upb::Handlers *dest, const upb::FieldDef *const *terminal, size_t n,
+    const void *owner);
+
+// Like GetDecoderHandlers(), but the decoder also checks that every message
+// has all of its required fields, as proto2's IsInitialized() does after
+// parsing.  The check costs a bit per required field in each decoder frame:
+// the decoder sets the field's bit when it sees the field, and compares the
+// frame against Handlers::RequiredMask() when the message ends.  A missing
+// field is an error in the pipeline status that gives the path to it, like
+// "Missing required field inner.name".  These handlers are never JIT'd.
+// Returns NULL if any message reachable from "dest" has more than
+// UPB_MAX_REQUIRED required fields, since those could not all be checked.
+inline const upb::Handlers *GetValidatingDecoderHandlers(
+    const upb::Handlers *dest, const void *owner);
+
+// The stream offset up to which the decoder has consumed its input.
+inline uint64_t BytesParsed(const Decoder* d);
+
+// Decodes "k" complete, independent messages, each from its own buffer into
+// its own decoder sink.  The sinks may come from different pipelines but must
+// all use the same decoder handlers, and must be freshly reset.
+//
+// The messages are decoded round-robin, one field at a time, so that the
+// cache misses of the different messages (on their input and on the objects
+// their handlers write to) overlap instead of being taken one after another.
+// This gives higher total throughput for batches of small messages.  Large
+// batches are interleaved a group at a time.  The JIT is not used, and since
+// every buffer is decoded to its end, string handlers must not apply
+// backpressure.
+//
+// Returns true if every message was decoded successfully; otherwise the
+// errors are in the statuses of the corresponding pipelines.
+inline bool DecodeBatch(Sink* const* sinks, const char* const* bufs,
+                        const size_t* lens, size_t k);
+
 // Returns true if these handlers represent a upb::pb::Decoder.
 bool IsDecoder(const upb::Handlers *h);
 
@@ -59,6 +127,14 @@ bool upb_pbdecoder_resetsink(upb_pbdecoder *d, upb_sink *sink);
 const upb_handlers *upb_pbdecoder_gethandlers(const upb_handlers *dest,
                                               bool allowjit,
                                               const void *owner);
+const upb_handlers *upb_pbdecoder_getterminalhandlers(
+    const upb_handlers *dest, const upb_fielddef *const *terminal, size_t n,
+    const void *owner);
+const upb_handlers *upb_pbdecoder_getvalidatinghandlers(
+    const upb_handlers *dest, const void *owner);
+uint64_t upb_pbdecoder_bytesparsed(const upb_pbdecoder *d);
+bool upb_pbdecoder_decodebatch(upb_sink *const *sinks, const char *const *bufs,
+                               const size_t *lens, size_t k);
 bool upb_pbdecoder_isdecoder(const upb_handlers *h);
 bool upb_pbdecoder_hasjitcode(const upb_handlers *h);
 const upb_handlers *upb_pbdecoder_getdesthandlers(const upb_handlers *h);
@@ -79,6 +155,22 @@ inline const upb::Handlers* GetDecoderHandlers(const upb::Handlers* dest,
                                                const void* owner) {
   return upb_pbdecoder_gethandlers(dest, allowjit, owner);
 }
+inline const upb::Handlers* GetTerminalDecoderHandlers(
+    const upb::Handlers* dest, const upb::FieldDef* const* terminal, size_t n,
+    const void* owner) {
+  return upb_pbdecoder_getterminalhandlers(dest, terminal, n, owner);
+}
+inline const upb::Handlers* GetValidatingDecoderHandlers(
+    const upb::Handlers* dest, const void* owner) {
+  return upb_pbdecoder_getvalidatinghandlers(dest, owner);
+}
+inline uint64_t BytesParsed(const Decoder* d) {
+  return upb_pbdecoder_bytesparsed(d);
+}
+inline bool DecodeBatch(Sink* const* sinks, const char* const* bufs,
+                        const size_t* lens, size_t k) {
+  return upb_pbdecoder_decodebatch(sinks, bufs, lens, k);
+}
 inline bool IsDecoder(const upb::Handlers* h) {
   return upb_pbdecoder_isdecoder(h);
 }
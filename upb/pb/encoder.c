@@ -1,54 +1,42 @@
 /*
  * upb - a minimalist implementation of protocol buffers.
  *
- * Copyright (c) 2009 Google Inc.  See LICENSE for details.
+ * Copyright (c) 2009-2013 Google Inc.  See LICENSE for details.
  * Author: Josh Haberman <jhaberman@gmail.com>
  */
 
 #include "upb/pb/encoder.h"
 
 #include <stdlib.h>
-#include "upb/descriptor.h"
+#include <string.h>
+#include "upb/pb/varint.h"
+#include "upb/shim/shim.h"
+#include "upb/table.h"
+
+#define FORCEINLINE static inline __attribute__((always_inline))
+#define NOINLINE static __attribute__((noinline))
 
 /* Functions for calculating sizes of wire values. ****************************/
 
 static size_t upb_v_uint64_t_size(uint64_t val) {
 #ifdef __GNUC__
-  int high_bit = 63 - __builtin_clzll(val);  // 0-based, undef if val == 0.
+  int high_bit = 63 - __builtin_clzll(val | 1);  // 0-based, 0 if val == 0.
 #else
   int high_bit = 0;
   uint64_t tmp = val;
   while(tmp >>= 1) high_bit++;
 #endif
-  return val == 0 ? 1 : high_bit / 7 + 1;
-}
-
-static size_t upb_v_int32_t_size(int32_t val) {
-  // v_uint32's are sign-extended to maintain wire compatibility with int64s.
-  return upb_v_uint64_t_size((int64_t)val);
-}
-static size_t upb_v_uint32_t_size(uint32_t val) {
-  return upb_v_uint64_t_size(val);
-}
-static size_t upb_f_uint64_t_size(uint64_t val) {
-  (void)val;  // Length is independent of value.
-  return sizeof(uint64_t);
-}
-static size_t upb_f_uint32_t_size(uint32_t val) {
-  (void)val;  // Length is independent of value.
-  return sizeof(uint32_t);
+  return high_bit / 7 + 1;
 }
 
 
 /* Functions to write wire values. ********************************************/
 
-// Since we know in advance the longest that the value could be, we always make
-// sure that our buffer is long enough.  This saves us from having to perform
-// bounds checks.
+// These write at "buf", which the caller has made long enough, and return the
+// end of what they wrote.
 
 // Puts a varint (wire type: UPB_WIRE_TYPE_VARINT).
-static uint8_t *upb_put_v_uint64_t(uint8_t *buf, uint64_t val)
-{
+static char *upb_put_v_uint64_t(char *buf, uint64_t val) {
   do {
     uint8_t byte = val & 0x7f;
     val >>= 7;
@@ -58,364 +46,513 @@ static uint8_t *upb_put_v_uint64_t(uint8_t *buf, uint64_t val)
   return buf;
 }
 
-// Puts an unsigned 32-bit varint, verbatim.  Never uses the high 64 bits.
-static uint8_t *upb_put_v_uint32_t(uint8_t *buf, uint32_t val)
-{
-  return upb_put_v_uint64_t(buf, val);
-}
-
-// Puts a signed 32-bit varint, first sign-extending to 64-bits.  We do this to
-// maintain wire-compatibility with 64-bit signed integers.
-static uint8_t *upb_put_v_int32_t(uint8_t *buf, int32_t val)
-{
-  return upb_put_v_uint64_t(buf, (int64_t)val);
-}
-
-static void upb_put32(uint8_t *buf, uint32_t val) {
+// Puts a fixed-length 32-bit integer (wire type: UPB_WIRE_TYPE_32BIT).
+static char *upb_put_f_uint32_t(char *buf, uint32_t val) {
   buf[0] = val & 0xff;
   buf[1] = (val >> 8) & 0xff;
   buf[2] = (val >> 16) & 0xff;
   buf[3] = (val >> 24);
-}
-
-// Puts a fixed-length 32-bit integer (wire type: UPB_WIRE_TYPE_32BIT).
-static uint8_t *upb_put_f_uint32_t(uint8_t *buf, uint32_t val)
-{
-  uint8_t *uint32_end = buf + sizeof(uint32_t);
-#if UPB_UNALIGNED_READS_OK
-  *(uint32_t*)buf = val;
-#else
-  upb_put32(buf, val);
-#endif
-  return uint32_end;
+  return buf + sizeof(uint32_t);
 }
 
 // Puts a fixed-length 64-bit integer (wire type: UPB_WIRE_TYPE_64BIT).
-static uint8_t *upb_put_f_uint64_t(uint8_t *buf, uint64_t val)
-{
-  uint8_t *uint64_end = buf + sizeof(uint64_t);
-#if UPB_UNALIGNED_READS_OK
-  *(uint64_t*)buf = val;
-#else
-  upb_put32(buf, (uint32_t)val);
-  upb_put32(buf, (uint32_t)(val >> 32));
-#endif
-  return uint64_end;
+static char *upb_put_f_uint64_t(char *buf, uint64_t val) {
+  upb_put_f_uint32_t(buf, (uint32_t)val);
+  return upb_put_f_uint32_t(buf + sizeof(uint32_t), (uint32_t)(val >> 32));
 }
 
-/* Functions to write and calculate sizes for .proto values. ******************/
+// The longest that a tag and a primitive value can be together.
+#define MAX_VALUE_SIZE (5 + UPB_PB_VARINT_MAX_LEN)
+
+// Wire type of each descriptor type.
+static const uint8_t wiretypes[] = {
+  0,
+  UPB_WIRE_TYPE_64BIT,        // DOUBLE
+  UPB_WIRE_TYPE_32BIT,        // FLOAT
+  UPB_WIRE_TYPE_VARINT,       // INT64
+  UPB_WIRE_TYPE_VARINT,       // UINT64
+  UPB_WIRE_TYPE_VARINT,       // INT32
+  UPB_WIRE_TYPE_64BIT,        // FIXED64
+  UPB_WIRE_TYPE_32BIT,        // FIXED32
+  UPB_WIRE_TYPE_VARINT,       // BOOL
+  UPB_WIRE_TYPE_DELIMITED,    // STRING
+  UPB_WIRE_TYPE_START_GROUP,  // GROUP
+  UPB_WIRE_TYPE_DELIMITED,    // MESSAGE
+  UPB_WIRE_TYPE_DELIMITED,    // BYTES
+  UPB_WIRE_TYPE_VARINT,       // UINT32
+  UPB_WIRE_TYPE_VARINT,       // ENUM
+  UPB_WIRE_TYPE_32BIT,        // SFIXED32
+  UPB_WIRE_TYPE_64BIT,        // SFIXED64
+  UPB_WIRE_TYPE_VARINT,       // SINT32
+  UPB_WIRE_TYPE_VARINT,       // SINT64
+};
+
 
-// Performs zig-zag encoding, which is used by sint32 and sint64.
-static uint32_t upb_zzenc_32(int32_t n) { return (n << 1) ^ (n >> 31); }
-static uint64_t upb_zzenc_64(int64_t n) { return (n << 1) ^ (n >> 63); }
+/* Encoding plans *************************************************************/
 
-/* Use macros to define a set of two functions for each .proto type:
- *
- *  // Converts and writes a .proto value into buf.  "end" indicates the end
- *  // of the current available buffer (if the buffer does not contain enough
- *  // space UPB_STATUS_NEED_MORE_DATA is returned).  On success, *outbuf will
- *  // point one past the data that was written.
- *  uint8_t *upb_put_INT32(uint8_t *buf, int32_t val);
- *
- *  // Returns the number of bytes required to encode val.
- *  size_t upb_get_INT32_size(int32_t val);
- *
- *  // Given a .proto value s (source) convert it to a wire value.
- *  uint32_t upb_vtowv_INT32(int32_t s);
- */
+// The encoder does not look at handlers or defs while encoding; it follows a
+// plan for each message, built from the shims' offsets and hasbits.
 
-#define VTOWV(type, wire_t, val_t) \
-  static wire_t upb_vtowv_ ## type(val_t s)
+typedef struct msgplan msgplan;
+
+typedef struct {
+  uint32_t tag;            // For groups, the START_GROUP tag.
+  uint8_t tagsize;         // Encoded size of the tag.
+  uint8_t fixedsize;       // For 32 and 64-bit values, with the tag; else 0.
+  uint8_t descriptortype;  // upb_descriptortype_t
+  bool repeated;
+  int32_t hasbit;          // -1 if none.
+  size_t offset;
+  size_t elemsize;         // Size of the field's C type.
+  const msgplan *sub;      // For submessages and groups.
+} fieldplan;
+
+struct msgplan {
+  fieldplan *fields;       // In descending order of number.
+  int field_count;
+};
+
+struct upb_pbencoder {
+  upb_inttable plans;      // upb_handlers* -> msgplan*, for every message.
+  const msgplan *top;
+};
 
-#define PUT(type, v_or_f, wire_t, val_t, member_name) \
-  static uint8_t *upb_put_ ## type(uint8_t *buf, val_t val) { \
-    wire_t tmp = upb_vtowv_ ## type(val); \
-    return upb_put_ ## v_or_f ## _ ## wire_t(buf, tmp); \
+static size_t elemsize(const upb_fielddef *f) {
+  if (upb_fielddef_isstring(f)) return sizeof(upb_shim_str);
+  if (upb_fielddef_issubmsg(f)) return sizeof(void*);
+  switch (upb_fielddef_type(f)) {
+    case UPB_TYPE_BOOL: return sizeof(bool);
+    case UPB_TYPE_DOUBLE:
+    case UPB_TYPE_INT64:
+    case UPB_TYPE_UINT64: return sizeof(uint64_t);
+    default: return sizeof(uint32_t);
   }
+}
 
-#define T(type, v_or_f, wire_t, val_t, member_name) \
-  static size_t upb_get_ ## type ## _size(val_t val) { \
-    return upb_ ## v_or_f ## _ ## wire_t ## _size(val); \
-  } \
-  VTOWV(type, wire_t, val_t);  /* prototype for PUT below */ \
-  PUT(type, v_or_f, wire_t, val_t, member_name) \
-  VTOWV(type, wire_t, val_t)
-
-T(INT32,    v,  int32_t, int32_t,  int32)   { return (uint32_t)s;     }
-T(INT64,    v, uint64_t, int64_t,  int64)   { return (uint64_t)s;     }
-T(UINT32,   v, uint32_t, uint32_t, uint32)  { return s;               }
-T(UINT64,   v, uint64_t, uint64_t, uint64)  { return s;               }
-T(SINT32,   v, uint32_t, int32_t,  int32)   { return upb_zzenc_32(s); }
-T(SINT64,   v, uint64_t, int64_t,  int64)   { return upb_zzenc_64(s); }
-T(FIXED32,  f, uint32_t, uint32_t, uint32)  { return s;               }
-T(FIXED64,  f, uint64_t, uint64_t, uint64)  { return s;               }
-T(SFIXED32, f, uint32_t, int32_t,  int32)   { return (uint32_t)s;     }
-T(SFIXED64, f, uint64_t, int64_t,  int64)   { return (uint64_t)s;     }
-T(BOOL,     v, uint32_t, bool,     _bool)   { return (uint32_t)s;     }
-T(ENUM,     v, uint32_t, int32_t,  int32)   { return (uint32_t)s;     }
-T(DOUBLE,   f, uint64_t, double,   _double) {
-  upb_value v;
-  v._double = s;
-  return v.uint64;
+static int cmp_fields(const void *_a, const void *_b) {
+  const fieldplan *a = _a, *b = _b;
+  return a->tag > b->tag ? -1 : 1;
 }
-T(FLOAT,    f, uint32_t, float,    _float)  {
+
+static bool hasmapentry(const upb_handlers *h, const upb_fielddef *f) {
+  upb_selector_t sel;
+  return upb_handlers_getselector(f, UPB_HANDLER_MAPENTRY, &sel) &&
+         upb_handlers_gethandler(h, sel);
+}
+
+// Returns the plan for the messages of "h", building it if necessary.
+static const msgplan *getplan(upb_pbencoder *e, const upb_handlers *h,
+                              upb_status *status) {
   upb_value v;
-  v._float = s;
-  return v.uint32;
+  if (upb_inttable_lookupptr(&e->plans, h, &v)) return upb_value_getptr(v);
+
+  // The plan is in the table before its fields are, for recursive messages.
+  const upb_msgdef *md = upb_handlers_msgdef(h);
+  msgplan *m = malloc(sizeof(*m));
+  if (!m) goto oom;
+  m->field_count = 0;
+  int n = upb_msgdef_numfields(md);
+  m->fields = malloc(UPB_MAX(1, n) * sizeof(fieldplan));
+  if (!m->fields) {
+    free(m);
+    goto oom;
+  }
+  if (!upb_inttable_insertptr(&e->plans, h, upb_value_ptr(m))) {
+    free(m->fields);
+    free(m);
+    goto oom;
+  }
+
+  upb_msg_iter i;
+  for (upb_msg_begin(&i, md); !upb_msg_done(&i); upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    if (hasmapentry(h, f)) {
+      upb_status_seterrliteral(status, "Map shims cannot be encoded");
+      return NULL;
+    }
+    const upb_shim_data *d = upb_shim_getfielddata(h, f);
+    const upb_handlers *sub =
+        upb_fielddef_issubmsg(f) ? upb_handlers_getsubhandlers(h, f) : NULL;
+    if (!d || (upb_fielddef_issubmsg(f) && !sub)) continue;
+
+    fieldplan *p = &m->fields[m->field_count++];
+    p->descriptortype = upb_fielddef_descriptortype(f);
+    p->tag = upb_fielddef_number(f) << 3 | wiretypes[p->descriptortype];
+    p->tagsize = upb_v_uint64_t_size(p->tag);
+    switch (p->tag & 7) {
+      case UPB_WIRE_TYPE_64BIT: p->fixedsize = p->tagsize + 8; break;
+      case UPB_WIRE_TYPE_32BIT: p->fixedsize = p->tagsize + 4; break;
+      default: p->fixedsize = 0;
+    }
+    p->repeated = upb_fielddef_isseq(f);
+    p->hasbit = p->repeated ? -1 : d->hasbit;
+    p->offset = d->offset;
+    p->elemsize = elemsize(f);
+    p->sub = NULL;
+    if (sub && !(p->sub = getplan(e, sub, status))) return NULL;
+  }
+  qsort(m->fields, m->field_count, sizeof(fieldplan), cmp_fields);
+  return m;
+
+oom:
+  upb_status_seterrliteral(status, "Out of memory");
+  return NULL;
 }
-#undef VTOWV
-#undef PUT
-#undef T
-
-static uint8_t *upb_encode_value(uint8_t *buf, upb_field_type_t ft, upb_value v)
-{
-#define CASE(t, member_name) \
-  case UPB_TYPE(t): return upb_put_ ## t(buf, v.member_name);
-  switch(ft) {
-    CASE(DOUBLE,   _double)
-    CASE(FLOAT,    _float)
-    CASE(INT32,    int32)
-    CASE(INT64,    int64)
-    CASE(UINT32,   uint32)
-    CASE(UINT64,   uint64)
-    CASE(SINT32,   int32)
-    CASE(SINT64,   int64)
-    CASE(FIXED32,  uint32)
-    CASE(FIXED64,  uint64)
-    CASE(SFIXED32, int32)
-    CASE(SFIXED64, int64)
-    CASE(BOOL,     _bool)
-    CASE(ENUM,     int32)
-    default: assert(false); return buf;
+
+upb_pbencoder *upb_pbencoder_new(const upb_handlers *h, upb_status *status) {
+  assert(upb_handlers_isfrozen(h));
+  upb_pbencoder *e = malloc(sizeof(*e));
+  if (!e || !upb_inttable_init(&e->plans, UPB_CTYPE_PTR)) {
+    free(e);
+    upb_status_seterrliteral(status, "Out of memory");
+    return NULL;
+  }
+  if (!(e->top = getplan(e, h, status))) {
+    upb_pbencoder_free(e);
+    return NULL;
   }
-#undef CASE
+  return e;
 }
 
-static uint32_t _upb_get_value_size(upb_field_type_t ft, upb_value v)
-{
-#define CASE(t, member_name) \
-  case UPB_TYPE(t): return upb_get_ ## t ## _size(v.member_name);
-  switch(ft) {
-    CASE(DOUBLE,   _double)
-    CASE(FLOAT,    _float)
-    CASE(INT32,    int32)
-    CASE(INT64,    int64)
-    CASE(UINT32,   uint32)
-    CASE(UINT64,   uint64)
-    CASE(SINT32,   int32)
-    CASE(SINT64,   int64)
-    CASE(FIXED32,  uint32)
-    CASE(FIXED64,  uint64)
-    CASE(SFIXED32, int32)
-    CASE(SFIXED64, int64)
-    CASE(BOOL,     _bool)
-    CASE(ENUM,     int32)
-    default: assert(false); return 0;
+void upb_pbencoder_free(upb_pbencoder *e) {
+  upb_inttable_iter i;
+  upb_inttable_begin(&i, &e->plans);
+  for(; !upb_inttable_done(&i); upb_inttable_next(&i)) {
+    msgplan *m = upb_value_getptr(upb_inttable_iter_value(&i));
+    free(m->fields);
+    free(m);
   }
-#undef CASE
+  upb_inttable_uninit(&e->plans);
+  free(e);
 }
 
-static uint8_t *_upb_put_tag(uint8_t *buf, upb_field_number_t num,
-                             upb_wire_type_t wt)
-{
-  return upb_put_UINT32(buf, wt | (num << 3));
+
+/* upb_pbencbuf ***************************************************************/
+
+void upb_pbencbuf_init(upb_pbencbuf *buf) {
+  buf->start = NULL;
+  buf->ptr = NULL;
+  buf->end = NULL;
 }
 
-static uint32_t _upb_get_tag_size(upb_field_number_t num)
-{
-  return upb_get_UINT32_size(num << 3);
+void upb_pbencbuf_uninit(upb_pbencbuf *buf) {
+  free(buf->start);
 }
 
+const char *upb_pbencbuf_data(const upb_pbencbuf *buf) {
+  return buf->ptr;
+}
 
-/* upb_sizebuilder ************************************************************/
+size_t upb_pbencbuf_len(const upb_pbencbuf *buf) {
+  return buf->end - buf->ptr;
+}
 
-struct upb_sizebuilder {
-  // Accumulating size for the current level.
-  uint32_t size;
 
-  // Stack of sizes for our current nesting.
-  uint32_t stack[UPB_MAX_NESTING], *top;
+/* Encoding *******************************************************************/
+
+typedef struct {
+  upb_pbencbuf *buf;
+  upb_status *status;
+  int depth;
+} encstate;
+
+// Moves the output to the end of a bigger buffer.
+NOINLINE bool grow(encstate *e, size_t n) {
+  upb_pbencbuf *b = e->buf;
+  size_t len = upb_pbencbuf_len(b);
+  size_t size = UPB_MAX(128, (b->end - b->start) * 2);
+  size = UPB_MAX(size, len + n);
+  char *start = malloc(size);
+  if (!start) {
+    upb_status_seterrliteral(e->status, "Out of memory");
+    return false;
+  }
+  if (len > 0) memcpy(start + size - len, b->ptr, len);
+  free(b->start);
+  b->start = start;
+  b->end = start + size;
+  b->ptr = b->end - len;
+  return true;
+}
 
-  // Vector of sizes.
-  uint32_t *sizes;
-  int sizes_len;
-  int sizes_size;
+// Makes room for "n" bytes before the output.  When not "checked", the
+// caller has already made sure that the whole message fits.
+FORCEINLINE bool reserve(encstate *e, size_t n, bool checked) {
+  return !checked || (size_t)(e->buf->ptr - e->buf->start) >= n ||
+         grow(e, n);
+}
 
-  upb_status status;
-};
+// These put a value before the output, which must have room for it.
+FORCEINLINE void putvarint(upb_pbencbuf *b, uint64_t val) {
+  b->ptr -= upb_v_uint64_t_size(val);
+  upb_put_v_uint64_t(b->ptr, val);
+}
 
-// upb_sink callbacks.
-static upb_sink_status _upb_sizebuilder_valuecb(upb_sink *sink, upb_fielddef *f,
-                                                upb_value val,
-                                                upb_status *status)
-{
-  (void)status;
-  upb_sizebuilder *sb = (upb_sizebuilder*)sink;
-  uint32_t size = 0;
-  size += _upb_get_tag_size(f->number);
-  size += _upb_get_value_size(f->type, val);
-  sb->size += size;
-  return UPB_SINK_CONTINUE;
+FORCEINLINE void putfixed32(upb_pbencbuf *b, uint32_t val) {
+  b->ptr -= sizeof(uint32_t);
+  upb_put_f_uint32_t(b->ptr, val);
 }
 
-static upb_sink_status _upb_sizebuilder_strcb(upb_sink *sink, upb_fielddef *f,
-                                              upb_strptr str,
-                                              int32_t start, uint32_t end,
-                                              upb_status *status)
-{
-  (void)status;
-  (void)str;   // String data itself is not used.
-  upb_sizebuilder *sb = (upb_sizebuilder*)sink;
-  if(start >= 0) {
-    uint32_t size = 0;
-    size += _upb_get_tag_size(f->number);
-    size += upb_get_UINT32_size(end - start);
-    sb->size += size;
-  }
-  return UPB_SINK_CONTINUE;
+FORCEINLINE void putfixed64(upb_pbencbuf *b, uint64_t val) {
+  b->ptr -= sizeof(uint64_t);
+  upb_put_f_uint64_t(b->ptr, val);
 }
 
-static upb_sink_status _upb_sizebuilder_startcb(upb_sink *sink, upb_fielddef *f,
-                                                upb_status *status)
-{
-  (void)status;
-  (void)f;  // Unused (we calculate tag size and delimiter in endcb).
-  upb_sizebuilder *sb = (upb_sizebuilder*)sink;
-  if(f->type == UPB_TYPE(MESSAGE)) {
-    *sb->top = sb->size;
-    sb->top++;
-    sb->size = 0;
-  } else {
-    assert(f->type == UPB_TYPE(GROUP));
-    sb->size += _upb_get_tag_size(f->number);
+// Returns the varint that a varint-typed primitive at "p" is written as.
+FORCEINLINE uint64_t varintval(const fieldplan *f, const char *p) {
+  switch (f->descriptortype) {
+    case UPB_DESCRIPTOR_TYPE_INT64:
+    case UPB_DESCRIPTOR_TYPE_UINT64:
+      return *(const uint64_t*)p;
+    // Negative int32s are sign-extended, for compatibility with int64.
+    case UPB_DESCRIPTOR_TYPE_INT32:
+    case UPB_DESCRIPTOR_TYPE_ENUM:
+      return (int64_t)*(const int32_t*)p;
+    case UPB_DESCRIPTOR_TYPE_UINT32:
+      return *(const uint32_t*)p;
+    case UPB_DESCRIPTOR_TYPE_SINT32:
+      return upb_zzenc_32(*(const int32_t*)p);
+    case UPB_DESCRIPTOR_TYPE_SINT64:
+      return upb_zzenc_64(*(const int64_t*)p);
+    default:
+      assert(f->descriptortype == UPB_DESCRIPTOR_TYPE_BOOL);
+      return *(const bool*)p;
   }
-  return UPB_SINK_CONTINUE;
 }
 
-static upb_sink_status _upb_sizebuilder_endcb(upb_sink *sink, upb_fielddef *f,
-                                              upb_status *status)
-{
-  (void)status;
-  upb_sizebuilder *sb = (upb_sizebuilder*)sink;
-  if(f->type == UPB_TYPE(MESSAGE)) {
-    sb->top--;
-    if(sb->sizes_len == sb->sizes_size) {
-      sb->sizes_size *= 2;
-      sb->sizes = realloc(sb->sizes, sb->sizes_size * sizeof(*sb->sizes));
+// Puts the tag and value of a primitive field whose C value is at "p".
+static void putprimitive(upb_pbencbuf *b, const fieldplan *f, const char *p) {
+  switch (f->tag & 7) {
+    case UPB_WIRE_TYPE_64BIT: {
+      uint64_t val;
+      memcpy(&val, p, sizeof(val));
+      putfixed64(b, val);
+      break;
     }
-    uint32_t child_size = sb->size;
-    uint32_t parent_size = *sb->top;
-    sb->sizes[sb->sizes_len++] = child_size;
-    // The size according to the parent includes the tag size and delimiter of
-    // the submessage.
-    parent_size += upb_get_UINT32_size(child_size);
-    parent_size += _upb_get_tag_size(f->number);
-    // Include size accumulated in parent before child began.
-    sb->size = child_size + parent_size;
-  } else {
-    assert(f->type == UPB_TYPE(GROUP));
-    // As an optimization, we could just add this number twice in startcb, to
-    // avoid having to recalculate it.
-    sb->size += _upb_get_tag_size(f->number);
+    case UPB_WIRE_TYPE_32BIT: {
+      uint32_t val;
+      memcpy(&val, p, sizeof(val));
+      putfixed32(b, val);
+      break;
+    }
+    default:
+      putvarint(b, varintval(f, p));
   }
-  return UPB_SINK_CONTINUE;
+  putvarint(b, f->tag);
 }
 
-upb_sink_callbacks _upb_sizebuilder_sink_vtbl = {
-  _upb_sizebuilder_valuecb,
-  _upb_sizebuilder_strcb,
-  _upb_sizebuilder_startcb,
-  _upb_sizebuilder_endcb
-};
+// Whether a non-repeated field of "msg" is written.  Without a hasbit, it is
+// if it is nonzero.
+FORCEINLINE bool has(const fieldplan *f, const char *msg) {
+  if (f->hasbit >= 0) return (msg[f->hasbit / 8] & (1 << (f->hasbit % 8)));
+  const char *p = msg + f->offset;
+  switch (f->descriptortype) {
+    case UPB_DESCRIPTOR_TYPE_STRING:
+    case UPB_DESCRIPTOR_TYPE_BYTES:
+      return ((const upb_shim_str*)p)->len > 0;
+    case UPB_DESCRIPTOR_TYPE_MESSAGE:
+    case UPB_DESCRIPTOR_TYPE_GROUP:
+      return *(void *const*)p != NULL;
+  }
+  switch (f->elemsize) {
+    case sizeof(uint64_t): return *(const uint64_t*)p != 0;
+    case sizeof(uint32_t): return *(const uint32_t*)p != 0;
+    default: return *(const bool*)p;
+  }
+}
 
+static bool encode_msg(encstate *e, const msgplan *m, const char *msg);
+static bool encode_msg_unchecked(encstate *e, const msgplan *m,
+                                 const char *msg);
+
+// Puts one value of "f", whose C value is at "p".
+FORCEINLINE bool encode_value(encstate *e, const fieldplan *f, const char *p,
+                              bool checked) {
+  upb_pbencbuf *b = e->buf;
+  const char *sub;
+  switch (f->descriptortype) {
+    case UPB_DESCRIPTOR_TYPE_STRING:
+    case UPB_DESCRIPTOR_TYPE_BYTES: {
+      const upb_shim_str *str = (const upb_shim_str*)p;
+      if (!reserve(e, str->len + MAX_VALUE_SIZE, checked)) return false;
+      b->ptr -= str->len;
+      if (str->len > 0) memcpy(b->ptr, str->ptr, str->len);
+      putvarint(b, str->len);
+      putvarint(b, f->tag);
+      return true;
+    }
+    case UPB_DESCRIPTOR_TYPE_MESSAGE: {
+      // The submessage's length is how much it added to the output.
+      size_t len = upb_pbencbuf_len(b);
+      sub = *(const char *const*)p;
+      if (checked ? !encode_msg(e, f->sub, sub)
+                  : !encode_msg_unchecked(e, f->sub, sub)) {
+        return false;
+      }
+      len = upb_pbencbuf_len(b) - len;
+      if (!reserve(e, MAX_VALUE_SIZE, checked)) return false;
+      putvarint(b, len);
+      putvarint(b, f->tag);
+      return true;
+    }
+    case UPB_DESCRIPTOR_TYPE_GROUP:
+      if (!reserve(e, MAX_VALUE_SIZE, checked)) return false;
+      putvarint(b, f->tag + 1);  // END_GROUP follows START_GROUP.
+      sub = *(const char *const*)p;
+      if (checked ? !encode_msg(e, f->sub, sub)
+                  : !encode_msg_unchecked(e, f->sub, sub)) {
+        return false;
+      }
+      if (!reserve(e, MAX_VALUE_SIZE, checked)) return false;
+      putvarint(b, f->tag);
+      return true;
+    default:
+      if (!reserve(e, MAX_VALUE_SIZE, checked)) return false;
+      putprimitive(b, f, p);
+      return true;
+  }
+}
 
-/* upb_sink callbacks *********************************************************/
+// Puts the fields of "msg", last field first.  A NULL message is empty.
+FORCEINLINE bool encode_msg_(encstate *e, const msgplan *m, const char *msg,
+                             bool checked) {
+  if (!msg) return true;
+  if (checked && ++e->depth > UPB_MAX_NESTING) {
+    upb_status_seterrliteral(e->status, "Nesting too deep.");
+    return false;
+  }
+  for (int i = 0; i < m->field_count; i++) {
+    const fieldplan *f = &m->fields[i];
+    const char *p = msg + f->offset;
+    if (f->repeated) {
+      const upb_shim_arr *arr = (const upb_shim_arr*)p;
+      const char *elems = arr->ptr;
+      for (uint32_t j = arr->len; j > 0; j--) {
+        if (!encode_value(e, f, elems + (j - 1) * f->elemsize, checked))
+          return false;
+      }
+    } else if (has(f, msg)) {
+      if (!encode_value(e, f, p, checked)) return false;
+    }
+  }
+  if (checked) e->depth--;
+  return true;
+}
 
-struct upb_encoder {
-  upb_sink base;
-  //upb_bytesink *bytesink;
-  uint32_t *sizes;
-  int size_offset;
-};
+// Writes into a buffer that grows as needed.
+static bool encode_msg(encstate *e, const msgplan *m, const char *msg) {
+  return encode_msg_(e, m, msg, true);
+}
 
+// Writes into a span that is known to be big enough, and whose nesting has
+// been checked already.
+static bool encode_msg_unchecked(encstate *e, const msgplan *m,
+                                 const char *msg) {
+  return encode_msg_(e, m, msg, false);
+}
 
-// Within one callback we may need to encode up to two separate values.
-#define UPB_ENCODER_BUFSIZE (UPB_MAX_ENCODED_SIZE * 2)
-
-static upb_sink_status _upb_encoder_push_buf(upb_encoder *s, const uint8_t *buf,
-                                             size_t len, upb_status *status)
-{
-  // TODO: conjure a upb_strptr that points to buf.
-  //upb_strptr ptr;
-  (void)s;
-  (void)buf;
-  (void)status;
-  size_t written = 5;// = upb_bytesink_onbytes(s->bytesink, ptr);
-  if(written < len) {
-    // TODO: mark to skip "written" bytes next time.
-    return UPB_SINK_STOP;
-  } else {
-    return UPB_SINK_CONTINUE;
+bool upb_pbencoder_encode(const upb_pbencoder *e, const void *msg,
+                          upb_pbencbuf *buf, upb_status *status) {
+  encstate state;
+  state.buf = buf;
+  state.status = status;
+  state.depth = 0;
+  buf->ptr = buf->end;
+  if (!encode_msg(&state, e->top, msg)) {
+    buf->ptr = buf->end;
+    return false;
   }
+  return true;
 }
 
-static upb_sink_status _upb_encoder_valuecb(upb_sink *sink, upb_fielddef *f,
-                                            upb_value val, upb_status *status)
-{
-  upb_encoder *s = (upb_encoder*)sink;
-  uint8_t buf[UPB_ENCODER_BUFSIZE], *ptr = buf;
-  upb_wire_type_t wt = upb_types[f->type].expected_wire_type;
-  // TODO: handle packed encoding.
-  ptr = _upb_put_tag(ptr, f->number, wt);
-  ptr = upb_encode_value(ptr, f->type, val);
-  return _upb_encoder_push_buf(s, buf, ptr - buf, status);
-}
 
-static upb_sink_status _upb_encoder_strcb(upb_sink *sink, upb_fielddef *f,
-                                          upb_strptr str,
-                                          int32_t start, uint32_t end,
-                                          upb_status *status)
-{
-  upb_encoder *s = (upb_encoder*)sink;
-  uint8_t buf[UPB_ENCODER_BUFSIZE], *ptr = buf;
-  if(start >= 0) {
-    ptr = _upb_put_tag(ptr, f->number, UPB_WIRE_TYPE_DELIMITED);
-    ptr = upb_put_UINT32(ptr, end - start);
+/* Encoding into a span *******************************************************/
+
+NOINLINE bool msgsize(encstate *e, const msgplan *m, const char *msg,
+                      size_t *size);
+
+// Adds the size of one value of "f", whose C value is at "p", to "*size".
+FORCEINLINE bool valuesize(encstate *e, const fieldplan *f, const char *p,
+                           size_t *size) {
+  size_t len = 0;
+  switch (f->descriptortype) {
+    case UPB_DESCRIPTOR_TYPE_STRING:
+    case UPB_DESCRIPTOR_TYPE_BYTES:
+      len = ((const upb_shim_str*)p)->len;
+      *size += f->tagsize + upb_v_uint64_t_size(len) + len;
+      return true;
+    case UPB_DESCRIPTOR_TYPE_MESSAGE:
+      if (!msgsize(e, f->sub, *(const char *const*)p, &len)) return false;
+      *size += f->tagsize + upb_v_uint64_t_size(len) + len;
+      return true;
+    case UPB_DESCRIPTOR_TYPE_GROUP:
+      if (!msgsize(e, f->sub, *(const char *const*)p, &len)) return false;
+      *size += f->tagsize * 2 + len;
+      return true;
   }
-  // TODO: properly handle partially consumed strings and partially supplied
-  // strings.
-  _upb_encoder_push_buf(s, buf, ptr - buf, status);
-  return _upb_encoder_push_buf(s, (uint8_t*)upb_string_getrobuf(str), end - start, status);
+  *size += f->fixedsize ? f->fixedsize
+                        : f->tagsize + upb_v_uint64_t_size(varintval(f, p));
+  return true;
 }
 
-static upb_sink_status _upb_encoder_startcb(upb_sink *sink, upb_fielddef *f,
-                                            upb_status *status)
-{
-  upb_encoder *s = (upb_encoder*)sink;
-  uint8_t buf[UPB_ENCODER_BUFSIZE], *ptr = buf;
-  if(f->type == UPB_TYPE(GROUP)) {
-    ptr = _upb_put_tag(ptr, f->number, UPB_WIRE_TYPE_START_GROUP);
-  } else {
-    ptr = _upb_put_tag(ptr, f->number, UPB_WIRE_TYPE_DELIMITED);
-    ptr = upb_put_UINT32(ptr, s->sizes[--s->size_offset]);
+// Adds the encoded size of "msg" to "*size".  Each submessage's size is
+// computed once, here; the back-to-front write that follows does not need it.
+NOINLINE bool msgsize(encstate *e, const msgplan *m, const char *msg,
+                      size_t *size) {
+  if (!msg) return true;
+  if (++e->depth > UPB_MAX_NESTING) {
+    upb_status_seterrliteral(e->status, "Nesting too deep.");
+    return false;
+  }
+  for (int i = 0; i < m->field_count; i++) {
+    const fieldplan *f = &m->fields[i];
+    const char *p = msg + f->offset;
+    if (f->repeated) {
+      const upb_shim_arr *arr = (const upb_shim_arr*)p;
+      const char *elems = arr->ptr;
+      if (f->fixedsize) {
+        *size += (size_t)arr->len * f->fixedsize;
+        continue;
+      }
+      for (uint32_t j = 0; j < arr->len; j++) {
+        if (!valuesize(e, f, elems + j * f->elemsize, size)) return false;
+      }
+    } else if (has(f, msg) && !valuesize(e, f, p, size)) {
+      return false;
+    }
   }
-  return _upb_encoder_push_buf(s, buf, ptr - buf, status);
+  e->depth--;
+  return true;
 }
 
-static upb_sink_status _upb_encoder_endcb(upb_sink *sink, upb_fielddef *f,
-                                          upb_status *status)
-{
-  upb_encoder *s = (upb_encoder*)sink;
-  uint8_t buf[UPB_ENCODER_BUFSIZE], *ptr = buf;
-  if(f->type != UPB_TYPE(GROUP)) return UPB_SINK_CONTINUE;
-  ptr = _upb_put_tag(ptr, f->number, UPB_WIRE_TYPE_END_GROUP);
-  return _upb_encoder_push_buf(s, buf, ptr - buf, status);
+bool upb_pbencoder_size(const upb_pbencoder *e, const void *msg,
+                        size_t *size, upb_status *status) {
+  encstate state;
+  state.buf = NULL;
+  state.status = status;
+  state.depth = 0;
+  *size = 0;
+  return msgsize(&state, e->top, msg, size);
 }
 
-upb_sink_callbacks _upb_encoder_sink_vtbl = {
-  _upb_encoder_valuecb,
-  _upb_encoder_strcb,
-  _upb_encoder_startcb,
-  _upb_encoder_endcb
-};
-
+bool upb_pbencoder_encodeto(const upb_pbencoder *e, const void *msg,
+                            char *buf, size_t capacity, size_t *len,
+                            upb_status *status) {
+  if (!upb_pbencoder_size(e, msg, len, status)) return false;
+  if (*len > capacity) {
+    upb_status_seterrliteral(status, "Buffer too small");
+    return false;
+  }
+  // Writing back to front from buf + *len leaves the message at "buf".
+  upb_pbencbuf span;
+  span.start = buf;
+  span.ptr = buf + *len;
+  span.end = span.ptr;
+  encstate state;
+  state.buf = &span;
+  state.status = status;
+  state.depth = 0;
+  encode_msg_unchecked(&state, e->top, msg);
+  assert(span.ptr == buf);
+  return true;
+}
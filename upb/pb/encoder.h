@@ -1,58 +1,171 @@
 /*
  * upb - a minimalist implementation of protocol buffers.
  *
- * Copyright (c) 2009-2010 Google Inc.  See LICENSE for details.
+ * Copyright (c) 2009-2013 Google Inc.  See LICENSE for details.
  * Author: Josh Haberman <jhaberman@gmail.com>
  *
- * Implements a set of upb_handlers that write protobuf data to the binary wire
- * format.
+ * upb::pb::Encoder serializes structs that are populated by upb::Shim
+ * handlers (like the ones tools/dump_cstruct.lua generates, or the ones
+ * upb::Shim::SetStruct() lays out at runtime) to the protobuf binary format.
  *
- * For messages that have any submessages, the encoder needs a buffer
- * containing the submessage sizes, so they can be properly written at the
- * front of each message.  Note that groups do *not* have this requirement.
+ * A length-delimited submessage needs its length before its contents, so the
+ * usual encoder makes two passes: one that computes the size of every
+ * submessage (and caches it in the message), and one that writes.  This one
+ * makes a single pass instead, writing the message back to front into a
+ * buffer that grows downward.  Each submessage is written before its length,
+ * at which point the length is just the number of bytes written since.
+ * Fields are visited in descending number order and repeated elements in
+ * reverse, so the output reads in the usual order:
+ *
+ *   upb_pbencoder *e = upb_pbencoder_new(shim_handlers, &status);
+ *   upb_pbencbuf buf;
+ *   upb_pbencbuf_init(&buf);
+ *   if (upb_pbencoder_encode(e, msg, &buf, &status))
+ *     fwrite(upb_pbencbuf_data(&buf), 1, upb_pbencbuf_len(&buf), file);
+ *   upb_pbencbuf_uninit(&buf);
+ *   upb_pbencoder_free(e);
+ *
+ * To write into a span the caller already has (like the tail of a frame),
+ * upb_pbencoder_encodeto() first computes the exact size of the message, and
+ * fails without writing anything if it does not fit.  Otherwise it writes
+ * straight into the span, with no buffer to grow and no bounds checks:
+ *
+ *   size_t len;
+ *   if (!upb_pbencoder_encodeto(e, msg, frame, capacity, &len, &status)) {
+ *     // "len" is the size needed, if the message was too big.
+ *   }
+ *
+ * A non-repeated field is written if its hasbit is set, or if it has no
+ * hasbit and is nonzero (or non-empty, for strings and submessages).
+ * Repeated fields are never packed.  Fields without shims, and unknown
+ * fields, are not written.
  */
 
 #ifndef UPB_ENCODER_H_
 #define UPB_ENCODER_H_
 
-#include "upb/upb.h"
-#include "upb/bytestream.h"
+#include "upb/handlers.h"
 
 #ifdef __cplusplus
-extern "C" {
+namespace upb {
+namespace pb {
+class EncodeBuffer;
+class Encoder;
+}  // namespace pb
+}  // namespace upb
+typedef upb::pb::EncodeBuffer upb_pbencbuf;
+typedef upb::pb::Encoder upb_pbencoder;
+#else
+struct upb_pbencbuf;
+struct upb_pbencoder;
+typedef struct upb_pbencbuf upb_pbencbuf;
+typedef struct upb_pbencoder upb_pbencoder;
 #endif
 
-/* upb_encoder ****************************************************************/
+#ifdef __cplusplus
 
-// A upb_encoder is a upb_sink that emits data to a upb_bytesink in the protocol
-// buffer binary wire format.
-struct upb_encoder;
-typedef struct upb_encoder upb_encoder;
+class upb::pb::Encoder {
+ public:
+  // Returns an encoder for structs populated by the shims in "h" (and its
+  // subhandlers), which must be frozen and must outlive the encoder.  Returns
+  // NULL and sets "status" if a field's shims store it in a way the encoder
+  // cannot read (like a map shim).
+  static Encoder* New(const Handlers* h, Status* status);
+  void Free();
 
-upb_encoder *upb_encoder_new(upb_msgdef *md);
-void upb_encoder_free(upb_encoder *e);
+  // Replaces the contents of "buf" with the serialized "msg".  Returns false
+  // and sets "status" if the buffer could not grow, or if the message nests
+  // deeper than UPB_MAX_NESTING.  The encoder is not modified, so any number
+  // of threads may use it at once.
+  bool Encode(const void* msg, EncodeBuffer* buf, Status* status) const;
 
-// Resets the given upb_encoder such that is is ready to begin encoding,
-// outputting data to "bytesink" (which must live until the encoder is
-// reset or destroyed).
-void upb_encoder_reset(upb_encoder *e, upb_bytesink *bytesink);
+  // Sets "size" to the exact size of the serialized "msg".  Returns false and
+  // sets "status" if the message nests deeper than UPB_MAX_NESTING.
+  bool Size(const void* msg, size_t* size, Status* status) const;
 
-// Returns the upb_sink to which data can be written.  The sink is invalidated
-// when the encoder is reset or destroyed.  Note that if the client wants to
-// encode any length-delimited submessages it must first call
-// upb_encoder_buildsizes() below.
-upb_sink *upb_encoder_sink(upb_encoder *e);
+  // Serializes "msg" to the start of "buf", and sets "len" to its size.
+  // Returns false and sets "status" if it nests too deeply, or if "len" is
+  // greater than "capacity", in which case nothing is written.
+  bool EncodeTo(const void* msg, char* buf, size_t capacity, size_t* len,
+                Status* status) const;
 
-// Call prior to pushing any data with embedded submessages.  "src" must yield
-// exactly the same data as what will next be encoded, but in reverse order.
-// The encoder iterates over this data in order to determine the sizes of the
-// submessages.  If any errors are returned by the upb_src, the status will
-// be saved in *status.  If the client is sure that the upb_src will not throw
-// any errors, "status" may be NULL.
-void upb_encoder_buildsizes(upb_encoder *e, upb_src *src, upb_status *status);
+ private:
+  UPB_DISALLOW_POD_OPS(Encoder);
+};
+
+class upb::pb::EncodeBuffer {
+ public:
+  EncodeBuffer();
+  ~EncodeBuffer();
+
+  // The output of the last Encode(), which is valid until the next one.
+  const char* data() const;
+  size_t size() const;
+
+ private:
+#else
+struct upb_pbencbuf {
+#endif
+  // The output is [ptr, end); [start, ptr) is free for the next bytes.
+  char *start, *ptr, *end;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+upb_pbencoder *upb_pbencoder_new(const upb_handlers *h, upb_status *status);
+void upb_pbencoder_free(upb_pbencoder *e);
+bool upb_pbencoder_encode(const upb_pbencoder *e, const void *msg,
+                          upb_pbencbuf *buf, upb_status *status);
+bool upb_pbencoder_size(const upb_pbencoder *e, const void *msg,
+                        size_t *size, upb_status *status);
+bool upb_pbencoder_encodeto(const upb_pbencoder *e, const void *msg,
+                            char *buf, size_t capacity, size_t *len,
+                            upb_status *status);
+
+void upb_pbencbuf_init(upb_pbencbuf *buf);
+void upb_pbencbuf_uninit(upb_pbencbuf *buf);
+const char *upb_pbencbuf_data(const upb_pbencbuf *buf);
+size_t upb_pbencbuf_len(const upb_pbencbuf *buf);
 
 #ifdef __cplusplus
 }  /* extern "C" */
+
+namespace upb {
+namespace pb {
+
+inline Encoder* Encoder::New(const Handlers* h, Status* status) {
+  return upb_pbencoder_new(h, status);
+}
+inline void Encoder::Free() {
+  upb_pbencoder_free(this);
+}
+inline bool Encoder::Encode(const void* msg, EncodeBuffer* buf,
+                            Status* status) const {
+  return upb_pbencoder_encode(this, msg, buf, status);
+}
+inline bool Encoder::Size(const void* msg, size_t* size,
+                          Status* status) const {
+  return upb_pbencoder_size(this, msg, size, status);
+}
+inline bool Encoder::EncodeTo(const void* msg, char* buf, size_t capacity,
+                              size_t* len, Status* status) const {
+  return upb_pbencoder_encodeto(this, msg, buf, capacity, len, status);
+}
+
+inline EncodeBuffer::EncodeBuffer() { upb_pbencbuf_init(this); }
+inline EncodeBuffer::~EncodeBuffer() { upb_pbencbuf_uninit(this); }
+inline const char* EncodeBuffer::data() const {
+  return upb_pbencbuf_data(this);
+}
+inline size_t EncodeBuffer::size() const {
+  return upb_pbencbuf_len(this);
+}
+
+}  // namespace pb
+}  // namespace upb
+
 #endif
 
 #endif  /* UPB_ENCODER_H_ */
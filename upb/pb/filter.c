@@ -0,0 +1,533 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ */
+
+#include "upb/pb/filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/pb/decoder.h"
+
+typedef enum {
+  PRED_UNKNOWN = 0,
+  PRED_FALSE = 1,
+  PRED_TRUE = 2,
+} tristate;
+
+// A message whose fields are tested: the record itself, or a submessage on the
+// path to a tested field.  Handlers get one of these as their closure, so that
+// values of the same message type elsewhere in the record are not mixed up
+// with them.
+typedef struct node {
+  upb_pbfilter *filter;
+  const struct node *parent;
+  const upb_fielddef *f;  // Submessage field in the parent.
+} node;
+
+// Nodes 0 and 1.  The closure of submessages that are not on any path is the
+// ignored node, which has no leaves and no children.
+#define IGNORED 0
+#define ROOT 1
+
+// A comparison, the leaves of the expression tree.
+typedef struct {
+  uint32_t node;
+  const upb_fielddef *f;
+  upb_predop op;
+  upb_value *vals;
+  size_t val_count;
+} leaf;
+
+typedef struct {
+  upb_predop op;
+  uint32_t leaf;       // For comparisons.
+  uint32_t *args;      // For AND, OR and NOT, indexes into exprs.
+  uint32_t arg_count;
+} expr;
+
+struct upb_pbfilter {
+  // The compiled predicate.  exprs[0] is the root.
+  expr *exprs;
+  uint32_t expr_count;
+  uint32_t *args;
+  uint32_t arg_count;
+  leaf *leaves;
+  uint32_t leaf_count;
+  node *nodes;
+  uint32_t node_count;
+
+  // Per record: the state of each leaf, and the result once it is known.
+  uint8_t *state;
+  tristate result;
+
+  // The string value being delivered.
+  char *str;
+  size_t str_len, str_size;
+
+  const upb_handlers *decoder_h;
+  upb_pipeline pipeline;
+  upb_sink *sink, *decoder_sink;
+  char seed[1024];
+};
+
+
+/* Evaluation *****************************************************************/
+
+static tristate eval(const upb_pbfilter *f, uint32_t i, bool final) {
+  const expr *e = &f->exprs[i];
+  switch (e->op) {
+    case UPB_PRED_AND:
+    case UPB_PRED_OR: {
+      // Short-circuits on FALSE for AND and TRUE for OR.
+      tristate decisive = e->op == UPB_PRED_AND ? PRED_FALSE : PRED_TRUE;
+      tristate ret = decisive == PRED_TRUE ? PRED_FALSE : PRED_TRUE;
+      for (uint32_t j = 0; j < e->arg_count; j++) {
+        tristate t = eval(f, e->args[j], final);
+        if (t == decisive) return decisive;
+        if (t == PRED_UNKNOWN) ret = PRED_UNKNOWN;
+      }
+      return ret;
+    }
+    case UPB_PRED_NOT: {
+      tristate t = eval(f, e->args[0], final);
+      if (t == PRED_UNKNOWN) return PRED_UNKNOWN;
+      return t == PRED_TRUE ? PRED_FALSE : PRED_TRUE;
+    }
+    default: {
+      tristate t = f->state[e->leaf];
+      // At the end of the record, comparisons on missing fields are false.
+      return (t == PRED_UNKNOWN && final) ? PRED_FALSE : t;
+    }
+  }
+}
+
+static bool test(upb_predop op, int c) {
+  switch (op) {
+    case UPB_PRED_EQ: return c == 0;
+    case UPB_PRED_NE: return c != 0;
+    case UPB_PRED_LT: return c < 0;
+    case UPB_PRED_LE: return c <= 0;
+    case UPB_PRED_GT: return c > 0;
+    case UPB_PRED_GE: return c >= 0;
+    default: assert(false); return false;
+  }
+}
+
+// Floating-point comparisons are done directly, so that NaN is unordered.
+#define T(ctype, name) \
+  static bool test ## name(upb_predop op, ctype a, ctype b) { \
+    switch (op) { \
+      case UPB_PRED_EQ: return a == b; \
+      case UPB_PRED_NE: return a != b; \
+      case UPB_PRED_LT: return a < b; \
+      case UPB_PRED_LE: return a <= b; \
+      case UPB_PRED_GT: return a > b; \
+      case UPB_PRED_GE: return a >= b; \
+      default: assert(false); return false; \
+    } \
+  }
+
+T(int32_t,  int32)
+T(int64_t,  int64)
+T(uint32_t, uint32)
+T(uint64_t, uint64)
+T(float,    float)
+T(double,   double)
+T(bool,     bool)
+#undef T
+
+static bool testval(const upb_fielddef *f, upb_predop op, upb_value a,
+                    upb_value b) {
+  switch (upb_fielddef_type(f)) {
+    case UPB_TYPE_ENUM:   UPB_FALLTHROUGH_INTENDED;
+    case UPB_TYPE_INT32:
+      return testint32(op, upb_value_getint32(a), upb_value_getint32(b));
+    case UPB_TYPE_INT64:
+      return testint64(op, upb_value_getint64(a), upb_value_getint64(b));
+    case UPB_TYPE_UINT32:
+      return testuint32(op, upb_value_getuint32(a), upb_value_getuint32(b));
+    case UPB_TYPE_UINT64:
+      return testuint64(op, upb_value_getuint64(a), upb_value_getuint64(b));
+    case UPB_TYPE_FLOAT:
+      return testfloat(op, upb_value_getfloat(a), upb_value_getfloat(b));
+    case UPB_TYPE_DOUBLE:
+      return testdouble(op, upb_value_getdouble(a), upb_value_getdouble(b));
+    case UPB_TYPE_BOOL:
+      return testbool(op, upb_value_getbool(a), upb_value_getbool(b));
+    default:
+      assert(false);
+      return false;
+  }
+}
+
+static bool teststr(upb_predop op, const char *str, size_t len,
+                    upb_value operand) {
+  const char *b = upb_value_getcstr(operand);
+  size_t blen = strlen(b);
+  int c = memcmp(str, b, UPB_MIN(len, blen));
+  if (c == 0) c = (len > blen) - (len < blen);
+  return test(op, c);
+}
+
+static bool testleaf(const leaf *l, upb_value v, const char *str, size_t len) {
+  upb_predop op = l->op == UPB_PRED_IN ? UPB_PRED_EQ : l->op;
+  for (size_t i = 0; i < l->val_count; i++) {
+    bool match = str ? teststr(op, str, len, l->vals[i]) :
+                       testval(l->f, op, v, l->vals[i]);
+    if (match) return true;
+  }
+  return false;
+}
+
+// Tests a value of "f" against the leaves that are waiting for it.  Returns
+// false (which stops the decoder) once the result of the predicate is known.
+static bool update(node *n, const upb_fielddef *f, upb_value v,
+                   const char *str, size_t len) {
+  upb_pbfilter *flt = n->filter;
+  uint32_t nodeidx = n - flt->nodes;
+  bool changed = false;
+  for (uint32_t i = 0; i < flt->leaf_count; i++) {
+    const leaf *l = &flt->leaves[i];
+    if (l->node != nodeidx || l->f != f || flt->state[i] != PRED_UNKNOWN)
+      continue;
+    if (testleaf(l, v, str, len)) {
+      flt->state[i] = PRED_TRUE;
+      changed = true;
+    } else if (!upb_fielddef_isseq(f)) {
+      // Later elements of a repeated field could still match.
+      flt->state[i] = PRED_FALSE;
+      changed = true;
+    }
+  }
+  if (!changed) return true;
+  flt->result = eval(flt, 0, false);
+  return flt->result == PRED_UNKNOWN;
+}
+
+
+/* Handlers *******************************************************************/
+
+#define T(ctype, name) \
+  static bool put ## name(void *c, const void *hd, ctype val) { \
+    upb_value v; \
+    upb_value_set ## name(&v, val); \
+    return update(c, hd, v, NULL, 0); \
+  }
+
+T(int32_t,  int32)
+T(int64_t,  int64)
+T(uint32_t, uint32)
+T(uint64_t, uint64)
+T(float,    float)
+T(double,   double)
+T(bool,     bool)
+#undef T
+
+static void *startstr(void *c, const void *hd, size_t size_hint) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(size_hint);
+  node *n = c;
+  n->filter->str_len = 0;
+  return c;
+}
+
+static size_t putstr(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(hd);
+  upb_pbfilter *f = ((node*)c)->filter;
+  if (f->str_len + n > f->str_size) {
+    size_t size = UPB_MAX(f->str_size * 2, f->str_len + n);
+    char *str = realloc(f->str, size);
+    if (!str) return 0;
+    f->str = str;
+    f->str_size = size;
+  }
+  memcpy(f->str + f->str_len, buf, n);
+  f->str_len += n;
+  return n;
+}
+
+static bool endstr(void *c, const void *hd) {
+  upb_pbfilter *f = ((node*)c)->filter;
+  upb_value none = UPB_VALUE_INIT_NONE;
+  // Never NULL, so that update() knows it has a string.
+  const char *str = f->str ? f->str : "";
+  return update(c, hd, none, str, f->str_len);
+}
+
+static void *startsubmsg(void *c, const void *hd) {
+  node *n = c;
+  upb_pbfilter *f = n->filter;
+  for (uint32_t i = ROOT + 1; i < f->node_count; i++) {
+    if (f->nodes[i].parent == n && f->nodes[i].f == hd) return &f->nodes[i];
+  }
+  return &f->nodes[IGNORED];
+}
+
+static bool endmsg(void *c, const void *hd, upb_status *status) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(status);
+  node *n = c;
+  upb_pbfilter *f = n->filter;
+  if (n == &f->nodes[ROOT]) f->result = eval(f, 0, true);
+  return true;
+}
+
+static void sethandlers(void *closure, upb_handlers *h) {
+  upb_pbfilter *flt = closure;
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  upb_handlers_setendmsg(h, endmsg, NULL, NULL);
+
+  upb_msg_iter i;
+  for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    void *hd = (void*)f;
+    if (upb_fielddef_issubmsg(f)) {
+      upb_handlers_setstartsubmsg(h, f, startsubmsg, hd, NULL);
+      continue;
+    }
+
+    bool tested = false;
+    for (uint32_t j = 0; j < flt->leaf_count; j++)
+      if (flt->leaves[j].f == f) tested = true;
+    if (!tested) continue;
+
+    switch (upb_fielddef_type(f)) {
+      case UPB_TYPE_ENUM:   UPB_FALLTHROUGH_INTENDED;
+      case UPB_TYPE_INT32:  upb_handlers_setint32(h, f, putint32, hd, NULL);
+                            break;
+      case UPB_TYPE_INT64:  upb_handlers_setint64(h, f, putint64, hd, NULL);
+                            break;
+      case UPB_TYPE_UINT32: upb_handlers_setuint32(h, f, putuint32, hd, NULL);
+                            break;
+      case UPB_TYPE_UINT64: upb_handlers_setuint64(h, f, putuint64, hd, NULL);
+                            break;
+      case UPB_TYPE_FLOAT:  upb_handlers_setfloat(h, f, putfloat, hd, NULL);
+                            break;
+      case UPB_TYPE_DOUBLE: upb_handlers_setdouble(h, f, putdouble, hd, NULL);
+                            break;
+      case UPB_TYPE_BOOL:   upb_handlers_setbool(h, f, putbool, hd, NULL);
+                            break;
+      case UPB_TYPE_STRING: UPB_FALLTHROUGH_INTENDED;
+      case UPB_TYPE_BYTES:
+        upb_handlers_setstartstr(h, f, startstr, hd, NULL);
+        upb_handlers_setstring(h, f, putstr, hd, NULL);
+        upb_handlers_setendstr(h, f, endstr, hd, NULL);
+        break;
+      case UPB_TYPE_MESSAGE:
+        break;
+    }
+  }
+}
+
+
+/* Compilation ****************************************************************/
+
+static bool count(const upb_pred *p, uint32_t *exprs, uint32_t *args,
+                  uint32_t *leaves, uint32_t *nodes, int depth,
+                  upb_status *s) {
+  if (depth > UPB_MAX_NESTING) {
+    upb_status_seterrliteral(s, "Predicate nested too deeply");
+    return false;
+  }
+  (*exprs)++;
+  switch (p->op) {
+    case UPB_PRED_NOT:
+    case UPB_PRED_AND:
+    case UPB_PRED_OR:
+      if (p->op == UPB_PRED_NOT && p->arg_count != 1) {
+        upb_status_seterrliteral(s, "NOT takes one argument");
+        return false;
+      }
+      *args += p->arg_count;
+      for (size_t i = 0; i < p->arg_count; i++) {
+        if (!count(p->args[i], exprs, args, leaves, nodes, depth + 1, s))
+          return false;
+      }
+      return true;
+    case UPB_PRED_IN:
+      break;
+    default:
+      if (p->val_count != 1) {
+        upb_status_seterrliteral(s, "Comparisons take one value");
+        return false;
+      }
+      break;
+  }
+  if (p->path_len == 0) {
+    upb_status_seterrliteral(s, "Comparison without a field");
+    return false;
+  }
+  (*leaves)++;
+  *nodes += p->path_len - 1;
+  return true;
+}
+
+// Checks that "p"'s path leads from "m" to a primitive or string field.
+static bool checkpath(const upb_msgdef *m, const upb_pred *p, upb_status *s) {
+  for (size_t i = 0; i < p->path_len; i++) {
+    const upb_fielddef *f = p->path[i];
+    if (upb_fielddef_msgdef(f) != m) {
+      upb_status_seterrf(s, "Field %s is not in message %s",
+                         upb_fielddef_name(f), upb_msgdef_fullname(m));
+      return false;
+    }
+    bool last = i == p->path_len - 1;
+    if (last != !upb_fielddef_issubmsg(f) || (!last && upb_fielddef_isseq(f))) {
+      upb_status_seterrf(s, "Can't test field %s", upb_fielddef_name(f));
+      return false;
+    }
+    if (!last) m = upb_downcast_msgdef(upb_fielddef_subdef(f));
+  }
+  return true;
+}
+
+static uint32_t getnode(upb_pbfilter *f, uint32_t parent,
+                        const upb_fielddef *field) {
+  for (uint32_t i = ROOT + 1; i < f->node_count; i++) {
+    if (f->nodes[i].parent == &f->nodes[parent] && f->nodes[i].f == field)
+      return i;
+  }
+  node *n = &f->nodes[f->node_count];
+  n->filter = f;
+  n->parent = &f->nodes[parent];
+  n->f = field;
+  return f->node_count++;
+}
+
+// Compiles "p" into the next free expr, whose index is returned.
+static uint32_t compile(upb_pbfilter *f, const upb_pred *p) {
+  uint32_t i = f->expr_count++;
+  expr *e = &f->exprs[i];
+  e->op = p->op;
+  if (p->op == UPB_PRED_AND || p->op == UPB_PRED_OR || p->op == UPB_PRED_NOT) {
+    e->args = f->args + f->arg_count;
+    e->arg_count = p->arg_count;
+    f->arg_count += p->arg_count;
+    for (size_t j = 0; j < p->arg_count; j++)
+      e->args[j] = compile(f, p->args[j]);
+    return i;
+  }
+
+  leaf *l = &f->leaves[f->leaf_count];
+  e->leaf = f->leaf_count++;
+  uint32_t n = ROOT;
+  for (size_t j = 0; j + 1 < p->path_len; j++) n = getnode(f, n, p->path[j]);
+  l->node = n;
+  l->f = p->path[p->path_len - 1];
+  l->op = p->op;
+  l->val_count = p->val_count;
+  l->vals = malloc(sizeof(upb_value) * UPB_MAX(p->val_count, 1));
+  for (size_t j = 0; j < p->val_count; j++) {
+    l->vals[j] = p->vals[j];
+    if (upb_fielddef_isstring(l->f))
+      upb_value_setcstr(&l->vals[j], upb_strdup(upb_value_getcstr(p->vals[j])));
+  }
+  return i;
+}
+
+static bool checkpaths(const upb_msgdef *m, const upb_pred *p, upb_status *s) {
+  switch (p->op) {
+    case UPB_PRED_AND:
+    case UPB_PRED_OR:
+    case UPB_PRED_NOT:
+      for (size_t i = 0; i < p->arg_count; i++)
+        if (!checkpaths(m, p->args[i], s)) return false;
+      return true;
+    default:
+      return checkpath(m, p, s);
+  }
+}
+
+upb_pbfilter *upb_pbfilter_new(const upb_msgdef *m, const upb_pred *pred,
+                               upb_status *status) {
+  assert(upb_msgdef_isfrozen(m));
+  uint32_t exprs = 0, args = 0, leaves = 0, nodes = 2;
+  if (!count(pred, &exprs, &args, &leaves, &nodes, 0, status) ||
+      !checkpaths(m, pred, status)) {
+    return NULL;
+  }
+  if (leaves == 0) {
+    upb_status_seterrliteral(status, "Predicate tests no fields");
+    return NULL;
+  }
+
+  upb_pbfilter *f = malloc(sizeof(*f));
+  f->exprs = malloc(sizeof(expr) * exprs);
+  f->args = malloc(sizeof(uint32_t) * UPB_MAX(args, 1));
+  f->leaves = malloc(sizeof(leaf) * leaves);
+  f->nodes = malloc(sizeof(node) * nodes);
+  f->state = malloc(leaves);
+  f->expr_count = 0;
+  f->arg_count = 0;
+  f->leaf_count = 0;
+  f->node_count = 2;
+  for (int i = IGNORED; i <= ROOT; i++) {
+    f->nodes[i].filter = f;
+    f->nodes[i].parent = NULL;
+    f->nodes[i].f = NULL;
+  }
+  compile(f, pred);
+  f->str = NULL;
+  f->str_len = 0;
+  f->str_size = 0;
+
+  const upb_handlers *h = upb_handlers_newfrozen(m, NULL, &h, sethandlers, f);
+  // Never JIT'd: the JIT does not stop when a handler returns false.
+  f->decoder_h = upb_pbdecoder_gethandlers(h, false, f);
+  upb_pipeline_init(&f->pipeline, f->seed, sizeof(f->seed), upb_realloc, NULL);
+  f->sink = upb_pipeline_newsink(&f->pipeline, h);
+  f->decoder_sink = upb_pipeline_newsink(&f->pipeline, f->decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(f->decoder_sink), f->sink);
+  // The decoder plan keeps its own ref on the handlers.
+  upb_handlers_unref(h, &h);
+  return f;
+}
+
+void upb_pbfilter_free(upb_pbfilter *f) {
+  upb_pipeline_uninit(&f->pipeline);
+  upb_handlers_unref(f->decoder_h, f);
+  for (uint32_t i = 0; i < f->leaf_count; i++) {
+    leaf *l = &f->leaves[i];
+    if (upb_fielddef_isstring(l->f)) {
+      for (size_t j = 0; j < l->val_count; j++)
+        free(upb_value_getcstr(l->vals[j]));
+    }
+    free(l->vals);
+  }
+  free(f->exprs);
+  free(f->args);
+  free(f->leaves);
+  free(f->nodes);
+  free(f->state);
+  free(f->str);
+  free(f);
+}
+
+bool upb_pbfilter_match(upb_pbfilter *f, const char *buf, size_t len) {
+  upb_pipeline_reset(&f->pipeline);
+  upb_sink_reset(f->sink, &f->nodes[ROOT]);
+  memset(f->state, PRED_UNKNOWN, f->leaf_count);
+  f->result = PRED_UNKNOWN;
+
+  upb_sink *s = f->decoder_sink;
+  if (!upb_sink_startmsg(s) ||
+      !upb_sink_startstr(s, UPB_BYTESTREAM_BYTES_STARTSTR, len)) {
+    return false;
+  }
+  // Returns a short count if the handlers stop decoding early.
+  upb_sink_putstring(s, UPB_BYTESTREAM_BYTES_STRING, buf, len);
+  if (!upb_ok(upb_pipeline_status(&f->pipeline))) return false;
+  if (f->result == PRED_UNKNOWN &&
+      (!upb_sink_endstr(s, UPB_BYTESTREAM_BYTES_ENDSTR) ||
+       !upb_sink_endmsg(s))) {
+    return false;
+  }
+  return f->result == PRED_TRUE;
+}
+
+const upb_status *upb_pbfilter_status(const upb_pbfilter *f) {
+  return upb_pipeline_status(&f->pipeline);
+}
@@ -0,0 +1,144 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * upb::pb::Filter evaluates a predicate over the fields of serialized protobuf
+ * records while they are being decoded, and stops decoding each record as
+ * soon as the result is known.  For example, "status == 3 && region in {...}"
+ * usually only needs the first few fields of a record that does not match,
+ * so filtering out most records costs far less than decoding them.  A
+ * predicate is a tree of upb_pred nodes:
+ *
+ *   const upb_fielddef *code = ..., *region = ...;
+ *   upb_value three = upb_value_int32(3);
+ *   upb_value regions[] = {...};
+ *   upb_pred eq = {UPB_PRED_EQ, &code, 1, &three, 1, NULL, 0};
+ *   upb_pred in = {UPB_PRED_IN, &region, 1, regions, 2, NULL, 0};
+ *   const upb_pred *args[] = {&eq, &in};
+ *   upb_pred and = {UPB_PRED_AND, NULL, 0, NULL, 0, args, 2};
+ *
+ *   upb_pbfilter *f = upb_pbfilter_new(md, &and, &status);
+ *   for (each record) {
+ *     if (upb_pbfilter_match(f, buf, len)) ... decode it for real.
+ *   }
+ *   upb_pbfilter_free(f);
+ *
+ * The predicate is compiled into handlers that are only registered for the
+ * fields it mentions, so the decoder skips over all other fields without
+ * calling out.  All state is reused between records.
+ *
+ * Records are only checked for errors up to the point where the result is
+ * known.  Comparisons on a field that the record does not have are false.
+ * For a non-repeated field the first value in the record is the one compared;
+ * a comparison on a repeated field is true if it is true for any element.
+ */
+
+#ifndef UPB_PB_FILTER_H_
+#define UPB_PB_FILTER_H_
+
+#include "upb/def.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace pb {
+class Filter;
+}  // namespace pb
+}  // namespace upb
+typedef upb::pb::Filter upb_pbfilter;
+#else
+struct upb_pbfilter;
+typedef struct upb_pbfilter upb_pbfilter;
+#endif
+
+typedef enum {
+  // Compare the field with vals[0].
+  UPB_PRED_EQ,
+  UPB_PRED_NE,
+  UPB_PRED_LT,
+  UPB_PRED_LE,
+  UPB_PRED_GT,
+  UPB_PRED_GE,
+
+  // True if the field equals any of "vals".
+  UPB_PRED_IN,
+
+  // Combine "args": any number of them for AND and OR, one for NOT.
+  UPB_PRED_AND,
+  UPB_PRED_OR,
+  UPB_PRED_NOT,
+} upb_predop;
+
+// A node of a predicate's syntax tree.  Only the members for "op" are used.
+typedef struct upb_pred {
+  upb_predop op;
+
+  // For comparisons and UPB_PRED_IN: the field to test, as a path from the
+  // filter's message type.  All but the last are non-repeated submessage
+  // fields; the last is a primitive or string field.
+  const upb_fielddef *const *path;
+  size_t path_len;
+
+  // The operands, typed like the field: enums are int32, and strings are
+  // NUL-terminated cstr values.  They are copied by upb_pbfilter_new().
+  const upb_value *vals;
+  size_t val_count;
+
+  const struct upb_pred *const *args;
+  size_t arg_count;
+} upb_pred;
+
+#ifdef __cplusplus
+
+class upb::pb::Filter {
+ public:
+  // Compiles "pred" for records of type "m" (which must be frozen).  Returns
+  // NULL and sets "status" if the predicate does not fit the type.
+  static Filter* New(const MessageDef* m, const upb_pred* pred,
+                     Status* status);
+  void Free();
+
+  // Returns true if the record matches.  When it returns false, status()
+  // tells whether the record was merely filtered out.
+  bool Match(const char* buf, size_t len);
+  const Status& status() const;
+
+ private:
+  UPB_DISALLOW_POD_OPS(Filter);
+};
+
+extern "C" {
+#endif
+
+upb_pbfilter *upb_pbfilter_new(const upb_msgdef *m, const upb_pred *pred,
+                               upb_status *status);
+void upb_pbfilter_free(upb_pbfilter *f);
+bool upb_pbfilter_match(upb_pbfilter *f, const char *buf, size_t len);
+const upb_status *upb_pbfilter_status(const upb_pbfilter *f);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+
+namespace upb {
+namespace pb {
+
+inline Filter* Filter::New(const MessageDef* m, const upb_pred* pred,
+                           Status* status) {
+  return upb_pbfilter_new(m, pred, status);
+}
+inline void Filter::Free() {
+  upb_pbfilter_free(this);
+}
+inline bool Filter::Match(const char* buf, size_t len) {
+  return upb_pbfilter_match(this, buf, len);
+}
+inline const Status& Filter::status() const {
+  return *upb_pbfilter_status(this);
+}
+
+}  // namespace pb
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_PB_FILTER_H_ */
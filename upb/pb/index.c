@@ -0,0 +1,314 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ */
+
+#include "upb/pb/index.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include "upb/bytestream.h"
+#include "upb/pb/varint.h"
+
+// A field of a message on an indexed path.
+typedef struct {
+  uint32_t number;
+  uint8_t wire_type;  // The native one; packable fields also take DELIMITED.
+  bool packable;
+  int path;           // The path that ends at this field, or -1.
+  int sub;            // The node for paths that continue into it, or -1.
+} target;
+
+// A message type on an indexed path, with the fields of it to look at.
+typedef struct {
+  target *targets;
+  size_t target_count;
+} node;
+
+typedef struct {
+  const upb_fielddef *f;
+
+  // The occurrences: offset of the tag from the start of the buffer, and
+  // length through the end of the value.
+  uint64_t *ofs;
+  uint32_t *len;
+  size_t count, size;
+} ipath;
+
+struct upb_pbindex {
+  const upb_msgdef *m;
+  node *nodes;  // nodes[0] is for "m".
+  size_t node_count;
+  ipath *paths;
+  size_t path_count;
+
+  const char *buf;
+  upb_status status;
+};
+
+upb_pbindex *upb_pbindex_new(const upb_msgdef *m) {
+  assert(upb_msgdef_isfrozen(m));
+  upb_pbindex *idx = malloc(sizeof(*idx));
+  idx->m = m;
+  idx->nodes = malloc(sizeof(node));
+  idx->nodes[0].targets = NULL;
+  idx->nodes[0].target_count = 0;
+  idx->node_count = 1;
+  idx->paths = NULL;
+  idx->path_count = 0;
+  idx->buf = NULL;
+  upb_status_init(&idx->status);
+  return idx;
+}
+
+void upb_pbindex_free(upb_pbindex *idx) {
+  for (size_t i = 0; i < idx->node_count; i++) free(idx->nodes[i].targets);
+  for (size_t i = 0; i < idx->path_count; i++) {
+    free(idx->paths[i].ofs);
+    free(idx->paths[i].len);
+  }
+  free(idx->nodes);
+  free(idx->paths);
+  upb_status_uninit(&idx->status);
+  free(idx);
+}
+
+
+/* Paths **********************************************************************/
+
+static target *findtarget(const node *n, uint32_t number) {
+  for (size_t i = 0; i < n->target_count; i++) {
+    if (n->targets[i].number == number) return &n->targets[i];
+  }
+  return NULL;
+}
+
+// Returns the target for "f" in node "n", adding it if necessary.
+static target *gettarget(upb_pbindex *idx, size_t n, const upb_fielddef *f) {
+  node *nd = &idx->nodes[n];
+  target *t = findtarget(nd, upb_fielddef_number(f));
+  if (t) return t;
+  nd->targets = realloc(nd->targets, sizeof(target) * (nd->target_count + 1));
+  t = &nd->targets[nd->target_count++];
+  upb_descriptortype_t type = upb_fielddef_descriptortype(f);
+  t->number = upb_fielddef_number(f);
+  t->wire_type = upb_pb_types[type].native_wire_type;
+  t->packable = upb_fielddef_isseq(f) && upb_pb_types[type].is_numeric;
+  t->path = -1;
+  t->sub = -1;
+  return t;
+}
+
+int upb_pbindex_addpath(upb_pbindex *idx, const upb_fielddef *const *fields,
+                        size_t len) {
+  const upb_msgdef *m = idx->m;
+  if (len == 0 || len > UPB_MAX_NESTING) {
+    upb_status_seterrliteral(&idx->status, "Bad path length");
+    return -1;
+  }
+  for (size_t i = 0; i < len; i++) {
+    const upb_fielddef *f = fields[i];
+    if (upb_fielddef_msgdef(f) != m) {
+      upb_status_seterrf(&idx->status, "Field %s is not in message %s",
+                         upb_fielddef_name(f), upb_msgdef_fullname(m));
+      return -1;
+    }
+    if (upb_fielddef_descriptortype(f) == UPB_DESCRIPTOR_TYPE_GROUP) {
+      upb_status_seterrf(&idx->status, "Can't index group %s",
+                         upb_fielddef_name(f));
+      return -1;
+    }
+    if (i < len - 1) {
+      if (!upb_fielddef_issubmsg(f) || upb_fielddef_isseq(f)) {
+        upb_status_seterrf(&idx->status,
+                           "Field %s must be a non-repeated submessage",
+                           upb_fielddef_name(f));
+        return -1;
+      }
+      m = upb_downcast_msgdef(upb_fielddef_subdef(f));
+    }
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < len - 1; i++) {
+    target *t = gettarget(idx, n, fields[i]);
+    if (t->sub < 0) {
+      idx->nodes =
+          realloc(idx->nodes, sizeof(node) * (idx->node_count + 1));
+      // "t" moved with the nodes.
+      t = findtarget(&idx->nodes[n], upb_fielddef_number(fields[i]));
+      t->sub = idx->node_count++;
+      idx->nodes[t->sub].targets = NULL;
+      idx->nodes[t->sub].target_count = 0;
+    }
+    n = t->sub;
+  }
+
+  target *t = gettarget(idx, n, fields[len - 1]);
+  if (t->path < 0) {
+    idx->paths = realloc(idx->paths, sizeof(ipath) * (idx->path_count + 1));
+    ipath *p = &idx->paths[idx->path_count];
+    p->f = fields[len - 1];
+    p->ofs = NULL;
+    p->len = NULL;
+    p->count = 0;
+    p->size = 0;
+    t->path = idx->path_count++;
+  }
+  return t->path;
+}
+
+
+/* Building *******************************************************************/
+
+static bool append(ipath *p, uint64_t ofs, size_t len) {
+  if (p->count == p->size) {
+    size_t size = UPB_MAX(p->size * 2, 64);
+    uint64_t *o = realloc(p->ofs, sizeof(*o) * size);
+    if (!o) return false;
+    p->ofs = o;
+    uint32_t *l = realloc(p->len, sizeof(*l) * size);
+    if (!l) return false;
+    p->len = l;
+    p->size = size;
+  }
+  p->ofs[p->count] = ofs;
+  p->len[p->count] = len;
+  p->count++;
+  return true;
+}
+
+// Indexes the fields of one message of node "n"'s type, in [p, end).
+static bool scan(upb_pbindex *idx, const node *n, const char *p,
+                 const char *end) {
+  while (p < end) {
+    const char *field = p;
+    uint64_t tag;
+    if (!upb_vdecode_bounded(&p, end, &tag) || tag > UINT32_MAX) {
+      upb_status_seterrliteral(&idx->status, "Bad tag");
+      return false;
+    }
+    uint8_t wire_type = tag & 0x7;
+    uint32_t fieldnum = tag >> 3;
+    if (fieldnum == 0 || fieldnum > UPB_MAX_FIELDNUMBER) {
+      upb_status_seterrliteral(&idx->status, "Invalid field number");
+      return false;
+    }
+    const char *value = p;
+    if (!upb_pb_skipfield(&p, end, wire_type, fieldnum)) {
+      upb_status_seterrliteral(&idx->status, "Bad field");
+      return false;
+    }
+
+    const target *t = findtarget(n, fieldnum);
+    if (!t || (wire_type != t->wire_type &&
+               !(wire_type == UPB_WIRE_TYPE_DELIMITED && t->packable))) {
+      continue;
+    }
+    if (t->path >= 0) {
+      if (p - field > UINT32_MAX) {
+        upb_status_seterrliteral(&idx->status, "Field too long to index");
+        return false;
+      }
+      if (!append(&idx->paths[t->path], field - idx->buf, p - field)) {
+        upb_status_seterrliteral(&idx->status, "Out of memory");
+        return false;
+      }
+    }
+    if (t->sub >= 0) {
+      uint64_t len;
+      upb_vdecode_bounded(&value, p, &len);
+      if (!scan(idx, &idx->nodes[t->sub], value, p)) return false;
+    }
+  }
+  return true;
+}
+
+bool upb_pbindex_build(upb_pbindex *idx, const char *buf, size_t len) {
+  upb_status_clear(&idx->status);
+  for (size_t i = 0; i < idx->path_count; i++) idx->paths[i].count = 0;
+  idx->buf = buf;
+  return scan(idx, &idx->nodes[0], buf, buf + len);
+}
+
+const upb_status *upb_pbindex_status(const upb_pbindex *idx) {
+  return &idx->status;
+}
+
+
+/* Lookups ********************************************************************/
+
+size_t upb_pbindex_count(const upb_pbindex *idx, int path) {
+  assert(path >= 0 && (size_t)path < idx->path_count);
+  return idx->paths[path].count;
+}
+
+const char *upb_pbindex_field(const upb_pbindex *idx, int path, size_t i,
+                              size_t *len) {
+  assert(i < upb_pbindex_count(idx, path));
+  const ipath *p = &idx->paths[path];
+  *len = p->len[i];
+  return idx->buf + p->ofs[i];
+}
+
+const char *upb_pbindex_value(const upb_pbindex *idx, int path, size_t i,
+                              size_t *len) {
+  size_t field_len;
+  const char *field = upb_pbindex_field(idx, path, i, &field_len);
+  const char *end = field + field_len;
+  uint64_t u64;
+  // Both were checked when the index was built.
+  bool ok = upb_vdecode_bounded(&field, end, &u64);
+  if (ok && (u64 & 0x7) == UPB_WIRE_TYPE_DELIMITED)
+    ok = upb_vdecode_bounded(&field, end, &u64);
+  UPB_ASSERT_VAR(ok, ok);
+  *len = end - field;
+  return field;
+}
+
+static bool startdecode(upb_sink *sink, size_t size_hint) {
+  return upb_sink_startmsg(sink) &&
+         upb_sink_startstr(sink, UPB_BYTESTREAM_BYTES_STARTSTR, size_hint);
+}
+
+static bool feed(upb_sink *sink, const char *buf, size_t len) {
+  return upb_sink_putstring(sink, UPB_BYTESTREAM_BYTES_STRING, buf, len) == len;
+}
+
+static bool enddecode(upb_sink *sink) {
+  return upb_sink_endstr(sink, UPB_BYTESTREAM_BYTES_ENDSTR) &&
+         upb_sink_endmsg(sink);
+}
+
+bool upb_pbindex_decode(const upb_pbindex *idx, int path, size_t first,
+                        size_t n, upb_sink *sink) {
+  assert(first + n <= upb_pbindex_count(idx, path));
+  const ipath *p = &idx->paths[path];
+  if (!startdecode(sink, 0)) return false;
+  // Occurrences that are next to each other (as the elements of a repeated
+  // field usually are) are passed to the decoder together.
+  const char *run = NULL;
+  size_t run_len = 0;
+  for (size_t i = first; i < first + n; i++) {
+    const char *field = idx->buf + p->ofs[i];
+    if (run && run + run_len == field) {
+      run_len += p->len[i];
+      continue;
+    }
+    if (run && !feed(sink, run, run_len)) return false;
+    run = field;
+    run_len = p->len[i];
+  }
+  if (run && !feed(sink, run, run_len)) return false;
+  return enddecode(sink);
+}
+
+bool upb_pbindex_decodevalue(const upb_pbindex *idx, int path, size_t i,
+                             upb_sink *sink) {
+  assert(upb_fielddef_descriptortype(idx->paths[path].f) ==
+         UPB_DESCRIPTOR_TYPE_MESSAGE);
+  size_t len;
+  const char *value = upb_pbindex_value(idx, path, i, &len);
+  return startdecode(sink, len) && feed(sink, value, len) && enddecode(sink);
+}
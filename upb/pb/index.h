@@ -0,0 +1,154 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * upb::pb::Index is a side index into a large serialized message, for random
+ * access to the occurrences of a few fields without decoding everything
+ * before them.  Reading the 100000th element of a repeated submessage field
+ * then costs one index lookup and the decoding of that element alone:
+ *
+ *   upb_pbindex *idx = upb_pbindex_new(md);
+ *   int items = upb_pbindex_addpath(idx, &items_field, 1);
+ *   if (!upb_pbindex_build(idx, buf, len)) ... upb_pbindex_status(idx)
+ *   ...
+ *   // "sink" is a decoder sink for handlers of the element type.
+ *   upb_pbindex_decodevalue(idx, items, 100000, sink);
+ *
+ * Each indexed path is a list of fields from the message type.  All but the
+ * last are non-repeated submessage fields; the last may be any field that is
+ * not a group.  The index stores the offset and length of each occurrence of
+ * it, 12 bytes per occurrence.  A packed run of values is one occurrence.
+ *
+ * Building the index only reads tags and lengths: it jumps over the fields
+ * that are not on an indexed path, including all of the indexed submessages
+ * themselves, so it runs much faster than decoding the message.  Fields whose
+ * wire type does not match are treated as unknown, as the decoder does.
+ *
+ * The index refers to the buffer it was built from, which must outlive it (or
+ * the next upb_pbindex_build()).  It is not thread-safe to build, but once
+ * built it may be read from any number of threads.
+ */
+
+#ifndef UPB_PB_INDEX_H_
+#define UPB_PB_INDEX_H_
+
+#include "upb/sink.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace pb {
+class Index;
+}  // namespace pb
+}  // namespace upb
+typedef upb::pb::Index upb_pbindex;
+#else
+struct upb_pbindex;
+typedef struct upb_pbindex upb_pbindex;
+#endif
+
+#ifdef __cplusplus
+
+class upb::pb::Index {
+ public:
+  // "m" must be frozen.
+  static Index* New(const MessageDef* m);
+  void Free();
+
+  // Adds a path to index and returns its number, or -1 (and sets status()) if
+  // it is not a valid path.  Adding a path twice returns the same number.
+  int AddPath(const FieldDef* const* path, size_t len);
+
+  // Indexes the given message, replacing the previous one.  Returns false and
+  // sets status() if the message is malformed along an indexed path.
+  bool Build(const char* buf, size_t len);
+  const Status& status() const;
+
+  // The number of occurrences of the path's field.
+  size_t count(int path) const;
+
+  // Occurrence "i" of the path's field, from its tag to the end of its value.
+  const char* field(int path, size_t i, size_t* len) const;
+
+  // The value of occurrence "i": for strings, submessages and packed runs the
+  // bytes after the length, and otherwise the bytes after the tag.
+  const char* value(int path, size_t i, size_t* len) const;
+
+  // Decodes occurrences [first, first + n) of the path's field as one message
+  // of the type that contains the field, which has just those values for it
+  // and nothing else.  "sink" must be a freshly reset upb::pb::Decoder sink
+  // for handlers of that type; its string handlers must not apply
+  // backpressure.  On failure the error is in the sink's pipeline status, and
+  // the pipeline must be reset before the sink is used again.
+  bool Decode(int path, size_t first, size_t n, Sink* sink) const;
+
+  // Decodes the value of submessage occurrence "i" as a message of the
+  // field's own type, under the same conditions as Decode().
+  bool DecodeValue(int path, size_t i, Sink* sink) const;
+
+ private:
+  UPB_DISALLOW_POD_OPS(Index);
+};
+
+extern "C" {
+#endif
+
+upb_pbindex *upb_pbindex_new(const upb_msgdef *m);
+void upb_pbindex_free(upb_pbindex *idx);
+int upb_pbindex_addpath(upb_pbindex *idx, const upb_fielddef *const *path,
+                        size_t len);
+bool upb_pbindex_build(upb_pbindex *idx, const char *buf, size_t len);
+const upb_status *upb_pbindex_status(const upb_pbindex *idx);
+size_t upb_pbindex_count(const upb_pbindex *idx, int path);
+const char *upb_pbindex_field(const upb_pbindex *idx, int path, size_t i,
+                              size_t *len);
+const char *upb_pbindex_value(const upb_pbindex *idx, int path, size_t i,
+                              size_t *len);
+bool upb_pbindex_decode(const upb_pbindex *idx, int path, size_t first,
+                        size_t n, upb_sink *sink);
+bool upb_pbindex_decodevalue(const upb_pbindex *idx, int path, size_t i,
+                             upb_sink *sink);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+
+namespace upb {
+namespace pb {
+
+inline Index* Index::New(const MessageDef* m) {
+  return upb_pbindex_new(m);
+}
+inline void Index::Free() {
+  upb_pbindex_free(this);
+}
+inline int Index::AddPath(const FieldDef* const* path, size_t len) {
+  return upb_pbindex_addpath(this, path, len);
+}
+inline bool Index::Build(const char* buf, size_t len) {
+  return upb_pbindex_build(this, buf, len);
+}
+inline const Status& Index::status() const {
+  return *upb_pbindex_status(this);
+}
+inline size_t Index::count(int path) const {
+  return upb_pbindex_count(this, path);
+}
+inline const char* Index::field(int path, size_t i, size_t* len) const {
+  return upb_pbindex_field(this, path, i, len);
+}
+inline const char* Index::value(int path, size_t i, size_t* len) const {
+  return upb_pbindex_value(this, path, i, len);
+}
+inline bool Index::Decode(int path, size_t first, size_t n, Sink* sink) const {
+  return upb_pbindex_decode(this, path, first, n, sink);
+}
+inline bool Index::DecodeValue(int path, size_t i, Sink* sink) const {
+  return upb_pbindex_decodevalue(this, path, i, sink);
+}
+
+}  // namespace pb
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_PB_INDEX_H_ */
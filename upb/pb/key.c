@@ -0,0 +1,180 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ */
+
+#include "upb/pb/key.h"
+
+#include <stdlib.h>
+#include "upb/bytestream.h"
+#include "upb/pb/decoder.h"
+
+struct upb_pbkey {
+  const upb_fielddef *f;
+  const upb_handlers *decoder_h;
+  upb_pipeline pipeline;
+  upb_sink *sink, *decoder_sink;
+
+  // The key from the last record.
+  bool found;
+  upb_value val;
+  const char *str;
+  size_t len;
+
+  char seed[1024];
+};
+
+// The closure for submessages.  A message type can contain itself, so the key
+// field's handlers can also be called for nested messages, which must be
+// ignored.
+static char nested;
+
+#define T(ctype, name) \
+  static bool put ## name(void *c, const void *hd, ctype val) { \
+    UPB_UNUSED(hd); \
+    upb_pbkey *k = c; \
+    if (c == &nested || k->found) return true; \
+    upb_value_set ## name(&k->val, val); \
+    k->found = true; \
+    return true; \
+  }
+
+T(int32_t,  int32)
+T(int64_t,  int64)
+T(uint32_t, uint32)
+T(uint64_t, uint64)
+T(float,    float)
+T(double,   double)
+T(bool,     bool)
+#undef T
+
+static void *startstr(void *c, const void *hd, size_t size_hint) {
+  UPB_UNUSED(hd);
+  UPB_UNUSED(size_hint);
+  upb_pbkey *k = c;
+  if (c != &nested && !k->found) {
+    k->str = NULL;
+    k->len = 0;
+  }
+  return c;
+}
+
+static size_t putstr(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(hd);
+  upb_pbkey *k = c;
+  if (c == &nested || k->found) return n;
+  // The whole record is in one buffer, so the pieces are contiguous.
+  if (!k->str) k->str = buf;
+  k->len += n;
+  return n;
+}
+
+static bool endstr(void *c, const void *hd) {
+  UPB_UNUSED(hd);
+  upb_pbkey *k = c;
+  if (c != &nested) k->found = true;
+  return true;
+}
+
+static void *startsubmsg(void *c, const void *hd) {
+  UPB_UNUSED(c);
+  UPB_UNUSED(hd);
+  return &nested;
+}
+
+static void sethandlers(void *closure, upb_handlers *h) {
+  const upb_fielddef *key = closure;
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  upb_msg_iter i;
+  for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    if (upb_fielddef_issubmsg(f))
+      upb_handlers_setstartsubmsg(h, f, startsubmsg, NULL, NULL);
+  }
+  if (m != upb_fielddef_msgdef(key)) return;
+
+  switch (upb_fielddef_type(key)) {
+    case UPB_TYPE_ENUM:   UPB_FALLTHROUGH_INTENDED;
+    case UPB_TYPE_INT32:  upb_handlers_setint32(h, key, putint32, NULL, NULL);
+                          break;
+    case UPB_TYPE_INT64:  upb_handlers_setint64(h, key, putint64, NULL, NULL);
+                          break;
+    case UPB_TYPE_UINT32: upb_handlers_setuint32(h, key, putuint32, NULL, NULL);
+                          break;
+    case UPB_TYPE_UINT64: upb_handlers_setuint64(h, key, putuint64, NULL, NULL);
+                          break;
+    case UPB_TYPE_FLOAT:  upb_handlers_setfloat(h, key, putfloat, NULL, NULL);
+                          break;
+    case UPB_TYPE_DOUBLE: upb_handlers_setdouble(h, key, putdouble, NULL, NULL);
+                          break;
+    case UPB_TYPE_BOOL:   upb_handlers_setbool(h, key, putbool, NULL, NULL);
+                          break;
+    case UPB_TYPE_STRING: UPB_FALLTHROUGH_INTENDED;
+    case UPB_TYPE_BYTES:
+      upb_handlers_setstartstr(h, key, startstr, NULL, NULL);
+      upb_handlers_setstring(h, key, putstr, NULL, NULL);
+      upb_handlers_setendstr(h, key, endstr, NULL, NULL);
+      break;
+    case UPB_TYPE_MESSAGE:
+      assert(false);
+      break;
+  }
+}
+
+upb_pbkey *upb_pbkey_new(const upb_fielddef *f) {
+  assert(upb_fielddef_isfrozen(f));
+  if (upb_fielddef_issubmsg(f)) return NULL;
+  upb_pbkey *k = malloc(sizeof(*k));
+  if (!k) return NULL;
+  k->f = f;
+
+  const upb_handlers *h = upb_handlers_newfrozen(
+      upb_fielddef_msgdef(f), NULL, &h, sethandlers, (void*)f);
+  k->decoder_h = upb_pbdecoder_getterminalhandlers(h, &f, 1, k);
+  upb_pipeline_init(&k->pipeline, k->seed, sizeof(k->seed), upb_realloc, NULL);
+  k->sink = upb_pipeline_newsink(&k->pipeline, h);
+  k->decoder_sink = upb_pipeline_newsink(&k->pipeline, k->decoder_h);
+  upb_pbdecoder_resetsink(upb_sink_getobj(k->decoder_sink), k->sink);
+  // The decoder plan keeps its own ref on the handlers.
+  upb_handlers_unref(h, &h);
+  k->found = false;
+  return k;
+}
+
+void upb_pbkey_free(upb_pbkey *k) {
+  upb_pipeline_uninit(&k->pipeline);
+  upb_handlers_unref(k->decoder_h, k);
+  free(k);
+}
+
+bool upb_pbkey_extract(upb_pbkey *k, const char *buf, size_t len) {
+  upb_pipeline_reset(&k->pipeline);
+  upb_sink_reset(k->sink, k);
+  k->found = false;
+
+  upb_sink *s = k->decoder_sink;
+  if (!upb_sink_startmsg(s) ||
+      !upb_sink_startstr(s, UPB_BYTESTREAM_BYTES_STARTSTR, len)) {
+    return false;
+  }
+  // Returns a short count when the decoder stops after the key.
+  upb_sink_putstring(s, UPB_BYTESTREAM_BYTES_STRING, buf, len);
+  return upb_ok(upb_pipeline_status(&k->pipeline)) &&
+         upb_sink_endstr(s, UPB_BYTESTREAM_BYTES_ENDSTR) &&
+         upb_sink_endmsg(s) &&
+         k->found;
+}
+
+upb_value upb_pbkey_value(const upb_pbkey *k) {
+  return k->val;
+}
+
+const char *upb_pbkey_str(const upb_pbkey *k, size_t *len) {
+  *len = k->len;
+  return k->str;
+}
+
+const upb_status *upb_pbkey_status(const upb_pbkey *k) {
+  return upb_pipeline_status(&k->pipeline);
+}
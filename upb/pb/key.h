@@ -0,0 +1,103 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * upb::pb::KeyExtractor pulls the value of one top-level field out of
+ * serialized protobuf records, for uses like sort or routing keys where the
+ * rest of the record does not matter:
+ *
+ *   upb_pbkey *k = upb_pbkey_new(f);
+ *   for (each record) {
+ *     if (upb_pbkey_extract(k, buf, len)) ... upb_pbkey_value(k)
+ *   }
+ *   upb_pbkey_free(k);
+ *
+ * It sets up its own handlers and a decoder whose only terminal field is the
+ * key, so decoding stops as soon as the key has been seen; the part of the
+ * record after it is never looked at.  All state is reused between records.
+ *
+ * The field must be a primitive or string field.  For a repeated field the
+ * first value is the key.  Strings point into the record's buffer.
+ */
+
+#ifndef UPB_PB_KEY_H_
+#define UPB_PB_KEY_H_
+
+#include "upb/def.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace pb {
+class KeyExtractor;
+}  // namespace pb
+}  // namespace upb
+typedef upb::pb::KeyExtractor upb_pbkey;
+#else
+struct upb_pbkey;
+typedef struct upb_pbkey upb_pbkey;
+#endif
+
+#ifdef __cplusplus
+
+class upb::pb::KeyExtractor {
+ public:
+  // Returns NULL if "f" (which must be frozen) is a submessage field.
+  static KeyExtractor* New(const FieldDef* f);
+  void Free();
+
+  // Returns true if the record has the key field.  When it returns false,
+  // status() tells whether the record was merely missing the field.
+  bool Extract(const char* buf, size_t len);
+
+  // The key from the last successful Extract(): value() for primitive fields
+  // (with enums as int32), str() for string fields.
+  upb_value value() const;
+  const char* str(size_t* len) const;
+  const Status& status() const;
+
+ private:
+  UPB_DISALLOW_POD_OPS(KeyExtractor);
+};
+
+extern "C" {
+#endif
+
+upb_pbkey *upb_pbkey_new(const upb_fielddef *f);
+void upb_pbkey_free(upb_pbkey *k);
+bool upb_pbkey_extract(upb_pbkey *k, const char *buf, size_t len);
+upb_value upb_pbkey_value(const upb_pbkey *k);
+const char *upb_pbkey_str(const upb_pbkey *k, size_t *len);
+const upb_status *upb_pbkey_status(const upb_pbkey *k);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+
+namespace upb {
+namespace pb {
+
+inline KeyExtractor* KeyExtractor::New(const FieldDef* f) {
+  return upb_pbkey_new(f);
+}
+inline void KeyExtractor::Free() {
+  upb_pbkey_free(this);
+}
+inline bool KeyExtractor::Extract(const char* buf, size_t len) {
+  return upb_pbkey_extract(this, buf, len);
+}
+inline upb_value KeyExtractor::value() const {
+  return upb_pbkey_value(this);
+}
+inline const char* KeyExtractor::str(size_t* len) const {
+  return upb_pbkey_str(this, len);
+}
+inline const Status& KeyExtractor::status() const {
+  return *upb_pbkey_status(this);
+}
+
+}  // namespace pb
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_PB_KEY_H_ */
@@ -0,0 +1,244 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ */
+
+#include "upb/pb/pull.h"
+
+#include <string.h>
+#include "upb/pb/varint.h"
+
+static upb_pull_event seterr(upb_pbpull *p, const char *msg) {
+  upb_status_seterrliteral(&p->status_, msg);
+  p->f = NULL;
+  return p->state = UPB_PULL_ERROR;
+}
+
+// Reads a length that is followed by at least that many bytes before "end".
+static bool getlen(const char **ptr, const char *end, size_t *len) {
+  uint64_t u64;
+  if (!upb_vdecode_bounded(ptr, end, &u64) || u64 > (uint64_t)(end - *ptr))
+    return false;
+  *len = u64;
+  return true;
+}
+
+static bool getfixed(const char **ptr, const char *end, void *val, size_t n) {
+  if ((size_t)(end - *ptr) < n) return false;
+  memcpy(val, *ptr, n);  // TODO: proper byte swapping for big-endian machines.
+  *ptr += n;
+  return true;
+}
+
+// Reads a value of the given numeric field into p->val.
+static bool getvalue(upb_pbpull *p, const upb_hotfield *f, const char *end) {
+  uint64_t u64;
+  uint32_t u32;
+  switch (f->descriptortype) {
+    case UPB_DESCRIPTOR_TYPE_DOUBLE: {
+      double d;
+      if (!getfixed(&p->ptr, end, &d, 8)) return false;
+      upb_value_setdouble(&p->val, d);
+      return true;
+    }
+    case UPB_DESCRIPTOR_TYPE_FLOAT: {
+      float fl;
+      if (!getfixed(&p->ptr, end, &fl, 4)) return false;
+      upb_value_setfloat(&p->val, fl);
+      return true;
+    }
+    case UPB_DESCRIPTOR_TYPE_FIXED64:
+      if (!getfixed(&p->ptr, end, &u64, 8)) return false;
+      upb_value_setuint64(&p->val, u64);
+      return true;
+    case UPB_DESCRIPTOR_TYPE_SFIXED64:
+      if (!getfixed(&p->ptr, end, &u64, 8)) return false;
+      upb_value_setint64(&p->val, (int64_t)u64);
+      return true;
+    case UPB_DESCRIPTOR_TYPE_FIXED32:
+      if (!getfixed(&p->ptr, end, &u32, 4)) return false;
+      upb_value_setuint32(&p->val, u32);
+      return true;
+    case UPB_DESCRIPTOR_TYPE_SFIXED32:
+      if (!getfixed(&p->ptr, end, &u32, 4)) return false;
+      upb_value_setint32(&p->val, (int32_t)u32);
+      return true;
+    default:
+      break;
+  }
+
+  // The rest are varints.
+  if (!upb_vdecode_bounded(&p->ptr, end, &u64)) return false;
+  switch (f->descriptortype) {
+    case UPB_DESCRIPTOR_TYPE_INT64:  upb_value_setint64(&p->val, u64); break;
+    case UPB_DESCRIPTOR_TYPE_UINT64: upb_value_setuint64(&p->val, u64); break;
+    case UPB_DESCRIPTOR_TYPE_INT32:  UPB_FALLTHROUGH_INTENDED;
+    case UPB_DESCRIPTOR_TYPE_ENUM:   upb_value_setint32(&p->val, u64); break;
+    case UPB_DESCRIPTOR_TYPE_UINT32: upb_value_setuint32(&p->val, u64); break;
+    case UPB_DESCRIPTOR_TYPE_BOOL:   upb_value_setbool(&p->val, u64); break;
+    case UPB_DESCRIPTOR_TYPE_SINT32:
+      upb_value_setint32(&p->val, upb_zzdec_32(u64));
+      break;
+    case UPB_DESCRIPTOR_TYPE_SINT64:
+      upb_value_setint64(&p->val, upb_zzdec_64(u64));
+      break;
+    default:
+      assert(false);
+  }
+  return true;
+}
+
+static upb_pull_event push(upb_pbpull *p, const upb_hotfield *f,
+                           const char *end, uint32_t group_fieldnum) {
+  if (p->top + 1 == p->stack + UPB_MAX_NESTING)
+    return seterr(p, "Nesting too deep.");
+  upb_pbpull_frame *fr = ++p->top;
+  fr->m = upb_downcast_msgdef(f->subdef);
+  fr->f = f;
+  fr->end = end;
+  fr->group_fieldnum = group_fieldnum;
+  p->f = f;
+  return p->state = UPB_PULL_STARTSUBMSG;
+}
+
+static upb_pull_event pop(upb_pbpull *p) {
+  p->f = p->top->f;
+  p->top--;
+  return p->state = UPB_PULL_ENDSUBMSG;
+}
+
+void upb_pbpull_reset(upb_pbpull *p, const upb_msgdef *m, const char *buf,
+                      size_t len) {
+  assert(upb_msgdef_isfrozen(m));
+  p->ptr = buf;
+  p->packed_f = NULL;
+  p->packed_end = NULL;
+  p->f = NULL;
+  p->str_data = NULL;
+  p->str_len = 0;
+  p->state = UPB_PULL_VALUE;
+  upb_status_init(&p->status_);
+  p->top = p->stack;
+  p->top->m = m;
+  p->top->f = NULL;
+  p->top->end = buf + len;
+  p->top->group_fieldnum = 0;
+}
+
+upb_pull_event upb_pbpull_next(upb_pbpull *p) {
+  if (p->state == UPB_PULL_ERROR || p->state == UPB_PULL_EOF)
+    return p->state;
+
+  while (1) {
+    if (p->packed_f) {
+      if (p->ptr < p->packed_end) {
+        p->f = p->packed_f;
+        if (!getvalue(p, p->f, p->packed_end))
+          return seterr(p, "Bad packed field");
+        return p->state = UPB_PULL_VALUE;
+      }
+      p->packed_f = NULL;
+    }
+
+    upb_pbpull_frame *fr = p->top;
+    if (p->ptr == fr->end) {
+      if (fr->group_fieldnum) return seterr(p, "Unterminated group");
+      if (fr == p->stack) {
+        p->f = NULL;
+        return p->state = UPB_PULL_EOF;
+      }
+      return pop(p);
+    }
+
+    uint64_t tag;
+    if (!upb_vdecode_bounded(&p->ptr, fr->end, &tag) || tag > UINT32_MAX)
+      return seterr(p, "Bad tag");
+    uint8_t wire_type = tag & 0x7;
+    uint32_t fieldnum = tag >> 3;
+    if (fieldnum == 0 || fieldnum > UPB_MAX_FIELDNUMBER)
+      return seterr(p, "Invalid field number");
+
+    const upb_hotfield *f = upb_msgdef_hotfield(fr->m, fieldnum);
+    size_t len;
+    if (f && wire_type == upb_pb_types[f->descriptortype].native_wire_type) {
+      switch (f->descriptortype) {
+        case UPB_DESCRIPTOR_TYPE_STRING:
+        case UPB_DESCRIPTOR_TYPE_BYTES:
+          if (!getlen(&p->ptr, fr->end, &len))
+            return seterr(p, "Bad string length");
+          p->f = f;
+          p->str_data = p->ptr;
+          p->str_len = len;
+          p->ptr += len;
+          return p->state = UPB_PULL_STRING;
+        case UPB_DESCRIPTOR_TYPE_MESSAGE:
+          if (!getlen(&p->ptr, fr->end, &len))
+            return seterr(p, "Bad submessage length");
+          return push(p, f, p->ptr + len, 0);
+        case UPB_DESCRIPTOR_TYPE_GROUP:
+          return push(p, f, fr->end, fieldnum);
+        default:
+          p->f = f;
+          if (!getvalue(p, f, fr->end)) return seterr(p, "Truncated value");
+          return p->state = UPB_PULL_VALUE;
+      }
+    } else if (f && wire_type == UPB_WIRE_TYPE_DELIMITED &&
+               upb_pb_types[f->descriptortype].is_numeric) {
+      if (!getlen(&p->ptr, fr->end, &len))
+        return seterr(p, "Bad packed field length");
+      p->packed_f = f;
+      p->packed_end = p->ptr + len;
+    } else if (wire_type == UPB_WIRE_TYPE_END_GROUP) {
+      if (fieldnum != fr->group_fieldnum)
+        return seterr(p, "Unmatched ENDGROUP tag");
+      return pop(p);
+    } else if (!upb_pb_skipfield(&p->ptr, fr->end, wire_type, fieldnum)) {
+      return seterr(p, "Bad unknown field");
+    }
+  }
+}
+
+const upb_fielddef *upb_pbpull_field(const upb_pbpull *p) {
+  return p->f ? p->f->f : NULL;
+}
+
+const upb_msgdef *upb_pbpull_msgdef(const upb_pbpull *p) {
+  return p->top->m;
+}
+
+upb_value upb_pbpull_value(const upb_pbpull *p) {
+  return p->val;
+}
+
+const char *upb_pbpull_str(const upb_pbpull *p, size_t *len) {
+  *len = p->str_len;
+  return p->str_data;
+}
+
+const upb_status *upb_pbpull_status(const upb_pbpull *p) {
+  return &p->status_;
+}
+
+void upb_pbpull_skipsubmsg(upb_pbpull *p) {
+  assert(p->state == UPB_PULL_STARTSUBMSG);
+  upb_pbpull_frame *fr = p->top;
+  if (fr->group_fieldnum == 0) {
+    p->ptr = fr->end;
+    return;
+  }
+
+  // Groups have no length, so their contents have to be scanned.  Stop just
+  // before the ENDGROUP tag so that it produces the UPB_PULL_ENDSUBMSG.
+  while (1) {
+    const char *ptr = p->ptr;
+    upb_pull_event e = upb_pbpull_next(p);
+    if (e == UPB_PULL_ERROR) return;
+    if (p->top < fr) {
+      p->ptr = ptr;
+      p->top = fr;
+      p->state = UPB_PULL_VALUE;
+      return;
+    }
+  }
+}
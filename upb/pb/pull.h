@@ -0,0 +1,194 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * upb::pb::PullDecoder is a pull-style ("iterator") decoder for protobuf
+ * binary data.  Instead of calling into a upb::Handlers, it returns one event
+ * at a time from Next(), so the caller can drive decoding from its own loop
+ * and keep its state in local variables instead of closures:
+ *
+ *   upb_pbpull p;
+ *   upb_pbpull_reset(&p, md, buf, len);
+ *   upb_pull_event e;
+ *   while ((e = upb_pbpull_next(&p)) > UPB_PULL_EOF) {
+ *     switch (e) {
+ *       case UPB_PULL_VALUE: ... upb_pbpull_field(&p), upb_pbpull_value(&p)
+ *       case UPB_PULL_STRING: ... upb_pbpull_str(&p, &len)
+ *       ...
+ *     }
+ *   }
+ *   if (e == UPB_PULL_ERROR) ... upb_pbpull_status(&p)
+ *
+ * Fields are looked up in the same per-message hot field tables that
+ * upb::pb::Decoder dispatches on, but values are returned to the caller
+ * instead of being passed to handlers, so decoding makes no indirect calls.
+ *
+ * The input must be a single, complete buffer that outlives the decoder;
+ * strings are returned as pointers into it, without copying.  Unknown fields
+ * are skipped.  There are no events for the start and end of repeated fields;
+ * each element (including each element of a packed field) is its own event.
+ *
+ * A upb_pbpull holds its whole stack inline, so it can be allocated on the C
+ * stack and needs no cleanup.
+ */
+
+#ifndef UPB_PB_PULL_H_
+#define UPB_PB_PULL_H_
+
+#include "upb/def.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace pb {
+class PullDecoder;
+}  // namespace pb
+}  // namespace upb
+typedef upb::pb::PullDecoder upb_pbpull;
+#else
+struct upb_pbpull;
+typedef struct upb_pbpull upb_pbpull;
+#endif
+
+typedef enum {
+  // Decoding failed; see upb_pbpull_status().  Every call to
+  // upb_pbpull_next() after this returns UPB_PULL_ERROR again.
+  UPB_PULL_ERROR = 0,
+
+  // The end of the top-level message.  Every call to upb_pbpull_next() after
+  // this returns UPB_PULL_EOF again.
+  UPB_PULL_EOF = 1,
+
+  // A primitive value for upb_pbpull_field(); see upb_pbpull_value().
+  UPB_PULL_VALUE = 2,
+
+  // A complete string or bytes value for upb_pbpull_field(); see
+  // upb_pbpull_str().
+  UPB_PULL_STRING = 3,
+
+  // The start and end of a submessage (or group) for upb_pbpull_field().
+  // Until the matching UPB_PULL_ENDSUBMSG, events are for fields of the
+  // submessage type.
+  UPB_PULL_STARTSUBMSG = 4,
+  UPB_PULL_ENDSUBMSG = 5,
+} upb_pull_event;
+
+typedef struct {
+  const upb_msgdef *m;
+  const upb_hotfield *f;  // The field this frame is for, NULL at the top.
+  const char *end;        // End of this message's data.
+  uint32_t group_fieldnum;  // 0 unless this frame is for a group.
+} upb_pbpull_frame;
+
+#ifdef __cplusplus
+
+class upb::pb::PullDecoder {
+ public:
+  PullDecoder(const MessageDef* m, const char* buf, size_t len);
+
+  // Starts decoding a new buffer of message type "m", which must be frozen.
+  void Reset(const MessageDef* m, const char* buf, size_t len);
+
+  upb_pull_event Next();
+
+  // Properties of the event last returned by Next().
+  const FieldDef* field() const;
+  const MessageDef* message_def() const;
+  upb_value value() const;
+  const char* str(size_t* len) const;
+  const Status& status() const;
+
+  // Call after UPB_PULL_STARTSUBMSG to skip the contents of the submessage;
+  // the next event is its UPB_PULL_ENDSUBMSG.
+  void SkipSubMessage();
+
+ private:
+#else
+struct upb_pbpull {
+#endif
+  const char *ptr;
+
+  // While inside a packed field: the field and the end of its data.
+  const upb_hotfield *packed_f;
+  const char *packed_end;
+
+  // Data for the last event.
+  const upb_hotfield *f;
+  upb_value val;
+  const char *str_data;
+  size_t str_len;
+
+  upb_pull_event state;  // Last event returned (UPB_PULL_VALUE initially).
+  upb_status status_;
+
+  upb_pbpull_frame *top;
+  upb_pbpull_frame stack[UPB_MAX_NESTING];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void upb_pbpull_reset(upb_pbpull *p, const upb_msgdef *m, const char *buf,
+                      size_t len);
+upb_pull_event upb_pbpull_next(upb_pbpull *p);
+void upb_pbpull_skipsubmsg(upb_pbpull *p);
+
+// The field of the last event, or NULL after UPB_PULL_EOF or UPB_PULL_ERROR.
+const upb_fielddef *upb_pbpull_field(const upb_pbpull *p);
+
+// The message type whose fields are currently being returned.  After
+// UPB_PULL_STARTSUBMSG this is the submessage's type.
+const upb_msgdef *upb_pbpull_msgdef(const upb_pbpull *p);
+
+// For UPB_PULL_VALUE, the value; its type is the field's upb_fieldtype_t,
+// with enums as int32.
+upb_value upb_pbpull_value(const upb_pbpull *p);
+
+// For UPB_PULL_STRING, the string data, which points into the input buffer.
+const char *upb_pbpull_str(const upb_pbpull *p, size_t *len);
+
+const upb_status *upb_pbpull_status(const upb_pbpull *p);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+
+namespace upb {
+namespace pb {
+
+inline PullDecoder::PullDecoder(const MessageDef* m, const char* buf,
+                                size_t len) {
+  upb_pbpull_reset(this, m, buf, len);
+}
+inline void PullDecoder::Reset(const MessageDef* m, const char* buf,
+                               size_t len) {
+  upb_pbpull_reset(this, m, buf, len);
+}
+inline upb_pull_event PullDecoder::Next() {
+  return upb_pbpull_next(this);
+}
+inline const FieldDef* PullDecoder::field() const {
+  return upb_pbpull_field(this);
+}
+inline const MessageDef* PullDecoder::message_def() const {
+  return upb_pbpull_msgdef(this);
+}
+inline upb_value PullDecoder::value() const {
+  return upb_pbpull_value(this);
+}
+inline const char* PullDecoder::str(size_t* len) const {
+  return upb_pbpull_str(this, len);
+}
+inline const Status& PullDecoder::status() const {
+  return *upb_pbpull_status(this);
+}
+inline void PullDecoder::SkipSubMessage() {
+  upb_pbpull_skipsubmsg(this);
+}
+
+}  // namespace pb
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_PB_PULL_H_ */
@@ -0,0 +1,498 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ */
+
+#include "upb/pb/records.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "upb/bytestream.h"
+#include "upb/pb/crc32c.h"
+#include "upb/pb/varint.h"
+
+static const char magic[8] = {'U', 'P', 'B', 'R', 'E', 'C', 'S', '1'};
+
+#define BLOCK_HEADER_SIZE 16
+#define INDEX_ENTRY_SIZE 24
+#define FOOTER_SIZE 24
+
+#define FLAG_CHECKSUM 1
+#define FLAG_RECORD_CHECKSUMS 2
+
+// Records are passed to the decoder in pieces of this size, so that each piece
+// is still in the L1 cache when the decoder reads it after it is checksummed.
+#define DECODE_CHUNK_SIZE 4096
+
+// TODO: proper byte swapping for big-endian machines.
+static void put32(char *p, uint32_t val) { memcpy(p, &val, 4); }
+static void put64(char *p, uint64_t val) { memcpy(p, &val, 8); }
+static uint32_t get32(const char *p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static uint64_t get64(const char *p) { uint64_t v; memcpy(&v, p, 8); return v; }
+
+
+/* upb_recordwriter ***********************************************************/
+
+struct upb_recordwriter {
+  upb_pipeline *pipeline;
+  FILE *file;
+  size_t block_size;
+  upb_recordchecksum_t checksum;
+  uint64_t ofs;      // Bytes written to the file so far.
+  uint64_t records;  // Records in the blocks written so far.
+
+  // The current block's records, after room for its header.
+  char *block;
+  size_t block_len, block_cap;
+  uint32_t block_records;
+  size_t record_start;  // Where the current record's bytes start.
+  uint32_t record_crc;  // CRC32C of the current record's bytes so far.
+
+  // The encoded index entries of the blocks written so far.
+  char *index;
+  size_t index_len, index_cap;
+};
+
+static bool reserve(upb_recordwriter *w, char **buf, size_t *cap, size_t len) {
+  if (len <= *cap) return true;
+  size_t cap2 = UPB_MAX(*cap * 2, len);
+  char *buf2 = upb_pipeline_realloc(w->pipeline, *buf, *cap, cap2);
+  if (!buf2) {
+    upb_pipeline_seterr(w->pipeline, "Out of memory");
+    return false;
+  }
+  *buf = buf2;
+  *cap = cap2;
+  return true;
+}
+
+static bool writebytes(upb_recordwriter *w, const char *buf, size_t len) {
+  if (fwrite(buf, 1, len, w->file) != len) {
+    upb_pipeline_seterr(w->pipeline, "Error writing record file");
+    return false;
+  }
+  w->ofs += len;
+  return true;
+}
+
+// Writes the current block, if it has any records.
+static bool flush(upb_recordwriter *w) {
+  if (w->block_records == 0) return true;
+  size_t len = w->block_len - BLOCK_HEADER_SIZE;
+  if (len > UINT32_MAX) {
+    upb_pipeline_seterr(w->pipeline, "Block too large");
+    return false;
+  }
+  char *hdr = w->block;
+  bool block_checksum = w->checksum == UPB_RECORDS_BLOCKCHECKSUM;
+  uint32_t flags = 0;
+  if (block_checksum) flags |= FLAG_CHECKSUM;
+  if (w->checksum == UPB_RECORDS_RECORDCHECKSUM) flags |= FLAG_RECORD_CHECKSUMS;
+  put32(hdr, len);
+  put32(hdr + 4, w->block_records);
+  put32(hdr + 8, flags);
+  put32(hdr + 12,
+        block_checksum ? upb_crc32c(0, hdr + BLOCK_HEADER_SIZE, len) : 0);
+
+  if (!reserve(w, &w->index, &w->index_cap, w->index_len + INDEX_ENTRY_SIZE))
+    return false;
+  char *ent = w->index + w->index_len;
+  put64(ent, w->ofs);
+  put64(ent + 8, w->records);
+  put32(ent + 16, len);
+  put32(ent + 20, w->block_records);
+  w->index_len += INDEX_ENTRY_SIZE;
+
+  if (!writebytes(w, w->block, w->block_len)) return false;
+  w->records += w->block_records;
+  w->block_records = 0;
+  w->block_len = BLOCK_HEADER_SIZE;
+  return true;
+}
+
+static void *writer_startstr(void *closure, const void *hd, size_t size_hint) {
+  UPB_UNUSED(hd);
+  upb_recordwriter *w = closure;
+  assert(w->file);
+  // Room for the longest length we allow; the record is moved back over what
+  // the length does not use when it ends.
+  size_t need = w->block_len + UPB_PB_VARINT_MAX_LEN + size_hint;
+  if (!reserve(w, &w->block, &w->block_cap, need)) return UPB_BREAK;
+  w->block_len += UPB_PB_VARINT_MAX_LEN;
+  w->record_start = w->block_len;
+  w->record_crc = 0;
+  return w;
+}
+
+static size_t writer_string(void *closure, const void *hd, const char *buf,
+                            size_t n) {
+  UPB_UNUSED(hd);
+  upb_recordwriter *w = closure;
+  if (!reserve(w, &w->block, &w->block_cap, w->block_len + n)) return 0;
+  memcpy(w->block + w->block_len, buf, n);
+  w->block_len += n;
+  if (w->checksum == UPB_RECORDS_RECORDCHECKSUM)
+    w->record_crc = upb_crc32c(w->record_crc, buf, n);
+  return n;
+}
+
+static bool writer_endstr(void *closure, const void *hd) {
+  UPB_UNUSED(hd);
+  upb_recordwriter *w = closure;
+  size_t len = w->block_len - w->record_start;
+  char *start = w->block + w->record_start - UPB_PB_VARINT_MAX_LEN;
+  size_t lenlen = upb_vencode64(len, start);
+  memmove(start + lenlen, w->block + w->record_start, len);
+  w->block_len = (start - w->block) + lenlen + len;
+  if (w->checksum == UPB_RECORDS_RECORDCHECKSUM) {
+    if (!reserve(w, &w->block, &w->block_cap, w->block_len + 4)) return false;
+    put32(w->block + w->block_len, w->record_crc);
+    w->block_len += 4;
+  }
+  w->block_records++;
+  if (w->block_len - BLOCK_HEADER_SIZE >= w->block_size) return flush(w);
+  return true;
+}
+
+static bool writer_init(void *obj, upb_pipeline *p) {
+  upb_recordwriter *w = obj;
+  w->pipeline = p;
+  w->file = NULL;
+  w->block = NULL;
+  w->block_cap = 0;
+  w->index = NULL;
+  w->index_cap = 0;
+  return true;
+}
+
+static const upb_frametype writer_frametype = {
+  sizeof(upb_recordwriter),
+  writer_init,
+  NULL,
+  NULL,
+};
+
+const upb_handlers *upb_recordwriter_newhandlers(const void *owner) {
+  upb_handlers *h = upb_handlers_new(UPB_BYTESTREAM, &writer_frametype, owner);
+  upb_handlers_setstartstr(h, UPB_BYTESTREAM_BYTES, writer_startstr, NULL,
+                           NULL);
+  upb_handlers_setstring(h, UPB_BYTESTREAM_BYTES, writer_string, NULL, NULL);
+  upb_handlers_setendstr(h, UPB_BYTESTREAM_BYTES, writer_endstr, NULL, NULL);
+  return h;
+}
+
+bool upb_recordwriter_open(upb_recordwriter *w, FILE *file, size_t block_size,
+                           upb_recordchecksum_t checksum) {
+  w->file = file;
+  w->block_size = block_size ? block_size : UPB_RECORDS_DEFAULT_BLOCKSIZE;
+  w->checksum = checksum;
+  w->ofs = 0;
+  w->records = 0;
+  w->block_records = 0;
+  w->block_len = BLOCK_HEADER_SIZE;
+  w->index_len = 0;
+  return reserve(w, &w->block, &w->block_cap, BLOCK_HEADER_SIZE) &&
+         writebytes(w, magic, sizeof(magic));
+}
+
+bool upb_recordwriter_finish(upb_recordwriter *w) {
+  if (!upb_ok(upb_pipeline_status(w->pipeline)) || !flush(w)) return false;
+  char footer[FOOTER_SIZE];
+  put64(footer, w->ofs);
+  put64(footer + 8, w->index_len / INDEX_ENTRY_SIZE);
+  memcpy(footer + 16, magic, sizeof(magic));
+  bool ok = writebytes(w, w->index, w->index_len) &&
+            writebytes(w, footer, sizeof(footer));
+  if (ok && fflush(w->file) != 0) {
+    upb_pipeline_seterr(w->pipeline, "Error writing record file");
+    ok = false;
+  }
+  w->file = NULL;
+  return ok;
+}
+
+
+/* upb_recordreader ***********************************************************/
+
+struct upb_recordreader {
+  const char *buf;
+  size_t len;
+  bool mapped;
+  const char *index;
+  uint64_t block_count;
+  uint64_t record_count;
+};
+
+// Checks the footer and the index, so that the blocks can be found without
+// further bounds checks.
+static bool load(upb_recordreader *r, upb_status *status) {
+  const char *buf = r->buf;
+  size_t len = r->len;
+  if (len < sizeof(magic) + FOOTER_SIZE ||
+      memcmp(buf, magic, sizeof(magic)) != 0 ||
+      memcmp(buf + len - sizeof(magic), magic, sizeof(magic)) != 0) {
+    upb_status_seterrliteral(status, "Not a record file");
+    return false;
+  }
+  const char *footer = buf + len - FOOTER_SIZE;
+  uint64_t index_ofs = get64(footer);
+  uint64_t count = get64(footer + 8);
+  uint64_t index_end = footer - buf;
+  if (index_ofs < sizeof(magic) || index_ofs > index_end ||
+      count != (index_end - index_ofs) / INDEX_ENTRY_SIZE ||
+      (index_end - index_ofs) % INDEX_ENTRY_SIZE != 0) {
+    upb_status_seterrliteral(status, "Record file index is corrupt");
+    return false;
+  }
+
+  // Blocks must be in order, with no gaps, and numbered consecutively.
+  uint64_t ofs = sizeof(magic);
+  uint64_t records = 0;
+  for (uint64_t i = 0; i < count; i++) {
+    const char *ent = buf + index_ofs + i * INDEX_ENTRY_SIZE;
+    if (get64(ent) != ofs || get64(ent + 8) != records) {
+      upb_status_seterrliteral(status, "Record file index is corrupt");
+      return false;
+    }
+    ofs += BLOCK_HEADER_SIZE + (uint64_t)get32(ent + 16);
+    records += get32(ent + 20);
+  }
+  if (ofs != index_ofs) {
+    upb_status_seterrliteral(status, "Record file index is corrupt");
+    return false;
+  }
+  r->index = buf + index_ofs;
+  r->block_count = count;
+  r->record_count = records;
+  return true;
+}
+
+upb_recordreader *upb_recordreader_openbuf(const char *buf, size_t len,
+                                           upb_status *status) {
+  upb_recordreader *r = malloc(sizeof(*r));
+  r->buf = buf;
+  r->len = len;
+  r->mapped = false;
+  if (!load(r, status)) {
+    free(r);
+    return NULL;
+  }
+  return r;
+}
+
+upb_recordreader *upb_recordreader_open(const char *filename,
+                                        upb_status *status) {
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) {
+    upb_status_seterrf(status, "couldn't open %s", filename);
+    return NULL;
+  }
+  struct stat st;
+  void *buf = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    buf = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (buf == MAP_FAILED) {
+    upb_status_seterrf(status, "couldn't map %s", filename);
+    return NULL;
+  }
+  upb_recordreader *r = upb_recordreader_openbuf(buf, st.st_size, status);
+  if (!r) {
+    munmap(buf, st.st_size);
+    return NULL;
+  }
+  r->mapped = true;
+  return r;
+}
+
+void upb_recordreader_close(upb_recordreader *r) {
+  if (r->mapped) munmap((void*)r->buf, r->len);
+  free(r);
+}
+
+uint64_t upb_recordreader_blockcount(const upb_recordreader *r) {
+  return r->block_count;
+}
+
+uint64_t upb_recordreader_recordcount(const upb_recordreader *r) {
+  return r->record_count;
+}
+
+static const char *indexentry(const upb_recordreader *r, uint64_t block) {
+  return r->index + block * INDEX_ENTRY_SIZE;
+}
+
+static void initcursor(const upb_recordreader *r, uint64_t block,
+                       uint64_t end_block, upb_recordcursor *c) {
+  c->r = r;
+  c->block = block;
+  c->end_block = end_block;
+  c->ptr = NULL;
+  c->end = NULL;
+  c->left = 0;
+  c->record_checksums = false;
+  upb_status_init(&c->status_);
+}
+
+void upb_recordreader_split(const upb_recordreader *r, size_t i, size_t n,
+                            upb_recordcursor *c) {
+  assert(i < n);
+  // Each split starts at the first block that starts at or after its share of
+  // the bytes.
+  uint64_t bounds[2];
+  for (int j = 0; j < 2; j++) {
+    uint64_t target = (r->index - r->buf) * (uint64_t)(i + j) / n;
+    uint64_t lo = 0, hi = r->block_count;
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (get64(indexentry(r, mid)) < target) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    bounds[j] = lo;
+  }
+  if (i + 1 == n) bounds[1] = r->block_count;
+  initcursor(r, bounds[0], bounds[1], c);
+}
+
+
+/* upb_recordcursor ***********************************************************/
+
+// Moves to the next block, checking it.
+static bool nextblock(upb_recordcursor *c) {
+  const upb_recordreader *r = c->r;
+  const char *hdr = r->buf + get64(indexentry(r, c->block));
+  const char *ent = indexentry(r, c->block);
+  uint32_t len = get32(hdr);
+  uint32_t count = get32(hdr + 4);
+  uint32_t flags = get32(hdr + 8);
+  if (len != get32(ent + 16) || count != get32(ent + 20)) {
+    upb_status_seterrliteral(&c->status_, "Record block header is corrupt");
+    return false;
+  }
+  const char *data = hdr + BLOCK_HEADER_SIZE;
+  if ((flags & FLAG_CHECKSUM) && upb_crc32c(0, data, len) != get32(hdr + 12)) {
+    upb_status_seterrliteral(&c->status_, "Record block checksum mismatch");
+    return false;
+  }
+  c->block++;
+  c->ptr = data;
+  c->end = data + len;
+  c->left = count;
+  c->record_checksums = (flags & FLAG_RECORD_CHECKSUMS) != 0;
+  return true;
+}
+
+// Gets the next record without checking its checksum, if it has one.
+static bool nextrecord(upb_recordcursor *c, const char **buf, size_t *len,
+                       uint32_t *crc) {
+  if (!upb_ok(&c->status_)) return false;
+  while (c->left == 0) {
+    if (c->ptr != c->end) {
+      upb_status_seterrliteral(&c->status_, "Record block is corrupt");
+      return false;
+    }
+    if (c->block == c->end_block) return false;
+    if (!nextblock(c)) return false;
+  }
+
+  uint64_t n;
+  size_t crclen = c->record_checksums ? 4 : 0;
+  if (!upb_vdecode_bounded(&c->ptr, c->end, &n) ||
+      (uint64_t)(c->end - c->ptr) < crclen ||
+      n > (uint64_t)(c->end - c->ptr) - crclen) {
+    upb_status_seterrliteral(&c->status_, "Record block is corrupt");
+    return false;
+  }
+  *buf = c->ptr;
+  *len = n;
+  if (c->record_checksums) *crc = get32(c->ptr + n);
+  c->ptr += n + crclen;
+  c->left--;
+  return true;
+}
+
+bool upb_recordcursor_next(upb_recordcursor *c, const char **buf,
+                           size_t *len) {
+  uint32_t crc;
+  if (!nextrecord(c, buf, len, &crc)) return false;
+  if (c->record_checksums && upb_crc32c(0, *buf, *len) != crc) {
+    upb_status_seterrliteral(&c->status_, "Record checksum mismatch");
+    return false;
+  }
+  return true;
+}
+
+bool upb_recordcursor_decode(upb_recordcursor *c, upb_sink *sink) {
+  const char *buf;
+  size_t len;
+  uint32_t expected;
+  if (!nextrecord(c, &buf, &len, &expected)) return false;
+  if (!c->record_checksums) return upb_bytestream_putstr(sink, buf, len);
+
+  if (!upb_sink_startmsg(sink) ||
+      !upb_sink_startstr(sink, UPB_BYTESTREAM_BYTES_STARTSTR, len)) {
+    return false;
+  }
+  uint32_t crc = 0;
+  size_t ofs = 0;
+  bool ok = true;
+  while (ofs < len) {
+    size_t n = UPB_MIN(len - ofs, DECODE_CHUNK_SIZE);
+    crc = upb_crc32c(crc, buf + ofs, n);
+    ofs += n;
+    if (upb_sink_putstring(sink, UPB_BYTESTREAM_BYTES_STRING,
+                           buf + ofs - n, n) != n) {
+      ok = false;
+      break;
+    }
+  }
+  // The sink may have stopped early without an error, but the record is still
+  // only good if all of it is.
+  crc = upb_crc32c(crc, buf + ofs, len - ofs);
+  if (crc != expected) {
+    upb_pipeline_seterr(upb_sink_pipeline(sink), "Record checksum mismatch");
+    return false;
+  }
+  if (!ok || !upb_sink_endstr(sink, UPB_BYTESTREAM_BYTES_ENDSTR)) return false;
+  upb_sink_endmsg(sink);
+  return true;
+}
+
+const upb_status *upb_recordcursor_status(const upb_recordcursor *c) {
+  return &c->status_;
+}
+
+void upb_recordreader_seek(const upb_recordreader *r, uint64_t record,
+                           upb_recordcursor *c) {
+  // The last block whose first record is at or before "record".
+  uint64_t lo = 0, hi = r->block_count;
+  while (hi - lo > 1) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (get64(indexentry(r, mid) + 8) <= record) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  initcursor(r, lo, r->block_count, c);
+  if (record >= r->record_count) {
+    c->block = c->end_block;
+    return;
+  }
+  // Skip the earlier records of the block by their lengths alone; only the
+  // one sought has its checksum checked, when it is read.
+  uint64_t skip = record - get64(indexentry(r, lo) + 8);
+  const char *buf;
+  size_t len;
+  uint32_t crc;
+  while (skip-- > 0 && nextrecord(c, &buf, &len, &crc)) {}
+}
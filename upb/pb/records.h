@@ -0,0 +1,248 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * A container file format for serialized records, with a writer stage and a
+ * reader that can seek and split files for parallel decoding.  Records are
+ * grouped into blocks, and an index of the blocks at the end of the file lets
+ * a reader find any block without scanning the ones before it:
+ *
+ *   file:   "UPBRECS1" block* index footer
+ *   block:  length:u32 record_count:u32 flags:u32 crc32c:u32 record*
+ *   record: varint length, then the record's bytes, then crc32c:u32 if
+ *           bit 1 of the block's flags is set
+ *   index:  (offset:u64 first_record:u64 length:u32 record_count:u32)*
+ *   footer: index_offset:u64 block_count:u64 "UPBRECS1"
+ *
+ * All integers are little-endian.  A block's "length" counts its records, not
+ * its header; its CRC32C covers the same bytes, and is only present if bit 0
+ * of "flags" is set.  A record's CRC32C covers just the record's bytes.  Each
+ * index entry gives the file offset of a block's header and the number of the
+ * block's first record in the file.
+ *
+ * upb::pb::RecordWriter is a pipeline object whose handlers take a
+ * upb::ByteStream: each string is one record, which may be passed in any
+ * number of pieces, so it can be fed directly by a stage that serializes
+ * messages:
+ *
+ *   upb_sink *sink = upb_pipeline_newsink(&pipeline, writer_handlers);
+ *   upb_recordwriter *w = upb_sink_getobj(sink);
+ *   upb_recordwriter_open(w, file, 0, UPB_RECORDS_RECORDCHECKSUM);
+ *   for (each record) upb_bytestream_putstr(sink, buf, len);
+ *   if (!upb_recordwriter_finish(w)) ... upb_pipeline_status(&pipeline)
+ *
+ * upb::pb::RecordReader maps a file and hands out cursors over its records,
+ * which point into the mapping and are passed to a decoder without copying.
+ * Cursors can start at any record, or cover one of "n" roughly equal splits of
+ * the file so that "n" threads can decode it in parallel:
+ *
+ *   upb_recordreader *r = upb_recordreader_open(filename, &status);
+ *   // In thread i of n:
+ *   upb_recordcursor c;
+ *   upb_recordreader_split(r, i, n, &c);
+ *   while (upb_recordcursor_decode(&c, decoder_sink)) { ... }
+ *   if (!upb_ok(upb_recordcursor_status(&c))) ...
+ *
+ * The reader checks the index when it opens the file and each block before its
+ * records are returned, so a corrupt file causes an error rather than reads
+ * outside the mapping.  Once opened, a reader may be used by any number of
+ * threads, each with its own cursors.
+ *
+ * A block checksum is verified in a pass over the whole block before any of
+ * its records are returned.  Record checksums are cheaper to use while
+ * decoding: upb_recordcursor_decode() computes each one over the piece of the
+ * record it is about to pass to the decoder, while the piece is in cache, and
+ * compares it at the end of the record.
+ */
+
+#ifndef UPB_PB_RECORDS_H_
+#define UPB_PB_RECORDS_H_
+
+#include <stdio.h>
+#include "upb/sink.h"
+
+#ifdef __cplusplus
+namespace upb {
+namespace pb {
+class RecordCursor;
+class RecordReader;
+class RecordWriter;
+}  // namespace pb
+}  // namespace upb
+typedef upb::pb::RecordCursor upb_recordcursor;
+typedef upb::pb::RecordReader upb_recordreader;
+typedef upb::pb::RecordWriter upb_recordwriter;
+#else
+struct upb_recordcursor;
+struct upb_recordreader;
+struct upb_recordwriter;
+typedef struct upb_recordcursor upb_recordcursor;
+typedef struct upb_recordreader upb_recordreader;
+typedef struct upb_recordwriter upb_recordwriter;
+#endif
+
+// The block size used when none is given: blocks are ended after the first
+// record that brings them to at least this many bytes.
+#define UPB_RECORDS_DEFAULT_BLOCKSIZE (64 * 1024)
+
+// What the writer checksums.
+typedef enum {
+  UPB_RECORDS_NOCHECKSUM,
+  UPB_RECORDS_BLOCKCHECKSUM,
+  UPB_RECORDS_RECORDCHECKSUM,
+} upb_recordchecksum_t;
+
+#ifdef __cplusplus
+
+class upb::pb::RecordWriter {
+ public:
+  // Returns handlers for a RecordWriter, which take a upb::ByteStream.
+  static const Handlers* NewHandlers(const void* owner);
+
+  // Starts a new file on "file", which must be open for writing and stays
+  // owned by the caller.  Blocks hold about "block_size" bytes of records (the
+  // default if 0).
+  bool Open(FILE* file, size_t block_size, upb_recordchecksum_t checksum);
+
+  // Writes the last block and the index.  The file is not closed.  Errors
+  // here or while writing records are in the pipeline status.
+  bool Finish();
+
+ private:
+  UPB_DISALLOW_POD_OPS(RecordWriter);
+};
+
+class upb::pb::RecordReader {
+ public:
+  // Maps the given file, or reads from a buffer that must outlive the reader.
+  // Returns NULL and sets "status" if the file is not a valid container.
+  static RecordReader* Open(const char* filename, Status* status);
+  static RecordReader* OpenBuffer(const char* buf, size_t len, Status* status);
+  void Close();
+
+  uint64_t block_count() const;
+  uint64_t record_count() const;
+
+  // Sets "c" to cover the records from number "record" to the end.  Records
+  // before it in its block are skipped without checking their checksums.
+  void Seek(uint64_t record, RecordCursor* c) const;
+
+  // Sets "c" to cover split "i" of "n", a run of whole blocks.  Splits are
+  // about equal in bytes, and together cover every record in order.
+  void Split(size_t i, size_t n, RecordCursor* c) const;
+
+ private:
+  UPB_DISALLOW_POD_OPS(RecordReader);
+};
+
+class upb::pb::RecordCursor {
+ public:
+  // Gets the next record, which points into the reader's data.  Returns false
+  // at the end of the cursor's records, or if a block or record is corrupt
+  // (see status()).
+  bool Next(const char** buf, size_t* len);
+
+  // Passes the next record to "sink", which takes a upb::ByteStream (like a
+  // upb::pb::Decoder sink).  Returns false at the end of the cursor's records,
+  // on an error in the record's block (see status()), or on an error in the
+  // sink (see its pipeline status).  A record whose checksum does not match is
+  // an error in the sink: its handlers may have seen some of its values, but
+  // the record never ends successfully.
+  bool Decode(Sink* sink);
+
+  const Status& status() const;
+
+ private:
+#else
+struct upb_recordcursor {
+#endif
+  const upb_recordreader *r;
+  uint64_t block, end_block;  // The next block to read, and the end.
+  const char *ptr, *end;      // The rest of the current block.
+  uint32_t left;              // Records left in the current block.
+  bool record_checksums;      // Whether the current block's records have them.
+  upb_status status_;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const upb_handlers *upb_recordwriter_newhandlers(const void *owner);
+bool upb_recordwriter_open(upb_recordwriter *w, FILE *file, size_t block_size,
+                           upb_recordchecksum_t checksum);
+bool upb_recordwriter_finish(upb_recordwriter *w);
+
+upb_recordreader *upb_recordreader_open(const char *filename,
+                                        upb_status *status);
+upb_recordreader *upb_recordreader_openbuf(const char *buf, size_t len,
+                                           upb_status *status);
+void upb_recordreader_close(upb_recordreader *r);
+uint64_t upb_recordreader_blockcount(const upb_recordreader *r);
+uint64_t upb_recordreader_recordcount(const upb_recordreader *r);
+void upb_recordreader_seek(const upb_recordreader *r, uint64_t record,
+                           upb_recordcursor *c);
+void upb_recordreader_split(const upb_recordreader *r, size_t i, size_t n,
+                            upb_recordcursor *c);
+
+bool upb_recordcursor_next(upb_recordcursor *c, const char **buf, size_t *len);
+bool upb_recordcursor_decode(upb_recordcursor *c, upb_sink *sink);
+const upb_status *upb_recordcursor_status(const upb_recordcursor *c);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+
+namespace upb {
+namespace pb {
+
+inline const Handlers* RecordWriter::NewHandlers(const void* owner) {
+  return upb_recordwriter_newhandlers(owner);
+}
+inline bool RecordWriter::Open(FILE* file, size_t block_size,
+                               upb_recordchecksum_t checksum) {
+  return upb_recordwriter_open(this, file, block_size, checksum);
+}
+inline bool RecordWriter::Finish() {
+  return upb_recordwriter_finish(this);
+}
+
+inline RecordReader* RecordReader::Open(const char* filename, Status* status) {
+  return upb_recordreader_open(filename, status);
+}
+inline RecordReader* RecordReader::OpenBuffer(const char* buf, size_t len,
+                                              Status* status) {
+  return upb_recordreader_openbuf(buf, len, status);
+}
+inline void RecordReader::Close() {
+  upb_recordreader_close(this);
+}
+inline uint64_t RecordReader::block_count() const {
+  return upb_recordreader_blockcount(this);
+}
+inline uint64_t RecordReader::record_count() const {
+  return upb_recordreader_recordcount(this);
+}
+inline void RecordReader::Seek(uint64_t record, RecordCursor* c) const {
+  upb_recordreader_seek(this, record, c);
+}
+inline void RecordReader::Split(size_t i, size_t n, RecordCursor* c) const {
+  upb_recordreader_split(this, i, n, c);
+}
+
+inline bool RecordCursor::Next(const char** buf, size_t* len) {
+  return upb_recordcursor_next(this, buf, len);
+}
+inline bool RecordCursor::Decode(Sink* sink) {
+  return upb_recordcursor_decode(this, sink);
+}
+inline const Status& RecordCursor::status() const {
+  return *upb_recordcursor_status(this);
+}
+
+}  // namespace pb
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_PB_RECORDS_H_ */
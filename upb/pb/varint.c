@@ -7,6 +7,75 @@
 
 #include "upb/pb/varint.h"
 
+const upb_pb_typeinfo upb_pb_types[] = {
+  {UPB_WIRE_TYPE_END_GROUP,   false},  // ENDGROUP
+  {UPB_WIRE_TYPE_64BIT,       true},   // DOUBLE
+  {UPB_WIRE_TYPE_32BIT,       true},   // FLOAT
+  {UPB_WIRE_TYPE_VARINT,      true},   // INT64
+  {UPB_WIRE_TYPE_VARINT,      true},   // UINT64
+  {UPB_WIRE_TYPE_VARINT,      true},   // INT32
+  {UPB_WIRE_TYPE_64BIT,       true},   // FIXED64
+  {UPB_WIRE_TYPE_32BIT,       true},   // FIXED32
+  {UPB_WIRE_TYPE_VARINT,      true},   // BOOL
+  {UPB_WIRE_TYPE_DELIMITED,   false},  // STRING
+  {UPB_WIRE_TYPE_START_GROUP, false},  // GROUP
+  {UPB_WIRE_TYPE_DELIMITED,   false},  // MESSAGE
+  {UPB_WIRE_TYPE_DELIMITED,   false},  // BYTES
+  {UPB_WIRE_TYPE_VARINT,      true},   // UINT32
+  {UPB_WIRE_TYPE_VARINT,      true},   // ENUM
+  {UPB_WIRE_TYPE_32BIT,       true},   // SFIXED32
+  {UPB_WIRE_TYPE_64BIT,       true},   // SFIXED64
+  {UPB_WIRE_TYPE_VARINT,      true},   // SINT32
+  {UPB_WIRE_TYPE_VARINT,      true},   // SINT64
+};
+
+bool upb_pb_skipfield(const char **ptr, const char *end, uint8_t wire_type,
+                      uint32_t fieldnum) {
+  // Unknown groups can nest; their field numbers are kept here to match them
+  // with their ENDGROUP tags.
+  uint32_t groups[UPB_MAX_NESTING];
+  int depth = 0;
+  const char *p = *ptr;
+  while (1) {
+    uint64_t u64;
+    switch (wire_type) {
+      case UPB_WIRE_TYPE_VARINT:
+        if (!upb_vdecode_bounded(&p, end, &u64)) return false;
+        break;
+      case UPB_WIRE_TYPE_64BIT:
+        if (end - p < 8) return false;
+        p += 8;
+        break;
+      case UPB_WIRE_TYPE_32BIT:
+        if (end - p < 4) return false;
+        p += 4;
+        break;
+      case UPB_WIRE_TYPE_DELIMITED:
+        if (!upb_vdecode_bounded(&p, end, &u64) ||
+            u64 > (uint64_t)(end - p)) {
+          return false;
+        }
+        p += u64;
+        break;
+      case UPB_WIRE_TYPE_START_GROUP:
+        if (depth == UPB_MAX_NESTING) return false;
+        groups[depth++] = fieldnum;
+        break;
+      case UPB_WIRE_TYPE_END_GROUP:
+        if (depth == 0 || groups[--depth] != fieldnum) return false;
+        break;
+      default:
+        return false;
+    }
+    if (depth == 0) break;
+    if (!upb_vdecode_bounded(&p, end, &u64)) return false;
+    wire_type = u64 & 0x7;
+    fieldnum = u64 >> 3;
+  }
+  *ptr = p;
+  return true;
+}
+
 // A basic branch-based decoder, uses 32-bit values to get good performance
 // on 32-bit architectures (but performs well on 64-bits also).
 // This scheme comes from the original Google Protobuf implementation (proto2).
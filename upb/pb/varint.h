@@ -29,6 +29,16 @@ typedef enum {
   UPB_WIRE_TYPE_32BIT       = 5,
 } upb_wiretype_t;
 
+// What each descriptor type (upb_descriptortype_t) looks like on the wire,
+// indexed by descriptor type.  Numeric types may also appear packed, as
+// UPB_WIRE_TYPE_DELIMITED.
+typedef struct {
+  uint8_t native_wire_type;
+  bool is_numeric;
+} upb_pb_typeinfo;
+
+extern const upb_pb_typeinfo upb_pb_types[];
+
 // The maximum number of bytes that it takes to encode a 64-bit varint.
 // Note that with a better encoding this could be 9 (TODO: write up a
 // wiki document about this).
@@ -96,6 +106,40 @@ UPB_INLINE upb_decoderet upb_vdecode_max8_fast(upb_decoderet r) {
   return upb_vdecode_max8_massimino(r);
 }
 
+// Decodes a varint that must end before "end", advancing "*ptr" past it.
+// Returns false if it does not, or if it is longer than
+// UPB_PB_VARINT_MAX_LEN bytes.  Safe to use at the end of a buffer.
+UPB_INLINE bool upb_vdecode_bounded(const char **ptr, const char *end,
+                                    uint64_t *val) {
+  const char *p = *ptr;
+  if (end - p >= UPB_PB_VARINT_MAX_LEN) {
+    upb_decoderet r = upb_vdecode_fast(p);
+    if (!r.p) return false;
+    *ptr = r.p;
+    *val = r.val;
+    return true;
+  }
+  uint64_t u64 = 0;
+  for (int bitpos = 0; bitpos < 70 && p < end; bitpos += 7) {
+    uint8_t byte = *p++;
+    u64 |= (uint64_t)(byte & 0x7f) << bitpos;
+    if ((byte & 0x80) == 0) {
+      *ptr = p;
+      *val = u64;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Skips the value of a field whose tag, with the given wire type and field
+// number, has just been read, advancing "*ptr" past it.  A group is skipped
+// through its ENDGROUP tag, along with any groups nested in it.  Returns false,
+// leaving "*ptr" unchanged, if the value is malformed or does not end before
+// "end".
+bool upb_pb_skipfield(const char **ptr, const char *end, uint8_t wire_type,
+                      uint32_t fieldnum);
+
 
 /* Encoding *******************************************************************/
 
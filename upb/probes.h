@@ -0,0 +1,97 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * Static tracepoints ("USDT probes") for tracers like bpftrace, perf and
+ * SystemTap.  They are compiled in only with -DUPB_USE_PROBES, and only for
+ * x86-64 ELF targets; otherwise the macros expand to nothing.
+ *
+ * A probe is a single nop, plus a note in the .note.stapsdt section that
+ * tells the tracer where the nop is and where to find the probe's arguments.
+ * A tracer attaches by replacing the nop with a breakpoint, so until then a
+ * probe costs the nop and whatever it takes to have its arguments in
+ * registers (arguments should be cheap expressions for that reason).  The
+ * notes have the same format as the ones <sys/sdt.h> generates, but that
+ * header is not needed to build.
+ *
+ * The probes, all of provider "upb", are:
+ *
+ *   decode_start(decoder, size_hint)
+ *   decode_end(decoder, bytes_parsed, ok)
+ *   decode_resume(decoder, len, residual_len)
+ *       The decoder was given the next buffer of "len" bytes, with
+ *       "residual_len" bytes saved from the previous one.
+ *   decode_suspend(decoder, consumed, residual_len)
+ *       The decoder is returning, having consumed "consumed" bytes of the
+ *       buffer.  This is at the end of the buffer, or on an error or a halt.
+ *   jit_enter(decoder, offset)
+ *   jit_exit(decoder, offset)
+ *       JIT code returned to the interpreter, which will decode the next
+ *       field.  (A suspend from inside JIT code has no jit_exit.)
+ *   pipeline_reset(pipeline)
+ *   pipeline_grow(pipeline, region_size)
+ *       The pipeline's arena allocated a new region.
+ *   error(status, msg)
+ *
+ * For example, to count JIT fallbacks by call stack:
+ *
+ *   bpftrace -e 'usdt:./myserver:upb:jit_exit { @[ustack] = count(); }'
+ */
+
+#ifndef UPB_PROBES_H_
+#define UPB_PROBES_H_
+
+#if defined(UPB_USE_PROBES) && defined(__GNUC__) && defined(__ELF__) && \
+    defined(__x86_64__)
+
+#include <stdint.h>
+
+// Every argument is passed as a signed 64-bit value ("-8@" in the note), as a
+// constant, register or memory operand.
+#define UPB_PROBE_ARG(x) "nor"((int64_t)(x))
+
+#define UPB_PROBE_(name, argfmt, ...)                                       \
+  __asm__ __volatile__(                                                     \
+      "990: nop\n"                                                          \
+      ".pushsection .note.stapsdt,\"?\",\"note\"\n"                         \
+      ".balign 4\n"                                                         \
+      ".4byte 992f-991f, 994f-993f, 3\n"                                    \
+      "991: .asciz \"stapsdt\"\n"                                           \
+      "992: .balign 4\n"                                                    \
+      "993: .8byte 990b\n"                                                  \
+      ".8byte _.stapsdt.base\n"                                             \
+      ".8byte 0\n"  /* No semaphore. */                                     \
+      ".asciz \"upb\"\n"                                                    \
+      ".asciz \"" #name "\"\n"                                              \
+      ".asciz \"" argfmt "\"\n"                                             \
+      "994: .balign 4\n"                                                    \
+      ".popsection\n"                                                       \
+      /* Tracers find the link-time address of the notes relative to this. */\
+      ".ifndef _.stapsdt.base\n"                                            \
+      ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"\
+      ".weak _.stapsdt.base\n"                                              \
+      ".hidden _.stapsdt.base\n"                                            \
+      "_.stapsdt.base: .space 1\n"                                          \
+      ".size _.stapsdt.base, 1\n"                                           \
+      ".popsection\n"                                                       \
+      ".endif\n"                                                            \
+      :: __VA_ARGS__)
+
+#define UPB_PROBE1(name, a) \
+  UPB_PROBE_(name, "-8@%0", UPB_PROBE_ARG(a))
+#define UPB_PROBE2(name, a, b) \
+  UPB_PROBE_(name, "-8@%0 -8@%1", UPB_PROBE_ARG(a), UPB_PROBE_ARG(b))
+#define UPB_PROBE3(name, a, b, c) \
+  UPB_PROBE_(name, "-8@%0 -8@%1 -8@%2", \
+             UPB_PROBE_ARG(a), UPB_PROBE_ARG(b), UPB_PROBE_ARG(c))
+
+#else
+
+#define UPB_PROBE1(name, a)
+#define UPB_PROBE2(name, a, b)
+#define UPB_PROBE3(name, a, b, c)
+
+#endif
+
+#endif  /* UPB_PROBES_H_ */
@@ -135,6 +135,21 @@ static const void *unobfuscate_v(upb_value x) {
 //
 static upb_inttable reftracks = UPB_EMPTY_INTTABLE_INIT(UPB_CTYPE_PTR);
 
+// See upb_refcounted_settracking().  Read without the lock, since it only
+// changes when no tracked refs exist.
+static uint32_t sample_every = 1;
+
+void upb_refcounted_settracking(uint32_t n) { sample_every = n; }
+
+// Returns true if refs that "owner" takes on "r" are tracked.  This must be
+// cheap and lock-free, since it is what untracked refs pay.
+static bool sampled(const upb_refcounted *r, const void *owner) {
+  if (sample_every <= 1) return sample_every == 1;
+  uint64_t h = (uint64_t)(uintptr_t)r * 0x9E3779B97F4A7C15ULL;
+  h = (h ^ (uint64_t)(uintptr_t)owner) * 0x9E3779B97F4A7C15ULL;
+  return (h >> 32) % sample_every == 0;
+}
+
 static upb_inttable *trygettab(const void *p) {
   upb_value v;
   return upb_inttable_lookupptr(&reftracks, p, &v) ? upb_value_getptr(v) : NULL;
@@ -153,6 +168,7 @@ static upb_inttable *gettab(const void *p) {
 }
 
 static void track(const upb_refcounted *r, const void *owner, bool ref2) {
+  if (!sampled(r, owner)) return;
   upb_lock();
   upb_inttable *refs = gettab(owner);
   upb_value v;
@@ -175,6 +191,7 @@ static void track(const upb_refcounted *r, const void *owner, bool ref2) {
 }
 
 static void untrack(const upb_refcounted *r, const void *owner, bool ref2) {
+  if (!sampled(r, owner)) return;
   upb_lock();
   upb_inttable *refs = gettab(owner);
   upb_value v;
@@ -196,6 +213,7 @@ static void untrack(const upb_refcounted *r, const void *owner, bool ref2) {
 }
 
 static void checkref(const upb_refcounted *r, const void *owner, bool ref2) {
+  if (!sampled(r, owner)) return;
   upb_lock();
   upb_inttable *refs = gettab(owner);
   upb_value v;
@@ -237,6 +255,8 @@ static void visit_check(const upb_refcounted *obj, const upb_refcounted *subobj,
   check_state *s = closure;
   assert(obj == s->obj);
   assert(subobj);
+  // Only sampled ref2's were recorded by getref2s().
+  if (!sampled(subobj, obj)) return;
   upb_inttable *ref2 = &s->ref2;
   upb_value v;
   bool removed = upb_inttable_removeptr(ref2, subobj, &v);
@@ -271,6 +291,10 @@ static void visit(const upb_refcounted *r, upb_refcounted_visit *v,
 
 #else
 
+void upb_refcounted_settracking(uint32_t sample_every) {
+  UPB_UNUSED(sample_every);
+}
+
 static void track(const upb_refcounted *r, const void *owner, bool ref2) {
   UPB_UNUSED(r);
   UPB_UNUSED(owner);
@@ -96,6 +96,20 @@ void upb_refcounted_donateref(
     const upb_refcounted *r, const void *from, const void *to);
 void upb_refcounted_checkref(const upb_refcounted *r, const void *owner);
 
+// In UPB_DEBUG_REFS builds every ref and unref takes a global lock to update
+// the tracking tables, which serializes multi-threaded programs.  This lets
+// such builds track only a sample of refs instead: 1 in "sample_every"
+// (owner, object) pairs, chosen by hashing the pair so that all refs a given
+// owner takes on a given object are either tracked or not.  Refs that are not
+// sampled cost no more than in a release build.  1 (the default) tracks every
+// ref and 0 disables tracking entirely.  upb_refcounted_checkref() can only
+// verify sampled refs.
+//
+// Must not be called while any refs are outstanding that would be sampled
+// differently; in practice, call it once at startup.  A no-op when
+// UPB_DEBUG_REFS is not defined.
+void upb_refcounted_settracking(uint32_t sample_every);
+
 
 // Internal-to-upb Interface ///////////////////////////////////////////////////
 
@@ -7,14 +7,17 @@
 
 #include "upb/shim/shim.h"
 
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
+#include "upb/table.h"
 
 // Fallback implementation if the shim is not specialized by the JIT.
 #define SHIM_WRITER(type, ctype)                                              \
   bool upb_shim_set ## type (void *c, const void *hd, ctype val) {            \
     uint8_t *m = c;                                                           \
     const upb_shim_data *d = hd;                                              \
-    if (d->hasbit > 0)                                                        \
+    if (d->hasbit >= 0)                                                       \
       *(uint8_t*)&m[d->hasbit / 8] |= 1 << (d->hasbit % 8);                   \
     *(ctype*)&m[d->offset] = val;                                             \
     return true;                                                              \
@@ -67,3 +70,458 @@ const upb_shim_data *upb_shim_getdata(const upb_handlers *h, upb_selector_t s) {
     return NULL;
   }
 }
+
+
+/* Shims that allocate ********************************************************/
+
+// Unlike the writers above these are not candidates for JIT specialization;
+// they exist so that generated structs can be populated without any
+// hand-written handlers.
+
+typedef struct {
+  upb_shim_data data;  // Returned by upb_shim_getfielddata().
+  size_t size;  // Element size for repeated primitives, struct size for msgs,
+                // and for maps the size of values stored by pointer.
+  bool strings;  // Map values are strings, stored as upb_shim_str.
+  upb_shim_alloc alloc;
+} allocdata;
+
+static allocdata *newallocdata(size_t offset, int32_t hasbit, size_t size,
+                               const upb_shim_alloc *a) {
+  allocdata *d = malloc(sizeof(*d));
+  if (!d) return NULL;
+  d->data.offset = offset;
+  d->data.hasbit = hasbit;
+  d->size = size;
+  d->strings = false;
+  d->alloc = *a;
+  return d;
+}
+
+static void *doalloc(const allocdata *d, void *p, size_t oldsize, size_t size) {
+  return d->alloc.func(d->alloc.ud, p, oldsize, size);
+}
+
+static void sethas(void *c, int32_t hasbit) {
+  if (hasbit >= 0) ((uint8_t*)c)[hasbit / 8] |= 1 << (hasbit % 8);
+}
+
+// Appends an uninitialized element to the array, returning NULL if we were
+// unable to grow it.
+static void *append(upb_shim_arr *arr, const allocdata *d, size_t elemsize) {
+  if (arr->len == arr->size) {
+    uint32_t size = UPB_MAX(8, arr->size * 2);
+    void *ptr = doalloc(d, arr->ptr, arr->size * elemsize, size * elemsize);
+    if (!ptr) return NULL;
+    arr->ptr = ptr;
+    arr->size = size;
+  }
+  return (char*)arr->ptr + (arr->len++ * elemsize);
+}
+
+static void *startseq(void *c, const void *hd) {
+  const allocdata *d = hd;
+  return (char*)c + d->data.offset;
+}
+
+#define SHIM_APPENDER(type, ctype)                                            \
+  static bool append ## type (void *c, const void *hd, ctype val) {           \
+    ctype *p = append(c, hd, sizeof(ctype));                                  \
+    if (!p) return false;                                                     \
+    *p = val;                                                                 \
+    return true;                                                              \
+  }                                                                           \
+
+SHIM_APPENDER(double, double)
+SHIM_APPENDER(float,  float)
+SHIM_APPENDER(int32,  int32_t)
+SHIM_APPENDER(int64,  int64_t)
+SHIM_APPENDER(uint32, uint32_t)
+SHIM_APPENDER(uint64, uint64_t)
+SHIM_APPENDER(bool,   bool)
+#undef SHIM_APPENDER
+
+static void *startstr(void *c, const void *hd, size_t size_hint) {
+  UPB_UNUSED(size_hint);
+  const allocdata *d = hd;
+  upb_shim_str *str = (upb_shim_str*)((char*)c + d->data.offset);
+  sethas(c, d->data.hasbit);
+  // Any previous value stays in the allocator, which we assume is an arena.
+  str->ptr = NULL;
+  str->len = 0;
+  return str;
+}
+
+static void *appendstr(void *c, const void *hd, size_t size_hint) {
+  UPB_UNUSED(size_hint);
+  upb_shim_str *str = append(c, hd, sizeof(upb_shim_str));
+  if (!str) return UPB_BREAK;
+  str->ptr = NULL;
+  str->len = 0;
+  return str;
+}
+
+static size_t putstr(void *c, const void *hd, const char *buf, size_t n) {
+  upb_shim_str *str = c;
+  char *ptr = doalloc(hd, str->ptr, str->len, str->len + n);
+  if (!ptr) return 0;
+  memcpy(ptr + str->len, buf, n);
+  str->ptr = ptr;
+  str->len += n;
+  return n;
+}
+
+static void *newmsg(const allocdata *d) {
+  void *msg = doalloc(d, NULL, 0, d->size);
+  if (msg) memset(msg, 0, d->size);
+  return msg;
+}
+
+static void *startsubmsg(void *c, const void *hd) {
+  const allocdata *d = hd;
+  void **p = (void**)((char*)c + d->data.offset);
+  sethas(c, d->data.hasbit);
+  // Repeated occurrences of a non-repeated submessage are merged.
+  if (!*p && !(*p = newmsg(d))) return UPB_BREAK;
+  return *p;
+}
+
+static void *appendsubmsg(void *c, const void *hd) {
+  void **p = append(c, hd, sizeof(void*));
+  if (!p || !(*p = newmsg(hd))) return UPB_BREAK;
+  return *p;
+}
+
+bool upb_shim_setstr(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                     int32_t hasbit, const upb_shim_alloc *a) {
+  assert(upb_fielddef_isstring(f));
+  allocdata *d = newallocdata(offset, hasbit, 0, a);
+  if (!d) return false;
+  bool ok;
+  if (upb_fielddef_isseq(f)) {
+    ok = upb_handlers_setstartseq(h, f, startseq, d, free) &&
+         upb_handlers_setstartstr(h, f, appendstr, d, NULL);
+  } else {
+    ok = upb_handlers_setstartstr(h, f, startstr, d, free);
+  }
+  return ok && upb_handlers_setstring(h, f, putstr, d, NULL);
+}
+
+bool upb_shim_setrepeated(upb_handlers *h, const upb_fielddef *f,
+                          size_t offset, const upb_shim_alloc *a) {
+  assert(upb_fielddef_isseq(f) && upb_fielddef_isprimitive(f));
+  allocdata *d = newallocdata(offset, -1, 0, a);
+  if (!d) return false;
+  if (!upb_handlers_setstartseq(h, f, startseq, d, free)) return false;
+
+#define TYPE(u, l) \
+  case UPB_TYPE_##u: return upb_handlers_set##l(h, f, append##l, d, NULL)
+
+  switch (upb_fielddef_type(f)) {
+    TYPE(INT64,  int64);
+    TYPE(INT32,  int32);
+    TYPE(ENUM,   int32);
+    TYPE(UINT64, uint64);
+    TYPE(UINT32, uint32);
+    TYPE(DOUBLE, double);
+    TYPE(FLOAT,  float);
+    TYPE(BOOL,   bool);
+    default: assert(false); return false;
+  }
+#undef TYPE
+}
+
+bool upb_shim_setsubmsg(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                        int32_t hasbit, size_t msgsize,
+                        const upb_shim_alloc *a) {
+  assert(upb_fielddef_issubmsg(f));
+  allocdata *d = newallocdata(offset, hasbit, msgsize, a);
+  if (!d) return false;
+  if (upb_fielddef_isseq(f)) {
+    return upb_handlers_setstartseq(h, f, startseq, d, free) &&
+           upb_handlers_setstartsubmsg(h, f, appendsubmsg, d, NULL);
+  } else {
+    return upb_handlers_setstartsubmsg(h, f, startsubmsg, d, free);
+  }
+}
+
+// Returns the data of the handler for selector "type" of "f" if it is
+// "func", otherwise NULL.
+static const upb_shim_data *getallocdata(const upb_handlers *h,
+                                         const upb_fielddef *f,
+                                         upb_handlertype_t type,
+                                         upb_func *func) {
+  upb_selector_t sel;
+  if (!upb_handlers_getselector(f, type, &sel) ||
+      upb_handlers_gethandler(h, sel) != func) {
+    return NULL;
+  }
+  const allocdata *d = upb_handlers_gethandlerdata(h, sel);
+  return &d->data;
+}
+
+const upb_shim_data *upb_shim_getfielddata(const upb_handlers *h,
+                                           const upb_fielddef *f) {
+  if (upb_fielddef_isseq(f)) {
+    // Map shims also start with startseq(), but store into a table.
+    upb_selector_t sel;
+    if (upb_handlers_getselector(f, UPB_HANDLER_MAPENTRY, &sel) &&
+        upb_handlers_gethandler(h, sel)) {
+      return NULL;
+    }
+    return getallocdata(h, f, UPB_HANDLER_STARTSEQ, (upb_func*)startseq);
+  } else if (upb_fielddef_isstring(f)) {
+    return getallocdata(h, f, UPB_HANDLER_STARTSTR, (upb_func*)startstr);
+  } else if (upb_fielddef_issubmsg(f)) {
+    return getallocdata(h, f, UPB_HANDLER_STARTSUBMSG,
+                        (upb_func*)startsubmsg);
+  } else {
+    upb_selector_t sel;
+    if (!upb_handlers_getselector(
+            f, upb_handlers_getprimitivehandlertype(f), &sel)) {
+      return NULL;
+    }
+    return upb_shim_getdata(h, sel);
+  }
+}
+
+
+/* Map shims ******************************************************************/
+
+// Returns in "v" the value to store for a map value.  String values are copied
+// into a new upb_shim_str, and 64-bit values into a new int64_t, uint64_t or
+// double, because the table can't store a value whose bits are all ones.
+static bool mapvalue(const allocdata *d, const upb_mapitem *item,
+                     upb_value *v) {
+  if (d->size == 0) {
+    *v = item->val;
+    return true;
+  }
+  void *box = doalloc(d, NULL, 0, d->size);
+  if (!box) return false;
+  if (d->strings) {
+    upb_shim_str *str = box;
+    str->ptr = NULL;
+    str->len = item->len;
+    if (item->len > 0) {
+      if (!(str->ptr = doalloc(d, NULL, 0, item->len))) return false;
+      memcpy(str->ptr, item->str, item->len);
+    }
+  } else {
+    *(uint64_t*)box = item->val.val.uint64;
+  }
+  upb_value_setptr(v, box);
+  return true;
+}
+
+// A later entry with the same key replaces the earlier one.  Any string value
+// it had stays in the allocator, which we assume is an arena.
+static bool putstrmap(void *c, const void *hd, const upb_mapitem *key,
+                      const upb_mapitem *val) {
+  upb_strtable *t = c;
+  upb_value v;
+  // The table takes NULL-terminated keys, so keys with NULLs can't be stored.
+  if (memchr(key->str, '\0', key->len) || !mapvalue(hd, val, &v))
+    return false;
+  char buf[64];
+  char *k = key->len < sizeof(buf) ? buf : malloc(key->len + 1);
+  if (!k) return false;
+  memcpy(k, key->str, key->len);
+  k[key->len] = '\0';
+  upb_strtable_remove(t, k, NULL);
+  bool ok = upb_strtable_insert(t, k, v);
+  if (k != buf) free(k);
+  return ok;
+}
+
+static bool putintmap(upb_inttable *t, uintptr_t key, upb_value v) {
+  upb_inttable_remove(t, key, NULL);
+  return upb_inttable_insert(t, key, v);
+}
+
+#define SHIM_INTMAP(type)                                                     \
+  static bool put ## type ## map(void *c, const void *hd,                     \
+                                 const upb_mapitem *key,                      \
+                                 const upb_mapitem *val) {                    \
+    upb_value v;                                                              \
+    return mapvalue(hd, val, &v) &&                                           \
+           putintmap(c, (uintptr_t)upb_value_get ## type(key->val), v);       \
+  }                                                                           \
+
+SHIM_INTMAP(int32)
+SHIM_INTMAP(int64)
+SHIM_INTMAP(uint32)
+SHIM_INTMAP(uint64)
+SHIM_INTMAP(bool)
+#undef SHIM_INTMAP
+
+bool upb_shim_setmap(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                     const upb_shim_alloc *a) {
+  assert(upb_fielddef_ismap(f));
+  const upb_msgdef *entry = upb_downcast_msgdef(upb_fielddef_subdef(f));
+  const upb_fielddef *val = upb_msgdef_itof(entry, 2);
+  upb_fieldtype_t keytype = upb_fielddef_type(upb_msgdef_itof(entry, 1));
+  // The table's keys are uintptr_t, which can't hold every 64-bit key here.
+  if ((keytype == UPB_TYPE_INT64 || keytype == UPB_TYPE_UINT64) &&
+      sizeof(uintptr_t) < sizeof(uint64_t)) {
+    return false;
+  }
+  size_t size = 0;
+  switch (upb_fielddef_type(val)) {
+    case UPB_TYPE_STRING:
+    case UPB_TYPE_BYTES: size = sizeof(upb_shim_str); break;
+    case UPB_TYPE_INT64:
+    case UPB_TYPE_UINT64:
+    case UPB_TYPE_DOUBLE: size = sizeof(uint64_t); break;
+    default: break;
+  }
+  allocdata *d = newallocdata(offset, -1, size, a);
+  if (!d) return false;
+  d->strings = upb_fielddef_isstring(val);
+  if (!upb_handlers_setstartseq(h, f, startseq, d, free)) return false;
+
+#define TYPE(u, l) \
+  case UPB_TYPE_##u: return upb_handlers_setmapentry(h, f, put##l##map, d, NULL)
+
+  switch (keytype) {
+    TYPE(INT64,  int64);
+    TYPE(INT32,  int32);
+    TYPE(UINT64, uint64);
+    TYPE(UINT32, uint32);
+    TYPE(BOOL,   bool);
+    case UPB_TYPE_STRING:
+      return upb_handlers_setmapentry(h, f, putstrmap, d, NULL);
+    default: assert(false); return false;
+  }
+#undef TYPE
+}
+
+
+/* Struct layout **************************************************************/
+
+// This lays structs out exactly like tools/dump_cstruct.lua, so that the
+// generated structs and the ones laid out at runtime are interchangeable.
+
+#define ALIGNOF(type) offsetof(struct { char c; type x; }, x)
+
+typedef struct {
+  const upb_fielddef *f;
+  int align;       // Alignment class, which determines the order.
+  size_t size;     // Size and alignment of the C type.
+  size_t alignment;
+  int32_t hasbit;
+  size_t offset;
+} member;
+
+static int cmp_number(const void *_a, const void *_b) {
+  const member *a = _a, *b = _b;
+  return upb_fielddef_number(a->f) < upb_fielddef_number(b->f) ? -1 : 1;
+}
+
+static int cmp_layout(const void *_a, const void *_b) {
+  const member *a = _a, *b = _b;
+  if (a->align != b->align) return a->align > b->align ? -1 : 1;
+  return cmp_number(a, b);
+}
+
+static void setctype(member *m) {
+#define CTYPE(type, align_class) \
+  m->size = sizeof(type); m->alignment = ALIGNOF(type); m->align = align_class
+
+  const upb_fielddef *f = m->f;
+  if (upb_fielddef_isseq(f)) {
+    CTYPE(upb_shim_arr, 8);
+  } else if (upb_fielddef_isstring(f)) {
+    CTYPE(upb_shim_str, 8);
+  } else if (upb_fielddef_issubmsg(f)) {
+    CTYPE(void*, 8);
+  } else {
+    switch (upb_fielddef_type(f)) {
+      case UPB_TYPE_DOUBLE: CTYPE(double, 8); break;
+      case UPB_TYPE_INT64:  CTYPE(int64_t, 8); break;
+      case UPB_TYPE_UINT64: CTYPE(uint64_t, 8); break;
+      case UPB_TYPE_FLOAT:  CTYPE(float, 4); break;
+      case UPB_TYPE_INT32:
+      case UPB_TYPE_ENUM:   CTYPE(int32_t, 4); break;
+      case UPB_TYPE_UINT32: CTYPE(uint32_t, 4); break;
+      case UPB_TYPE_BOOL:   CTYPE(bool, 1); break;
+      default: assert(false);
+    }
+  }
+#undef CTYPE
+}
+
+// Returns the message's members in layout order, or NULL if out of memory
+// (or if there are none).  The caller must free() the array.
+static member *layout(const upb_msgdef *m, int *n, size_t *size) {
+  *n = upb_msgdef_numfields(m);
+  member *members = malloc(*n * sizeof(*members));
+  if (!members) return NULL;
+  upb_msg_iter i;
+  int j = 0;
+  for (upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+    members[j++].f = upb_msg_iter_field(&i);
+  }
+
+  // Hasbits are assigned in number order, before reordering by alignment.
+  qsort(members, *n, sizeof(*members), cmp_number);
+  int32_t hasbits = 0;
+  for (j = 0; j < *n; j++) {
+    members[j].hasbit = upb_fielddef_isseq(members[j].f) ? -1 : hasbits++;
+    setctype(&members[j]);
+  }
+  qsort(members, *n, sizeof(*members), cmp_layout);
+
+  // Like the generated structs, pad the hasbits to 8 bytes if any member is in
+  // the 8-byte alignment class (members are sorted, so the first one is).
+  size_t words = (hasbits + 31) / 32;
+  if (*n > 0 && members[0].align == 8 && words % 2 == 1) words++;
+  size_t ofs = words * sizeof(uint32_t);
+  size_t maxalign = hasbits > 0 ? ALIGNOF(uint32_t) : 1;
+  for (j = 0; j < *n; j++) {
+    member *mem = &members[j];
+    ofs = (ofs + mem->alignment - 1) / mem->alignment * mem->alignment;
+    mem->offset = ofs;
+    ofs += mem->size;
+    maxalign = UPB_MAX(maxalign, mem->alignment);
+  }
+  // An empty struct gets a char member.
+  *size = *n == 0 ? 1 : (ofs + maxalign - 1) / maxalign * maxalign;
+  return members;
+}
+
+size_t upb_shim_structsize(const upb_msgdef *m) {
+  int n;
+  size_t size;
+  free(layout(m, &n, &size));
+  return size;
+}
+
+bool upb_shim_setstruct(upb_handlers *h, const upb_shim_alloc *a) {
+  int n;
+  size_t size;
+  member *members = layout(upb_handlers_msgdef(h), &n, &size);
+  if (!members && n > 0) return false;
+  bool ok = true;
+  for (int i = 0; i < n && ok; i++) {
+    const member *m = &members[i];
+    const upb_fielddef *f = m->f;
+    if (upb_fielddef_issubmsg(f)) {
+      const upb_msgdef *sub = upb_downcast_msgdef(upb_fielddef_subdef(f));
+      ok = upb_shim_setsubmsg(h, f, m->offset, m->hasbit,
+                              upb_shim_structsize(sub), a);
+    } else if (upb_fielddef_isstring(f)) {
+      ok = upb_shim_setstr(h, f, m->offset, m->hasbit, a);
+    } else if (upb_fielddef_isseq(f)) {
+      ok = upb_shim_setrepeated(h, f, m->offset, a);
+    } else {
+      ok = upb_shim_set(h, f, m->offset, m->hasbit);
+    }
+  }
+  free(members);
+  return ok;
+}
+
+void upb_shim_structhandlers(void *closure, upb_handlers *h) {
+  upb_shim_setstruct(h, closure);
+}
@@ -25,6 +25,30 @@ typedef struct {
   int32_t hasbit;
 } upb_shim_data;
 
+// Memory-owning members of a struct that is populated by shims (see
+// tools/dump_cstruct.lua, which generates such structs from a .proto file).
+// The pointed-to memory comes from a upb_shim_alloc and is never freed by the
+// shims themselves; an arena (like a upb_pipeline) is the natural backing.
+typedef struct {
+  char *ptr;
+  size_t len;
+} upb_shim_str;
+
+typedef struct {
+  void *ptr;      // Elements of the field's C type (pointers for submessages).
+  uint32_t len;   // Number of elements that have been appended.
+  uint32_t size;  // Number of elements that "ptr" has room for.
+} upb_shim_arr;
+
+// Allocation function with the same contract as upb_pipeline_realloc().
+typedef void *upb_shim_allocfunc(void *ud, void *ptr, size_t oldsize,
+                                 size_t size);
+
+typedef struct {
+  upb_shim_allocfunc *func;
+  void *ud;
+} upb_shim_alloc;
+
 #ifdef __cplusplus
 
 namespace upb {
@@ -40,6 +64,48 @@ struct Shim {
   // If this handler is a shim, returns the corresponding upb::Shim::Data.
   // Otherwise returns NULL.
   static const Data* GetData(const Handlers* h, Handlers::Selector s);
+
+  // These set the handlers for the fields that need memory: strings (into a
+  // upb_shim_str), repeated fields (into a upb_shim_arr) and submessages (into
+  // a pointer to a newly-allocated, zeroed struct of size "msgsize").  The
+  // hasbit is ignored for repeated fields.  Memory is obtained from "a",
+  // which is copied.  Returns true if all handlers were set successfully.
+  static bool SetString(Handlers *h, const FieldDef *f, size_t ofs,
+                        int32_t hasbit, const upb_shim_alloc *a);
+  static bool SetRepeated(Handlers *h, const FieldDef *f, size_t ofs,
+                          const upb_shim_alloc *a);
+  static bool SetSubMessage(Handlers *h, const FieldDef *f, size_t ofs,
+                            int32_t hasbit, size_t msgsize,
+                            const upb_shim_alloc *a);
+
+  // Sets the handlers for a map field (see FieldDef::IsMap()) to insert each
+  // entry into the table at the given offset, which must already be
+  // initialized: a upb_strtable for string keys, otherwise a upb_inttable
+  // whose keys are the integer keys converted to uintptr_t (so 64-bit keys
+  // fail where uintptr_t is narrower).  The table's type is the C type of
+  // the values, or UPB_CTYPE_PTR for string values, which are stored as a
+  // upb_shim_str obtained from "a", and for int64, uint64 and double values,
+  // which are stored as a pointer to a copy obtained from "a".  A repeated
+  // key replaces the earlier value.  String keys containing NULL stop
+  // processing.
+  static bool SetMap(Handlers *h, const FieldDef *f, size_t ofs,
+                     const upb_shim_alloc *a);
+
+  // Returns where the shims set for field "f" store it, for any of the
+  // setters above except SetMap(), or NULL if "f" does not have shims.  The
+  // hasbit is always -1 for repeated fields.  This lets readers of the
+  // struct (like upb::pb::Encoder) find their way around it.
+  static const Data* GetFieldData(const Handlers* h, const FieldDef* f);
+
+  // Lays out a struct for every field of the handlers' message, exactly as
+  // tools/dump_cstruct.lua would generate it, and sets the shims for it.
+  // This is for messages that are only known at runtime.  Map fields are
+  // stored like other repeated submessages.  Returns true if all handlers
+  // were set successfully.
+  static bool SetStruct(Handlers* h, const upb_shim_alloc* a);
+
+  // Returns the size of the struct that SetStruct() lays out for "m".
+  static size_t StructSize(const MessageDef* m);
 };
 
 }  // namespace upb
@@ -51,6 +117,24 @@ extern "C" {
 bool upb_shim_set(upb_handlers *h, const upb_fielddef *f, size_t offset,
                   int32_t hasbit);
 const upb_shim_data *upb_shim_getdata(const upb_handlers *h, upb_selector_t s);
+bool upb_shim_setstr(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                     int32_t hasbit, const upb_shim_alloc *a);
+bool upb_shim_setrepeated(upb_handlers *h, const upb_fielddef *f,
+                          size_t offset, const upb_shim_alloc *a);
+bool upb_shim_setsubmsg(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                        int32_t hasbit, size_t msgsize,
+                        const upb_shim_alloc *a);
+bool upb_shim_setmap(upb_handlers *h, const upb_fielddef *f, size_t offset,
+                     const upb_shim_alloc *a);
+const upb_shim_data *upb_shim_getfielddata(const upb_handlers *h,
+                                           const upb_fielddef *f);
+bool upb_shim_setstruct(upb_handlers *h, const upb_shim_alloc *a);
+size_t upb_shim_structsize(const upb_msgdef *m);
+
+// A upb_handlers_callback for upb_handlers_newfrozen() that calls
+// upb_shim_setstruct() for every message.  "closure" must be a
+// const upb_shim_alloc*.
+void upb_shim_structhandlers(void *closure, upb_handlers *h);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -66,6 +150,33 @@ inline const Shim::Data* Shim::GetData(const Handlers* h,
                                        Handlers::Selector s) {
   return upb_shim_getdata(h, s);
 }
+inline bool Shim::SetString(Handlers* h, const FieldDef* f, size_t ofs,
+                            int32_t hasbit, const upb_shim_alloc* a) {
+  return upb_shim_setstr(h, f, ofs, hasbit, a);
+}
+inline bool Shim::SetRepeated(Handlers* h, const FieldDef* f, size_t ofs,
+                              const upb_shim_alloc* a) {
+  return upb_shim_setrepeated(h, f, ofs, a);
+}
+inline bool Shim::SetSubMessage(Handlers* h, const FieldDef* f, size_t ofs,
+                                int32_t hasbit, size_t msgsize,
+                                const upb_shim_alloc* a) {
+  return upb_shim_setsubmsg(h, f, ofs, hasbit, msgsize, a);
+}
+inline bool Shim::SetMap(Handlers* h, const FieldDef* f, size_t ofs,
+                         const upb_shim_alloc* a) {
+  return upb_shim_setmap(h, f, ofs, a);
+}
+inline const Shim::Data* Shim::GetFieldData(const Handlers* h,
+                                            const FieldDef* f) {
+  return upb_shim_getfielddata(h, f);
+}
+inline bool Shim::SetStruct(Handlers* h, const upb_shim_alloc* a) {
+  return upb_shim_setstruct(h, a);
+}
+inline size_t Shim::StructSize(const MessageDef* m) {
+  return upb_shim_structsize(m);
+}
 
 }  // namespace
 
@@ -0,0 +1,692 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ */
+
+#include "upb/shred.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Alignment of column data; a cache line, and enough for any vector unit.
+#define ALIGN 64
+
+// A growable buffer whose data is aligned to ALIGN bytes.
+typedef struct {
+  char *raw;   // As returned by malloc().
+  char *data;
+  size_t len, size;
+} buf;
+
+static void buf_init(buf *b) {
+  b->raw = NULL;
+  b->data = NULL;
+  b->len = 0;
+  b->size = 0;
+}
+
+static bool buf_append(buf *b, const void *p, size_t n) {
+  if (b->len + n > b->size) {
+    size_t size = UPB_MAX(UPB_MAX(b->size * 2, b->len + n), ALIGN);
+    char *raw = malloc(size + ALIGN - 1);
+    if (!raw) return false;
+    char *data =
+        (char*)(((uintptr_t)raw + ALIGN - 1) & ~(uintptr_t)(ALIGN - 1));
+    if (b->len) memcpy(data, b->data, b->len);
+    free(b->raw);
+    b->raw = raw;
+    b->data = data;
+    b->size = size;
+  }
+  memcpy(b->data + b->len, p, n);
+  b->len += n;
+  return true;
+}
+
+struct upb_column {
+  const upb_fielddef **path;
+  size_t path_len;
+  uint8_t maxrep, maxdef;
+
+  // One byte per entry each.
+  buf rep, def;
+
+  // Values of the non-null entries, and for strings, their end offsets after
+  // a leading zero.
+  buf values;
+  size_t value_count;
+  buf offsets;
+};
+
+// The message type at one path of the schema.  Unlike defs, there is one of
+// these for each path that leads to the type.
+typedef struct schemanode schemanode;
+
+typedef struct {
+  const upb_fielddef *f;
+  schemanode *sub;                // For submessage fields.
+  uint32_t col_begin, col_end;    // The columns under this field.
+  uint8_t rep;  // The repetition level at which this field repeats.
+  uint8_t def;  // The definition level when this field is present.
+
+  // The message instance in which the field was last seen; later values in
+  // the same instance repeat at "rep".
+  uint64_t seen;
+} child;
+
+struct schemanode {
+  child *children;  // In upb_msg_iter order.
+  uint32_t child_count;
+};
+
+// A message instance being shredded.
+typedef struct {
+  const schemanode *node;
+  uint64_t id;
+  uint8_t rep;  // Repetition level of the first value of each field.
+  uint8_t def;  // Definition level of this message.
+} frame;
+
+// Where each column stood when the current record started, to drop the record
+// if it is rejected.
+typedef struct {
+  size_t size, value_count, values_len, offsets_len;
+} mark;
+
+struct upb_shredder {
+  const upb_msgdef *m;
+  schemanode *root;
+  upb_column *columns;
+  size_t column_count;
+  const upb_handlers *handlers;
+  size_t record_count;
+
+  mark *marks;
+  frame stack[UPB_MAX_NESTING];
+  int depth;
+  uint64_t next_id;
+  bool pushed;  // startsubmsg() pushed a frame for the coming startmsg().
+  bool failed;  // The current record will be rejected.
+  upb_status error;  // Why, for the pipeline status at the end of the record.
+
+  // The column of the string being shredded.
+  upb_column *str_col;
+};
+
+
+/* Schema *********************************************************************/
+
+static void freenode(schemanode *n) {
+  for (uint32_t i = 0; i < n->child_count; i++) {
+    if (n->children[i].sub) freenode(n->children[i].sub);
+  }
+  free(n->children);
+  free(n);
+}
+
+static upb_column *newcolumn(upb_shredder *s) {
+  if (s->column_count % 16 == 0) {
+    s->columns =
+        realloc(s->columns, (s->column_count + 16) * sizeof(upb_column));
+  }
+  return &s->columns[s->column_count++];
+}
+
+// Builds the node for message type "m" at the given path, which has "len"
+// fields and leads to a message at repetition level "rep" and definition
+// level "def".
+static schemanode *newnode(upb_shredder *s, const upb_msgdef *m,
+                           const upb_fielddef **path, size_t len, int rep,
+                           int def, upb_status *status) {
+  if (len >= UPB_MAX_NESTING) {
+    upb_status_seterrliteral(status, "Schema nested too deeply");
+    return NULL;
+  }
+  for (size_t i = 0; i < len; i++) {
+    if (upb_fielddef_msgdef(path[i]) == m) {
+      upb_status_seterrf(status, "Can't shred recursive message type %s",
+                         upb_msgdef_fullname(m));
+      return NULL;
+    }
+  }
+
+  schemanode *n = malloc(sizeof(*n));
+  n->child_count = 0;
+  n->children = malloc(sizeof(child) * UPB_MAX(upb_msgdef_numfields(m), 1));
+  upb_msg_iter i;
+  for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i)) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    child *ch = &n->children[n->child_count++];
+    upb_label_t label = upb_fielddef_label(f);
+    ch->f = f;
+    ch->sub = NULL;
+    ch->rep = rep + (label == UPB_LABEL_REPEATED);
+    ch->def = def + (label != UPB_LABEL_REQUIRED);
+    ch->seen = 0;
+    ch->col_begin = s->column_count;
+    path[len] = f;
+    if (upb_fielddef_issubmsg(f)) {
+      const upb_msgdef *sub = upb_downcast_msgdef(upb_fielddef_subdef(f));
+      ch->sub = newnode(s, sub, path, len + 1, ch->rep, ch->def, status);
+      if (!ch->sub) {
+        n->child_count--;
+        freenode(n);
+        return NULL;
+      }
+    } else {
+      upb_column *c = newcolumn(s);
+      c->path = malloc(sizeof(*c->path) * (len + 1));
+      memcpy(c->path, path, sizeof(*c->path) * (len + 1));
+      c->path_len = len + 1;
+      c->maxrep = ch->rep;
+      c->maxdef = ch->def;
+      buf_init(&c->rep);
+      buf_init(&c->def);
+      buf_init(&c->values);
+      buf_init(&c->offsets);
+      c->value_count = 0;
+      if (upb_fielddef_isstring(f)) {
+        uint32_t zero = 0;
+        buf_append(&c->offsets, &zero, sizeof(zero));
+      }
+    }
+    ch->col_end = s->column_count;
+  }
+  return n;
+}
+
+
+/* Handlers *******************************************************************/
+
+// Returns the current frame's child for the field with handler data "hd".
+static child *getchild(upb_shredder *s, const void *hd) {
+  const frame *fr = &s->stack[s->depth - 1];
+  return &fr->node->children[*(const uint32_t*)hd];
+}
+
+// Rejects the current record; nothing more is written to the columns until it
+// ends, when the first reason ("msg", given the name of field "f" if any) is
+// reported in the pipeline status.  Handlers go on returning true so that the
+// record is decoded to its end rather than halting the decoder.
+static void fail(upb_shredder *s, const char *msg, const upb_fielddef *f) {
+  if (s->failed) return;
+  s->failed = true;
+  if (f) {
+    upb_status_seterrf(&s->error, msg, upb_fielddef_name(f));
+  } else {
+    upb_status_seterrliteral(&s->error, msg);
+  }
+}
+
+// Whether the child is a non-repeated field that the current frame has
+// already seen, in which case its entry is the last one in its columns.
+static bool isdup(const upb_shredder *s, const child *ch) {
+  return upb_fielddef_label(ch->f) != UPB_LABEL_REPEATED &&
+         ch->seen == s->stack[s->depth - 1].id;
+}
+
+// Marks the child as seen in the current frame and returns the repetition
+// level of its value.
+static uint8_t see(upb_shredder *s, child *ch) {
+  const frame *fr = &s->stack[s->depth - 1];
+  uint8_t rep = ch->seen == fr->id ? ch->rep : fr->rep;
+  ch->seen = fr->id;
+  return rep;
+}
+
+static bool putlevels(upb_column *c, uint8_t rep, uint8_t def) {
+  return buf_append(&c->rep, &rep, 1) && buf_append(&c->def, &def, 1);
+}
+
+static bool putvalue(upb_shredder *s, const void *hd, const void *val,
+                     size_t size) {
+  if (s->failed) return true;
+  child *ch = getchild(s, hd);
+  upb_column *c = &s->columns[ch->col_begin];
+  if (isdup(s, ch)) {
+    // The last value of a non-repeated field wins, as when parsing.
+    memcpy(c->values.data + c->values.len - size, val, size);
+    return true;
+  }
+  if (!putlevels(c, see(s, ch), c->maxdef) ||
+      !buf_append(&c->values, val, size)) {
+    fail(s, "Out of memory", NULL);
+    return true;
+  }
+  c->value_count++;
+  return true;
+}
+
+#define T(ctype, name) \
+  static bool put ## name(void *c, const void *hd, ctype val) { \
+    return putvalue(c, hd, &val, sizeof(val)); \
+  }
+
+T(int32_t,  int32)
+T(int64_t,  int64)
+T(uint32_t, uint32)
+T(uint64_t, uint64)
+T(float,    float)
+T(double,   double)
+#undef T
+
+static bool putbool(void *c, const void *hd, bool val) {
+  uint8_t byte = val;
+  return putvalue(c, hd, &byte, 1);
+}
+
+static void *startstr(void *c, const void *hd, size_t size_hint) {
+  UPB_UNUSED(size_hint);
+  upb_shredder *s = c;
+  child *ch = getchild(s, hd);
+  upb_column *col = &s->columns[ch->col_begin];
+  s->str_col = col;
+  if (s->failed) return s;
+  if (isdup(s, ch)) {
+    // Drop the earlier string, keeping its levels for this one.
+    col->offsets.len -= sizeof(uint32_t);
+    uint32_t start;
+    memcpy(&start, col->offsets.data + col->offsets.len - sizeof(start),
+           sizeof(start));
+    col->values.len = start;
+    col->value_count--;
+  } else if (!putlevels(col, see(s, ch), col->maxdef)) {
+    fail(s, "Out of memory", NULL);
+  }
+  return s;
+}
+
+// Always takes the whole buffer: running out of memory rejects the record
+// rather than applying backpressure, which would never be relieved.
+static size_t putstr(void *c, const void *hd, const char *buf, size_t n) {
+  UPB_UNUSED(hd);
+  upb_shredder *s = c;
+  if (!s->failed && !buf_append(&s->str_col->values, buf, n))
+    fail(s, "Out of memory", NULL);
+  return n;
+}
+
+static bool endstr(void *c, const void *hd) {
+  UPB_UNUSED(hd);
+  upb_shredder *s = c;
+  upb_column *col = s->str_col;
+  if (s->failed) return true;
+  uint32_t end = col->values.len;
+  col->value_count++;
+  if (!buf_append(&col->offsets, &end, sizeof(end)))
+    fail(s, "Out of memory", NULL);
+  return true;
+}
+
+static void push(upb_shredder *s, const schemanode *n, uint8_t rep,
+                 uint8_t def) {
+  frame *fr = &s->stack[s->depth++];
+  fr->node = n;
+  fr->id = ++s->next_id;
+  fr->rep = rep;
+  fr->def = def;
+}
+
+static void rollback(upb_shredder *s) {
+  for (size_t i = 0; i < s->column_count; i++) {
+    upb_column *col = &s->columns[i];
+    const mark *m = &s->marks[i];
+    col->rep.len = m->size;
+    col->def.len = m->size;
+    col->value_count = m->value_count;
+    col->values.len = m->values_len;
+    col->offsets.len = m->offsets_len;
+  }
+}
+
+static bool startmsg(void *c, const void *hd) {
+  UPB_UNUSED(hd);
+  upb_shredder *s = c;
+  if (s->pushed) {
+    // A submessage, pushed by startsubmsg().
+    s->pushed = false;
+    return true;
+  }
+
+  // A record that was abandoned part way (say, on a decode error) is dropped.
+  if (s->depth > 0) rollback(s);
+  for (size_t i = 0; i < s->column_count; i++) {
+    const upb_column *col = &s->columns[i];
+    mark *m = &s->marks[i];
+    m->size = col->def.len;
+    m->value_count = col->value_count;
+    m->values_len = col->values.len;
+    m->offsets_len = col->offsets.len;
+  }
+  s->depth = 0;
+  s->failed = false;
+  upb_status_clear(&s->error);
+  push(s, s->root, 0, 0);
+  return true;
+}
+
+// Writes nulls to the columns of the fields that the message did not have.
+static bool endmsg(void *c, const void *hd, upb_status *status) {
+  UPB_UNUSED(hd);
+  upb_shredder *s = c;
+  const frame *fr = &s->stack[s->depth - 1];
+  for (uint32_t i = 0; i < fr->node->child_count && !s->failed; i++) {
+    const child *ch = &fr->node->children[i];
+    if (ch->seen == fr->id) continue;
+    if (upb_fielddef_label(ch->f) == UPB_LABEL_REQUIRED) {
+      fail(s, "Required field %s is missing", ch->f);
+      break;
+    }
+    for (uint32_t j = ch->col_begin; j < ch->col_end; j++) {
+      if (!putlevels(&s->columns[j], fr->rep, fr->def)) {
+        fail(s, "Out of memory", NULL);
+        break;
+      }
+    }
+  }
+
+  // The sink ignores the result for submessages, so a failure in one is only
+  // acted on at the end of the record.
+  if (s->depth > 1) return !s->failed;
+  s->depth = 0;
+  if (s->failed) {
+    upb_status_copy(status, &s->error);
+    rollback(s);
+    return false;
+  }
+  s->record_count++;
+  return true;
+}
+
+static void *startsubmsg(void *c, const void *hd) {
+  upb_shredder *s = c;
+  child *ch = getchild(s, hd);
+  if (isdup(s, ch)) {
+    // A parser would merge the two, but the first one's entries are already
+    // in the columns, interleaved with those of its siblings.
+    fail(s, "Submessage %s appears more than once", ch->f);
+  }
+  uint8_t rep = see(s, ch);
+  push(s, ch->sub, rep, ch->def);
+  s->pushed = true;
+  return s;
+}
+
+static bool endsubmsg(void *c, const void *hd) {
+  UPB_UNUSED(hd);
+  upb_shredder *s = c;
+  s->depth--;
+  return true;
+}
+
+static void sethandlers(void *closure, upb_handlers *h) {
+  UPB_UNUSED(closure);
+  const upb_msgdef *m = upb_handlers_msgdef(h);
+  upb_handlers_setstartmsg(h, startmsg, NULL, NULL);
+  upb_handlers_setendmsg(h, endmsg, NULL, NULL);
+
+  upb_msg_iter i;
+  uint32_t index = 0;
+  for(upb_msg_begin(&i, m); !upb_msg_done(&i); upb_msg_next(&i), index++) {
+    const upb_fielddef *f = upb_msg_iter_field(&i);
+    uint32_t *hd = malloc(sizeof(*hd));
+    *hd = index;
+    switch (upb_fielddef_type(f)) {
+      case UPB_TYPE_ENUM:   UPB_FALLTHROUGH_INTENDED;
+      case UPB_TYPE_INT32:  upb_handlers_setint32(h, f, putint32, hd, free);
+                            break;
+      case UPB_TYPE_INT64:  upb_handlers_setint64(h, f, putint64, hd, free);
+                            break;
+      case UPB_TYPE_UINT32: upb_handlers_setuint32(h, f, putuint32, hd, free);
+                            break;
+      case UPB_TYPE_UINT64: upb_handlers_setuint64(h, f, putuint64, hd, free);
+                            break;
+      case UPB_TYPE_FLOAT:  upb_handlers_setfloat(h, f, putfloat, hd, free);
+                            break;
+      case UPB_TYPE_DOUBLE: upb_handlers_setdouble(h, f, putdouble, hd, free);
+                            break;
+      case UPB_TYPE_BOOL:   upb_handlers_setbool(h, f, putbool, hd, free);
+                            break;
+      case UPB_TYPE_STRING: UPB_FALLTHROUGH_INTENDED;
+      case UPB_TYPE_BYTES:
+        upb_handlers_setstartstr(h, f, startstr, hd, free);
+        upb_handlers_setstring(h, f, putstr, NULL, NULL);
+        upb_handlers_setendstr(h, f, endstr, NULL, NULL);
+        break;
+      case UPB_TYPE_MESSAGE:
+        upb_handlers_setstartsubmsg(h, f, startsubmsg, hd, free);
+        upb_handlers_setendsubmsg(h, f, endsubmsg, NULL, NULL);
+        break;
+    }
+  }
+}
+
+
+/* upb_shredder ***************************************************************/
+
+static void freecolumns(upb_shredder *s) {
+  for (size_t i = 0; i < s->column_count; i++) {
+    upb_column *c = &s->columns[i];
+    free(c->path);
+    free(c->rep.raw);
+    free(c->def.raw);
+    free(c->values.raw);
+    free(c->offsets.raw);
+  }
+  free(s->columns);
+}
+
+upb_shredder *upb_shredder_new(const upb_msgdef *m, upb_status *status) {
+  assert(upb_msgdef_isfrozen(m));
+  upb_shredder *s = malloc(sizeof(*s));
+  s->m = m;
+  s->columns = NULL;
+  s->column_count = 0;
+  s->record_count = 0;
+  s->depth = 0;
+  s->next_id = 0;
+  s->pushed = false;
+  s->failed = false;
+  upb_status_init(&s->error);
+  const upb_fielddef *path[UPB_MAX_NESTING];
+  s->root = newnode(s, m, path, 0, 0, 0, status);
+  if (!s->root) {
+    freecolumns(s);
+    upb_status_uninit(&s->error);
+    free(s);
+    return NULL;
+  }
+  s->marks = malloc(sizeof(mark) * UPB_MAX(s->column_count, 1));
+  s->handlers = upb_handlers_newfrozen(m, NULL, s, sethandlers, NULL);
+  return s;
+}
+
+void upb_shredder_free(upb_shredder *s) {
+  upb_handlers_unref(s->handlers, s);
+  freecolumns(s);
+  free(s->marks);
+  freenode(s->root);
+  upb_status_uninit(&s->error);
+  free(s);
+}
+
+const upb_handlers *upb_shredder_handlers(const upb_shredder *s) {
+  return s->handlers;
+}
+
+size_t upb_shredder_recordcount(const upb_shredder *s) {
+  return s->record_count;
+}
+
+size_t upb_shredder_columncount(const upb_shredder *s) {
+  return s->column_count;
+}
+
+const upb_column *upb_shredder_column(const upb_shredder *s, size_t i) {
+  assert(i < s->column_count);
+  return &s->columns[i];
+}
+
+void upb_shredder_clear(upb_shredder *s) {
+  for (size_t i = 0; i < s->column_count; i++) {
+    mark *m = &s->marks[i];
+    memset(m, 0, sizeof(*m));
+    m->offsets_len = s->columns[i].offsets.len ? sizeof(uint32_t) : 0;
+  }
+  rollback(s);
+  s->record_count = 0;
+  s->depth = 0;
+  s->pushed = false;
+}
+
+
+/* upb_column *****************************************************************/
+
+const upb_fielddef *const *upb_column_path(const upb_column *c, size_t *len) {
+  *len = c->path_len;
+  return c->path;
+}
+
+int upb_column_maxrep(const upb_column *c) { return c->maxrep; }
+int upb_column_maxdef(const upb_column *c) { return c->maxdef; }
+size_t upb_column_size(const upb_column *c) { return c->def.len; }
+
+const uint8_t *upb_column_replevels(const upb_column *c) {
+  return (const uint8_t*)c->rep.data;
+}
+
+const uint8_t *upb_column_deflevels(const upb_column *c) {
+  return (const uint8_t*)c->def.data;
+}
+
+const void *upb_column_values(const upb_column *c, size_t *n) {
+  *n = c->value_count;
+  return c->values.data;
+}
+
+const uint32_t *upb_column_stroffsets(const upb_column *c) {
+  return (const uint32_t*)c->offsets.data;
+}
+
+
+/* upb_assembler **************************************************************/
+
+struct upb_assembler {
+  const upb_shredder *s;
+  size_t record;
+
+  // For each column, its next entry and its next value.
+  size_t *entry;
+  size_t *value;
+};
+
+upb_assembler *upb_assembler_new(const upb_shredder *s) {
+  upb_assembler *a = malloc(sizeof(*a));
+  size_t n = UPB_MAX(s->column_count, 1);
+  a->s = s;
+  a->record = 0;
+  a->entry = calloc(n, sizeof(size_t));
+  a->value = calloc(n, sizeof(size_t));
+  return a;
+}
+
+void upb_assembler_free(upb_assembler *a) {
+  free(a->entry);
+  free(a->value);
+  free(a);
+}
+
+static upb_selector_t getsel(const upb_fielddef *f, upb_handlertype_t type) {
+  upb_selector_t sel;
+  bool ok = upb_handlers_getselector(f, type, &sel);
+  UPB_ASSERT_VAR(ok, ok);
+  return sel;
+}
+
+// Pushes the next value of column "i", whose field is "f".
+static bool putnext(upb_assembler *a, size_t i, const upb_fielddef *f,
+                    upb_sink *sink) {
+  const upb_column *c = &a->s->columns[i];
+  size_t v = a->value[i]++;
+  const char *p = c->values.data;
+
+  switch (upb_fielddef_type(f)) {
+#define T(type, ctype, name) \
+    case UPB_TYPE_ ## type: \
+      return upb_sink_put ## name( \
+          sink, getsel(f, upb_handlers_getprimitivehandlertype(f)), \
+          ((const ctype*)p)[v]);
+    T(ENUM,   int32_t,  int32)
+    T(INT32,  int32_t,  int32)
+    T(INT64,  int64_t,  int64)
+    T(UINT32, uint32_t, uint32)
+    T(UINT64, uint64_t, uint64)
+    T(FLOAT,  float,    float)
+    T(DOUBLE, double,   double)
+    T(BOOL,   uint8_t,  bool)
+#undef T
+    case UPB_TYPE_STRING:
+    case UPB_TYPE_BYTES: {
+      const uint32_t *ofs = (const uint32_t*)c->offsets.data;
+      size_t len = ofs[v + 1] - ofs[v];
+      return upb_sink_startstr(sink, getsel(f, UPB_HANDLER_STARTSTR), len) &&
+             upb_sink_putstring(sink, getsel(f, UPB_HANDLER_STRING),
+                                p + ofs[v], len) == len &&
+             upb_sink_endstr(sink, getsel(f, UPB_HANDLER_ENDSTR));
+    }
+    case UPB_TYPE_MESSAGE:
+      break;
+  }
+  assert(false);
+  return false;
+}
+
+// Whether the next entry of column "i" repeats at level "rep".
+static bool repeats(const upb_assembler *a, size_t i, uint8_t rep) {
+  const upb_column *c = &a->s->columns[i];
+  size_t e = a->entry[i];
+  return e < c->def.len && (uint8_t)c->rep.data[e] == rep;
+}
+
+static bool assemble(upb_assembler *a, const schemanode *n, upb_sink *sink) {
+  for (uint32_t i = 0; i < n->child_count; i++) {
+    const child *ch = &n->children[i];
+    const upb_fielddef *f = ch->f;
+    // The first column under the field tells whether it is present.
+    size_t col = ch->col_begin;
+    if (col == ch->col_end) continue;  // A message with no columns.
+    uint8_t def = a->s->columns[col].def.data[a->entry[col]];
+    if (def < ch->def) {
+      // One null in each column says that the field is absent.
+      for (size_t j = ch->col_begin; j < ch->col_end; j++) a->entry[j]++;
+      continue;
+    }
+
+    bool seq = upb_fielddef_isseq(f);
+    if (seq && !upb_sink_startseq(sink, getsel(f, UPB_HANDLER_STARTSEQ)))
+      return false;
+    do {
+      if (ch->sub) {
+        if (!upb_sink_startsubmsg(sink, getsel(f, UPB_HANDLER_STARTSUBMSG)) ||
+            !assemble(a, ch->sub, sink)) {
+          return false;
+        }
+        upb_sink_endsubmsg(sink, getsel(f, UPB_HANDLER_ENDSUBMSG));
+      } else {
+        a->entry[col]++;
+        if (!putnext(a, col, f, sink)) return false;
+      }
+    } while (seq && repeats(a, col, ch->rep));
+    if (seq) upb_sink_endseq(sink, getsel(f, UPB_HANDLER_ENDSEQ));
+  }
+  return true;
+}
+
+bool upb_assembler_next(upb_assembler *a, upb_sink *sink) {
+  if (a->record == a->s->record_count) return false;
+  a->record++;
+  upb_sink_startmsg(sink);
+  if (!assemble(a, a->s->root, sink)) return false;
+  return upb_sink_endmsg(sink);
+}
@@ -0,0 +1,225 @@
+/*
+ * upb - a minimalist implementation of protocol buffers.
+ *
+ * Copyright (c) 2013 Google Inc.  See LICENSE for details.
+ *
+ * upb::Shredder is a sink stage that stores records column-wise, with one
+ * column for each primitive or string field reachable from the record type,
+ * using the repetition and definition levels of the Dremel paper
+ * ("Dremel: Interactive Analysis of Web-Scale Datasets", Melnik et al.):
+ *
+ *   - Each entry of a column has a repetition level (at which repeated field
+ *     of the column's path the value repeats; 0 for a new record) and a
+ *     definition level (how many of the optional and repeated fields on the
+ *     path are present).  An entry whose definition level is less than the
+ *     column's maximum is a null and has no value.
+ *
+ *   - The values of the non-null entries are stored in one contiguous array of
+ *     their native type (bools as one byte each), aligned to 64 bytes, so
+ *     that they can be scanned with vector instructions.  String values are
+ *     concatenated, with an array of offsets.
+ *
+ * The levels are computed directly from the handler calls, so records can be
+ * shredded straight from a decoder without building objects first:
+ *
+ *   upb_shredder *s = upb_shredder_new(md, &status);
+ *   // Sink for upb_shredder_handlers(s) with closure s, fed by a decoder.
+ *   ...
+ *   for (size_t i = 0; i < upb_shredder_columncount(s); i++) {
+ *     const upb_column *c = upb_shredder_column(s, i);
+ *     ... upb_column_values(c, &n), upb_column_deflevels(c) ...
+ *   }
+ *
+ * upb::Assembler does the reverse, and pushes the records that were shredded
+ * into any sink for the same message type.  Within each message, fields come
+ * out in the order of the columns rather than the order they came in.
+ *
+ * Recursive message types can't be shredded, since they would need an
+ * unbounded number of columns.  Required fields count toward neither level,
+ * so a record that lacks one is rejected: it is left out of the columns, and
+ * an error is set in the pipeline status.  A non-repeated field that appears
+ * more than once keeps its last value, as when parsing, but a non-repeated
+ * submessage that does would have to be merged, so its record is rejected too.
+ * A record that is abandoned part way (for example on a decode error) is
+ * dropped when the next one starts.
+ * Neither stage is thread-safe.
+ */
+
+#ifndef UPB_SHRED_H_
+#define UPB_SHRED_H_
+
+#include "upb/sink.h"
+
+#ifdef __cplusplus
+namespace upb {
+class Assembler;
+class Column;
+class Shredder;
+}  // namespace upb
+typedef upb::Assembler upb_assembler;
+typedef upb::Column upb_column;
+typedef upb::Shredder upb_shredder;
+#else
+struct upb_assembler;
+struct upb_column;
+struct upb_shredder;
+typedef struct upb_assembler upb_assembler;
+typedef struct upb_column upb_column;
+typedef struct upb_shredder upb_shredder;
+#endif
+
+#ifdef __cplusplus
+
+class upb::Shredder {
+ public:
+  // Returns NULL and sets "status" if "m" (which must be frozen) is recursive.
+  static Shredder* New(const MessageDef* m, Status* status);
+  void Free();
+
+  // Handlers for records of the shredder's type; the closure must be the
+  // shredder.  They are owned by the shredder.
+  const Handlers* handlers() const;
+
+  // The number of records shredded so far.
+  size_t record_count() const;
+
+  // Columns are in depth-first order of the schema.
+  size_t column_count() const;
+  const Column* column(size_t i) const;
+
+  // Discards all records, keeping the memory for reuse.
+  void Clear();
+
+ private:
+  UPB_DISALLOW_POD_OPS(Shredder);
+};
+
+class upb::Column {
+ public:
+  // The fields from the record type to the column's leaf field.
+  const FieldDef* const* path(size_t* len) const;
+
+  int max_repetition_level() const;
+  int max_definition_level() const;
+
+  // The number of entries, including nulls.
+  size_t size() const;
+  const uint8_t* repetition_levels() const;
+  const uint8_t* definition_levels() const;
+
+  // The values of the non-null entries, "*n" of them.  For strings this is
+  // their concatenated bytes, and string i is bytes [offsets[i], offsets[i+1])
+  // of it.
+  const void* values(size_t* n) const;
+  const uint32_t* string_offsets() const;
+
+ private:
+  UPB_DISALLOW_POD_OPS(Column);
+};
+
+class upb::Assembler {
+ public:
+  // The shredder must not be changed while the assembler is in use.
+  static Assembler* New(const Shredder* s);
+  void Free();
+
+  // Pushes the next record into "sink", whose handlers must be for the
+  // shredder's message type.  Returns false after the last record, or if the
+  // sink stopped.
+  bool Next(Sink* sink);
+
+ private:
+  UPB_DISALLOW_POD_OPS(Assembler);
+};
+
+extern "C" {
+#endif
+
+upb_shredder *upb_shredder_new(const upb_msgdef *m, upb_status *status);
+void upb_shredder_free(upb_shredder *s);
+const upb_handlers *upb_shredder_handlers(const upb_shredder *s);
+size_t upb_shredder_recordcount(const upb_shredder *s);
+size_t upb_shredder_columncount(const upb_shredder *s);
+const upb_column *upb_shredder_column(const upb_shredder *s, size_t i);
+void upb_shredder_clear(upb_shredder *s);
+
+const upb_fielddef *const *upb_column_path(const upb_column *c, size_t *len);
+int upb_column_maxrep(const upb_column *c);
+int upb_column_maxdef(const upb_column *c);
+size_t upb_column_size(const upb_column *c);
+const uint8_t *upb_column_replevels(const upb_column *c);
+const uint8_t *upb_column_deflevels(const upb_column *c);
+const void *upb_column_values(const upb_column *c, size_t *n);
+const uint32_t *upb_column_stroffsets(const upb_column *c);
+
+upb_assembler *upb_assembler_new(const upb_shredder *s);
+void upb_assembler_free(upb_assembler *a);
+bool upb_assembler_next(upb_assembler *a, upb_sink *sink);
+
+#ifdef __cplusplus
+}  /* extern "C" */
+
+namespace upb {
+
+inline Shredder* Shredder::New(const MessageDef* m, Status* status) {
+  return upb_shredder_new(m, status);
+}
+inline void Shredder::Free() {
+  upb_shredder_free(this);
+}
+inline const Handlers* Shredder::handlers() const {
+  return upb_shredder_handlers(this);
+}
+inline size_t Shredder::record_count() const {
+  return upb_shredder_recordcount(this);
+}
+inline size_t Shredder::column_count() const {
+  return upb_shredder_columncount(this);
+}
+inline const Column* Shredder::column(size_t i) const {
+  return upb_shredder_column(this, i);
+}
+inline void Shredder::Clear() {
+  upb_shredder_clear(this);
+}
+
+inline const FieldDef* const* Column::path(size_t* len) const {
+  return upb_column_path(this, len);
+}
+inline int Column::max_repetition_level() const {
+  return upb_column_maxrep(this);
+}
+inline int Column::max_definition_level() const {
+  return upb_column_maxdef(this);
+}
+inline size_t Column::size() const {
+  return upb_column_size(this);
+}
+inline const uint8_t* Column::repetition_levels() const {
+  return upb_column_replevels(this);
+}
+inline const uint8_t* Column::definition_levels() const {
+  return upb_column_deflevels(this);
+}
+inline const void* Column::values(size_t* n) const {
+  return upb_column_values(this, n);
+}
+inline const uint32_t* Column::string_offsets() const {
+  return upb_column_stroffsets(this);
+}
+
+inline Assembler* Assembler::New(const Shredder* s) {
+  return upb_assembler_new(s);
+}
+inline void Assembler::Free() {
+  upb_assembler_free(this);
+}
+inline bool Assembler::Next(Sink* sink) {
+  return upb_assembler_next(this, sink);
+}
+
+}  // namespace upb
+
+#endif
+
+#endif  /* UPB_SHRED_H_ */
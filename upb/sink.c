@@ -9,18 +9,41 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include "upb/probes.h"
 
-static void upb_sink_init(upb_sink *s, const upb_handlers *h, upb_pipeline *p);
+static bool upb_sink_init(upb_sink *s, const upb_handlers *h, upb_pipeline *p);
 static void upb_sink_resetobj(void *obj);
 static const upb_frametype upb_sink_frametype;
 
+// Returns the number of frames to allocate initially for a stack that will be
+// used with handlers "h".
+static size_t initialdepth(const upb_handlers *h) {
+  uint32_t depth = upb_handlers_maxdepth(h);
+  return depth ? depth : UPB_INITIAL_NESTING;
+}
+
 static bool chkstack(upb_sink *s) {
-  if (s->top + 1 >= s->limit) {
-    upb_status_seterrliteral(&s->pipeline_->status_, "Nesting too deep.");
-    return false;
-  } else {
+  if (s->top + 1 < s->limit) return true;
+
+  // Only stacks for recursive types can get here without being at the limit.
+  size_t size = s->limit - s->stack;
+  if (size < UPB_MAX_NESTING) {
+    size_t newsize = UPB_MIN(size * 2, UPB_MAX_NESTING);
+    struct upb_sinkframe *stack = upb_pipeline_realloc(
+        s->pipeline_, s->stack, size * sizeof(*stack),
+        newsize * sizeof(*stack));
+    if (!stack) {
+      upb_status_seterrliteral(&s->pipeline_->status_, "out of memory");
+      return false;
+    }
+    s->top = stack + (s->top - s->stack);
+    s->stack = stack;
+    s->limit = stack + newsize;
     return true;
   }
+
+  upb_status_seterrliteral(&s->pipeline_->status_, "Nesting too deep.");
+  return false;
 }
 
 #define alignof(type) offsetof (struct { char c; type member; }, member)
@@ -102,6 +125,7 @@ void *upb_pipeline_alloc(upb_pipeline *p, size_t bytes) {
     if (!p->realloc || !(r = p->realloc(p->ud, NULL, size))) {
       return NULL;
     }
+    UPB_PROBE2(pipeline_grow, p, size);
     r->prev = p->region_head;
     p->region_head = r;
     p->bump_limit = (char*)r + size;
@@ -122,7 +146,7 @@ void *upb_pipeline_realloc(upb_pipeline *p, void *ptr,
     return ptr;
   } else {
     void *mem = upb_pipeline_alloc(p, bytes);
-    memcpy(mem, ptr, oldsize);
+    if (mem && ptr) memcpy(mem, ptr, oldsize);
     return mem;
   }
 }
@@ -130,15 +154,17 @@ void *upb_pipeline_realloc(upb_pipeline *p, void *ptr,
 void *upb_pipeline_allocobj(upb_pipeline *p, const upb_frametype *ft) {
   struct obj *obj = upb_pipeline_alloc(p, objsize(ft->size));
   if (!obj) return NULL;
+  // Only objects that were initialized are linked in to be reset and uninit.
+  if (ft->init && !ft->init(&obj->data, p)) return NULL;
 
   obj->prev = p->obj_head;
   obj->ft = ft;
   p->obj_head = obj;
-  if (ft->init) ft->init(&obj->data, p);
   return &obj->data;
 }
 
 void upb_pipeline_reset(upb_pipeline *p) {
+  UPB_PROBE1(pipeline_reset, p);
   upb_status_clear(&p->status_);
   for (struct obj *o = p->obj_head; o; o = o->prev) {
     if (o->ft->reset)
@@ -148,14 +174,17 @@ void upb_pipeline_reset(upb_pipeline *p) {
 
 upb_sink *upb_pipeline_newsink(upb_pipeline *p, const upb_handlers *handlers) {
   upb_sink *s = upb_pipeline_allocobj(p, &upb_sink_frametype);
-  upb_sink_init(s, handlers, p);
-  return s;
+  return s && upb_sink_init(s, handlers, p) ? s : NULL;
 }
 
 const upb_status *upb_pipeline_status(const upb_pipeline *p) {
   return &p->status_;
 }
 
+void upb_pipeline_seterr(upb_pipeline *p, const char *msg) {
+  upb_status_seterrliteral(&p->status_, msg);
+}
+
 typedef struct {
   const upb_handlers *h;
 } handlersref_t;
@@ -199,15 +228,19 @@ static void upb_sink_resetobj(void *obj) {
   s->top = s->stack;
 }
 
-static void upb_sink_init(upb_sink *s, const upb_handlers *h, upb_pipeline *p) {
+static bool upb_sink_init(upb_sink *s, const upb_handlers *h, upb_pipeline *p) {
   s->pipeline_ = p;
-  s->stack = upb_pipeline_alloc(p, sizeof(*s->stack) * UPB_MAX_NESTING);
+  size_t depth = initialdepth(h);
+  s->stack = upb_pipeline_alloc(p, sizeof(*s->stack) * depth);
+  if (!s->stack) return false;
   s->top = s->stack;
-  s->limit = s->stack + UPB_MAX_NESTING;
+  s->limit = s->stack + depth;
   s->top->h = h;
   if (h->ft) {
     s->top->closure = upb_pipeline_allocobj(p, h->ft);
+    if (!s->top->closure) return false;
   }
+  return true;
 }
 
 upb_pipeline *upb_sink_pipeline(const upb_sink *s) {
@@ -245,12 +278,10 @@ bool upb_sink_endmsg(upb_sink *s) {
 
 #define PUTVAL(type, ctype) \
   bool upb_sink_put ## type(upb_sink *s, upb_selector_t sel, ctype val) { \
-    const upb_handlers *h = s->top->h; \
-    upb_ ## type ## _handler *handler = (upb_ ## type ## _handler*) \
-        upb_handlers_gethandler(h, sel); \
-    if (handler) { \
-      const void *hd = upb_handlers_gethandlerdata(h, sel); \
-      bool ok = handler(s->top->closure, hd, val); \
+    const upb_handlers_tabent *e = upb_handlers_getentry(s->top->h, sel); \
+    if (e && e->func) { \
+      upb_ ## type ## _handler *handler = (upb_ ## type ## _handler*)e->func; \
+      bool ok = handler(s->top->closure, e->data, val); \
       if (!ok) return false; \
     } \
     return true; \
@@ -267,13 +298,10 @@ PUTVAL(bool,   bool);
 
 size_t upb_sink_putstring(upb_sink *s, upb_selector_t sel,
                           const char *buf, size_t n) {
-  const upb_handlers *h = s->top->h;
-  upb_string_handler *handler =
-      (upb_string_handler*)upb_handlers_gethandler(h, sel);
-
-  if (handler) {
-    const void *hd = upb_handlers_gethandlerdata(h, sel);;
-    n = handler(s->top->closure, hd, buf, n);
+  const upb_handlers_tabent *e = upb_handlers_getentry(s->top->h, sel);
+  if (e && e->func) {
+    upb_string_handler *handler = (upb_string_handler*)e->func;
+    n = handler(s->top->closure, e->data, buf, n);
   }
 
   return n;
@@ -322,6 +350,21 @@ bool upb_sink_endseq(upb_sink *s, upb_selector_t sel) {
   return true;
 }
 
+bool upb_sink_putmapentry(upb_sink *s, upb_selector_t sel,
+                          const upb_mapitem *key, const upb_mapitem *val) {
+  const upb_handlers *h = s->top->h;
+  upb_mapentry_handler *handler =
+      (upb_mapentry_handler*)upb_handlers_gethandler(h, sel);
+
+  if (handler) {
+    const void *hd = upb_handlers_gethandlerdata(h, sel);
+    bool ok = handler(s->top->closure, hd, key, val);
+    if (!ok) return false;
+  }
+
+  return true;
+}
+
 bool upb_sink_startstr(upb_sink *s, upb_selector_t sel, size_t size_hint) {
   if (!chkstack(s)) return false;
 
@@ -67,7 +67,8 @@ class upb::Pipeline {
 
   // Returns a newly-allocated Sink for the given handlers.  The sink is will
   // live as long as the pipeline does.  Caller retains ownership of the
-  // handlers object, which must outlive the pipeline.
+  // handlers object, which must outlive the pipeline.  Returns NULL if the
+  // sink or its object could not be allocated.
   //
   // TODO(haberman): add an option for the sink to take a ref, so the handlers
   // don't have to outlive?  This would be simpler but imposes a minimum cost.
@@ -84,6 +85,11 @@ class upb::Pipeline {
   // The current error status for the pipeline.
   const upb::Status& status() const;
 
+  // Sets an error in the pipeline's status, for code that drives a pipeline
+  // rather than being called with the status (as end-of-message handlers
+  // are).
+  void SetError(const char* msg);
+
   // Calls "reset" on all Sinks and resettable state objects in the arena, and
   // resets the error status.  Useful for resetting processing state so new
   // input can be accepted.
@@ -95,8 +101,9 @@ class upb::Pipeline {
   void* Alloc(size_t size);
   void* Realloc(void* ptr, size_t old_size, size_t size);
 
-  // Allocates an object with the given FrameType.  Note that this object may
-  // *not* be resized with Realloc().
+  // Allocates an object with the given FrameType, or returns NULL if it could
+  // not be allocated or its init() failed.  Note that this object may *not* be
+  // resized with Realloc().
   void* AllocObject(const FrameType* type);
 
  private:
@@ -115,7 +122,9 @@ struct upb_pipeline {
 
 struct upb_frametype {
   size_t size;
-  void (*init)(void* obj, upb_pipeline *p);
+  // Returns false if the object could not be initialized, for example because
+  // the memory it needs could not be allocated from the pipeline.
+  bool (*init)(void* obj, upb_pipeline *p);
   void (*uninit)(void* obj);
   void (*reset)(void* obj);
 };
@@ -198,6 +207,11 @@ class upb::Sink {
   bool StartSequence(Handlers::Selector s);
   bool EndSequence(Handlers::Selector s);
 
+  // For map fields, one whole entry, in place of the entry's submessage.
+  // Like the values of a repeated field it must be inside a sequence.
+  bool PutMapEntry(Handlers::Selector s, const upb_mapitem *key,
+                   const upb_mapitem *val);
+
  private:
   UPB_DISALLOW_POD_OPS(Sink);
 #else
@@ -225,6 +239,7 @@ void upb_pipeline_donateref(
     upb_pipeline *p, const upb_handlers *h, const void *owner);
 upb_sink *upb_pipeline_newsink(upb_pipeline *p, const upb_handlers *h);
 const upb_status *upb_pipeline_status(const upb_pipeline *p);
+void upb_pipeline_seterr(upb_pipeline *p, const char *msg);
 
 void upb_sink_reset(upb_sink *s, void *closure);
 upb_pipeline *upb_sink_pipeline(const upb_sink *s);
@@ -246,6 +261,8 @@ bool upb_sink_startsubmsg(upb_sink *s, upb_selector_t sel);
 bool upb_sink_endsubmsg(upb_sink *s, upb_selector_t sel);
 bool upb_sink_startseq(upb_sink *s, upb_selector_t sel);
 bool upb_sink_endseq(upb_sink *s, upb_selector_t sel);
+bool upb_sink_putmapentry(upb_sink *s, upb_selector_t sel,
+                          const upb_mapitem *key, const upb_mapitem *val);
 
 #ifdef __cplusplus
 }  /* extern "C" */
@@ -279,6 +296,9 @@ inline void Pipeline::Reset() {
 inline const upb::Status& Pipeline::status() const {
   return *upb_pipeline_status(this);
 }
+inline void Pipeline::SetError(const char* msg) {
+  upb_pipeline_seterr(this, msg);
+}
 inline Sink* Pipeline::NewSink(const upb::Handlers* handlers) {
   return upb_pipeline_newsink(this, handlers);
 }
@@ -345,6 +365,10 @@ inline bool Sink::StartSequence(Handlers::Selector sel) {
 inline bool Sink::EndSequence(Handlers::Selector sel) {
   return upb_sink_endseq(this, sel);
 }
+inline bool Sink::PutMapEntry(Handlers::Selector sel, const upb_mapitem *key,
+                              const upb_mapitem *val) {
+  return upb_sink_putmapentry(this, sel, key, val);
+}
 
 }  // namespace upb
 #endif
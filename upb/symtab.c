@@ -31,6 +31,146 @@ void upb_symtab_checkref(const upb_symtab *s, const void *owner) {
   upb_refcounted_checkref(upb_upcast(s), owner);
 }
 
+/* Scope tree ****************************************************************/
+
+// Relative names are resolved with a tree that has one node per name
+// component: the node for "foo.bar.Baz" is the child "Baz" of the node for
+// "foo.bar".  Resolving a name walks outward from the scope of the base name,
+// which takes one hash lookup per component and never has to build candidate
+// names.  Nodes do not own refs on their defs; the owning table does.
+typedef struct upb_symtab_scope {
+  struct upb_symtab_scope *parent;
+  upb_strtable children;  // Name component -> upb_symtab_scope*.
+  upb_def *def;           // The def with this name, if any (NULL for packages).
+} upb_symtab_scope;
+
+static upb_symtab_scope *upb_scope_new(upb_symtab_scope *parent) {
+  upb_symtab_scope *s = malloc(sizeof(*s));
+  if (!s) return NULL;
+  if (!upb_strtable_init(&s->children, UPB_CTYPE_PTR)) {
+    free(s);
+    return NULL;
+  }
+  s->parent = parent;
+  s->def = NULL;
+  return s;
+}
+
+static void upb_scope_free(upb_symtab_scope *s) {
+  upb_strtable_iter i;
+  upb_strtable_begin(&i, &s->children);
+  for (; !upb_strtable_done(&i); upb_strtable_next(&i)) {
+    upb_scope_free(upb_value_getptr(upb_strtable_iter_value(&i)));
+  }
+  upb_strtable_uninit(&s->children);
+  free(s);
+}
+
+// Returns the length of the first component of "name".
+static size_t upb_scope_complen(const char *name, const char *end) {
+  const char *p = memchr(name, UPB_SYMBOL_SEPARATOR, end - name);
+  return (p ? p : end) - name;
+}
+
+static upb_symtab_scope *upb_scope_child(const upb_symtab_scope *s,
+                                         const char *name, size_t len) {
+  upb_value v;
+  return upb_strtable_lookup2(&s->children, name, len, &v) ?
+      upb_value_getptr(v) : NULL;
+}
+
+// Returns the node for the dotted name [name, end) relative to "s", or NULL if
+// there is none.
+static upb_symtab_scope *upb_scope_find(const upb_symtab_scope *s,
+                                        const char *name, const char *end) {
+  while (s) {
+    size_t len = upb_scope_complen(name, end);
+    s = upb_scope_child(s, name, len);
+    if (name + len == end) break;
+    name += len + 1;
+  }
+  return (upb_symtab_scope*)s;
+}
+
+// Records "def" as the def named "name", creating any missing scopes and
+// replacing any existing def of that name.
+static bool upb_scope_add(upb_symtab_scope *root, const char *name,
+                          upb_def *def) {
+  const char *end = name + strlen(name);
+  upb_symtab_scope *s = root;
+  while (1) {
+    size_t len = upb_scope_complen(name, end);
+    upb_symtab_scope *child = upb_scope_child(s, name, len);
+    if (!child) {
+      char *key = malloc(len + 1);
+      if (!key || !(child = upb_scope_new(s))) {
+        free(key);
+        return false;
+      }
+      memcpy(key, name, len);
+      key[len] = '\0';
+      bool ok = upb_strtable_insert(&s->children, key, upb_value_ptr(child));
+      free(key);
+      if (!ok) {
+        upb_scope_free(child);
+        return false;
+      }
+    }
+    s = child;
+    if (name + len == end) break;
+    name += len + 1;
+  }
+  s->def = def;
+  return true;
+}
+
+// Given a symbol and the base symbol inside which it is defined, find the
+// symbol's definition using the rules described in descriptor.proto.  As in
+// C++, the first component of a qualified name binds to the innermost scope
+// that defines it; that scope must then contain the rest of the name.  Only
+// messages and packages can contain names, so the search skips over other
+// kinds of defs.
+static upb_def *upb_resolvename(const upb_symtab_scope *root,
+                                const char *base, const char *sym) {
+  const char *end = sym + strlen(sym);
+  if (sym == end) return NULL;
+  if (sym[0] == UPB_SYMBOL_SEPARATOR) {
+    // Symbols starting with '.' are absolute, so we do a single walk.
+    const upb_symtab_scope *s = upb_scope_find(root, sym + 1, end);
+    return s ? s->def : NULL;
+  }
+
+  // Find the scope of "base", or the innermost enclosing scope that exists.
+  const upb_symtab_scope *s = root;
+  if (base && base[0]) {
+    const char *b = base, *bend = base + strlen(base);
+    while (1) {
+      size_t len = upb_scope_complen(b, bend);
+      const upb_symtab_scope *child = upb_scope_child(s, b, len);
+      if (!child) break;
+      s = child;
+      if (b + len == bend) break;
+      b += len + 1;
+    }
+  }
+
+  size_t len = upb_scope_complen(sym, end);
+  for (; s; s = s->parent) {
+    const upb_symtab_scope *first = upb_scope_child(s, sym, len);
+    if (!first) continue;
+    if (sym + len == end) {
+      if (first->def) return first->def;
+    } else if (!first->def || first->def->type == UPB_DEF_MSG) {
+      const upb_symtab_scope *ret = upb_scope_find(first, sym + len + 1, end);
+      return ret ? ret->def : NULL;
+    }
+  }
+  return NULL;
+}
+
+
+/* upb_symtab *****************************************************************/
+
 static void upb_symtab_free(upb_refcounted *r) {
   upb_symtab *s = (upb_symtab*)r;
   upb_strtable_iter i;
@@ -40,6 +180,7 @@ static void upb_symtab_free(upb_refcounted *r) {
     upb_def_unref(def, s);
   }
   upb_strtable_uninit(&s->symtab);
+  upb_scope_free(s->scopes);
   free(s);
 }
 
@@ -47,6 +188,11 @@ static const struct upb_refcounted_vtbl vtbl = {NULL, &upb_symtab_free};
 
 upb_symtab *upb_symtab_new(const void *owner) {
   upb_symtab *s = malloc(sizeof(*s));
+  if (!s) return NULL;
+  if (!(s->scopes = upb_scope_new(NULL))) {
+    free(s);
+    return NULL;
+  }
   upb_refcounted_init(upb_upcast(s), &vtbl, owner);
   upb_strtable_init(&s->symtab, UPB_CTYPE_PTR);
   return s;
@@ -95,28 +241,9 @@ const upb_msgdef *upb_symtab_lookupmsg(const upb_symtab *s, const char *sym,
   return ret;
 }
 
-// Given a symbol and the base symbol inside which it is defined, find the
-// symbol's definition in t.
-static upb_def *upb_resolvename(const upb_strtable *t,
-                                const char *base, const char *sym) {
-  if(strlen(sym) == 0) return NULL;
-  if(sym[0] == UPB_SYMBOL_SEPARATOR) {
-    // Symbols starting with '.' are absolute, so we do a single lookup.
-    // Slice to omit the leading '.'
-    upb_value v;
-    return upb_strtable_lookup(t, sym + 1, &v) ? upb_value_getptr(v) : NULL;
-  } else {
-    // Remove components from base until we find an entry or run out.
-    // TODO: This branch is totally broken, but currently not used.
-    (void)base;
-    assert(false);
-    return NULL;
-  }
-}
-
 const upb_def *upb_symtab_resolve(const upb_symtab *s, const char *base,
                                   const char *sym, const void *owner) {
-  upb_def *ret = upb_resolvename(&s->symtab, base, sym);
+  upb_def *ret = upb_resolvename(s->scopes, base, sym);
   if (ret) upb_def_ref(ret, owner);
   return ret;
 }
@@ -144,10 +271,9 @@ static bool upb_resolve_dfs(const upb_def *def, upb_strtable *addtab,
   do {
     assert(upb_def_isfrozen(def));
     if (def->type == UPB_DEF_FIELD) continue;
-    upb_value v;
-    if (upb_strtable_lookup(addtab, upb_def_fullname(def), &v)) {
-      // Because we memoize we should not visit a node after we have dup'd it.
-      assert(((upb_def*)upb_value_getptr(v))->came_from_user);
+    // Because we memoize we do not visit a node after we have dup'd it, so
+    // the entry is a def from the user, or a message that is being extended.
+    if (upb_strtable_lookup(addtab, upb_def_fullname(def), NULL)) {
       need_dup = true;
     }
     const upb_msgdef *m = upb_dyncast_msgdef(def);
@@ -188,14 +314,46 @@ oom:
   return false;
 }
 
+// Returns the message in "addtab" that extension "f" extends, adding a dup of
+// it from the symtab if it is not being added already.
+static upb_msgdef *upb_symtab_extendee(upb_symtab *s, upb_strtable *addtab,
+                                       const upb_fielddef *f,
+                                       upb_status *status) {
+  const char *name = upb_fielddef_containingtypename(f);
+  if (name[0] == UPB_SYMBOL_SEPARATOR) name++;
+  upb_value v;
+  upb_def *def = NULL;
+  if (upb_strtable_lookup(addtab, name, &v)) {
+    def = upb_value_getptr(v);
+  } else if (upb_strtable_lookup(&s->symtab, name, &v) &&
+             upb_dyncast_msgdef(upb_value_getptr(v))) {
+    def = upb_def_dup(upb_value_getptr(v), s);
+    if (!def || !upb_strtable_insert(addtab, name, upb_value_ptr(def))) {
+      if (def) upb_def_unref(def, s);
+      upb_status_seterrliteral(status, "out of memory");
+      return NULL;
+    }
+  }
+  upb_msgdef *m = def ? upb_dyncast_msgdef_mutable(def) : NULL;
+  if (!m) {
+    upb_status_seterrf(status, "couldn't find message '%s' extended by '%s'",
+                       name, upb_fielddef_name(f));
+  }
+  return m;
+}
+
 bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
                     upb_status *status) {
   upb_def **add_defs = NULL;
+  upb_symtab_scope *addscopes = NULL;
+  upb_fielddef **exts = NULL;
+  int ext_count = 0;
   upb_strtable addtab;
   if (!upb_strtable_init(&addtab, UPB_CTYPE_PTR)) {
     upb_status_seterrliteral(status, "out of memory");
     return false;
   }
+  if (n > 0 && !(exts = malloc(sizeof(*exts) * n))) goto oom_err;
 
   // Add new defs to table.
   for (int i = 0; i < n; i++) {
@@ -211,6 +369,19 @@ bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
           status, "Anonymous defs cannot be added to a symtab");
       goto err;
     }
+    upb_fielddef *f = upb_dyncast_fielddef_mutable(def);
+    if (f) {
+      if (!upb_fielddef_isextension(f) ||
+          !upb_fielddef_containingtypename(f)) {
+        upb_status_seterrf(
+            status, "field '%s' is not an extension of a named message",
+            fullname);
+        goto err;
+      }
+      upb_def_donateref(def, ref_donor, s);
+      exts[ext_count++] = f;
+      continue;
+    }
     if (upb_strtable_lookup(&addtab, fullname, NULL)) {
       upb_status_seterrf(status, "Conflicting defs named '%s'", fullname);
       goto err;
@@ -223,6 +394,13 @@ bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
       goto oom_err;
   }
 
+  // Add extensions to the messages they extend, which are replaced like any
+  // other message that changes.
+  for (int i = 0; i < ext_count; i++) {
+    upb_msgdef *m = upb_symtab_extendee(s, &addtab, exts[i], status);
+    if (!m || !upb_msgdef_addfield(m, exts[i], s, status)) goto err;
+  }
+
   // Add dups of any existing def that can reach a def with the same name as
   // one of "defs."
   upb_inttable seen;
@@ -237,6 +415,13 @@ bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
   upb_inttable_uninit(&seen);
 
   // Now using the table, resolve symbolic references.
+  if (!(addscopes = upb_scope_new(NULL))) goto oom_err;
+  upb_strtable_begin(&i, &addtab);
+  for (; !upb_strtable_done(&i); upb_strtable_next(&i)) {
+    upb_def *def = upb_value_getptr(upb_strtable_iter_value(&i));
+    if (!upb_scope_add(addscopes, upb_strtable_iter_key(&i), def))
+      goto oom_err;
+  }
   upb_strtable_begin(&i, &addtab);
   for (; !upb_strtable_done(&i); upb_strtable_next(&i)) {
     upb_def *def = upb_value_getptr(upb_strtable_iter_value(&i));
@@ -250,7 +435,7 @@ bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
       upb_fielddef *f = upb_msg_iter_field(&j);
       const char *name = upb_fielddef_subdefname(f);
       if (name) {
-        upb_def *subdef = upb_resolvename(&addtab, base, name);
+        upb_def *subdef = upb_resolvename(addscopes, base, name);
         if (subdef == NULL) {
           upb_status_seterrf(
               status, "couldn't resolve name '%s' in message '%s'", name, base);
@@ -279,6 +464,8 @@ bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
   // This must be delayed until all errors have been detected, since error
   // recovery code uses this table to cleanup defs.
   upb_strtable_uninit(&addtab);
+  upb_scope_free(addscopes);
+  free(exts);
 
   // TODO(haberman) we don't properly handle errors after this point (like
   // OOM in upb_strtable_insert() below).
@@ -290,7 +477,8 @@ bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
       const upb_def *def = upb_value_getptr(v);
       upb_def_unref(def, s);
     }
-    bool success = upb_strtable_insert(&s->symtab, name, upb_value_ptr(def));
+    bool success = upb_strtable_insert(&s->symtab, name, upb_value_ptr(def)) &&
+                   upb_scope_add(s->scopes, name, def);
     UPB_ASSERT_VAR(success, success == true);
   }
   free(add_defs);
@@ -299,21 +487,29 @@ bool upb_symtab_add(upb_symtab *s, upb_def *const*defs, int n, void *ref_donor,
 oom_err:
   upb_status_seterrliteral(status, "out of memory");
 err: {
+    // Extensions that were added to a message now belong to it.
+    for (int i = 0; i < ext_count; i++) {
+      if (!upb_fielddef_msgdef(exts[i]))
+        upb_fielddef_donateref(exts[i], s, ref_donor);
+    }
     // For defs the user passed in, we need to donate the refs back.  For defs
     // we dup'd, we need to just unref them.
     upb_strtable_iter i;
     upb_strtable_begin(&i, &addtab);
     for (; !upb_strtable_done(&i); upb_strtable_next(&i)) {
       upb_def *def = upb_value_getptr(upb_strtable_iter_value(&i));
-      if (def->came_from_user) {
+      bool came_from_user = def->came_from_user;
+      def->came_from_user = false;
+      if (came_from_user) {
         upb_def_donateref(def, s, ref_donor);
       } else {
         upb_def_unref(def, s);
       }
-      def->came_from_user = false;
     }
   }
   upb_strtable_uninit(&addtab);
+  free(exts);
+  if (addscopes) upb_scope_free(addscopes);
   free(add_defs);
   assert(!upb_ok(status));
   return false;
@@ -28,6 +28,8 @@ typedef struct upb_symtab upb_symtab;
 
 #include "upb/def.h"
 
+struct upb_symtab_scope;
+
 #ifdef __cplusplus
 
 class upb::SymbolTable {
@@ -84,6 +86,13 @@ class upb::SymbolTable {
   // themselves be replaced also, so that the resulting set of defs is fully
   // consistent.
   //
+  // The list may also contain extensions: fielddefs with is_extension() and a
+  // containing_type_name(), which must be a full name.  Each is added to the
+  // message it extends, which is replaced like any other def that changes (so
+  // the symtab serves as the registry of extensions).  Extensions are kept
+  // when their message is replaced because something it reaches changed, but
+  // not when a new def of the message itself is added.
+  //
   // This logic implemented in this method is a convenience; ultimately it
   // calls some combination of upb_fielddef_setsubdef(), upb_def_dup(), and
   // upb_freeze(), any of which the client could call themself.  However, since
@@ -92,7 +101,8 @@ class upb::SymbolTable {
   // The entire operation either succeeds or fails.  If the operation fails,
   // the symtab is unchanged, false is returned, and status indicates the
   // error.  The caller passes a ref on all defs to the symtab (even if the
-  // operation fails).
+  // operation fails).  An extension that was added to its message before the
+  // failure stays with that message.
   //
   // TODO(haberman): currently failure will leave the symtab unchanged, but may
   // leave the defs themselves partially resolved.  Does this matter?  If so we
@@ -119,6 +129,7 @@ struct upb_symtab {
 #endif
   upb_refcounted base;
   upb_strtable symtab;
+  struct upb_symtab_scope *scopes;  // Root of the scope tree; see symtab.c.
 };
 
 // Native C API.
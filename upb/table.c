@@ -238,6 +238,21 @@ bool upb_strtable_lookup(const upb_strtable *t, const char *key, upb_value *v) {
   return lookup(&t->t, strkey(key), v, &strhash, &streql);
 }
 
+bool upb_strtable_lookup2(const upb_strtable *t, const char *key, size_t len,
+                          upb_value *v) {
+  if (t->t.size_lg2 == 0) return false;
+  const upb_tabent *e =
+      t->t.entries + (MurmurHash2(key, len, 0) & t->t.mask);
+  if (upb_tabent_isempty(e)) return false;
+  for (; e; e = e->next) {
+    if (strncmp(e->key.str, key, len) == 0 && e->key.str[len] == '\0') {
+      if (v) _upb_value_setval(v, e->val, t->t.type);
+      return true;
+    }
+  }
+  return false;
+}
+
 bool upb_strtable_remove(upb_strtable *t, const char *key, upb_value *val) {
   upb_tabkey tabkey;
   if (rm(&t->t, strkey(key), val, &tabkey, &strhash, &streql)) {
@@ -140,6 +140,11 @@ bool upb_strtable_insert(upb_strtable *t, const char *key, upb_value val);
 bool upb_inttable_lookup(const upb_inttable *t, uintptr_t key, upb_value *v);
 bool upb_strtable_lookup(const upb_strtable *t, const char *key, upb_value *v);
 
+// Like upb_strtable_lookup(), but the key is given as the first "len" bytes of
+// "key" and need not be NULL-terminated.
+bool upb_strtable_lookup2(const upb_strtable *t, const char *key, size_t len,
+                          upb_value *v);
+
 // Removes an item from the table.  Returns true if the remove was successful,
 // and stores the removed item in *val if non-NULL.
 bool upb_inttable_remove(upb_inttable *t, uintptr_t key, upb_value *val);
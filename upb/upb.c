@@ -11,6 +11,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "upb/probes.h"
 #include "upb/upb.h"
 
 #ifdef NDEBUG
@@ -41,6 +42,7 @@ void upb_status_seterrf(upb_status *status, const char *msg, ...) {
   upb_vrprintf(&status->buf, &status->bufsize, 0, msg, args);
   va_end(args);
   status->str = status->buf;
+  UPB_PROBE2(error, status, status->str);
 }
 
 void upb_status_seterrliteral(upb_status *status, const char *msg) {
@@ -48,6 +50,7 @@ void upb_status_seterrliteral(upb_status *status, const char *msg) {
   status->error = true;
   status->str = msg;
   status->space = NULL;
+  UPB_PROBE2(error, status, msg);
 }
 
 void upb_status_copy(upb_status *to, const upb_status *from) {
@@ -171,15 +171,23 @@ char *upb_strdup(const char *s);
   } while (0)
 
 // The maximum that any submessages can be nested.  Matches proto2's limit.
-// At the moment this specifies the size of several statically-sized arrays
-// and therefore setting it high will cause more memory to be used.  Will
-// be replaced by a runtime-configurable limit and dynamically-resizing arrays.
+// Sink and decoder stacks are sized from upb_handlers_maxdepth() and only grow
+// up to this limit for recursive message types.
 // TODO: make this a runtime-settable property of upb_handlers.
 #define UPB_MAX_NESTING 64
 
+// Number of frames initially allocated for stacks whose maximum depth is not
+// known ahead of time (recursive message types).  They grow on demand.
+#define UPB_INITIAL_NESTING 8
+
 // Inherent limit of protobuf wire format and schema definition.
 #define UPB_MAX_FIELDNUMBER ((1 << 29) - 1)
 
+// Decoders keep a 64-bit mask of the required fields seen in each message
+// (see upb_handlers_requiredmask()), so only this many of a message's
+// required fields, the ones with the lowest numbers, are checked.
+#define UPB_MAX_REQUIRED 64
+
 // Nested type names are separated by periods.
 #define UPB_SYMBOL_SEPARATOR '.'
 